@@ -18,6 +18,13 @@
 #define API __declspec(dllimport)
 #endif
 
+/*
+ * Functions which change state and return nothing may be called from any thread.
+ * Calls from threads other than the game's are queued and take effect at the end
+ * of the frame, in the order they were made. Every other function must be called
+ * from the game's thread.
+ */
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -63,6 +70,139 @@ extern "C"
 		ShaderFlags_Count
 	} ShaderFlags;
 
+	/**
+	 * \brief Hooked Direct3D draw entry points counted by \c LanternFrameStats.
+	 * \sa LanternFrameStats
+	 */
+	typedef enum
+	{
+		LanternDraw_Primitive,
+		LanternDraw_IndexedPrimitive,
+		LanternDraw_PrimitiveUP,
+		LanternDraw_IndexedPrimitiveUP,
+		LanternDraw_Count
+	} LanternDraw;
+
+	/**
+	 * \brief The number of buckets in \c LanternFrameStats::shader_start_time.
+	 * Bucket 0 counts calls which took less than 256 nanoseconds, and each
+	 * following bucket doubles the upper bound. The last bucket also counts
+	 * every call slower than that.
+	 */
+#define LANTERN_TIME_BUCKETS 16
+
+	/**
+	 * \brief Work done by Lantern in a single frame.
+	 * \sa frame_stats_get
+	 */
+	typedef struct
+	{
+		/** \brief Index of the frame since the mod was loaded. */
+		uint32_t frame;
+		/** \brief Time from the end of the previous frame to the end of this one, in milliseconds. */
+		float frame_time;
+		/** \brief Draw calls made through each hooked entry point. \sa LanternDraw */
+		uint32_t draws[LanternDraw_Count];
+		/** \brief Changes of shader permutation between draws. */
+		uint32_t shader_switches;
+		/** \brief Shader constant registers uploaded. */
+		uint32_t constant_registers;
+		/** \brief Palette atlases generated. */
+		uint32_t atlas_uploads;
+		/** \brief Materials parsed by the game. */
+		uint32_t material_parses;
+		/** \brief Material, PL and SL callbacks invoked. */
+		uint32_t callback_invocations;
+		/** \brief Shader permutations found in, or added to, the shader cache. */
+		uint32_t shader_cache_hits;
+		uint32_t shader_cache_misses;
+		/** \brief Polybuff streams drawn from, or missing from, the polybuff cache. */
+		uint32_t polybuff_cache_hits;
+		uint32_t polybuff_cache_misses;
+		/**
+		 * \brief Histogram of the time spent setting up shaders for each draw.
+		 * Only collected while enabled with \c frame_stats_enable.
+		 * \sa LANTERN_TIME_BUCKETS
+		 */
+		uint32_t shader_start_time[LANTERN_TIME_BUCKETS];
+	} LanternFrameStats;
+
+	/**
+	 * \brief Subsystems whose memory is tracked by Lantern.
+	 * \sa memory_usage
+	 */
+	typedef enum
+	{
+		/** \brief Pooled palette and source light data. */
+		LanternMemory_Palettes,
+		/** \brief Palette atlas textures. */
+		LanternMemory_Atlases,
+		/** \brief The shader source file. */
+		LanternMemory_ShaderSource,
+		/** \brief Bytecode of created shaders. */
+		LanternMemory_ShaderBytecode,
+		/** \brief Callbacks and instanced models registered through the API. */
+		LanternMemory_Callbacks,
+		LanternMemory_Count
+	} LanternMemoryTag;
+
+	/**
+	 * \brief Memory held by a subsystem.
+	 * \sa memory_usage
+	 */
+	typedef struct
+	{
+		/** \brief Bytes currently held. */
+		size_t bytes;
+		/** \brief Allocations currently held. */
+		size_t allocations;
+		/** \brief The most bytes held at once since the mod was loaded. */
+		size_t peak_bytes;
+	} LanternMemoryUsage;
+
+	/**
+	 * \brief Deduplication of palette and source light data across palette instances.
+	 * Palettes and sources identical to ones already held by another instance are
+	 * shared with it, as are the palette's rows in the combined atlas.
+	 * \sa palette_stats
+	 */
+	typedef struct
+	{
+		/** \brief Palettes and source files loaded. */
+		uint32_t palette_loads;
+		uint32_t source_loads;
+		/** \brief Loads identical to data already held, which share it instead of keeping a copy. */
+		uint32_t palette_dedupes;
+		uint32_t source_dedupes;
+		/**
+		 * \brief Palettes written to the combined atlas, and instances which shared the
+		 * rows of an identical palette instead, counted each time the atlas is updated.
+		 */
+		uint32_t atlases_generated;
+		uint32_t atlases_shared;
+		/** \brief Distinct palettes and sources currently held. */
+		uint32_t unique_palettes;
+		uint32_t unique_sources;
+	} LanternPaletteStats;
+
+	/**
+	 * \brief Identifies a palette loaded ahead of time through the API. 0 is never a valid handle.
+	 * \sa palette_handle_create
+	 */
+	typedef uint32_t lantern_palette_handle;
+
+	/**
+	 * \brief Where a palette handle is used in place of the palettes loaded for the stage.
+	 * \sa palette_handle_bind
+	 */
+	typedef enum
+	{
+		/** \brief The palette blended from, normally the stage's own. */
+		LanternBinding_Primary,
+		/** \brief The palette blended towards, normally the second loaded one. */
+		LanternBinding_Blend,
+	} LanternBinding;
+
 	/**
 	 * \brief The function prototype used for level-load callbacks.
 	 * Level-load callbacks can be used to provide custom Lantern files.
@@ -126,6 +266,28 @@ extern "C"
 	 */
 	API void sl_load_unregister(lantern_load_cb callback);
 
+	/**
+	 * \brief Register a pure level-load callback to provide custom PL (palette) files to the API.
+	 * A pure callback's result depends only on the level, act and time of day, and doesn't change
+	 * while it's registered, so it's only called once for each of them. To change its results,
+	 * unregister and register it again.
+	 * \param callback A pointer to a function which will act as the callback.
+	 *
+	 * \sa pl_load_register
+	 * \sa pl_load_unregister
+	 */
+	API void pl_load_register_pure(lantern_load_cb callback);
+
+	/**
+	 * \brief Register a pure level-load callback to provide custom SL (source light) files to the API.
+	 * \param callback A pointer to a function which will act as the callback.
+	 *
+	 * \sa pl_load_register_pure
+	 * \sa sl_load_register
+	 * \sa sl_load_unregister
+	 */
+	API void sl_load_register_pure(lantern_load_cb callback);
+
 	/**
 	 * \brief Register a material callback.
 	 * Material callbacks can be used to apply parameters when a specific material is encountered.
@@ -149,6 +311,33 @@ extern "C"
 	 */
 	API void material_unregister(NJS_MATERIAL const* const* materials, size_t length, lantern_material_cb callback);
 
+	/**
+	 * \brief Marks models as safe to draw with hardware instancing.
+	 * Consecutive draws of the same registered model are queued and drawn
+	 * together, with each meshset's material parsed once for all of them.
+	 * Only use this for models whose draws don't depend on state changed
+	 * between them, other than their position. Lantern parameters set by
+	 * material callbacks are still applied.
+	 * Each meshset is drawn for every instance before the next meshset,
+	 * so overlapping instances of models using alpha blending may blend
+	 * in a different order than they would otherwise.
+	 * \param models An array of pointers to \c NJS_MODEL_SADX to mark.
+	 * \param length Length of \p models
+	 *
+	 * \sa instancing_unregister
+	 */
+	API void instancing_register(NJS_MODEL_SADX const* const* models, size_t length);
+
+	/**
+	 * \brief Unmarks models previously marked with \c instancing_register.
+	 * Must be called before a registered model is freed.
+	 * \param models An array of pointers to \c NJS_MODEL_SADX to unmark.
+	 * \param length Length of \p models
+	 *
+	 * \sa instancing_register
+	 */
+	API void instancing_unregister(NJS_MODEL_SADX const* const* models, size_t length);
+
 	/**
 	 * \brief Permanently add or remove material flags to be used during the next draw call.
 	 * \param flags The flags to add or remove.
@@ -337,6 +526,105 @@ extern "C"
 	 */
 	API void set_light_direction(const NJS_VECTOR* v);
 
+	/**
+	 * \brief Enables or disables timing of the shader setup done for each draw.
+	 * Other frame statistics are always collected.
+	 * \sa LanternFrameStats
+	 */
+	API void frame_stats_enable(bool enable);
+
+	/**
+	 * \brief Returns the number of completed frames available to \c frame_stats_get.
+	 */
+	API size_t frame_stats_count(void);
+
+	/**
+	 * \brief Gets the statistics of a recently completed frame.
+	 * \param frames_ago 0 for the most recently completed frame, 1 for the one before it, and so on.
+	 * \param stats Receives the statistics.
+	 * \return \c false if \p frames_ago is not less than \c frame_stats_count.
+	 */
+	API bool frame_stats_get(size_t frames_ago, LanternFrameStats* stats);
+
+	/**
+	 * \brief Writes the statistics of every frame available to \c frame_stats_get to a CSV file.
+	 * \param path Path of the file to create or overwrite.
+	 * \return \c false if the file could not be written.
+	 */
+	API bool frame_stats_dump(const char* path);
+
+	/**
+	 * \brief Starts or stops recording timeline markers in Lantern's hooks.
+	 * \sa timeline_dump
+	 */
+	API void timeline_enable(bool enable);
+
+	/**
+	 * \brief Writes the most recently recorded timeline markers as Chrome trace event JSON,
+	 * which can be opened in chrome://tracing or ui.perfetto.dev.
+	 * \param path Path of the file to create or overwrite.
+	 * \return \c false if the file could not be written.
+	 * \sa timeline_enable
+	 */
+	API bool timeline_dump(const char* path);
+
+	/**
+	 * \brief Gets the memory currently held by a subsystem.
+	 * \param tag The subsystem to query.
+	 * \param usage Receives the memory usage.
+	 * \return \c false if \p tag is out of range.
+	 */
+	API bool memory_usage(LanternMemoryTag tag, LanternMemoryUsage* usage);
+
+	/**
+	 * \brief Gets palette deduplication statistics since the mod was loaded.
+	 * \param stats Receives the statistics.
+	 * \return \c false if \p stats is null.
+	 */
+	API bool palette_stats(LanternPaletteStats* stats);
+
+	/**
+	 * \brief Creates a palette handle with no palette loaded.
+	 * Palettes loaded into handles stay resident until released, so switching
+	 * between them with \c palette_handle_bind never touches the disk or the atlas.
+	 * \return The new handle.
+	 * \sa palette_handle_load
+	 * \sa palette_handle_release
+	 */
+	API lantern_palette_handle palette_handle_create(void);
+
+	/**
+	 * \brief Loads a PL (palette) file into a palette handle.
+	 * \param handle The handle to load into.
+	 * \param path Path of the PL file.
+	 * \return \c false if \p handle is invalid or the file could not be loaded.
+	 */
+	API bool palette_handle_load(lantern_palette_handle handle, const char* path);
+
+	/**
+	 * \brief Loads an SL (source light) file into a palette handle.
+	 * Its light direction is used while the handle is bound as the primary palette.
+	 * \param handle The handle to load into.
+	 * \param path Path of the SL file.
+	 * \return \c false if \p handle is invalid or the file could not be loaded.
+	 */
+	API bool palette_handle_load_source(lantern_palette_handle handle, const char* path);
+
+	/**
+	 * \brief Uses a palette handle in place of the stage's palettes.
+	 * \param handle The handle to bind, or 0 to restore the stage's palette.
+	 * \param binding Where to bind the handle.
+	 * \return \c false if \p handle or \p binding is invalid.
+	 */
+	API bool palette_handle_bind(lantern_palette_handle handle, LanternBinding binding);
+
+	/**
+	 * \brief Releases a palette handle, unbinding it if it's bound.
+	 * \param handle The handle to release.
+	 * \return \c false if \p handle is invalid.
+	 */
+	API bool palette_handle_release(lantern_palette_handle handle);
+
 #ifdef __cplusplus
 }
 #endif
@@ -5,6 +5,8 @@
 #include <MemAccess.h>
 #include <Trampoline.h>
 
+#include <vector>
+
 // Static materials (in the main exe)
 #include "ssgarden.h"
 #include "ecgarden.h"
@@ -19,169 +21,495 @@ static Trampoline* ChaoGardenMR_SetLandTable_Day_t     = nullptr;
 static Trampoline* ChaoGardenMR_SetLandTable_Evening_t = nullptr;
 static Trampoline* ChaoGardenMR_SetLandTable_Night_t   = nullptr;
 
-template <typename T = NJS_MATERIAL, size_t N>
-void copy_materials(const T (&mats)[N], size_t offset, HMODULE key = reinterpret_cast<HMODULE>(0x400000))
+struct MaterialList
+{
+	const NJS_MATERIAL* materials;
+	size_t count;
+	size_t offset;
+};
+
+template <size_t N>
+constexpr MaterialList material_list(const NJS_MATERIAL (&materials)[N], size_t offset)
 {
-	memcpy((void*)((int)key + offset), (void*)mats, sizeof(T) * N);
+	return { materials, N, offset };
 }
 
 /// <summary>
-/// Copies materials that are shared between day time
-/// and evening Mystic Ruins Chao Gardens.
+/// A set of material lists applied to a module as a single unit.
+/// The lists are reduced to a delta of the 32-bit words which actually differ
+/// from the module's own data the first time the set is applied, so subsequent
+/// applications only touch words that were changed since.
+///
+/// Being active at the same base doesn't mean the module is still patched: the
+/// Mystic Ruins garden module is freed and reloaded at its preferred base on
+/// time of day changes and on re-entering the garden, so every application
+/// checks the patched words themselves.
 /// </summary>
-static void copy_shared()
+class PatchSet
+{
+	struct Delta
+	{
+		Uint32* dest;
+		Uint32 value;
+		Uint32 original;
+	};
+
+	const char* name;
+	const MaterialList* lists;
+	const size_t count;
+
+	std::vector<Delta> deltas;
+	size_t base = 0;
+	bool active = false;
+
+	void build(size_t new_base);
+
+public:
+	template <size_t N>
+	PatchSet(const char* name, const MaterialList (&lists)[N])
+		: name(name),
+		  lists(lists),
+		  count(N)
+	{
+	}
+
+	/// <summary>
+	/// Applies the set to the module at the specified base address.
+	/// Writes nothing if every patched word already holds its patched value.
+	/// </summary>
+	/// <returns>The number of bytes written.</returns>
+	size_t apply(size_t new_base);
+
+	/// <summary>
+	/// Restores the module's original data if the set is active.
+	/// </summary>
+	/// <returns>The number of bytes written.</returns>
+	size_t revert(size_t current_base);
+};
+
+void PatchSet::build(size_t new_base)
+{
+	deltas.clear();
+	base = new_base;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const auto& list = lists[i];
+
+		const auto dest   = reinterpret_cast<Uint32*>(base + list.offset);
+		const auto source = reinterpret_cast<const Uint32*>(list.materials);
+		const size_t n    = list.count * sizeof(NJS_MATERIAL) / sizeof(Uint32);
+
+		for (size_t j = 0; j < n; j++)
+		{
+			if (dest[j] != source[j])
+			{
+				deltas.push_back({ &dest[j], source[j], dest[j] });
+			}
+		}
+	}
+
+	deltas.shrink_to_fit();
+
+	PrintDebug("[lantern] Chao Garden patch set \"%s\": %u changed words\n", name, deltas.size());
+}
+
+size_t PatchSet::apply(size_t new_base)
+{
+	if (!new_base)
+	{
+		return 0;
+	}
+
+	if (base != new_base)
+	{
+		build(new_base);
+	}
+
+	size_t written = 0;
+
+	for (auto& delta : deltas)
+	{
+		if (*delta.dest != delta.value)
+		{
+			*delta.dest = delta.value;
+			written += sizeof(Uint32);
+		}
+	}
+
+	active = true;
+	return written;
+}
+
+size_t PatchSet::revert(size_t current_base)
 {
-	copy_materials(matlist_00007404, 0x00007404, ModuleHandles[2]);
-	copy_materials(matlist_00007518, 0x00007518, ModuleHandles[2]);
-	copy_materials(matlist_00008A08, 0x00008A08, ModuleHandles[2]);
-	copy_materials(matlist_0000955C, 0x0000955C, ModuleHandles[2]);
-	copy_materials(matlist_00009DA0, 0x00009DA0, ModuleHandles[2]);
-	copy_materials(matlist_0000A000, 0x0000A000, ModuleHandles[2]);
-	copy_materials(matlist_0000A8D0, 0x0000A8D0, ModuleHandles[2]);
-	copy_materials(matlist_0000BF90, 0x0000BF90, ModuleHandles[2]);
-	copy_materials(matlist_0000FE98, 0x0000FE98, ModuleHandles[2]);
-	copy_materials(matlist_000106CC, 0x000106CC, ModuleHandles[2]);
-	copy_materials(matlist_00010848, 0x00010848, ModuleHandles[2]);
-	copy_materials(matlist_00013700, 0x00013700, ModuleHandles[2]);
-	copy_materials(matlist_00013B08, 0x00013B08, ModuleHandles[2]);
-	copy_materials(matlist_00014030, 0x00014030, ModuleHandles[2]);
-	copy_materials(matlist_00014518, 0x00014518, ModuleHandles[2]);
-	copy_materials(matlist_00014A18, 0x00014A18, ModuleHandles[2]);
-	copy_materials(matlist_00014EE8, 0x00014EE8, ModuleHandles[2]);
-	copy_materials(matlist_000153B8, 0x000153B8, ModuleHandles[2]);
-	copy_materials(matlist_000156F0, 0x000156F0, ModuleHandles[2]);
-	copy_materials(matlist_00015C58, 0x00015C58, ModuleHandles[2]);
-	copy_materials(matlist_00016070, 0x00016070, ModuleHandles[2]);
-	copy_materials(matlist_000165B8, 0x000165B8, ModuleHandles[2]);
-	copy_materials(matlist_00017778, 0x00017778, ModuleHandles[2]);
-	copy_materials(matlist_00017AC0, 0x00017AC0, ModuleHandles[2]);
-	copy_materials(matlist_00017E08, 0x00017E08, ModuleHandles[2]);
-	copy_materials(matlist_00018788, 0x00018788, ModuleHandles[2]);
-	copy_materials(matlist_00018DCC, 0x00018DCC, ModuleHandles[2]);
-	copy_materials(matlist_0001940C, 0x0001940C, ModuleHandles[2]);
-	copy_materials(matlist_00019A4C, 0x00019A4C, ModuleHandles[2]);
-	copy_materials(matlist_0001A08C, 0x0001A08C, ModuleHandles[2]);
-	copy_materials(matlist_0001A6CC, 0x0001A6CC, ModuleHandles[2]);
-	copy_materials(matlist_0001AD0C, 0x0001AD0C, ModuleHandles[2]);
-	copy_materials(matlist_0001B34C, 0x0001B34C, ModuleHandles[2]);
-	copy_materials(matlist_0001B98C, 0x0001B98C, ModuleHandles[2]);
-	copy_materials(matlist_0001BFCC, 0x0001BFCC, ModuleHandles[2]);
-	copy_materials(matlist_0001C60C, 0x0001C60C, ModuleHandles[2]);
-	copy_materials(matlist_0001D78C, 0x0001D78C, ModuleHandles[2]);
-	copy_materials(matlist_0001E90C, 0x0001E90C, ModuleHandles[2]);
-	copy_materials(matlist_0001FA8C, 0x0001FA8C, ModuleHandles[2]);
-	copy_materials(matlist_00020C0C, 0x00020C0C, ModuleHandles[2]);
-	copy_materials(matlist_00021D8C, 0x00021D8C, ModuleHandles[2]);
-	copy_materials(matlist_00022F0C, 0x00022F0C, ModuleHandles[2]);
-	copy_materials(matlist_0002408C, 0x0002408C, ModuleHandles[2]);
-	copy_materials(matlist_0002520C, 0x0002520C, ModuleHandles[2]);
-	copy_materials(matlist_0002638C, 0x0002638C, ModuleHandles[2]);
-	copy_materials(matlist_0002750C, 0x0002750C, ModuleHandles[2]);
-	copy_materials(matlist_0002868C, 0x0002868C, ModuleHandles[2]);
-	copy_materials(matlist_0002980C, 0x0002980C, ModuleHandles[2]);
-	copy_materials(matlist_0002A98C, 0x0002A98C, ModuleHandles[2]);
-	copy_materials(matlist_0002BB0C, 0x0002BB0C, ModuleHandles[2]);
-	copy_materials(matlist_0002CC90, 0x0002CC90, ModuleHandles[2]);
-	copy_materials(matlist_0002D308, 0x0002D308, ModuleHandles[2]);
-	copy_materials(matlist_0002D9A0, 0x0002D9A0, ModuleHandles[2]);
-	copy_materials(matlist_0002E038, 0x0002E038, ModuleHandles[2]);
-	copy_materials(matlist_0002E2C0, 0x0002E2C0, ModuleHandles[2]);
-	copy_materials(matlist_0002E548, 0x0002E548, ModuleHandles[2]);
-	copy_materials(matlist_0002E7D0, 0x0002E7D0, ModuleHandles[2]);
-	copy_materials(matlist_0002EEA0, 0x0002EEA0, ModuleHandles[2]);
-	copy_materials(matlist_0002FC88, 0x0002FC88, ModuleHandles[2]);
-	copy_materials(matlist_000305C8, 0x000305C8, ModuleHandles[2]);
-	copy_materials(matlist_00030EF8, 0x00030EF8, ModuleHandles[2]);
-	copy_materials(matlist_000322B0, 0x000322B0, ModuleHandles[2]);
-	copy_materials(matlist_00032BDC, 0x00032BDC, ModuleHandles[2]);
-	copy_materials(matlist_00033730, 0x00033730, ModuleHandles[2]);
+	if (!active)
+	{
+		return 0;
+	}
+
+	active = false;
+
+	// The module has been reloaded elsewhere, so there's nothing to restore.
+	if (base != current_base)
+	{
+		return 0;
+	}
+
+	size_t written = 0;
+
+	for (auto& delta : deltas)
+	{
+		if (*delta.dest != delta.original)
+		{
+			*delta.dest = delta.original;
+			written += sizeof(Uint32);
+		}
+	}
+
+	return written;
+}
+
+/// Materials that are shared between day time
+/// and evening Mystic Ruins Chao Gardens.
+static const MaterialList mr_shared_lists[] = {
+	material_list(matlist_00007404, 0x00007404),
+	material_list(matlist_00007518, 0x00007518),
+	material_list(matlist_00008A08, 0x00008A08),
+	material_list(matlist_0000955C, 0x0000955C),
+	material_list(matlist_00009DA0, 0x00009DA0),
+	material_list(matlist_0000A000, 0x0000A000),
+	material_list(matlist_0000A8D0, 0x0000A8D0),
+	material_list(matlist_0000BF90, 0x0000BF90),
+	material_list(matlist_0000FE98, 0x0000FE98),
+	material_list(matlist_000106CC, 0x000106CC),
+	material_list(matlist_00010848, 0x00010848),
+	material_list(matlist_00013700, 0x00013700),
+	material_list(matlist_00013B08, 0x00013B08),
+	material_list(matlist_00014030, 0x00014030),
+	material_list(matlist_00014518, 0x00014518),
+	material_list(matlist_00014A18, 0x00014A18),
+	material_list(matlist_00014EE8, 0x00014EE8),
+	material_list(matlist_000153B8, 0x000153B8),
+	material_list(matlist_000156F0, 0x000156F0),
+	material_list(matlist_00015C58, 0x00015C58),
+	material_list(matlist_00016070, 0x00016070),
+	material_list(matlist_000165B8, 0x000165B8),
+	material_list(matlist_00017778, 0x00017778),
+	material_list(matlist_00017AC0, 0x00017AC0),
+	material_list(matlist_00017E08, 0x00017E08),
+	material_list(matlist_00018788, 0x00018788),
+	material_list(matlist_00018DCC, 0x00018DCC),
+	material_list(matlist_0001940C, 0x0001940C),
+	material_list(matlist_00019A4C, 0x00019A4C),
+	material_list(matlist_0001A08C, 0x0001A08C),
+	material_list(matlist_0001A6CC, 0x0001A6CC),
+	material_list(matlist_0001AD0C, 0x0001AD0C),
+	material_list(matlist_0001B34C, 0x0001B34C),
+	material_list(matlist_0001B98C, 0x0001B98C),
+	material_list(matlist_0001BFCC, 0x0001BFCC),
+	material_list(matlist_0001C60C, 0x0001C60C),
+	material_list(matlist_0001D78C, 0x0001D78C),
+	material_list(matlist_0001E90C, 0x0001E90C),
+	material_list(matlist_0001FA8C, 0x0001FA8C),
+	material_list(matlist_00020C0C, 0x00020C0C),
+	material_list(matlist_00021D8C, 0x00021D8C),
+	material_list(matlist_00022F0C, 0x00022F0C),
+	material_list(matlist_0002408C, 0x0002408C),
+	material_list(matlist_0002520C, 0x0002520C),
+	material_list(matlist_0002638C, 0x0002638C),
+	material_list(matlist_0002750C, 0x0002750C),
+	material_list(matlist_0002868C, 0x0002868C),
+	material_list(matlist_0002980C, 0x0002980C),
+	material_list(matlist_0002A98C, 0x0002A98C),
+	material_list(matlist_0002BB0C, 0x0002BB0C),
+	material_list(matlist_0002CC90, 0x0002CC90),
+	material_list(matlist_0002D308, 0x0002D308),
+	material_list(matlist_0002D9A0, 0x0002D9A0),
+	material_list(matlist_0002E038, 0x0002E038),
+	material_list(matlist_0002E2C0, 0x0002E2C0),
+	material_list(matlist_0002E548, 0x0002E548),
+	material_list(matlist_0002E7D0, 0x0002E7D0),
+	material_list(matlist_0002EEA0, 0x0002EEA0),
+	material_list(matlist_0002FC88, 0x0002FC88),
+	material_list(matlist_000305C8, 0x000305C8),
+	material_list(matlist_00030EF8, 0x00030EF8),
+	material_list(matlist_000322B0, 0x000322B0),
+	material_list(matlist_00032BDC, 0x00032BDC),
+	material_list(matlist_00033730, 0x00033730),
+};
+
+static const MaterialList mr_day_lists[] = {
+	material_list(matlist_00009440, 0x00009440),
+};
+
+static const MaterialList mr_evening_lists[] = {
+	material_list(matlist_00009440_e, 0x00009440),
+};
+
+static const MaterialList mr_night_lists[] = {
+	material_list(matlist_00007254, 0x00007254),
+	material_list(matlist_00007368, 0x00007368),
+	material_list(matlist_00008858, 0x00008858),
+	material_list(matlist_00009290, 0x00009290),
+	material_list(matlist_000093C0, 0x000093C0),
+	material_list(matlist_00009C08, 0x00009C08),
+	material_list(matlist_00009E68, 0x00009E68),
+	material_list(matlist_0000A738, 0x0000A738),
+	material_list(matlist_0000BDF8, 0x0000BDF8),
+	material_list(matlist_0000FD00, 0x0000FD00),
+	material_list(matlist_00010534, 0x00010534),
+	material_list(matlist_000106B0, 0x000106B0),
+	material_list(matlist_00013568, 0x00013568),
+	material_list(matlist_00013970, 0x00013970),
+	material_list(matlist_00013E98, 0x00013E98),
+	material_list(matlist_00014380, 0x00014380),
+	material_list(matlist_00014880, 0x00014880),
+	material_list(matlist_00014D50, 0x00014D50),
+	material_list(matlist_00015220, 0x00015220),
+	material_list(matlist_00015558, 0x00015558),
+	material_list(matlist_00015AC0, 0x00015AC0),
+	material_list(matlist_00015ED8, 0x00015ED8),
+	material_list(matlist_00016420, 0x00016420),
+	material_list(matlist_000175E0, 0x000175E0),
+	material_list(matlist_00017928, 0x00017928),
+	material_list(matlist_00017C70, 0x00017C70),
+	material_list(matlist_000185F0, 0x000185F0),
+	material_list(matlist_00018C34, 0x00018C34),
+	material_list(matlist_00019274, 0x00019274),
+	material_list(matlist_000198B4, 0x000198B4),
+	material_list(matlist_00019EF4, 0x00019EF4),
+	material_list(matlist_0001A534, 0x0001A534),
+	material_list(matlist_0001AB74, 0x0001AB74),
+	material_list(matlist_0001B1B4, 0x0001B1B4),
+	material_list(matlist_0001B7F4, 0x0001B7F4),
+	material_list(matlist_0001BE34, 0x0001BE34),
+	material_list(matlist_0001C474, 0x0001C474),
+	material_list(matlist_0001D5F4, 0x0001D5F4),
+	material_list(matlist_0001E774, 0x0001E774),
+	material_list(matlist_0001F8F4, 0x0001F8F4),
+	material_list(matlist_00020A74, 0x00020A74),
+	material_list(matlist_00021BF4, 0x00021BF4),
+	material_list(matlist_00022D74, 0x00022D74),
+	material_list(matlist_00023EF4, 0x00023EF4),
+	material_list(matlist_00025074, 0x00025074),
+	material_list(matlist_000261F4, 0x000261F4),
+	material_list(matlist_00027374, 0x00027374),
+	material_list(matlist_000284F4, 0x000284F4),
+	material_list(matlist_00029674, 0x00029674),
+	material_list(matlist_0002A7F4, 0x0002A7F4),
+	material_list(matlist_0002B974, 0x0002B974),
+	material_list(matlist_0002CAF8, 0x0002CAF8),
+	material_list(matlist_0002D170, 0x0002D170),
+	material_list(matlist_0002D808, 0x0002D808),
+	material_list(matlist_0002DEA0, 0x0002DEA0),
+	material_list(matlist_0002E128, 0x0002E128),
+	material_list(matlist_0002E3B0, 0x0002E3B0),
+	material_list(matlist_0002E638, 0x0002E638),
+	material_list(matlist_0002ED08, 0x0002ED08),
+	material_list(matlist_0002FAF0, 0x0002FAF0),
+	material_list(matlist_00030430, 0x00030430),
+	material_list(matlist_00030D60, 0x00030D60),
+	material_list(matlist_00032118, 0x00032118),
+	material_list(matlist_00032A44, 0x00032A44),
+	material_list(matlist_000338D8, 0x000338D8),
+};
+
+static const MaterialList ss_lists[] = {
+	material_list(matlist_03236884, 0x03236884),
+	material_list(matlist_03236AF8, 0x03236AF8),
+	material_list(matlist_03236D08, 0x03236D08),
+	material_list(matlist_03236E70, 0x03236E70),
+	material_list(matlist_03237250, 0x03237250),
+	material_list(matlist_03237560, 0x03237560),
+	material_list(matlist_03237A50, 0x03237A50),
+	material_list(matlist_03237FB8, 0x03237FB8),
+	material_list(matlist_03238388, 0x03238388),
+	material_list(matlist_03238E54, 0x03238E54),
+	material_list(matlist_032390C0, 0x032390C0),
+	material_list(matlist_03239438, 0x03239438),
+	material_list(matlist_03239AD4, 0x03239AD4),
+	material_list(matlist_03239C40, 0x03239C40),
+	material_list(matlist_03239FE0, 0x03239FE0),
+	material_list(matlist_0323A148, 0x0323A148),
+	material_list(matlist_0323A2B0, 0x0323A2B0),
+	material_list(matlist_0323A444, 0x0323A444),
+	material_list(matlist_0323A9D8, 0x0323A9D8),
+	material_list(matlist_0323AC10, 0x0323AC10),
+	material_list(matlist_0323B7B8, 0x0323B7B8),
+	material_list(matlist_0323B8F0, 0x0323B8F0),
+	material_list(matlist_0323BA98, 0x0323BA98),
+	material_list(matlist_0323BCD0, 0x0323BCD0),
+	material_list(matlist_0323BE38, 0x0323BE38),
+	material_list(matlist_0323BFA0, 0x0323BFA0),
+	material_list(matlist_0323C4F0, 0x0323C4F0),
+	material_list(matlist_03243EB0, 0x03243EB0),
+	material_list(matlist_032446F0, 0x032446F0),
+	material_list(matlist_03245900, 0x03245900),
+	material_list(matlist_03248830, 0x03248830),
+	material_list(matlist_03249754, 0x03249754),
+	material_list(matlist_0324B524, 0x0324B524),
+	material_list(matlist_0324C238, 0x0324C238),
+	material_list(matlist_0324C9EC, 0x0324C9EC),
+	material_list(matlist_0324CB08, 0x0324CB08),
+	material_list(matlist_0324CC28, 0x0324CC28),
+	material_list(matlist_0324E098, 0x0324E098),
+	material_list(matlist_03254028, 0x03254028),
+	material_list(matlist_03255714, 0x03255714),
+	material_list(matlist_03257214, 0x03257214),
+	material_list(matlist_03257E00, 0x03257E00),
+	material_list(matlist_03258DA0, 0x03258DA0),
+	material_list(matlist_032594B0, 0x032594B0),
+	material_list(matlist_0325A450, 0x0325A450),
+	material_list(matlist_0325AB60, 0x0325AB60),
+	material_list(matlist_0325B744, 0x0325B744),
+	material_list(matlist_0325BCB8, 0x0325BCB8),
+	material_list(matlist_0325D7A4, 0x0325D7A4),
+	material_list(matlist_0325E390, 0x0325E390),
+	material_list(matlist_0325F660, 0x0325F660),
+	material_list(matlist_03260160, 0x03260160),
+	material_list(matlist_03261900, 0x03261900),
+	material_list(matlist_03262058, 0x03262058),
+	material_list(matlist_03262DDC, 0x03262DDC),
+	material_list(matlist_03264B08, 0x03264B08),
+	material_list(matlist_03264D60, 0x03264D60),
+	material_list(matlist_03269D68, 0x03269D68),
+	material_list(matlist_0326A754, 0x0326A754),
+	material_list(matlist_0326A8E4, 0x0326A8E4),
+};
+
+static const MaterialList ec_lists[] = {
+	material_list(matlist_02FD83B0, 0x02FD83B0),
+	material_list(matlist_02FD8938, 0x02FD8938),
+	material_list(matlist_02FD0F64, 0x02FD0F64),
+	material_list(matlist_02FD116C, 0x02FD116C),
+	material_list(matlist_02FD24CC, 0x02FD24CC),
+	material_list(matlist_02FD4810, 0x02FD4810),
+	material_list(matlist_02FD4AC0, 0x02FD4AC0),
+	material_list(matlist_02FD4D58, 0x02FD4D58),
+	material_list(matlist_02FD583C, 0x02FD583C),
+	material_list(matlist_02FD59B8, 0x02FD59B8),
+	material_list(matlist_02FD5B4C, 0x02FD5B4C),
+	material_list(matlist_02FD5CE4, 0x02FD5CE4),
+	material_list(matlist_02FD5E7C, 0x02FD5E7C),
+	material_list(matlist_02FD6018, 0x02FD6018),
+	material_list(matlist_02FD75F8, 0x02FD75F8),
+	material_list(matlist_02FD9148, 0x02FD9148),
+	material_list(matlist_02FDC7B8, 0x02FDC7B8),
+	material_list(matlist_02FDE5AC, 0x02FDE5AC),
+	material_list(matlist_02FE0104, 0x02FE0104),
+	material_list(matlist_02FE4F68, 0x02FE4F68),
+	material_list(matlist_02FE6E6C, 0x02FE6E6C),
+	material_list(matlist_02FE7A18, 0x02FE7A18),
+	material_list(matlist_02FE8538, 0x02FE8538),
+	material_list(matlist_02FE90A0, 0x02FE90A0),
+	material_list(matlist_02FE9C48, 0x02FE9C48),
+	material_list(matlist_02FE9F58, 0x02FE9F58),
+	material_list(matlist_02FEAA38, 0x02FEAA38),
+	material_list(matlist_02FEB5E0, 0x02FEB5E0),
+	material_list(matlist_02FEB850, 0x02FEB850),
+	material_list(matlist_02FEC420, 0x02FEC420),
+	material_list(matlist_02FECFC8, 0x02FECFC8),
+	material_list(matlist_02FED238, 0x02FED238),
+	material_list(matlist_02FEDB10, 0x02FEDB10),
+	material_list(matlist_02FEE5E0, 0x02FEE5E0),
+	material_list(matlist_02FEEF78, 0x02FEEF78),
+	material_list(matlist_02FEFA58, 0x02FEFA58),
+	material_list(matlist_02FEFBDC, 0x02FEFBDC),
+	material_list(matlist_02FEFE7C, 0x02FEFE7C),
+	material_list(matlist_02FF002C, 0x02FF002C),
+	material_list(matlist_02FF01B4, 0x02FF01B4),
+	material_list(matlist_02FF03C4, 0x02FF03C4),
+	material_list(matlist_02FF0BC8, 0x02FF0BC8),
+	material_list(matlist_02FF1EB8, 0x02FF1EB8),
+	material_list(matlist_02FF33D0, 0x02FF33D0),
+	material_list(matlist_02FF3500, 0x02FF3500),
+	material_list(matlist_02FF38D0, 0x02FF38D0),
+	material_list(matlist_02FF3CA0, 0x02FF3CA0),
+	material_list(matlist_02FF4070, 0x02FF4070),
+	material_list(matlist_02FF4440, 0x02FF4440),
+	material_list(matlist_02FF4810, 0x02FF4810),
+	material_list(matlist_02FF4BE0, 0x02FF4BE0),
+	material_list(matlist_02FF4FB0, 0x02FF4FB0),
+	material_list(matlist_02FF5380, 0x02FF5380),
+	material_list(matlist_02FF5750, 0x02FF5750),
+	material_list(matlist_02FF5B20, 0x02FF5B20),
+	material_list(matlist_02FF5EF0, 0x02FF5EF0),
+	material_list(matlist_02FF62C0, 0x02FF62C0),
+	material_list(matlist_02FF6690, 0x02FF6690),
+	material_list(matlist_02FF6A60, 0x02FF6A60),
+	material_list(matlist_02FF6E30, 0x02FF6E30),
+	material_list(matlist_02FF7200, 0x02FF7200),
+	material_list(matlist_02FF75D0, 0x02FF75D0),
+	material_list(matlist_02FF79A0, 0x02FF79A0),
+	material_list(matlist_02FF7D70, 0x02FF7D70),
+	material_list(matlist_02FF7EF8, 0x02FF7EF8),
+	material_list(matlist_02FF9BD4, 0x02FF9BD4),
+	material_list(matlist_02FFA2D0, 0x02FFA2D0),
+	material_list(matlist_02FFA9D0, 0x02FFA9D0),
+	material_list(matlist_02FFB0D0, 0x02FFB0D0),
+	material_list(matlist_02FFB7D0, 0x02FFB7D0),
+	material_list(matlist_02FFC674, 0x02FFC674),
+	material_list(matlist_02FFD018, 0x02FFD018),
+	material_list(matlist_030007B4, 0x030007B4),
+	material_list(matlist_03000C10, 0x03000C10),
+	material_list(matlist_03001964, 0x03001964),
+	material_list(matlist_03001DC0, 0x03001DC0),
+	material_list(matlist_03002B14, 0x03002B14),
+	material_list(matlist_03002F70, 0x03002F70),
+	material_list(matlist_03003CC4, 0x03003CC4),
+	material_list(matlist_03004120, 0x03004120),
+};
+
+static PatchSet mr_shared("Mystic Ruins (shared)", mr_shared_lists);
+static PatchSet mr_day("Mystic Ruins (day)", mr_day_lists);
+static PatchSet mr_evening("Mystic Ruins (evening)", mr_evening_lists);
+static PatchSet mr_night("Mystic Ruins (night)", mr_night_lists);
+static PatchSet ss_garden("Station Square", ss_lists);
+static PatchSet ec_garden("Egg Carrier", ec_lists);
+
+static void report(const char* transition, size_t written)
+{
+	PrintDebug("[lantern] Chao Garden materials (%s): %u bytes written\n", transition, written);
+}
+
+static size_t mr_base()
+{
+	return reinterpret_cast<size_t>(ModuleHandles[2]);
 }
 
 static void __cdecl ChaoGardenMR_SetLandTable_Day_r()
 {
 	TARGET_DYNAMIC(ChaoGardenMR_SetLandTable_Day)();
 
-	copy_shared();
-	copy_materials(matlist_00009440, 0x00009440, ModuleHandles[2]);
+	const auto base = mr_base();
+
+	// Day and evening patch the same materials, so the
+	// other one has to be undone before this one is applied.
+	size_t written = mr_evening.revert(base);
+	written += mr_shared.apply(base);
+	written += mr_day.apply(base);
+
+	report("Mystic Ruins day", written);
 }
 
 static void __cdecl ChaoGardenMR_SetLandTable_Evening_r()
 {
 	TARGET_DYNAMIC(ChaoGardenMR_SetLandTable_Evening)();
 
-	copy_shared();
-	copy_materials(matlist_00009440_e, 0x00009440, ModuleHandles[2]);
+	const auto base = mr_base();
+
+	size_t written = mr_day.revert(base);
+	written += mr_shared.apply(base);
+	written += mr_evening.apply(base);
+
+	report("Mystic Ruins evening", written);
 }
 
 static void __cdecl ChaoGardenMR_SetLandTable_Night_r()
 {
 	TARGET_DYNAMIC(ChaoGardenMR_SetLandTable_Night)();
-
-	copy_materials(matlist_00007254, 0x00007254, ModuleHandles[2]);
-	copy_materials(matlist_00007368, 0x00007368, ModuleHandles[2]);
-	copy_materials(matlist_00008858, 0x00008858, ModuleHandles[2]);
-	copy_materials(matlist_00009290, 0x00009290, ModuleHandles[2]);
-	copy_materials(matlist_000093C0, 0x000093C0, ModuleHandles[2]);
-	copy_materials(matlist_00009C08, 0x00009C08, ModuleHandles[2]);
-	copy_materials(matlist_00009E68, 0x00009E68, ModuleHandles[2]);
-	copy_materials(matlist_0000A738, 0x0000A738, ModuleHandles[2]);
-	copy_materials(matlist_0000BDF8, 0x0000BDF8, ModuleHandles[2]);
-	copy_materials(matlist_0000FD00, 0x0000FD00, ModuleHandles[2]);
-	copy_materials(matlist_00010534, 0x00010534, ModuleHandles[2]);
-	copy_materials(matlist_000106B0, 0x000106B0, ModuleHandles[2]);
-	copy_materials(matlist_00013568, 0x00013568, ModuleHandles[2]);
-	copy_materials(matlist_00013970, 0x00013970, ModuleHandles[2]);
-	copy_materials(matlist_00013E98, 0x00013E98, ModuleHandles[2]);
-	copy_materials(matlist_00014380, 0x00014380, ModuleHandles[2]);
-	copy_materials(matlist_00014880, 0x00014880, ModuleHandles[2]);
-	copy_materials(matlist_00014D50, 0x00014D50, ModuleHandles[2]);
-	copy_materials(matlist_00015220, 0x00015220, ModuleHandles[2]);
-	copy_materials(matlist_00015558, 0x00015558, ModuleHandles[2]);
-	copy_materials(matlist_00015AC0, 0x00015AC0, ModuleHandles[2]);
-	copy_materials(matlist_00015ED8, 0x00015ED8, ModuleHandles[2]);
-	copy_materials(matlist_00016420, 0x00016420, ModuleHandles[2]);
-	copy_materials(matlist_000175E0, 0x000175E0, ModuleHandles[2]);
-	copy_materials(matlist_00017928, 0x00017928, ModuleHandles[2]);
-	copy_materials(matlist_00017C70, 0x00017C70, ModuleHandles[2]);
-	copy_materials(matlist_000185F0, 0x000185F0, ModuleHandles[2]);
-	copy_materials(matlist_00018C34, 0x00018C34, ModuleHandles[2]);
-	copy_materials(matlist_00019274, 0x00019274, ModuleHandles[2]);
-	copy_materials(matlist_000198B4, 0x000198B4, ModuleHandles[2]);
-	copy_materials(matlist_00019EF4, 0x00019EF4, ModuleHandles[2]);
-	copy_materials(matlist_0001A534, 0x0001A534, ModuleHandles[2]);
-	copy_materials(matlist_0001AB74, 0x0001AB74, ModuleHandles[2]);
-	copy_materials(matlist_0001B1B4, 0x0001B1B4, ModuleHandles[2]);
-	copy_materials(matlist_0001B7F4, 0x0001B7F4, ModuleHandles[2]);
-	copy_materials(matlist_0001BE34, 0x0001BE34, ModuleHandles[2]);
-	copy_materials(matlist_0001C474, 0x0001C474, ModuleHandles[2]);
-	copy_materials(matlist_0001D5F4, 0x0001D5F4, ModuleHandles[2]);
-	copy_materials(matlist_0001E774, 0x0001E774, ModuleHandles[2]);
-	copy_materials(matlist_0001F8F4, 0x0001F8F4, ModuleHandles[2]);
-	copy_materials(matlist_00020A74, 0x00020A74, ModuleHandles[2]);
-	copy_materials(matlist_00021BF4, 0x00021BF4, ModuleHandles[2]);
-	copy_materials(matlist_00022D74, 0x00022D74, ModuleHandles[2]);
-	copy_materials(matlist_00023EF4, 0x00023EF4, ModuleHandles[2]);
-	copy_materials(matlist_00025074, 0x00025074, ModuleHandles[2]);
-	copy_materials(matlist_000261F4, 0x000261F4, ModuleHandles[2]);
-	copy_materials(matlist_00027374, 0x00027374, ModuleHandles[2]);
-	copy_materials(matlist_000284F4, 0x000284F4, ModuleHandles[2]);
-	copy_materials(matlist_00029674, 0x00029674, ModuleHandles[2]);
-	copy_materials(matlist_0002A7F4, 0x0002A7F4, ModuleHandles[2]);
-	copy_materials(matlist_0002B974, 0x0002B974, ModuleHandles[2]);
-	copy_materials(matlist_0002CAF8, 0x0002CAF8, ModuleHandles[2]);
-	copy_materials(matlist_0002D170, 0x0002D170, ModuleHandles[2]);
-	copy_materials(matlist_0002D808, 0x0002D808, ModuleHandles[2]);
-	copy_materials(matlist_0002DEA0, 0x0002DEA0, ModuleHandles[2]);
-	copy_materials(matlist_0002E128, 0x0002E128, ModuleHandles[2]);
-	copy_materials(matlist_0002E3B0, 0x0002E3B0, ModuleHandles[2]);
-	copy_materials(matlist_0002E638, 0x0002E638, ModuleHandles[2]);
-	copy_materials(matlist_0002ED08, 0x0002ED08, ModuleHandles[2]);
-	copy_materials(matlist_0002FAF0, 0x0002FAF0, ModuleHandles[2]);
-	copy_materials(matlist_00030430, 0x00030430, ModuleHandles[2]);
-	copy_materials(matlist_00030D60, 0x00030D60, ModuleHandles[2]);
-	copy_materials(matlist_00032118, 0x00032118, ModuleHandles[2]);
-	copy_materials(matlist_00032A44, 0x00032A44, ModuleHandles[2]);
-	copy_materials(matlist_000338D8, 0x000338D8, ModuleHandles[2]);
+	report("Mystic Ruins night", mr_night.apply(mr_base()));
 }
 
 static void fix_light(NJS_OBJECT* obj)
@@ -205,159 +533,31 @@ static void fix_light(NJS_OBJECT* obj)
 	fix_light(obj->sibling);
 }
 
+void ApplyChaoGardenMaterials(int level)
+{
+	switch (level)
+	{
+		case LevelIDs_SSGarden:
+			report("Station Square", ss_garden.apply(0x400000));
+			break;
+
+		case LevelIDs_ECGarden:
+			report("Egg Carrier", ec_garden.apply(0x400000));
+			break;
+
+		default:
+			break;
+	}
+}
+
 void FixChaoGardenMaterials()
 {
 	ChaoGardenMR_SetLandTable_Day_t     = new Trampoline(0x0072A790, 0x0072A796, ChaoGardenMR_SetLandTable_Day_r);
 	ChaoGardenMR_SetLandTable_Evening_t = new Trampoline(0x0072A820, 0x0072A826, ChaoGardenMR_SetLandTable_Evening_r);
 	ChaoGardenMR_SetLandTable_Night_t   = new Trampoline(0x0072A8B0, 0x0072A8B6, ChaoGardenMR_SetLandTable_Night_r);
 
-#pragma region Station Square
+	// Station Square
 	fix_light(&ChaoRaceDoor_Model);
 	fix_light(&BlackMarketDoor_Model);
 	fix_light(&SSGardenExit_Model);
-
-	copy_materials(matlist_03236884, 0x03236884);
-	copy_materials(matlist_03236AF8, 0x03236AF8);
-	copy_materials(matlist_03236D08, 0x03236D08);
-	copy_materials(matlist_03236E70, 0x03236E70);
-	copy_materials(matlist_03237250, 0x03237250);
-	copy_materials(matlist_03237560, 0x03237560);
-	copy_materials(matlist_03237A50, 0x03237A50);
-	copy_materials(matlist_03237FB8, 0x03237FB8);
-	copy_materials(matlist_03238388, 0x03238388);
-	copy_materials(matlist_03238E54, 0x03238E54);
-	copy_materials(matlist_032390C0, 0x032390C0);
-	copy_materials(matlist_03239438, 0x03239438);
-	copy_materials(matlist_03239AD4, 0x03239AD4);
-	copy_materials(matlist_03239C40, 0x03239C40);
-	copy_materials(matlist_03239FE0, 0x03239FE0);
-	copy_materials(matlist_0323A148, 0x0323A148);
-	copy_materials(matlist_0323A2B0, 0x0323A2B0);
-	copy_materials(matlist_0323A444, 0x0323A444);
-	copy_materials(matlist_0323A9D8, 0x0323A9D8);
-	copy_materials(matlist_0323AC10, 0x0323AC10);
-	copy_materials(matlist_0323B7B8, 0x0323B7B8);
-	copy_materials(matlist_0323B8F0, 0x0323B8F0);
-	copy_materials(matlist_0323BA98, 0x0323BA98);
-	copy_materials(matlist_0323BCD0, 0x0323BCD0);
-	copy_materials(matlist_0323BE38, 0x0323BE38);
-	copy_materials(matlist_0323BFA0, 0x0323BFA0);
-	copy_materials(matlist_0323C4F0, 0x0323C4F0);
-	copy_materials(matlist_03243EB0, 0x03243EB0);
-	copy_materials(matlist_032446F0, 0x032446F0);
-	copy_materials(matlist_03245900, 0x03245900);
-	copy_materials(matlist_03248830, 0x03248830);
-	copy_materials(matlist_03249754, 0x03249754);
-	copy_materials(matlist_0324B524, 0x0324B524);
-	copy_materials(matlist_0324C238, 0x0324C238);
-	copy_materials(matlist_0324C9EC, 0x0324C9EC);
-	copy_materials(matlist_0324CB08, 0x0324CB08);
-	copy_materials(matlist_0324CC28, 0x0324CC28);
-	copy_materials(matlist_0324E098, 0x0324E098);
-	copy_materials(matlist_03254028, 0x03254028);
-	copy_materials(matlist_03255714, 0x03255714);
-	copy_materials(matlist_03257214, 0x03257214);
-	copy_materials(matlist_03257E00, 0x03257E00);
-	copy_materials(matlist_03258DA0, 0x03258DA0);
-	copy_materials(matlist_032594B0, 0x032594B0);
-	copy_materials(matlist_0325A450, 0x0325A450);
-	copy_materials(matlist_0325AB60, 0x0325AB60);
-	copy_materials(matlist_0325B744, 0x0325B744);
-	copy_materials(matlist_0325BCB8, 0x0325BCB8);
-	copy_materials(matlist_0325D7A4, 0x0325D7A4);
-	copy_materials(matlist_0325E390, 0x0325E390);
-	copy_materials(matlist_0325F660, 0x0325F660);
-	copy_materials(matlist_03260160, 0x03260160);
-	copy_materials(matlist_03261900, 0x03261900);
-	copy_materials(matlist_03262058, 0x03262058);
-	copy_materials(matlist_03262DDC, 0x03262DDC);
-	copy_materials(matlist_03264B08, 0x03264B08);
-	copy_materials(matlist_03264D60, 0x03264D60);
-	copy_materials(matlist_03269D68, 0x03269D68);
-	copy_materials(matlist_0326A754, 0x0326A754);
-	copy_materials(matlist_0326A8E4, 0x0326A8E4);
-#pragma endregion
-
-#pragma region Egg Carrier
-	copy_materials(matlist_02FD83B0, 0x02FD83B0);
-	copy_materials(matlist_02FD8938, 0x02FD8938);
-	copy_materials(matlist_02FD0F64, 0x02FD0F64);
-	copy_materials(matlist_02FD116C, 0x02FD116C);
-	copy_materials(matlist_02FD24CC, 0x02FD24CC);
-	copy_materials(matlist_02FD4810, 0x02FD4810);
-	copy_materials(matlist_02FD4AC0, 0x02FD4AC0);
-	copy_materials(matlist_02FD4D58, 0x02FD4D58);
-	copy_materials(matlist_02FD583C, 0x02FD583C);
-	copy_materials(matlist_02FD59B8, 0x02FD59B8);
-	copy_materials(matlist_02FD5B4C, 0x02FD5B4C);
-	copy_materials(matlist_02FD5CE4, 0x02FD5CE4);
-	copy_materials(matlist_02FD5E7C, 0x02FD5E7C);
-	copy_materials(matlist_02FD6018, 0x02FD6018);
-	copy_materials(matlist_02FD75F8, 0x02FD75F8);
-	copy_materials(matlist_02FD9148, 0x02FD9148);
-	copy_materials(matlist_02FDC7B8, 0x02FDC7B8);
-	copy_materials(matlist_02FDE5AC, 0x02FDE5AC);
-	copy_materials(matlist_02FE0104, 0x02FE0104);
-	copy_materials(matlist_02FE4F68, 0x02FE4F68);
-	copy_materials(matlist_02FE6E6C, 0x02FE6E6C);
-	copy_materials(matlist_02FE7A18, 0x02FE7A18);
-	copy_materials(matlist_02FE8538, 0x02FE8538);
-	copy_materials(matlist_02FE90A0, 0x02FE90A0);
-	copy_materials(matlist_02FE9C48, 0x02FE9C48);
-	copy_materials(matlist_02FE9F58, 0x02FE9F58);
-	copy_materials(matlist_02FEAA38, 0x02FEAA38);
-	copy_materials(matlist_02FEB5E0, 0x02FEB5E0);
-	copy_materials(matlist_02FEB850, 0x02FEB850);
-	copy_materials(matlist_02FEC420, 0x02FEC420);
-	copy_materials(matlist_02FECFC8, 0x02FECFC8);
-	copy_materials(matlist_02FED238, 0x02FED238);
-	copy_materials(matlist_02FEDB10, 0x02FEDB10);
-	copy_materials(matlist_02FEE5E0, 0x02FEE5E0);
-	copy_materials(matlist_02FEEF78, 0x02FEEF78);
-	copy_materials(matlist_02FEFA58, 0x02FEFA58);
-	copy_materials(matlist_02FEFBDC, 0x02FEFBDC);
-	copy_materials(matlist_02FEFE7C, 0x02FEFE7C);
-	copy_materials(matlist_02FF002C, 0x02FF002C);
-	copy_materials(matlist_02FF01B4, 0x02FF01B4);
-	copy_materials(matlist_02FF03C4, 0x02FF03C4);
-	copy_materials(matlist_02FF0BC8, 0x02FF0BC8);
-	copy_materials(matlist_02FF1EB8, 0x02FF1EB8);
-	copy_materials(matlist_02FF33D0, 0x02FF33D0);
-	copy_materials(matlist_02FF3500, 0x02FF3500);
-	copy_materials(matlist_02FF38D0, 0x02FF38D0);
-	copy_materials(matlist_02FF3CA0, 0x02FF3CA0);
-	copy_materials(matlist_02FF4070, 0x02FF4070);
-	copy_materials(matlist_02FF4440, 0x02FF4440);
-	copy_materials(matlist_02FF4810, 0x02FF4810);
-	copy_materials(matlist_02FF4BE0, 0x02FF4BE0);
-	copy_materials(matlist_02FF4FB0, 0x02FF4FB0);
-	copy_materials(matlist_02FF5380, 0x02FF5380);
-	copy_materials(matlist_02FF5750, 0x02FF5750);
-	copy_materials(matlist_02FF5B20, 0x02FF5B20);
-	copy_materials(matlist_02FF5EF0, 0x02FF5EF0);
-	copy_materials(matlist_02FF62C0, 0x02FF62C0);
-	copy_materials(matlist_02FF6690, 0x02FF6690);
-	copy_materials(matlist_02FF6A60, 0x02FF6A60);
-	copy_materials(matlist_02FF6E30, 0x02FF6E30);
-	copy_materials(matlist_02FF7200, 0x02FF7200);
-	copy_materials(matlist_02FF75D0, 0x02FF75D0);
-	copy_materials(matlist_02FF79A0, 0x02FF79A0);
-	copy_materials(matlist_02FF7D70, 0x02FF7D70);
-	copy_materials(matlist_02FF7EF8, 0x02FF7EF8);
-	copy_materials(matlist_02FF9BD4, 0x02FF9BD4);
-	copy_materials(matlist_02FFA2D0, 0x02FFA2D0);
-	copy_materials(matlist_02FFA9D0, 0x02FFA9D0);
-	copy_materials(matlist_02FFB0D0, 0x02FFB0D0);
-	copy_materials(matlist_02FFB7D0, 0x02FFB7D0);
-	copy_materials(matlist_02FFC674, 0x02FFC674);
-	copy_materials(matlist_02FFD018, 0x02FFD018);
-	copy_materials(matlist_030007B4, 0x030007B4);
-	copy_materials(matlist_03000C10, 0x03000C10);
-	copy_materials(matlist_03001964, 0x03001964);
-	copy_materials(matlist_03001DC0, 0x03001DC0);
-	copy_materials(matlist_03002B14, 0x03002B14);
-	copy_materials(matlist_03002F70, 0x03002F70);
-	copy_materials(matlist_03003CC4, 0x03003CC4);
-	copy_materials(matlist_03004120, 0x03004120);
-#pragma endregion
 }
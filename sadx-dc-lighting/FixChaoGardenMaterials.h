@@ -1,3 +1,5 @@
 #pragma once
 
 void FixChaoGardenMaterials();
+/// Applies material fixes for the Station Square or Egg Carrier Chao Garden if \p level is either.
+void ApplyChaoGardenMaterials(int level);
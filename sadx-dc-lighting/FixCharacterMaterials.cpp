@@ -8,6 +8,8 @@
 #include <SADXModLoader.h>
 #include "../include/lanternapi.h"
 #include "FixCharacterMaterials.h"
+#include "MaterialOverrides.h"
+#include "globals.h"
 
 static HMODULE CHRMODELS        = GetModuleHandle(L"CHRMODELS_orig");
 static HMODULE ADV00MODELS      = GetModuleHandle(L"ADV00MODELS");
@@ -3241,14 +3243,22 @@ static void actions(const std::string& id, int length, const T (&ids)[N])
 
 void FixCharacterMaterials()
 {
-	material_register(LevelSpecular, LengthOfArray(LevelSpecular), &ForceDiffuse0Specular0);
-	material_register(ObjectSpecular, LengthOfArray(ObjectSpecular), &ForceDiffuse0Specular1);
-	material_register(Specular2Materials, LengthOfArray(Specular2Materials), &ForceDiffuse2Specular2);
-	material_register(Specular3Materials, LengthOfArray(Specular3Materials), &ForceDiffuse2Specular3);
-	material_register(Specular5Materials, LengthOfArray(Specular5Materials), &ForceDiffuse4Specular5);
-	material_register(ChaosPuddle, LengthOfArray(ChaosPuddle), &ChaosPuddleFunc);
-	material_register(Chaos2Materials, LengthOfArray(Chaos2Materials), &Chaos2Function);
-	material_register(NPCMaterials, LengthOfArray(NPCMaterials), &NPCModelsFunction);
+	// The material arrays above are converted into an override table by tools/materialtable
+	// every time the mod is built, so the table can't drift from them. If the table is
+	// available, it's applied directly in Direct3D_ParseMaterial_r and the callbacks are
+	// unnecessary. The tool reads the registrations below to pair arrays with callbacks.
+	if (!material_overrides::load(globals::get_system_path("materials.bin")))
+	{
+		material_register(LevelSpecular, LengthOfArray(LevelSpecular), &ForceDiffuse0Specular0);
+		material_register(ObjectSpecular, LengthOfArray(ObjectSpecular), &ForceDiffuse0Specular1);
+		material_register(Specular2Materials, LengthOfArray(Specular2Materials), &ForceDiffuse2Specular2);
+		material_register(Specular3Materials, LengthOfArray(Specular3Materials), &ForceDiffuse2Specular3);
+		material_register(Specular5Materials, LengthOfArray(Specular5Materials), &ForceDiffuse4Specular5);
+		material_register(ChaosPuddle, LengthOfArray(ChaosPuddle), &ChaosPuddleFunc);
+		material_register(Chaos2Materials, LengthOfArray(Chaos2Materials), &Chaos2Function);
+		material_register(NPCMaterials, LengthOfArray(NPCMaterials), &NPCModelsFunction);
+	}
+
 	auto handle = reinterpret_cast<size_t>(CHRMODELS);
 	//Stuff that ignores lighting
 	//Sonic's Crystal Ring
@@ -0,0 +1,82 @@
+#pragma once
+
+// This header is shared with the material table converter
+// in the tools directory, so it must remain portable.
+
+#include <cstddef>
+#include <cstdint>
+
+namespace material_overrides
+{
+	/// "LMOT" - Lantern Material Override Table
+	constexpr uint32_t MAGIC   = 0x544F4D4C;
+	constexpr uint16_t VERSION = 1;
+
+	/// Length of a null-padded module name in the module name table.
+	constexpr size_t MODULE_NAME_LENGTH = 32;
+
+	/// Module index used for absolute addresses (i.e. the main executable).
+	constexpr uint8_t MODULE_ABSOLUTE = 0;
+
+	/// Determines which set of palette indices is applied.
+	enum Predicate : uint8_t
+	{
+		/// Primary indices are always used.
+		Predicate_Always,
+		/// Primary indices are used in Chaos 2, alternate indices otherwise.
+		Predicate_Chaos2,
+		/// Primary indices are used in Chaos 2, Chaos 6 and Perfect Chaos, alternate indices otherwise.
+		Predicate_ChaosBoss,
+		Predicate_Count
+	};
+
+	enum Options : uint8_t
+	{
+		Options_None,
+		/// Promotes stage specular indices (0 and 1) to
+		/// their character equivalents (2 and 3) instead
+		/// of replacing the specular index outright.
+		Options_PromoteSpecular = 1 << 0,
+	};
+
+#pragma pack(push, 1)
+
+	/// The table begins with this header, followed by \c module_count
+	/// module names of \c MODULE_NAME_LENGTH bytes each, followed by
+	/// \c entry_count entries.
+	struct Header
+	{
+		uint32_t magic;
+		uint16_t version;
+		uint16_t module_count;
+		uint32_t entry_count;
+	};
+
+	struct Entry
+	{
+		/// Absolute address if \c module is \c MODULE_ABSOLUTE,
+		/// otherwise an offset relative to the module's base address.
+		uint32_t address;
+		/// One-based index into the module name table.
+		uint8_t module;
+		/// Diffuse index, or -1 to leave it unchanged.
+		int8_t diffuse;
+		/// Specular index, or -1 to leave it unchanged.
+		int8_t specular;
+		/// Diffuse index used when \c predicate is not satisfied.
+		int8_t alt_diffuse;
+		/// Specular index used when \c predicate is not satisfied.
+		int8_t alt_specular;
+		Predicate predicate;
+		Options options;
+		uint8_t reserved;
+		/// Material flags are combined as (flags & flags_and) | flags_or.
+		uint32_t flags_or;
+		uint32_t flags_and;
+	};
+
+#pragma pack(pop)
+
+	static_assert(sizeof(Header) == 12, "material override header size mismatch");
+	static_assert(sizeof(Entry) == 20, "material override entry size mismatch");
+}
@@ -0,0 +1,225 @@
+#include "stdafx.h"
+
+#include <Windows.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <SADXModLoader.h>
+
+#include "../include/lanternapi.h"
+#include "MaterialOverrides.h"
+
+namespace material_overrides
+{
+	static HANDLE file_handle    = INVALID_HANDLE_VALUE;
+	static HANDLE mapping_handle = nullptr;
+	static const uint8_t* view   = nullptr;
+
+	static std::unordered_map<const NJS_MATERIAL*, const Entry*> entries;
+
+	static bool predicate(Predicate p)
+	{
+		switch (p)
+		{
+			default:
+			case Predicate_Always:
+				return true;
+
+			case Predicate_Chaos2:
+				return CurrentLevel == LevelIDs_Chaos2;
+
+			case Predicate_ChaosBoss:
+				return CurrentLevel == LevelIDs_Chaos2
+				       || CurrentLevel == LevelIDs_Chaos6
+				       || CurrentLevel == LevelIDs_PerfectChaos;
+		}
+	}
+
+	static bool map_file(const std::string& path, size_t& size)
+	{
+		file_handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		                          OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+		if (file_handle == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+
+		size = static_cast<size_t>(GetFileSize(file_handle, nullptr));
+
+		if (size < sizeof(Header))
+		{
+			return false;
+		}
+
+		mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+		if (mapping_handle == nullptr)
+		{
+			return false;
+		}
+
+		view = static_cast<const uint8_t*>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+		return view != nullptr;
+	}
+
+	bool load(const std::string& path)
+	{
+		unload();
+
+		size_t size = 0;
+
+		if (!map_file(path, size))
+		{
+			PrintDebug("[lantern] Material override table not found: %s\n", path.c_str());
+			unload();
+			return false;
+		}
+
+		const auto header = reinterpret_cast<const Header*>(view);
+
+		if (header->magic != MAGIC || header->version != VERSION)
+		{
+			PrintDebug("[lantern] Invalid material override table: %s\n", path.c_str());
+			unload();
+			return false;
+		}
+
+		const size_t names_size = header->module_count * MODULE_NAME_LENGTH;
+
+		if (sizeof(Header) + names_size + header->entry_count * sizeof(Entry) > size)
+		{
+			PrintDebug("[lantern] Truncated material override table: %s\n", path.c_str());
+			unload();
+			return false;
+		}
+
+		PrintDebug("[lantern] Loading material override table: %s\n", path.c_str());
+
+		const auto names = reinterpret_cast<const char*>(view + sizeof(Header));
+		std::vector<size_t> bases(header->module_count + 1);
+
+		// Index 0 is reserved for absolute addresses.
+		bases[MODULE_ABSOLUTE] = 0;
+
+		for (size_t i = 0; i < header->module_count; i++)
+		{
+			const std::string name(names + i * MODULE_NAME_LENGTH,
+			                       strnlen(names + i * MODULE_NAME_LENGTH, MODULE_NAME_LENGTH));
+
+			bases[i + 1] = reinterpret_cast<size_t>(GetModuleHandleA(name.c_str()));
+		}
+
+		const auto table = reinterpret_cast<const Entry*>(view + sizeof(Header) + names_size);
+		entries.reserve(header->entry_count);
+
+		for (size_t i = 0; i < header->entry_count; i++)
+		{
+			const auto& entry = table[i];
+
+			if (entry.module > header->module_count)
+			{
+				continue;
+			}
+
+			// Skip entries for modules which aren't loaded.
+			if (entry.module != MODULE_ABSOLUTE && !bases[entry.module])
+			{
+				continue;
+			}
+
+			const auto material = reinterpret_cast<const NJS_MATERIAL*>(bases[entry.module] + entry.address);
+			entries[material] = &entry;
+		}
+
+		PrintDebug("[lantern] Resolved %u of %u material overrides.\n", entries.size(), header->entry_count);
+
+		if (entries.empty())
+		{
+			unload();
+			return false;
+		}
+
+		return true;
+	}
+
+	void unload()
+	{
+		entries.clear();
+
+		if (view != nullptr)
+		{
+			UnmapViewOfFile(view);
+			view = nullptr;
+		}
+
+		if (mapping_handle != nullptr)
+		{
+			CloseHandle(mapping_handle);
+			mapping_handle = nullptr;
+		}
+
+		if (file_handle != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(file_handle);
+			file_handle = INVALID_HANDLE_VALUE;
+		}
+	}
+
+	bool loaded()
+	{
+		return !entries.empty();
+	}
+
+	const Entry* find(const NJS_MATERIAL* material)
+	{
+		if (entries.empty())
+		{
+			return nullptr;
+		}
+
+		const auto it = entries.find(material);
+		return it == entries.end() ? nullptr : it->second;
+	}
+
+	Uint32 apply_flags(const Entry* entry, Uint32 flags)
+	{
+		return (flags & entry->flags_and) | entry->flags_or;
+	}
+
+	void apply_indices(const Entry* entry)
+	{
+		const bool primary = predicate(entry->predicate);
+
+		const int32_t diffuse  = primary ? entry->diffuse : entry->alt_diffuse;
+		const int32_t specular = primary ? entry->specular : entry->alt_specular;
+
+		if (entry->options & Options_PromoteSpecular)
+		{
+			if (diffuse >= 0 && get_diffuse() != diffuse)
+			{
+				set_diffuse(diffuse, false);
+			}
+
+			const int32_t current = get_specular();
+
+			if (current == 0 || current == 1)
+			{
+				set_specular(current + 2, false);
+			}
+
+			return;
+		}
+
+		if (diffuse >= 0)
+		{
+			set_diffuse(diffuse, false);
+		}
+
+		if (specular >= 0)
+		{
+			set_specular(specular, false);
+		}
+	}
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <ninja.h>
+
+#include "MaterialOverrideFormat.h"
+
+namespace material_overrides
+{
+	/// <summary>
+	/// Maps a material override table into memory and resolves its entries.
+	/// </summary>
+	/// <param name="path">Path to the table.</param>
+	/// <returns><c>true</c> if the table was loaded and contains at least one entry.</returns>
+	bool load(const std::string& path);
+	/// Unmaps the table and clears all resolved entries.
+	void unload();
+	/// Returns \c true if a table is currently loaded.
+	bool loaded();
+	/// Returns the override entry for the specified material, or \c nullptr if there is none.
+	const Entry* find(const NJS_MATERIAL* material);
+	/// Applies the material flag masks of \p entry to \p flags.
+	Uint32 apply_flags(const Entry* entry, Uint32 flags);
+	/// Applies the palette indices of \p entry as temporary overrides.
+	void apply_indices(const Entry* entry);
+}
@@ -70,8 +70,7 @@ static void __cdecl Obj_SkyDeck_r(ObjectMaster* _this)
 	globals::palettes.load_palette(LevelIDs_SkyDeck, 0);
 	globals::palettes.load_source(LevelIDs_SkyDeck, 0);
 
-	param::PaletteB = nullptr;
-	LanternInstance lantern(&param::PaletteB);
+	LanternInstance lantern;
 
 	lantern.load_palette(LevelIDs_SkyDeck, 1);
 	handle = globals::palettes.add(lantern);
@@ -6,228 +6,109 @@ std::vector<IShaderParameter*> IShaderParameter::values_assigned {};
 template <>
 bool ShaderParameter<bool>::commit(IDirect3DDevice9* device)
 {
-	if (is_modified())
+	return state.commit([&](bool value)
 	{
-		const auto f = current ? 1.0f : 0.0f;
+		const auto f = value ? 1.0f : 0.0f;
 		float buffer[4] = { f, f, f, f };
 
-		if (type & Type::vertex)
-		{
-			device->SetVertexShaderConstantF(index, buffer, 1);
-		}
-
-		if (type & Type::pixel)
-		{
-			device->SetPixelShaderConstantF(index, buffer, 1);
-		}
-
-		clear();
-		return true;
-	}
-
-	assigned = false;
-	return false;
+		shader_constants::set(device, index, type, buffer, 1);
+	});
 }
 
 template <>
 bool ShaderParameter<int>::commit(IDirect3DDevice9* device)
 {
-	if (is_modified())
+	return state.commit([&](int value)
 	{
-		const auto f = static_cast<float>(current);
+		const auto f = static_cast<float>(value);
 		float buffer[4] = { f, f, f, f };
 
-		if (type & Type::vertex)
-		{
-			device->SetVertexShaderConstantF(index, buffer, 1);
-		}
-
-		if (type & Type::pixel)
-		{
-			device->SetPixelShaderConstantF(index, buffer, 1);
-		}
-
-		clear();
-		return true;
-	}
-
-	assigned = false;
-	return false;
+		shader_constants::set(device, index, type, buffer, 1);
+	});
 }
 
 template <>
 bool ShaderParameter<float>::commit(IDirect3DDevice9* device)
 {
-	if (is_modified())
+	return state.commit([&](float value)
 	{
-		D3DXVECTOR4 value = { current, current, current, current };
-
-		if (type & Type::vertex)
-		{
-			device->SetVertexShaderConstantF(index, value, 1);
-		}
-
-		if (type & Type::pixel)
-		{
-			device->SetPixelShaderConstantF(index, value, 1);
-		}
-
-		clear();
-		return true;
-	}
-
-	assigned = false;
-	return false;
+		D3DXVECTOR4 buffer = { value, value, value, value };
+		shader_constants::set(device, index, type, buffer, 1);
+	});
 }
 
 template <>
 bool ShaderParameter<D3DXVECTOR4>::commit(IDirect3DDevice9* device)
 {
-	if (is_modified())
+	return state.commit([&](const D3DXVECTOR4& value)
 	{
-		if (type & Type::vertex)
-		{
-			device->SetVertexShaderConstantF(index, current, 1);
-		}
-
-		if (type & Type::pixel)
-		{
-			device->SetPixelShaderConstantF(index, current, 1);
-		}
-
-		clear();
-		return true;
-	}
-
-	assigned = false;
-	return false;
+		shader_constants::set(device, index, type, value, 1);
+	});
 }
 
 template <>
 bool ShaderParameter<D3DXVECTOR3>::commit(IDirect3DDevice9* device)
 {
-	if (is_modified())
+	return state.commit([&](const D3DXVECTOR3& value)
 	{
-		D3DXVECTOR4 value = { current.x, current.y, current.z, 0.0f };
-
-		if (type & Type::vertex)
-		{
-			device->SetVertexShaderConstantF(index, value, 1);
-		}
-
-		if (type & Type::pixel)
-		{
-			device->SetPixelShaderConstantF(index, value, 1);
-		}
-
-		clear();
-		return true;
-	}
-
-	assigned = false;
-	return false;
+		D3DXVECTOR4 buffer = { value.x, value.y, value.z, 0.0f };
+		shader_constants::set(device, index, type, buffer, 1);
+	});
 }
 
 template <>
 bool ShaderParameter<D3DXVECTOR2>::commit(IDirect3DDevice9* device)
 {
-	if (is_modified())
+	return state.commit([&](const D3DXVECTOR2& value)
 	{
-		D3DXVECTOR4 value = { current.x, current.y, 0.0f, 1.0f };
-
-		if (type & Type::vertex)
-		{
-			device->SetVertexShaderConstantF(index, value, 1);
-		}
-
-		if (type & Type::pixel)
-		{
-			device->SetPixelShaderConstantF(index, value, 1);
-		}
-
-		clear();
-		return true;
-	}
-
-	assigned = false;
-	return false;
+		D3DXVECTOR4 buffer = { value.x, value.y, 0.0f, 1.0f };
+		shader_constants::set(device, index, type, buffer, 1);
+	});
 }
 
 template <>
 bool ShaderParameter<D3DXCOLOR>::commit(IDirect3DDevice9* device)
 {
-	if (is_modified())
-	{
-		static_assert(sizeof(D3DXCOLOR) == sizeof(D3DXVECTOR4), "D3DXCOLOR size does not match D3DXVECTOR4.");
-
-		if (type & Type::vertex)
-		{
-			device->SetVertexShaderConstantF(index, current, 1);
-		}
+	static_assert(sizeof(D3DXCOLOR) == sizeof(D3DXVECTOR4), "D3DXCOLOR size does not match D3DXVECTOR4.");
 
-		if (type & Type::pixel)
-		{
-			device->SetPixelShaderConstantF(index, current, 1);
-		}
-
-		clear();
-		return true;
-	}
-
-	assigned = false;
-	return false;
+	return state.commit([&](const D3DXCOLOR& value)
+	{
+		shader_constants::set(device, index, type, value, 1);
+	});
 }
 
 template <>
 bool ShaderParameter<D3DXMATRIX>::commit(IDirect3DDevice9* device)
 {
-	if (is_modified())
+	return state.commit([&](const D3DXMATRIX& value)
 	{
-		if (type & Type::vertex)
-		{
-			device->SetVertexShaderConstantF(index, current, 4);
-		}
-
-		if (type & Type::pixel)
-		{
-			device->SetPixelShaderConstantF(index, current, 4);
-		}
-
-		clear();
-		return true;
-	}
-
-	assigned = false;
-	return false;
+		shader_constants::set(device, index, type, value, 4);
+	});
 }
 
 template <>
 bool ShaderParameter<Texture>::commit(IDirect3DDevice9* device)
 {
-	if (is_modified())
+	return state.commit([&](const Texture& value)
 	{
-		if (type & Type::vertex)
-		{
-			device->SetTexture(D3DVERTEXTEXTURESAMPLER0 + index, current);
-		}
-
-		if (type & Type::pixel)
-		{
-			device->SetTexture(index, current);
-		}
-
-		clear();
-		return true;
-	}
-
-	assigned = false;
-	return false;
+		shader_constants::set_texture(device, index, type, value.p);
+	});
 }
 
 template <>
 void ShaderParameter<Texture>::release()
 {
-	clear();
-	current = nullptr;
-	last = nullptr;
+	state.discard(nullptr);
+}
+
+template <>
+uint32_t ShaderParameter<D3DXMATRIX>::register_count() const
+{
+	return ((type & Type::vertex ? 1 : 0) + (type & Type::pixel ? 1 : 0)) * 4;
+}
+
+template <>
+uint32_t ShaderParameter<Texture>::register_count() const
+{
+	return 0;
 }
@@ -5,6 +5,8 @@
 #include <d3d9.h>
 #include <d3dx9effect.h>
 
+#include "shader_constants.h"
+
 using VertexShader = CComPtr<IDirect3DVertexShader9>;
 using PixelShader  = CComPtr<IDirect3DPixelShader9>;
 using Buffer       = CComPtr<ID3DXBuffer>;
@@ -18,9 +20,9 @@ public:
 	{
 		enum T
 		{
-			vertex = 0b01,
-			pixel = 0b10,
-			both = 0b11
+			vertex = shader_constants::vertex,
+			pixel  = shader_constants::pixel,
+			both   = shader_constants::both
 		};
 	};
 
@@ -32,6 +34,8 @@ public:
 	virtual bool commit(IDirect3DDevice9* device) = 0;
 	virtual bool commit_now(IDirect3DDevice9* device) = 0;
 	virtual void release() = 0;
+	/// Number of constant registers written by a commit.
+	virtual uint32_t register_count() const = 0;
 };
 
 template<typename T>
@@ -40,17 +44,13 @@ class ShaderParameter : public IShaderParameter
 	const int index;
 	const Type::T type;
 
-	bool reset = false;
-	bool assigned = false;
-	T last;
-	T current;
+	shader_constants::Tracked<T> state;
 
 public:
 	ShaderParameter(const int index, const T& default_value, const Type::T type) :
 		index(index),
 		type(type),
-		last(default_value),
-		current(default_value)
+		state(default_value)
 	{
 	}
 
@@ -59,6 +59,7 @@ public:
 	bool commit(IDirect3DDevice9* device) override;
 	bool commit_now(IDirect3DDevice9* device) override;
 	void release() override;
+	uint32_t register_count() const override;
 	T value() const;
 	ShaderParameter<T>& operator=(const T& value);
 	ShaderParameter<T>& operator=(const ShaderParameter<T>& value);
@@ -67,21 +68,19 @@ public:
 template <typename T>
 bool ShaderParameter<T>::is_modified()
 {
-	return reset || (assigned && last != current);
+	return state.is_modified();
 }
 
 template <typename T>
 void ShaderParameter<T>::clear()
 {
-	reset = false;
-	assigned = false;
-	last = current;
+	state.clear();
 }
 
 template <typename T>
 bool ShaderParameter<T>::commit_now(IDirect3DDevice9* device)
 {
-	reset = true;
+	state.force();
 	return commit(device);
 }
 
@@ -90,29 +89,33 @@ void ShaderParameter<T>::release()
 {
 	clear();
 }
+template <typename T>
+uint32_t ShaderParameter<T>::register_count() const
+{
+	return (type & Type::vertex ? 1 : 0) + (type & Type::pixel ? 1 : 0);
+}
+
 template <typename T>
 T ShaderParameter<T>::value() const
 {
-	return current;
+	return state.value();
 }
 
 template <typename T>
 ShaderParameter<T>& ShaderParameter<T>::operator=(const T& value)
 {
-	if (!assigned)
+	if (state.assign(value))
 	{
 		values_assigned.push_back(this);
 	}
 
-	assigned = true;
-	current = value;
 	return *this;
 }
 
 template <typename T>
 ShaderParameter<T>& ShaderParameter<T>::operator=(const ShaderParameter<T>& value)
 {
-	*this = value.current;
+	*this = value.state.value();
 	return *this;
 }
 
@@ -126,3 +129,5 @@ template<> bool ShaderParameter<D3DXCOLOR>::commit(IDirect3DDevice9* device);
 template<> bool ShaderParameter<D3DXMATRIX>::commit(IDirect3DDevice9* device);
 template<> bool ShaderParameter<Texture>::commit(IDirect3DDevice9* device);
 template<> void ShaderParameter<Texture>::release();
+template<> uint32_t ShaderParameter<D3DXMATRIX>::register_count() const;
+template<> uint32_t ShaderParameter<Texture>::register_count() const;
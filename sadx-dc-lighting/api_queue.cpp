@@ -0,0 +1,45 @@
+#include "stdafx.h"
+
+#include <thread>
+
+#include "api_queue.h"
+
+namespace api_queue
+{
+	static Queue<Command, CAPACITY> queue;
+	static std::atomic<std::thread::id> render_thread {};
+
+	void set_render_thread()
+	{
+		render_thread.store(std::this_thread::get_id(), std::memory_order_release);
+	}
+
+	bool on_render_thread()
+	{
+		const auto id = render_thread.load(std::memory_order_acquire);
+		return id == std::thread::id() || id == std::this_thread::get_id();
+	}
+
+	void push(const Command& command)
+	{
+		while (!queue.try_push(command))
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	size_t drain()
+	{
+		size_t count = 0;
+		Command command;
+
+		// Bounded so producers which keep pushing can't hold up the frame.
+		while (count < CAPACITY && queue.try_pop(command))
+		{
+			command();
+			++count;
+		}
+
+		return count;
+	}
+}
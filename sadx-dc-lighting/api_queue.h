@@ -0,0 +1,171 @@
+#pragma once
+
+// This header is intentionally free of game and Direct3D
+// dependencies so that it can be used and measured headlessly.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/*
+ * Lets API functions be called from threads other than the render
+ * thread. Calls made on the render thread run directly; calls from any
+ * other thread are deferred as commands onto a bounded lock-free queue
+ * and run on the render thread when it drains the queue at the end of
+ * each frame, in the order they were enqueued.
+ *
+ * Until the render thread is set, every call runs directly.
+ */
+namespace api_queue
+{
+	/// An API call with its arguments captured by value.
+	class Command
+	{
+		void (*run_)(const Command&) = nullptr;
+		alignas(8) unsigned char storage[32] {};
+
+	public:
+		Command() = default;
+
+		template <typename F>
+		explicit Command(F f)
+		{
+			static_assert(sizeof(F) <= sizeof(storage), "command captures too much");
+			static_assert(std::is_trivially_copyable<F>::value && std::is_trivially_destructible<F>::value,
+			              "commands are copied bytewise and never destroyed");
+
+			new (storage) F(f);
+
+			run_ = [](const Command& c)
+			{
+				(*reinterpret_cast<const F*>(c.storage))();
+			};
+		}
+
+		void operator()() const
+		{
+			run_(*this);
+		}
+	};
+
+	/// <summary>
+	/// A bounded multi-producer, single-consumer queue. Each cell carries a sequence
+	/// number which tells producers whether it's free for the position they claimed,
+	/// and the consumer whether it's been written, so neither side ever takes a lock.
+	/// </summary>
+	/// <typeparam name="N">Capacity; must be a power of two.</typeparam>
+	template <typename T, size_t N>
+	class Queue
+	{
+		static_assert(N >= 2 && (N & (N - 1)) == 0, "capacity must be a power of two");
+
+		struct Cell
+		{
+			std::atomic<size_t> sequence;
+			T value;
+		};
+
+		Cell cells[N];
+		alignas(64) std::atomic<size_t> tail { 0 };
+		// Only touched by the consumer.
+		alignas(64) size_t head = 0;
+
+	public:
+		Queue()
+		{
+			for (size_t i = 0; i < N; i++)
+			{
+				cells[i].sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+
+		Queue(const Queue&) = delete;
+		Queue& operator=(const Queue&) = delete;
+
+		/// Enqueues \p value from any thread. Returns false if the queue is full.
+		bool try_push(const T& value)
+		{
+			size_t pos = tail.load(std::memory_order_relaxed);
+			Cell* cell;
+
+			for (;;)
+			{
+				cell = &cells[pos & (N - 1)];
+
+				const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+				const auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+
+				if (diff == 0)
+				{
+					if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					{
+						break;
+					}
+				}
+				else if (diff < 0)
+				{
+					// The consumer hasn't freed this cell since the last time around.
+					return false;
+				}
+				else
+				{
+					pos = tail.load(std::memory_order_relaxed);
+				}
+			}
+
+			cell->value = value;
+			cell->sequence.store(pos + 1, std::memory_order_release);
+			return true;
+		}
+
+		/// Dequeues into \p value. Must only be called from the consumer thread.
+		bool try_pop(T& value)
+		{
+			Cell& cell = cells[head & (N - 1)];
+
+			if (cell.sequence.load(std::memory_order_acquire) != head + 1)
+			{
+				return false;
+			}
+
+			value = std::move(cell.value);
+			cell.sequence.store(head + N, std::memory_order_release);
+			++head;
+			return true;
+		}
+	};
+
+	constexpr size_t CAPACITY = 1024;
+
+	/// Makes the calling thread the render thread.
+	void set_render_thread();
+
+	/// Returns true if the calling thread is the render thread, or if none has been set.
+	bool on_render_thread();
+
+	/// Enqueues \p command, waiting for the render thread to make room if the queue is full.
+	void push(const Command& command);
+
+	/// <summary>
+	/// Enqueues <paramref name="f"/> and returns true if called from any thread but
+	/// the render thread. Otherwise returns false, and the caller goes on to do the
+	/// work directly.
+	/// </summary>
+	template <typename F>
+	bool defer(F f)
+	{
+		if (on_render_thread())
+		{
+			return false;
+		}
+
+		push(Command(f));
+		return true;
+	}
+
+	/// Runs queued commands, at most CAPACITY of them. Must only be called from the render thread.
+	size_t drain();
+}
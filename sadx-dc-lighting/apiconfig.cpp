@@ -1,7 +1,8 @@
 #include "stdafx.h"
 #include "apiconfig.h"
 
-std::unordered_map<const NJS_MATERIAL*, std::deque<lantern_material_cb>> apiconfig::material_callbacks {};
+decltype(apiconfig::material_callbacks) apiconfig::material_callbacks {};
+decltype(apiconfig::instanced_models) apiconfig::instanced_models {};
 
 bool apiconfig::landtable_specular = false;
 bool apiconfig::object_vcolor      = true;
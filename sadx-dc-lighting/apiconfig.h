@@ -2,15 +2,26 @@
 
 #include <deque>
 #include <unordered_map>
+#include <unordered_set>
 
 #include <ninja.h>
 
 #include "..\include\lanternapi.h"
+#include "memory_accounting.h"
 
 class apiconfig
 {
 public:
-	static std::unordered_map<const NJS_MATERIAL*, std::deque<lantern_material_cb>> material_callbacks;
+	template <typename T>
+	using Allocator = memory_accounting::Allocator<T, memory_accounting::Tag::Callbacks>;
+
+	using MaterialCallbacks = std::deque<lantern_material_cb, Allocator<lantern_material_cb>>;
+
+	static std::unordered_map<const NJS_MATERIAL*, MaterialCallbacks, std::hash<const NJS_MATERIAL*>, std::equal_to<const NJS_MATERIAL*>,
+	                          Allocator<std::pair<const NJS_MATERIAL* const, MaterialCallbacks>>> material_callbacks;
+
+	static std::unordered_set<const NJS_MODEL_SADX*, std::hash<const NJS_MODEL_SADX*>, std::equal_to<const NJS_MODEL_SADX*>,
+	                          Allocator<const NJS_MODEL_SADX*>> instanced_models;
 
 	static bool landtable_specular;
 	static bool object_vcolor;
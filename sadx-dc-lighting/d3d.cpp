@@ -17,6 +17,7 @@
 #include <MinHook.h>
 
 // Standard library
+#include <algorithm>
 #include <iomanip>
 #include <sstream>
 #include <vector>
@@ -29,6 +30,16 @@
 #include "ShaderParameter.h"
 #include "FileSystem.h"
 #include "apiconfig.h"
+#include "polybuff_indexed.h"
+#include "instancing.h"
+#include "software_lighting.h"
+#include "trace_recorder.h"
+#include "frame_stats.h"
+#include "timeline.h"
+#include "shader_usage.h"
+#include "memory_accounting.h"
+#include "palette_store.h"
+#include "api_queue.h"
 
 namespace param
 {
@@ -60,6 +71,8 @@ namespace param
 	ShaderParameter<float>       AlphaRef(33, 16.0f / 255.0f, IShaderParameter::Type::pixel);
 	ShaderParameter<D3DXVECTOR3> ViewPosition(34, {}, IShaderParameter::Type::pixel);
 
+	ShaderParameter<D3DXMATRIX>  ViewMatrix(35, {}, IShaderParameter::Type::vertex);
+
 	IShaderParameter* const parameters[] = {
 		&PaletteA,
 		&PaletteB,
@@ -87,6 +100,8 @@ namespace param
 		&FogColor,
 		&AlphaRef,
 		&ViewPosition,
+
+		&ViewMatrix,
 	};
 
 	static void release_parameters()
@@ -112,6 +127,7 @@ namespace local
 	static Trampoline* PolyBuff_DrawTriangleStrip_t       = nullptr;
 	static Trampoline* PolyBuff_DrawTriangleList_t        = nullptr;
 
+	static HRESULT __stdcall EndScene_r(IDirect3DDevice9* _this);
 	static HRESULT __stdcall DrawPrimitive_r(IDirect3DDevice9* _this,
 	                                         D3DPRIMITIVETYPE PrimitiveType,
 	                                         UINT StartVertex,
@@ -138,6 +154,7 @@ namespace local
 	                                                  CONST void* pVertexStreamZeroData,
 	                                                  UINT VertexStreamZeroStride);
 
+	static decltype(EndScene_r)* EndScene_t                             = nullptr;
 	static decltype(DrawPrimitive_r)* DrawPrimitive_t                   = nullptr;
 	static decltype(DrawIndexedPrimitive_r)* DrawIndexedPrimitive_t     = nullptr;
 	static decltype(DrawPrimitiveUP_r)* DrawPrimitiveUP_t               = nullptr;
@@ -149,12 +166,21 @@ namespace local
 	constexpr auto VS_MASK       = ShaderFlags_Texture | ShaderFlags_EnvMap | ShaderFlags_Light | ShaderFlags_Blend;
 	constexpr auto PS_MASK       = ShaderFlags_Texture | ShaderFlags_Alpha | ShaderFlags_Fog | ShaderFlags_RangeFog;
 
+	// Vertex shader variants which aren't selectable through the API.
+	// They're combined with the shader flags to identify a vertex shader.
+	enum VertexVariant : Uint32
+	{
+		VertexVariant_Instanced     = 1 << 8,
+		VertexVariant_SoftwareLight = 1 << 9,
+		VertexVariant_Mask          = VertexVariant_Instanced | VertexVariant_SoftwareLight
+	};
+
 	static Uint32 shader_flags = DEFAULT_FLAGS;
 	static Uint32 last_flags   = DEFAULT_FLAGS;
 
 	static D3DXVECTOR3 last_light_dir = {};
 
-	static std::vector<uint8_t> shader_file;
+	static std::vector<uint8_t, memory_accounting::Allocator<uint8_t, memory_accounting::Tag::ShaderSource>> shader_file;
 	static std::unordered_map<ShaderFlags, VertexShader> vertex_shaders;
 	static std::unordered_map<ShaderFlags, PixelShader> pixel_shaders;
 
@@ -163,8 +189,16 @@ namespace local
 	static bool   using_shader  = false;
 	static bool   supports_xrgb = false;
 
+	// Replaces the next draw call made by the game while d3d::draw_polybuff is drawing a polybuff.
+	static const std::function<void()>* polybuff_draw = nullptr;
+
 	static std::vector<D3DXMACRO> macros;
 
+	// Permutations which together account for this share of past draws are created up front.
+	constexpr double HOT_PERMUTATION_COVERAGE = 0.99;
+	static shader_usage::Histogram permutation_usage;
+	static bool permutation_usage_loaded = false;
+
 	DataPointer(Direct3DDevice8*, Direct3D_Device, 0x03D128B0);
 	DataPointer(Direct3D8*, Direct3D_Object, 0x03D11F60);
 
@@ -190,8 +224,57 @@ namespace local
 		return flags;
 	}
 
+	// Keys identifying a permutation in the shader maps and cache.
+	static Uint32 vs_key(Uint32 flags)
+	{
+		return sanitize(flags & VS_MASK) | (flags & VertexVariant_Mask);
+	}
+
+	static Uint32 ps_key(Uint32 flags)
+	{
+		return sanitize(flags & PS_MASK);
+	}
+
+	static std::string usage_path()
+	{
+		// Kept outside of the cache directory so that it survives shader changes.
+		return globals::mod_path + "\\shader_usage.txt";
+	}
+
+	template <typename T>
+	static size_t bytecode_size(T* shader)
+	{
+		UINT size = 0;
+		shader->GetFunction(nullptr, &size);
+		return size;
+	}
+
+	template <typename T>
+	static void store_shader(std::unordered_map<ShaderFlags, CComPtr<T>>& shaders, ShaderFlags key, const CComPtr<T>& shader)
+	{
+		auto& entry = shaders[key];
+
+		if (entry != nullptr)
+		{
+			memory_accounting::release(memory_accounting::Tag::ShaderBytecode, bytecode_size(entry.p));
+		}
+
+		entry = shader;
+		memory_accounting::allocate(memory_accounting::Tag::ShaderBytecode, bytecode_size(shader.p));
+	}
+
 	static void free_shaders()
 	{
+		for (auto& it : vertex_shaders)
+		{
+			memory_accounting::release(memory_accounting::Tag::ShaderBytecode, bytecode_size(it.second.p));
+		}
+
+		for (auto& it : pixel_shaders)
+		{
+			memory_accounting::release(memory_accounting::Tag::ShaderBytecode, bytecode_size(it.second.p));
+		}
+
 		vertex_shaders.clear();
 		pixel_shaders.clear();
 		d3d::vertex_shader = nullptr;
@@ -214,6 +297,38 @@ namespace local
 			d3d::vertex_shader = get_vertex_shader(DEFAULT_FLAGS);
 			d3d::pixel_shader  = get_pixel_shader(DEFAULT_FLAGS);
 
+			if (!permutation_usage_loaded)
+			{
+				permutation_usage_loaded = true;
+
+				if (!permutation_usage.load(usage_path()))
+				{
+					PrintDebug("[lantern] Ignoring malformed shader usage file.\n");
+				}
+			}
+
+			// Create the permutations most likely to be drawn with now, leaving
+			// the rest to be created when they are first drawn with.
+			for (auto key : permutation_usage.hottest(shader_usage::Stage::Vertex, HOT_PERMUTATION_COVERAGE))
+			{
+				const bool usable = key & VertexVariant_SoftwareLight
+					? software_lighting::enabled()
+					: !(key & ShaderFlags_Light && software_lighting::enabled());
+
+				if (usable && vertex_shaders.find(static_cast<ShaderFlags>(key)) == vertex_shaders.end())
+				{
+					get_vertex_shader(key);
+				}
+			}
+
+			for (auto key : permutation_usage.hottest(shader_usage::Stage::Pixel, HOT_PERMUTATION_COVERAGE))
+			{
+				if (pixel_shaders.find(static_cast<ShaderFlags>(key)) == pixel_shaders.end())
+				{
+					get_pixel_shader(key);
+				}
+			}
+
 		#ifdef PRECOMPILE_SHADERS
 			for (Uint32 i = 0; i < ShaderFlags_Count; i++)
 			{
@@ -260,6 +375,22 @@ namespace local
 				result << " | ";
 			}
 
+			if (flags & VertexVariant_Instanced)
+			{
+				flags &= ~VertexVariant_Instanced;
+				result << "USE_INSTANCING";
+				thing = true;
+				continue;
+			}
+
+			if (flags & VertexVariant_SoftwareLight)
+			{
+				flags &= ~VertexVariant_SoftwareLight;
+				result << "SOFTWARE_LIGHTING";
+				thing = true;
+				continue;
+			}
+
 			if (flags & ShaderFlags_Fog)
 			{
 				flags &= ~ShaderFlags_Fog;
@@ -460,6 +591,16 @@ namespace local
 	{
 		using namespace d3d;
 
+		if (flags & VertexVariant_Instanced)
+		{
+			macros.push_back({ "USE_INSTANCING", "1" });
+		}
+
+		if (flags & VertexVariant_SoftwareLight)
+		{
+			macros.push_back({ "SOFTWARE_LIGHTING", "1" });
+		}
+
 		flags = sanitize(flags);
 
 		if (flags & ShaderFlags_Texture)
@@ -586,7 +727,7 @@ namespace local
 	{
 		using namespace std;
 
-		flags = sanitize(flags & VS_MASK);
+		flags = vs_key(flags);
 
 		if (shader_file.empty())
 		{
@@ -597,10 +738,13 @@ namespace local
 			const auto it = vertex_shaders.find(static_cast<ShaderFlags>(flags));
 			if (it != vertex_shaders.end())
 			{
+				++frame_stats::current.shader_cache_hits;
 				return it->second;
 			}
 		}
 
+		++frame_stats::current.shader_cache_misses;
+
 		macros.clear();
 
 		const string sid_path = filesystem::combine_path(globals::cache_path, shader_id(flags) + ".vs");
@@ -650,7 +794,7 @@ namespace local
 			save_cached_shader(sid_path, data);
 		}
 
-		vertex_shaders[static_cast<ShaderFlags>(flags)] = shader;
+		store_shader(vertex_shaders, static_cast<ShaderFlags>(flags), shader);
 		return shader;
 	}
 
@@ -667,10 +811,13 @@ namespace local
 			const auto it = pixel_shaders.find(static_cast<ShaderFlags>(flags & PS_MASK));
 			if (it != pixel_shaders.end())
 			{
+				++frame_stats::current.shader_cache_hits;
 				return it->second;
 			}
 		}
 
+		++frame_stats::current.shader_cache_misses;
+
 		macros.clear();
 
 		flags = sanitize(flags & PS_MASK);
@@ -722,7 +869,7 @@ namespace local
 			save_cached_shader(sid_path, data);
 		}
 
-		pixel_shaders[static_cast<ShaderFlags>(flags & PS_MASK)] = shader;
+		store_shader(pixel_shaders, static_cast<ShaderFlags>(flags & PS_MASK), shader);
 		return shader;
 	}
 
@@ -756,6 +903,63 @@ namespace local
 		}
 	}
 
+	/// <summary>
+	/// Lists the permutations which have never been drawn with, along with their
+	/// cache files, so that they can be left out of a shipped shader cache.
+	/// </summary>
+	static void write_usage_report(const std::string& path)
+	{
+		using shader_usage::Stage;
+
+		std::vector<uint32_t> vs_candidates;
+		std::vector<uint32_t> ps_candidates;
+
+		for (Uint32 i = 0; i < ShaderFlags_Count; i++)
+		{
+			const auto vs = vs_key(i);
+
+			for (Uint32 variant : { 0u, static_cast<Uint32>(VertexVariant_Instanced), static_cast<Uint32>(VertexVariant_SoftwareLight) })
+			{
+				if (variant == VertexVariant_SoftwareLight && !(vs & ShaderFlags_Light))
+				{
+					continue;
+				}
+
+				if (std::find(vs_candidates.begin(), vs_candidates.end(), vs | variant) == vs_candidates.end())
+				{
+					vs_candidates.push_back(vs | variant);
+				}
+			}
+
+			const auto ps = ps_key(i);
+
+			if (std::find(ps_candidates.begin(), ps_candidates.end(), ps) == ps_candidates.end())
+			{
+				ps_candidates.push_back(ps);
+			}
+		}
+
+		std::ofstream file(path, std::ios::out | std::ios::trunc);
+
+		if (!file.is_open())
+		{
+			return;
+		}
+
+		file << "Shader permutations never drawn with, out of "
+			<< permutation_usage.total(Stage::Vertex) << " recorded draws:\n";
+
+		for (auto key : permutation_usage.unused(Stage::Vertex, vs_candidates))
+		{
+			file << shader_id(key) << ".vs  " << to_string(key) << '\n';
+		}
+
+		for (auto key : permutation_usage.unused(Stage::Pixel, ps_candidates))
+		{
+			file << shader_id(key) << ".ps  " << to_string(key) << '\n';
+		}
+	}
+
 	static void shader_end()
 	{
 		if (using_shader)
@@ -766,7 +970,7 @@ namespace local
 		}
 	}
 
-	static void shader_start()
+	static void update_shaders()
 	{
 		if (!d3d::do_effect || !drawing)
 		{
@@ -779,7 +983,21 @@ namespace local
 
 		bool changes = false;
 
-		const auto flags = sanitize(shader_flags);
+		auto flags = sanitize(shader_flags);
+
+		if (software_lighting::enabled())
+		{
+			// Palettes can't be sampled by the vertex shader, so only
+			// draws lit on the CPU can use the lighting permutations.
+			flags = d3d::draw_software_lit ? flags | VertexVariant_SoftwareLight : sanitize(flags & ~ShaderFlags_Light);
+		}
+
+		if (d3d::draw_instanced)
+		{
+			flags |= VertexVariant_Instanced;
+		}
+
+		permutation_usage.add(vs_key(flags), ps_key(flags));
 
 		if (flags != last_flags)
 		{
@@ -788,6 +1006,7 @@ namespace local
 
 			changes = true;
 			last_flags = flags;
+			++frame_stats::current.shader_switches;
 
 			try
 			{
@@ -823,7 +1042,10 @@ namespace local
 		{
 			for (auto& it : IShaderParameter::values_assigned)
 			{
-				it->commit(d3d::device);
+				if (it->commit(d3d::device))
+				{
+					frame_stats::current.constant_registers += it->register_count();
+				}
 			}
 
 			IShaderParameter::values_assigned.clear();
@@ -832,12 +1054,28 @@ namespace local
 		using_shader = true;
 	}
 
+	static void shader_start()
+	{
+		TIMELINE_SCOPE("shader_start");
+
+		if (!frame_stats::enabled())
+		{
+			update_shaders();
+			return;
+		}
+
+		const auto start = frame_stats::clock::now();
+		update_shaders();
+		frame_stats::time_shader_start(start);
+	}
+
 #define MHOOK(NAME) MH_CreateHook(vtbl[IndexOf_ ## NAME], NAME ## _r, (LPVOID*)&NAME ## _t)
 
 	static void hook_vtable()
 	{
 		enum
 		{
+			IndexOf_EndScene = 42,
 			IndexOf_SetTexture = 65,
 			IndexOf_DrawPrimitive = 81,
 			IndexOf_DrawIndexedPrimitive,
@@ -847,6 +1085,7 @@ namespace local
 
 		auto vtbl = (void**)(*(void**)d3d::device);
 
+		MHOOK(EndScene);
 		MHOOK(DrawPrimitive);
 		MHOOK(DrawIndexedPrimitive);
 		MHOOK(DrawPrimitiveUP);
@@ -867,6 +1106,7 @@ namespace local
 
 	static void __cdecl sub_77EAD0_r(void* a1, int a2, int a3)
 	{
+		instancing::flush();
 		begin();
 		run_trampoline(TARGET_DYNAMIC(sub_77EAD0), a1, a2, a3);
 		end();
@@ -874,6 +1114,7 @@ namespace local
 
 	static void __cdecl sub_77EBA0_r(void* a1, int a2, int a3)
 	{
+		instancing::flush();
 		begin();
 		run_trampoline(TARGET_DYNAMIC(sub_77EBA0), a1, a2, a3);
 		end();
@@ -881,6 +1122,13 @@ namespace local
 
 	static void __cdecl njDrawModel_SADX_r(NJS_MODEL_SADX* a1)
 	{
+		TIMELINE_SCOPE("njDrawModel_SADX");
+
+		if (instancing::queue(a1))
+		{
+			return;
+		}
+
 		begin();
 
 		if (a1 && a1->nbMat && a1->mats)
@@ -907,6 +1155,7 @@ namespace local
 
 	static void __cdecl njDrawModel_SADX_Dynamic_r(NJS_MODEL_SADX* a1)
 	{
+		instancing::flush();
 		begin();
 
 		if (a1 && a1->nbMat && a1->mats)
@@ -933,6 +1182,7 @@ namespace local
 
 	static void __fastcall PolyBuff_DrawTriangleStrip_r(PolyBuff* _this)
 	{
+		instancing::flush();
 		begin();
 		run_trampoline(TARGET_DYNAMIC(PolyBuff_DrawTriangleStrip), _this);
 		end();
@@ -940,6 +1190,7 @@ namespace local
 
 	static void __fastcall PolyBuff_DrawTriangleList_r(PolyBuff* _this)
 	{
+		instancing::flush();
 		begin();
 		run_trampoline(TARGET_DYNAMIC(PolyBuff_DrawTriangleList), _this);
 		end();
@@ -963,10 +1214,8 @@ namespace local
 
 		if (result != D3D_OK)
 		{
-			MessageBoxA(WindowHandle, "Your GPU does not support any (reasonable) vertex texture sample formats.",
-			            "Insufficient GPU support", MB_OK | MB_ICONERROR);
-
-			Exit();
+			PrintDebug("[lantern] GPU does not support any (reasonable) vertex texture sample formats. Lighting will be done on the CPU.\n");
+			software_lighting::set_enabled(true);
 		}
 	}
 
@@ -1020,6 +1269,7 @@ namespace local
 	static void __cdecl Direct3D_SetWorldTransform_r()
 	{
 		TARGET_DYNAMIC(Direct3D_SetWorldTransform)();
+		TRACE_EVENT(world_transform);
 
 		if (!LanternInstance::use_palette())
 		{
@@ -1044,6 +1294,7 @@ namespace local
 		// The view matrix can also be set here if necessary.
 		param::ProjectionMatrix = D3DXMATRIX(ProjectionMatrix) * D3DXMATRIX(TransformationMatrix);
 		param::ViewPosition = D3DXVECTOR3(InverseViewMatrix._41, InverseViewMatrix._42, InverseViewMatrix._43);
+		TRACE_EVENT(projection_matrix, hfov, nearPlane, farPlane, param::ProjectionMatrix.value());
 	}
 
 	static void __cdecl Direct3D_SetViewportAndTransform_r()
@@ -1062,6 +1313,9 @@ namespace local
 	static void __cdecl Direct3D_PerformLighting_r(int type)
 	{
 		const auto target = TARGET_DYNAMIC(Direct3D_PerformLighting);
+		TRACE_EVENT(perform_lighting, type);
+
+		instancing::flush();
 
 		if (!LanternInstance::use_palette())
 		{
@@ -1094,12 +1348,36 @@ namespace local
 #define D3D_ORIG(NAME) \
 	NAME ## _t
 
+	static HRESULT __stdcall EndScene_r(IDirect3DDevice9* _this)
+	{
+		instancing::flush();
+		api_queue::drain();
+		TRACE_EVENT(frame);
+		frame_stats::end_frame();
+		return D3D_ORIG(EndScene)(_this);
+	}
+
 	static HRESULT __stdcall DrawPrimitive_r(IDirect3DDevice9* _this,
 	                                         D3DPRIMITIVETYPE PrimitiveType,
 	                                         UINT StartVertex,
 	                                         UINT PrimitiveCount)
 	{
+		if (polybuff_draw != nullptr)
+		{
+			// The game has applied the polybuff's state; the
+			// substituted draw goes through these hooks itself.
+			const auto draw = polybuff_draw;
+			polybuff_draw = nullptr;
+			(*draw)();
+			return D3D_OK;
+		}
+
+		// Anything drawn outside of the hooked draw functions has
+		// already set up its state, so it's preserved around the flush.
+		instancing::flush(true);
+		++frame_stats::current.draws[LanternDraw_Primitive];
 		shader_start();
+		TRACE_EVENT(draw, trace::DrawKind::Primitive, PrimitiveType, PrimitiveCount, 0, using_shader ? last_flags : 0);
 		auto result = D3D_ORIG(DrawPrimitive)(_this, PrimitiveType, StartVertex, PrimitiveCount);
 		shader_end();
 		return result;
@@ -1113,7 +1391,10 @@ namespace local
 	                                                UINT startIndex,
 	                                                UINT primCount)
 	{
+		instancing::flush(true);
+		++frame_stats::current.draws[LanternDraw_IndexedPrimitive];
 		shader_start();
+		TRACE_EVENT(draw, trace::DrawKind::IndexedPrimitive, PrimitiveType, primCount, NumVertices, using_shader ? last_flags : 0);
 		auto result = D3D_ORIG(DrawIndexedPrimitive)(_this, PrimitiveType, BaseVertexIndex, MinVertexIndex, NumVertices, startIndex, primCount);
 		shader_end();
 		return result;
@@ -1125,7 +1406,10 @@ namespace local
 	                                           CONST void* pVertexStreamZeroData,
 	                                           UINT VertexStreamZeroStride)
 	{
+		instancing::flush(true);
+		++frame_stats::current.draws[LanternDraw_PrimitiveUP];
 		shader_start();
+		TRACE_EVENT(draw, trace::DrawKind::PrimitiveUP, PrimitiveType, PrimitiveCount, 0, using_shader ? last_flags : 0);
 		auto result = D3D_ORIG(DrawPrimitiveUP)(_this, PrimitiveType, PrimitiveCount, pVertexStreamZeroData, VertexStreamZeroStride);
 		shader_end();
 		return result;
@@ -1141,7 +1425,10 @@ namespace local
 	                                                  CONST void* pVertexStreamZeroData,
 	                                                  UINT VertexStreamZeroStride)
 	{
+		instancing::flush(true);
+		++frame_stats::current.draws[LanternDraw_IndexedPrimitiveUP];
 		shader_start();
+		TRACE_EVENT(draw, trace::DrawKind::IndexedPrimitiveUP, PrimitiveType, PrimitiveCount, NumVertices, using_shader ? last_flags : 0);
 		auto result = D3D_ORIG(DrawIndexedPrimitiveUP)(_this, PrimitiveType, MinVertexIndex, NumVertices, PrimitiveCount, pIndexData, IndexDataFormat, pVertexStreamZeroData, VertexStreamZeroStride);
 		shader_end();
 		return result;
@@ -1158,6 +1445,22 @@ namespace local
 		Direct3D_Device->SetVertexShader(buffer->FVF);
 		Direct3D_Device->SetStreamSource(0, buffer->VertexBuffer, buffer->Size);
 
+		if (instancing::active())
+		{
+			begin();
+			instancing::draw(buffer);
+			end();
+			return;
+		}
+
+		if (software_lighting::upload(buffer))
+		{
+			begin();
+			software_lighting::draw(buffer);
+			end();
+			return;
+		}
+
 		const auto index_buffer = buffer->IndexBuffer;
 		if (index_buffer)
 		{
@@ -1210,6 +1513,8 @@ namespace d3d
 	VertexShader vertex_shader;
 	PixelShader pixel_shader;
 	bool do_effect = false;
+	bool draw_instanced = false;
+	bool draw_software_lit = false;
 
 	bool supports_xrgb()
 	{
@@ -1267,11 +1572,48 @@ namespace d3d
 		}
 	}
 
+	Uint32 get_flags()
+	{
+		return local::sanitize(local::shader_flags);
+	}
+
 	bool shaders_null()
 	{
 		return vertex_shader == nullptr || pixel_shader == nullptr;
 	}
 
+	void draw_polybuff(PolyBuff& polybuff, D3DPRIMITIVETYPE type, UINT primitive_count, const std::function<void()>& draw)
+	{
+		// Polybuffs are drawn right after they're locked,
+		// so none of their render arguments are pending here.
+		polybuff.RenderArgs[polybuff.LockCount++] = { 0, primitive_count, static_cast<Uint32>(Direct3D_CurrentCullMode), 0 };
+
+		local::polybuff_draw = &draw;
+
+		if (type == D3DPT_TRIANGLESTRIP)
+		{
+			local::PolyBuff_DrawTriangleStrip_r(&polybuff);
+		}
+		else
+		{
+			local::PolyBuff_DrawTriangleList_r(&polybuff);
+		}
+
+		local::polybuff_draw = nullptr;
+	}
+
+	bool readable(Direct3DVertexBuffer8* vertex_buffer)
+	{
+		D3DVERTEXBUFFER_DESC desc {};
+
+		if (FAILED(vertex_buffer->GetProxyInterface()->GetDesc(&desc)) || desc.Usage & D3DUSAGE_WRITEONLY)
+		{
+			return false;
+		}
+
+		return desc.Pool != D3DPOOL_DEFAULT || desc.Usage & D3DUSAGE_DYNAMIC;
+	}
+
 	void init_trampolines()
 	{
 		using namespace local;
@@ -1308,6 +1650,9 @@ extern "C"
 	{
 		end();
 		free_shaders();
+		polybuff_indexed::release();
+		instancing::release();
+		software_lighting::release();
 	}
 
 	EXPORT void __cdecl OnRenderDeviceReset()
@@ -1317,7 +1662,25 @@ extern "C"
 
 	EXPORT void __cdecl OnExit()
 	{
+		frame_stats::flush_csv();
+
+		if (permutation_usage.total(shader_usage::Stage::Vertex))
+		{
+			permutation_usage.save(usage_path());
+			write_usage_report(globals::mod_path + "\\shader_usage_report.txt");
+		}
+
+		if (timeline::enabled())
+		{
+			timeline::write(globals::mod_path + "\\timeline.json");
+		}
+
+		globals::palettes.release_atlas();
+		palette_store::clear();
 		param::release_parameters();
 		free_shaders();
+		polybuff_indexed::release();
+		instancing::release();
+		software_lighting::release();
 	}
 }
@@ -4,9 +4,12 @@
 #include <d3dx9effect.h>
 #include <d3d8to9.hpp>
 #include <ninja.h>
+#include <functional>
 
 #include "ShaderParameter.h"
 
+struct PolyBuff;
+
 namespace d3d
 {
 	extern IDirect3DDevice9* device;
@@ -14,11 +17,32 @@ namespace d3d
 	extern PixelShader pixel_shader;
 
 	extern bool do_effect;
+	/// Selects the instanced vertex shader permutations for the next draw.
+	extern bool draw_instanced;
+	/// Selects the vertex shader permutations which take lighting from the vertex colors for the next draw.
+	extern bool draw_software_lit;
 	bool supports_xrgb();
 	void reset_overrides();
 	void load_shader();
 	void set_flags(Uint32 flags, bool add = true);
+	/// Returns the shader flags the next draw will use.
+	Uint32 get_flags();
 	bool shaders_null();
+
+	/// <summary>
+	/// Draws a stream which was prepared outside of a polybuff in its place. The polybuff is
+	/// drawn by its own draw function with render arguments recorded the way PolyBuff_Lock*
+	/// records them, so the game applies the current cull mode and the draw hooks apply the
+	/// shader as usual; only the draw call the game makes is replaced with <paramref name="draw"/>.
+	/// </summary>
+	void draw_polybuff(PolyBuff& polybuff, D3DPRIMITIVETYPE type, UINT primitive_count, const std::function<void()>& draw);
+
+	/// <summary>
+	/// Returns true if a vertex buffer can be locked for reading. Meshset buffers are created
+	/// by the game, so this is checked rather than assumed: write-only buffers and static
+	/// default pool buffers can't be read back, and would otherwise fail to lock every time.
+	/// </summary>
+	bool readable(Direct3DVertexBuffer8* vertex_buffer);
 	void init_trampolines();
 }
 
@@ -50,6 +74,8 @@ namespace param
 	extern ShaderParameter<D3DXCOLOR> FogColor;
 	extern ShaderParameter<float> AlphaRef;
 	extern ShaderParameter<D3DXVECTOR3> ViewPosition;
+
+	extern ShaderParameter<D3DXMATRIX> ViewMatrix;
 }
 
 // Same as in the mod loader except with d3d8to9 types.
@@ -8,7 +8,9 @@
 
 // Local
 #include "d3d.h"
+#include "instancing.h"
 #include "../include/lanternapi.h"
+#include "trace_recorder.h"
 
 static D3DFOGMODE fog_mode = D3DFOG_NONE;
 
@@ -26,25 +28,33 @@ using namespace d3d;
 
 static void __cdecl njDisableFog_r()
 {
+	// Queued instances are drawn with the fog they were queued with.
+	instancing::flush();
 	TARGET_STATIC(njDisableFog)();
+	TRACE_EVENT(fog_enable, false);
 	set_flags(ShaderFlags_Fog, false);
 }
 
 static void __cdecl njEnableFog_r()
 {
+	instancing::flush();
 	TARGET_STATIC(njEnableFog)();
+	TRACE_EVENT(fog_enable, true);
 	param::FogMode = fog_mode;
 	set_flags(ShaderFlags_Fog, true);
 }
 
 static void __cdecl njSetFogColor_r(Uint32 c)
 {
+	instancing::flush();
 	TARGET_STATIC(njSetFogColor)(c);
+	TRACE_EVENT(fog_color, c);
 	param::FogColor = D3DXCOLOR(c);
 }
 
 static void __cdecl njSetFogTable_r(NJS_FOG_TABLE fogtable)
 {
+	instancing::flush();
 	TARGET_STATIC(njSetFogTable)(fogtable);
 
 	if (device == nullptr)
@@ -72,4 +82,5 @@ static void __cdecl njSetFogTable_r(NJS_FOG_TABLE fogtable)
 	}
 
 	param::FogConfig = fog_config;
+	TRACE_EVENT(fog_table, fog_mode, start, end, fog_config.z);
 }
@@ -0,0 +1,204 @@
+#include "stdafx.h"
+
+#include <array>
+#include <fstream>
+
+#include "frame_stats.h"
+#include "polybuff_cache.h"
+
+namespace frame_stats
+{
+	LanternFrameStats current = {};
+
+	static bool enabled_ = false;
+
+	static std::array<LanternFrameStats, HISTORY_SIZE> history {};
+	static size_t head   = 0;
+	static size_t filled = 0;
+
+	static uint32_t frame_index = 0;
+	static clock::time_point last_frame_end = clock::now();
+	static polybuff_cache::Stats last_polybuff = {};
+
+	static std::string csv_path;
+	static size_t csv_pending = 0;
+
+	static const char* const DRAW_NAMES[LanternDraw_Count] = {
+		"draw_primitive",
+		"draw_indexed_primitive",
+		"draw_primitive_up",
+		"draw_indexed_primitive_up",
+	};
+
+	void set_enabled(bool value)
+	{
+		enabled_ = value;
+	}
+
+	bool enabled()
+	{
+		return enabled_;
+	}
+
+	void time_shader_start(clock::time_point start)
+	{
+		const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count();
+
+		size_t bucket = 0;
+
+		for (auto v = static_cast<uint64_t>(ns) >> 8; v && bucket < LANTERN_TIME_BUCKETS - 1; v >>= 1)
+		{
+			++bucket;
+		}
+
+		++current.shader_start_time[bucket];
+	}
+
+	static void write_header(std::ofstream& file)
+	{
+		file << "frame,frame_time";
+
+		for (auto name : DRAW_NAMES)
+		{
+			file << ',' << name;
+		}
+
+		file << ",shader_switches,constant_registers,atlas_uploads,material_parses,callback_invocations"
+		        ",shader_cache_hits,shader_cache_misses,polybuff_cache_hits,polybuff_cache_misses";
+
+		for (size_t i = 0; i < LANTERN_TIME_BUCKETS - 1; i++)
+		{
+			file << ",shader_start_lt_" << (256u << i) << "ns";
+		}
+
+		file << ",shader_start_ge_" << (256u << (LANTERN_TIME_BUCKETS - 2)) << "ns\n";
+	}
+
+	static void write_row(std::ofstream& file, const LanternFrameStats& stats)
+	{
+		file << stats.frame << ',' << stats.frame_time;
+
+		for (auto draws : stats.draws)
+		{
+			file << ',' << draws;
+		}
+
+		file << ',' << stats.shader_switches
+		     << ',' << stats.constant_registers
+		     << ',' << stats.atlas_uploads
+		     << ',' << stats.material_parses
+		     << ',' << stats.callback_invocations
+		     << ',' << stats.shader_cache_hits
+		     << ',' << stats.shader_cache_misses
+		     << ',' << stats.polybuff_cache_hits
+		     << ',' << stats.polybuff_cache_misses;
+
+		for (auto count : stats.shader_start_time)
+		{
+			file << ',' << count;
+		}
+
+		file << '\n';
+	}
+
+	// Writes the most recent \p frames frames, oldest first.
+	static void write_rows(std::ofstream& file, size_t frames)
+	{
+		for (size_t i = frames; i > 0; i--)
+		{
+			write_row(file, history[(head + HISTORY_SIZE - i) % HISTORY_SIZE]);
+		}
+	}
+
+	void end_frame()
+	{
+		const auto now = clock::now();
+		const auto& polybuff = polybuff_cache::stats();
+
+		current.frame       = frame_index++;
+		current.frame_time  = std::chrono::duration<float, std::milli>(now - last_frame_end).count();
+		current.polybuff_cache_hits   = static_cast<uint32_t>(polybuff.hits - last_polybuff.hits);
+		current.polybuff_cache_misses = static_cast<uint32_t>(polybuff.misses - last_polybuff.misses);
+
+		last_frame_end = now;
+		last_polybuff  = polybuff;
+
+		history[head] = current;
+		head = (head + 1) % HISTORY_SIZE;
+
+		if (filled < HISTORY_SIZE)
+		{
+			++filled;
+		}
+
+		current = {};
+
+		if (!csv_path.empty() && ++csv_pending == HISTORY_SIZE)
+		{
+			flush_csv();
+		}
+	}
+
+	bool start_csv(const std::string& path)
+	{
+		std::ofstream file(path, std::ios::out | std::ios::trunc);
+
+		if (!file.is_open())
+		{
+			return false;
+		}
+
+		write_header(file);
+
+		csv_path    = path;
+		csv_pending = 0;
+		return true;
+	}
+
+	void flush_csv()
+	{
+		if (csv_path.empty() || !csv_pending)
+		{
+			return;
+		}
+
+		std::ofstream file(csv_path, std::ios::out | std::ios::app);
+
+		if (file.is_open())
+		{
+			write_rows(file, csv_pending);
+		}
+
+		csv_pending = 0;
+	}
+
+	size_t count()
+	{
+		return filled;
+	}
+
+	bool get(size_t frames_ago, LanternFrameStats& stats)
+	{
+		if (frames_ago >= filled)
+		{
+			return false;
+		}
+
+		stats = history[(head + HISTORY_SIZE - 1 - frames_ago) % HISTORY_SIZE];
+		return true;
+	}
+
+	bool dump(const std::string& path)
+	{
+		std::ofstream file(path, std::ios::out | std::ios::trunc);
+
+		if (!file.is_open())
+		{
+			return false;
+		}
+
+		write_header(file);
+		write_rows(file, filled);
+		return file.good();
+	}
+}
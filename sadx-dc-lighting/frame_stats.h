@@ -0,0 +1,47 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+
+#include "../include/lanternapi.h"
+
+/*
+ * Counts the work done by the hooks each frame. Counters are plain
+ * increments on the frame in progress, which is moved into a ring of
+ * recent frames at the end of each frame. Timing of shader_start is
+ * only collected while enabled, since reading the clock around every
+ * draw isn't free.
+ */
+namespace frame_stats
+{
+	using clock = std::chrono::high_resolution_clock;
+
+	/// Frames kept for frame_stats_get and written per CSV flush.
+	constexpr size_t HISTORY_SIZE = 600;
+
+	/// Counters for the frame in progress.
+	extern LanternFrameStats current;
+
+	void set_enabled(bool value);
+	bool enabled();
+
+	/// Records the time taken by a call to shader_start which began at \p start.
+	void time_shader_start(clock::time_point start);
+
+	/// Completes the frame in progress and starts the next one.
+	void end_frame();
+
+	/// <summary>
+	/// Appends every completed frame to a CSV file as the history fills up, and on <see cref="flush_csv"/>.
+	/// The file is overwritten when logging starts.
+	/// </summary>
+	bool start_csv(const std::string& path);
+	/// Appends frames which haven't been written yet to the CSV file.
+	void flush_csv();
+
+	size_t count();
+	/// Gets a completed frame; 0 is the most recent.
+	bool get(size_t frames_ago, LanternFrameStats& stats);
+	/// Writes every completed frame in the history to a new CSV file.
+	bool dump(const std::string& path);
+}
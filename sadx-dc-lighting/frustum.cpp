@@ -0,0 +1,138 @@
+#include "stdafx.h"
+
+#include <cmath>
+#include <xmmintrin.h>
+
+#include "frustum.h"
+
+namespace frustum
+{
+	Planes extract(const float* m)
+	{
+		// Column j of the matrix is (m[j], m[4 + j], m[8 + j], m[12 + j]).
+		static const int   columns[6] = { 0, 0, 1, 1, 2, 2 };
+		static const float signs[6]   = { 1.0f, -1.0f, 1.0f, -1.0f, 1.0f, -1.0f };
+
+		Planes result {};
+
+		for (int i = 0; i < 6; i++)
+		{
+			const int j = columns[i];
+
+			float a, b, c, d;
+
+			// The near plane is z >= 0 rather than z >= -w.
+			if (i == 4)
+			{
+				a = m[j];
+				b = m[4 + j];
+				c = m[8 + j];
+				d = m[12 + j];
+			}
+			else
+			{
+				a = m[3] + signs[i] * m[j];
+				b = m[7] + signs[i] * m[4 + j];
+				c = m[11] + signs[i] * m[8 + j];
+				d = m[15] + signs[i] * m[12 + j];
+			}
+
+			const float length = std::sqrt(a * a + b * b + c * c);
+			const float scale  = length > 0.0f ? 1.0f / length : 0.0f;
+
+			result.a[i] = a * scale;
+			result.b[i] = b * scale;
+			result.c[i] = c * scale;
+			result.d[i] = d * scale;
+		}
+
+		return result;
+	}
+
+	void SphereSet::clear()
+	{
+		x.clear();
+		y.clear();
+		z.clear();
+		r.clear();
+		count = 0;
+	}
+
+	void SphereSet::add(float cx, float cy, float cz, float radius)
+	{
+		// Keep the arrays padded to a multiple of four with empty spheres.
+		if (count % 4 == 0)
+		{
+			x.resize(count + 4, 0.0f);
+			y.resize(count + 4, 0.0f);
+			z.resize(count + 4, 0.0f);
+			r.resize(count + 4, 0.0f);
+		}
+
+		x[count] = cx;
+		y[count] = cy;
+		z[count] = cz;
+		r[count] = radius;
+		++count;
+	}
+
+	size_t SphereSet::size() const
+	{
+		return count;
+	}
+
+	void SphereSet::cull(const Planes& planes, std::vector<uint32_t>& visible) const
+	{
+		visible.clear();
+
+		__m128 pa[6], pb[6], pc[6], pd[6];
+
+		for (int i = 0; i < 6; i++)
+		{
+			pa[i] = _mm_set1_ps(planes.a[i]);
+			pb[i] = _mm_set1_ps(planes.b[i]);
+			pc[i] = _mm_set1_ps(planes.c[i]);
+			pd[i] = _mm_set1_ps(planes.d[i]);
+		}
+
+		for (size_t base = 0; base < count; base += 4)
+		{
+			const __m128 sx = _mm_loadu_ps(&x[base]);
+			const __m128 sy = _mm_loadu_ps(&y[base]);
+			const __m128 sz = _mm_loadu_ps(&z[base]);
+			const __m128 nr = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&r[base]));
+
+			__m128 outside = _mm_setzero_ps();
+
+			for (int i = 0; i < 6; i++)
+			{
+				__m128 distance = _mm_add_ps(_mm_mul_ps(pa[i], sx), pd[i]);
+				distance = _mm_add_ps(distance, _mm_mul_ps(pb[i], sy));
+				distance = _mm_add_ps(distance, _mm_mul_ps(pc[i], sz));
+
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, nr));
+			}
+
+			int mask = ~_mm_movemask_ps(outside) & 0xF;
+
+			while (mask)
+			{
+				unsigned long lane = 0;
+
+				while (!(mask & (1 << lane)))
+				{
+					++lane;
+				}
+
+				mask &= mask - 1;
+
+				const size_t index = base + lane;
+
+				if (index < count)
+				{
+					visible.push_back(static_cast<uint32_t>(index));
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+// This header is intentionally free of game and Direct3D
+// dependencies so that it can be used and measured headlessly.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace frustum
+{
+	/// View frustum planes in structure-of-arrays layout.
+	/// A point p is inside a plane if a * p.x + b * p.y + c * p.z + d >= 0.
+	struct Planes
+	{
+		float a[6];
+		float b[6];
+		float c[6];
+		float d[6];
+	};
+
+	/// <summary>
+	/// Extracts normalized frustum planes from a row-major world-to-clip matrix
+	/// using the Direct3D convention (row vectors, clip space z in [0, 1]).
+	/// </summary>
+	Planes extract(const float* m);
+
+	/// Bounding spheres packed four at a time for SIMD testing.
+	class SphereSet
+	{
+		std::vector<float> x, y, z, r;
+		size_t count = 0;
+
+	public:
+		void clear();
+		void add(float cx, float cy, float cz, float radius);
+		size_t size() const;
+
+		/// <summary>
+		/// Tests every sphere against the frustum, four at a time.
+		/// </summary>
+		/// <param name="planes">The frustum to test against.</param>
+		/// <param name="visible">Receives the indices of spheres which intersect the frustum, in ascending order.</param>
+		void cull(const Planes& planes, std::vector<uint32_t>& visible) const;
+	};
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+// This header is intentionally free of game and Direct3D
+// dependencies so that it can be used and measured headlessly.
+
+namespace instancing
+{
+	/// Columns of an instance's world matrix, as read by the instanced vertex shader.
+	struct InstanceData
+	{
+		float columns[3][4];
+	};
+
+	static_assert(sizeof(InstanceData) == 48, "instance data size mismatch");
+
+	/// <summary>
+	/// Packs a world matrix into the instance stream. The matrix is row-major with
+	/// row vectors, like D3DXMATRIX, so its last column is always (0, 0, 0, 1) and
+	/// only the first three columns are stored.
+	/// </summary>
+	inline void pack(const float (&world)[4][4], InstanceData& out)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			for (int r = 0; r < 4; r++)
+			{
+				out.columns[c][r] = world[r][c];
+			}
+		}
+	}
+}
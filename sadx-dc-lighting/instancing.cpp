@@ -0,0 +1,524 @@
+#include "stdafx.h"
+
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include <atlbase.h>
+#include <d3dx9.h>
+#include <SADXModLoader.h>
+
+#include "d3d.h"
+#include "globals.h"
+#include "lantern.h"
+#include "apiconfig.h"
+#include "instancing.h"
+#include "instance_data.h"
+#include "software_lighting.h"
+
+namespace instancing
+{
+	FunctionPointer(void, SetWorldTransform, (), 0x00791AB0);
+	FunctionPointer(void, DrawModel, (NJS_MODEL_SADX* model), 0x0077EDA0);
+
+	static constexpr UINT MAX_INSTANCES        = 1024;
+	static constexpr UINT INSTANCE_BUFFER_SIZE = 1 << 20;
+
+	struct Instance
+	{
+		NJS_MATRIX matrix;
+	};
+
+	/// Device state the game sets directly rather than through anything hooked.
+	/// Fog is flushed for by the fog hooks instead.
+	static const D3DRENDERSTATETYPE RENDER_STATES[] = {
+		D3DRS_ALPHABLENDENABLE,
+		D3DRS_SRCBLEND,
+		D3DRS_DESTBLEND,
+		D3DRS_ALPHATESTENABLE,
+		D3DRS_ALPHAREF,
+		D3DRS_ALPHAFUNC,
+		D3DRS_ZENABLE,
+		D3DRS_ZWRITEENABLE,
+		D3DRS_ZFUNC,
+		D3DRS_CULLMODE,
+		D3DRS_FOGENABLE,
+	};
+
+	static constexpr size_t RENDER_STATE_COUNT = sizeof(RENDER_STATES) / sizeof(RENDER_STATES[0]);
+
+	/// Everything which must match for two draws to be drawn together.
+	/// The batch's state is restored while it's drawn, since the game may
+	/// have changed it again by the time the batch is flushed.
+	struct State
+	{
+		NJS_MODEL_SADX* model;
+		NJS_TEXLIST* texlist;
+		Uint32 control_3d;
+		Uint32 attr_and;
+		Uint32 attr_or;
+		Sint32 light_type;
+		NJS_ARGB material;
+		DWORD render_states[RENDER_STATE_COUNT];
+
+		bool operator==(const State& other) const
+		{
+			return model == other.model
+			       && texlist == other.texlist
+			       && control_3d == other.control_3d
+			       && attr_and == other.attr_and
+			       && attr_or == other.attr_or
+			       && light_type == other.light_type
+			       && !memcmp(&material, &other.material, sizeof(NJS_ARGB))
+			       && !memcmp(render_states, other.render_states, sizeof(render_states));
+		}
+	};
+
+	/// <summary>
+	/// Device state which drawing a batch changes and a draw already set up by the game
+	/// depends on. Render states are restored separately, along with the batch's own.
+	/// Cheaper than a state block, which a flush from a draw hook would otherwise need
+	/// for every draw following a queued batch.
+	/// </summary>
+	struct DeviceState
+	{
+		CComPtr<IDirect3DVertexBuffer9> streams[2];
+		UINT offsets[2] {};
+		UINT strides[2] {};
+		UINT frequencies[2] {};
+		CComPtr<IDirect3DIndexBuffer9> indices;
+		CComPtr<IDirect3DVertexDeclaration9> declaration;
+		DWORD fvf = 0;
+		CComPtr<IDirect3DVertexShader9> vertex_shader;
+		CComPtr<IDirect3DPixelShader9> pixel_shader;
+		CComPtr<IDirect3DBaseTexture9> texture;
+		D3DMATRIX world {};
+		D3DMATERIAL9 material {};
+
+		void save()
+		{
+			const auto device = d3d::device;
+
+			for (UINT i = 0; i < 2; i++)
+			{
+				device->GetStreamSource(i, &streams[i], &offsets[i], &strides[i]);
+				device->GetStreamSourceFreq(i, &frequencies[i]);
+			}
+
+			device->GetIndices(&indices);
+			device->GetVertexDeclaration(&declaration);
+			device->GetFVF(&fvf);
+			device->GetVertexShader(&vertex_shader);
+			device->GetPixelShader(&pixel_shader);
+			device->GetTexture(0, &texture);
+			device->GetTransform(D3DTS_WORLD, &world);
+			device->GetMaterial(&material);
+		}
+
+		void restore() const
+		{
+			const auto device = d3d::device;
+
+			for (UINT i = 0; i < 2; i++)
+			{
+				device->SetStreamSource(i, streams[i], offsets[i], strides[i]);
+				device->SetStreamSourceFreq(i, frequencies[i]);
+			}
+
+			device->SetIndices(indices);
+
+			// Setting an FVF replaces the declaration with one built from it.
+			if (fvf)
+			{
+				device->SetFVF(fvf);
+			}
+			else
+			{
+				device->SetVertexDeclaration(declaration);
+			}
+
+			device->SetVertexShader(vertex_shader);
+			device->SetPixelShader(pixel_shader);
+			device->SetTexture(0, texture);
+			device->SetTransform(D3DTS_WORLD, &world);
+			device->SetMaterial(&material);
+		}
+	};
+
+	static bool enabled_ = true;
+	static bool flushing = false;
+	static bool uploaded = false;
+
+	static State batch {};
+	static std::vector<Instance> instances;
+
+	static CComPtr<IDirect3DVertexBuffer9> instance_buffer;
+	static UINT instance_offset = 0;
+	static UINT uploaded_offset = 0;
+
+	static std::unordered_map<DWORD, CComPtr<IDirect3DVertexDeclaration9>> declarations;
+
+	static Stats stats_ {};
+
+	void set_enabled(bool value)
+	{
+		enabled_ = value;
+	}
+
+	bool enabled()
+	{
+		return enabled_;
+	}
+
+	static void get_render_states(DWORD* values)
+	{
+		for (size_t i = 0; i < RENDER_STATE_COUNT; i++)
+		{
+			d3d::device->GetRenderState(RENDER_STATES[i], &values[i]);
+		}
+	}
+
+	static void set_render_states(const DWORD* values)
+	{
+		for (size_t i = 0; i < RENDER_STATE_COUNT; i++)
+		{
+			d3d::device->SetRenderState(RENDER_STATES[i], values[i]);
+		}
+	}
+
+	static bool eligible(NJS_MODEL_SADX* model)
+	{
+		// Software lighting needs each instance's world matrix on the CPU.
+		if (!enabled_ || model == nullptr || apiconfig::instanced_models.empty() || software_lighting::enabled())
+		{
+			return false;
+		}
+
+		// Temporary overrides only last for a single draw, so they can't be shared.
+		if (LanternInstance::diffuse_override_is_temp || LanternInstance::specular_override_is_temp
+		    || apiconfig::override_light_dir || apiconfig::alpha_ref_is_temp || param::ForceDefaultDiffuse.value())
+		{
+			return false;
+		}
+
+		return apiconfig::instanced_models.find(model) != apiconfig::instanced_models.end();
+	}
+
+	bool queue(NJS_MODEL_SADX* model)
+	{
+		if (flushing)
+		{
+			return false;
+		}
+
+		if (!eligible(model))
+		{
+			flush();
+			return false;
+		}
+
+		State state = {
+			model,
+			Direct3D_CurrentTexList,
+			_nj_control_3d_flag_,
+			_nj_constant_attr_and_,
+			_nj_constant_attr_or_,
+			globals::light_type,
+			_nj_constant_material_
+		};
+
+		get_render_states(state.render_states);
+
+		if (!instances.empty() && !(state == batch))
+		{
+			flush();
+		}
+
+		if (instances.empty())
+		{
+			batch = state;
+		}
+
+		instances.emplace_back();
+		memcpy(instances.back().matrix, _nj_current_matrix_ptr_, sizeof(NJS_MATRIX));
+
+		if (instances.size() >= MAX_INSTANCES)
+		{
+			flush();
+		}
+
+		return true;
+	}
+
+	static bool create()
+	{
+		if (instance_buffer != nullptr)
+		{
+			return true;
+		}
+
+		const auto result = d3d::device->CreateVertexBuffer(INSTANCE_BUFFER_SIZE, D3DUSAGE_DYNAMIC | D3DUSAGE_WRITEONLY,
+		                                                    0, D3DPOOL_DEFAULT, &instance_buffer, nullptr);
+
+		if (FAILED(result))
+		{
+			instance_buffer = nullptr;
+			return false;
+		}
+
+		instance_offset = 0;
+		return true;
+	}
+
+	// Writes the world matrix of every queued instance to the instance buffer.
+	static bool upload()
+	{
+		const UINT size = static_cast<UINT>(instances.size() * sizeof(InstanceData));
+
+		if (!create())
+		{
+			return false;
+		}
+
+		UINT offset = instance_offset;
+		DWORD flags = D3DLOCK_NOOVERWRITE;
+
+		if (offset + size > INSTANCE_BUFFER_SIZE)
+		{
+			offset = 0;
+			flags  = D3DLOCK_DISCARD;
+		}
+
+		void* data = nullptr;
+
+		if (FAILED(instance_buffer->Lock(offset, size, &data, flags)))
+		{
+			return false;
+		}
+
+		auto out = static_cast<InstanceData*>(data);
+
+		for (const auto& instance : instances)
+		{
+			// Let the game build the world matrix from its own matrix stack.
+			memcpy(_nj_current_matrix_ptr_, instance.matrix, sizeof(NJS_MATRIX));
+			SetWorldTransform();
+
+			const D3DXMATRIX world(WorldMatrix);
+			pack(world.m, *out++);
+		}
+
+		instance_buffer->Unlock();
+
+		uploaded_offset = offset;
+		instance_offset = offset + size;
+		return true;
+	}
+
+	void flush(bool preserve_state)
+	{
+		if (instances.empty() || flushing)
+		{
+			return;
+		}
+
+		DeviceState device_state;
+
+		if (preserve_state)
+		{
+			device_state.save();
+		}
+
+		flushing = true;
+
+		const auto control_3d = _nj_control_3d_flag_;
+		const auto attr_and   = _nj_constant_attr_and_;
+		const auto attr_or    = _nj_constant_attr_or_;
+		const auto material   = _nj_constant_material_;
+
+		DWORD render_states[RENDER_STATE_COUNT];
+		get_render_states(render_states);
+
+		NJS_MATRIX matrix;
+		memcpy(matrix, _nj_current_matrix_ptr_, sizeof(NJS_MATRIX));
+
+		_nj_control_3d_flag_   = batch.control_3d;
+		_nj_constant_attr_and_ = batch.attr_and;
+		_nj_constant_attr_or_  = batch.attr_or;
+		_nj_constant_material_ = batch.material;
+		set_render_states(batch.render_states);
+
+		const auto count = instances.size();
+		uploaded = count > 1 && upload();
+
+		if (uploaded)
+		{
+			param::ViewMatrix = D3DXMATRIX(ViewMatrix);
+		}
+
+		// The model is drawn normally at the first instance's matrix,
+		// and each of its meshsets is then drawn for every instance.
+		memcpy(_nj_current_matrix_ptr_, instances[0].matrix, sizeof(NJS_MATRIX));
+		DrawModel(batch.model);
+
+		memcpy(_nj_current_matrix_ptr_, matrix, sizeof(NJS_MATRIX));
+
+		_nj_control_3d_flag_   = control_3d;
+		_nj_constant_attr_and_ = attr_and;
+		_nj_constant_attr_or_  = attr_or;
+		_nj_constant_material_ = material;
+		set_render_states(render_states);
+
+		if (count > 1)
+		{
+			++stats_.batches;
+			stats_.instances += count;
+		}
+
+		instances.clear();
+		uploaded = false;
+		flushing = false;
+
+		if (preserve_state)
+		{
+			device_state.restore();
+		}
+	}
+
+	bool active()
+	{
+		return flushing && instances.size() > 1;
+	}
+
+	static IDirect3DVertexDeclaration9* declaration(DWORD fvf)
+	{
+		const auto it = declarations.find(fvf);
+
+		if (it != declarations.end())
+		{
+			return it->second;
+		}
+
+		auto& result = declarations[fvf];
+
+		D3DVERTEXELEMENT9 elements[MAX_FVF_DECL_SIZE];
+
+		if (FAILED(D3DXDeclaratorFromFVF(fvf, elements)))
+		{
+			return nullptr;
+		}
+
+		size_t n = 0;
+
+		while (elements[n].Stream != 0xFF)
+		{
+			++n;
+		}
+
+		if (n + 4 > MAX_FVF_DECL_SIZE)
+		{
+			return nullptr;
+		}
+
+		// The world matrix columns are read as TEXCOORD5 through TEXCOORD7.
+		for (size_t i = 0; i < 3; i++)
+		{
+			elements[n + i] = {
+				1, static_cast<WORD>(i * 16), D3DDECLTYPE_FLOAT4, D3DDECLMETHOD_DEFAULT,
+				D3DDECLUSAGE_TEXCOORD, static_cast<BYTE>(5 + i)
+			};
+		}
+
+		elements[n + 3] = D3DDECL_END();
+
+		d3d::device->CreateVertexDeclaration(elements, &result);
+		return result;
+	}
+
+	void draw(MeshSetBuffer* buffer)
+	{
+		const auto count        = static_cast<UINT>(instances.size());
+		const auto index_buffer = buffer->IndexBuffer;
+
+		IDirect3DVertexDeclaration9* vertex_declaration = nullptr;
+
+		// Instances can only share a draw when the shader is doing the transform.
+		if (uploaded && index_buffer != nullptr && d3d::do_effect && !d3d::shaders_null()
+		    && (vertex_declaration = declaration(buffer->FVF)) != nullptr)
+		{
+			Direct3D_Device->SetIndices(index_buffer, 0);
+
+			d3d::device->SetVertexDeclaration(vertex_declaration);
+			d3d::device->SetStreamSource(1, instance_buffer, uploaded_offset, sizeof(InstanceData));
+			d3d::device->SetStreamSourceFreq(0, D3DSTREAMSOURCE_INDEXEDDATA | count);
+			d3d::device->SetStreamSourceFreq(1, D3DSTREAMSOURCE_INSTANCEDATA | 1u);
+
+			d3d::draw_instanced = true;
+
+			Direct3D_Device->DrawIndexedPrimitive(buffer->PrimitiveType,
+			                                      buffer->MinIndex,
+			                                      buffer->NumVertecies,
+			                                      buffer->StartIndex,
+			                                      buffer->PrimitiveCount);
+
+			d3d::draw_instanced = false;
+
+			d3d::device->SetStreamSourceFreq(0, 1);
+			d3d::device->SetStreamSourceFreq(1, 1);
+			d3d::device->SetStreamSource(1, nullptr, 0, 0);
+			d3d::device->SetFVF(buffer->FVF);
+
+			++stats_.instanced_draws;
+			return;
+		}
+
+		for (const auto& instance : instances)
+		{
+			memcpy(_nj_current_matrix_ptr_, instance.matrix, sizeof(NJS_MATRIX));
+			SetWorldTransform();
+
+			if (index_buffer != nullptr)
+			{
+				Direct3D_Device->SetIndices(index_buffer, 0);
+				Direct3D_Device->DrawIndexedPrimitive(buffer->PrimitiveType,
+				                                      buffer->MinIndex,
+				                                      buffer->NumVertecies,
+				                                      buffer->StartIndex,
+				                                      buffer->PrimitiveCount);
+			}
+			else
+			{
+				Direct3D_Device->DrawPrimitive(buffer->PrimitiveType,
+				                               buffer->StartIndex,
+				                               buffer->PrimitiveCount);
+			}
+		}
+
+		++stats_.fallback_draws;
+	}
+
+	void release()
+	{
+		instances.clear();
+		instance_buffer = nullptr;
+		declarations.clear();
+	}
+
+	void report()
+	{
+		if (stats_.batches)
+		{
+			PrintDebug("[lantern] Instancing: %u batches, %.1f instances per batch, %u instanced and %u per-instance meshset draws\n",
+			           stats_.batches,
+			           static_cast<float>(stats_.instances) / static_cast<float>(stats_.batches),
+			           stats_.instanced_draws, stats_.fallback_draws);
+		}
+
+		stats_ = {};
+	}
+
+	const Stats& stats()
+	{
+		return stats_;
+	}
+}
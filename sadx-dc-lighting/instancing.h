@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+
+#include <ninja.h>
+
+#include "d3d.h"
+
+/*
+ * Hardware instancing for models registered through the API.
+ * Consecutive draws of the same registered model in the same state
+ * are queued rather than drawn, and are drawn together with a single
+ * material parse per meshset once anything else is drawn or the fog
+ * changes. The constant material and the blend, alpha test, depth and
+ * cull render states are part of that state, and the batch's values
+ * are restored while it's drawn. Meshsets
+ * with an index buffer are drawn as one instanced draw, taking world
+ * matrices from a second vertex stream; the rest are drawn once per
+ * instance.
+ */
+namespace instancing
+{
+	struct Stats
+	{
+		/// Flushed batches of two or more instances.
+		size_t batches;
+		/// Instances drawn in those batches.
+		size_t instances;
+		/// Meshsets drawn with a single instanced draw.
+		size_t instanced_draws;
+		/// Meshsets drawn once per instance.
+		size_t fallback_draws;
+	};
+
+	void set_enabled(bool value);
+	bool enabled();
+
+	/// <summary>
+	/// Queues a draw of a registered model at the current matrix.
+	/// Any queued instances which can't be drawn together with it are drawn first.
+	/// </summary>
+	/// <returns><c>true</c> if the draw was queued, <c>false</c> if the model must be drawn now.</returns>
+	bool queue(NJS_MODEL_SADX* model);
+	/// <summary>
+	/// Draws all queued instances.
+	/// </summary>
+	/// <param name="preserve_state">
+	/// Restores the streams, index buffer, vertex format, shaders, texture, world transform
+	/// and material afterwards, which drawing the batch changes. Required when called from
+	/// the middle of a draw which has already set up its own state.
+	/// </param>
+	void flush(bool preserve_state = false);
+	/// Returns \c true while queued instances are being drawn.
+	bool active();
+	/// Draws a meshset buffer for every queued instance. Only valid while \c active.
+	void draw(MeshSetBuffer* buffer);
+
+	/// Releases the instance buffer and vertex declarations.
+	void release();
+
+	/// Prints statistics to the debug log and resets them.
+	void report();
+	const Stats& stats();
+}
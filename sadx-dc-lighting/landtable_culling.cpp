@@ -0,0 +1,145 @@
+#include "stdafx.h"
+
+#include <vector>
+
+#include <d3dx9.h>
+#include <SADXModLoader.h>
+
+#include "d3d.h"
+#include "frustum.h"
+#include "landtable_culling.h"
+
+namespace landtable_culling
+{
+	static bool enabled_ = false;
+
+	// The landtable the spheres were packed from.
+	static LandTable* packed = nullptr;
+	static Sint16 packed_count = 0;
+
+	static frustum::SphereSet spheres;
+	static std::vector<uint32_t> entries;
+	static std::vector<uint32_t> visible;
+	static std::vector<uint32_t> culled;
+
+	static Stats stats_ {};
+
+	void set_enabled(bool value)
+	{
+		enabled_ = value;
+	}
+
+	bool enabled()
+	{
+		return enabled_;
+	}
+
+	static void pack(LandTable* landtable)
+	{
+		packed       = landtable;
+		packed_count = landtable->COLCount;
+
+		spheres.clear();
+		entries.clear();
+
+		for (int i = 0; i < landtable->COLCount; i++)
+		{
+			const auto& col = landtable->Col[i];
+
+			if (col.Flags & ColFlags_Visible && col.Model != nullptr)
+			{
+				spheres.add(col.Center.x, col.Center.y, col.Center.z, col.Radius);
+				entries.push_back(static_cast<uint32_t>(i));
+			}
+		}
+	}
+
+	void begin()
+	{
+		culled.clear();
+
+		const auto landtable = CurrentLandTable;
+
+		if (!enabled_ || landtable == nullptr)
+		{
+			return;
+		}
+
+		if (landtable != packed || landtable->COLCount != packed_count)
+		{
+			pack(landtable);
+		}
+
+		// Landtable entries are in world space, so they're drawn with
+		// the view matrix followed by the projection used by the shader.
+		const D3DXMATRIX clip = D3DXMATRIX(ViewMatrix) * param::ProjectionMatrix.value();
+		const auto planes = frustum::extract(static_cast<const float*>(clip));
+
+		spheres.cull(planes, visible);
+
+		// Entries which aren't in the visible list are hidden from the original.
+		size_t v = 0;
+
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			if (v < visible.size() && visible[v] == i)
+			{
+				++v;
+				continue;
+			}
+
+			auto& col = landtable->Col[entries[i]];
+
+			if (col.Flags & ColFlags_Visible)
+			{
+				col.Flags &= ~ColFlags_Visible;
+				culled.push_back(entries[i]);
+			}
+		}
+
+		++stats_.frames;
+		stats_.last_visible = visible.size();
+		stats_.last_culled  = culled.size();
+		stats_.visible += stats_.last_visible;
+		stats_.culled  += stats_.last_culled;
+	}
+
+	void end()
+	{
+		if (culled.empty())
+		{
+			return;
+		}
+
+		const auto landtable = CurrentLandTable;
+
+		for (auto i : culled)
+		{
+			landtable->Col[i].Flags |= ColFlags_Visible;
+		}
+
+		culled.clear();
+	}
+
+	void report()
+	{
+		if (stats_.frames)
+		{
+			const auto total = stats_.visible + stats_.culled;
+
+			PrintDebug("[lantern] Landtable culling: %u frames, %.1f visible and %.1f culled per frame (%.1f%% culled)\n",
+			           stats_.frames,
+			           static_cast<float>(stats_.visible) / static_cast<float>(stats_.frames),
+			           static_cast<float>(stats_.culled) / static_cast<float>(stats_.frames),
+			           total ? 100.0f * static_cast<float>(stats_.culled) / static_cast<float>(total) : 0.0f);
+		}
+
+		stats_ = {};
+		packed = nullptr;
+	}
+
+	const Stats& stats()
+	{
+		return stats_;
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+
+/*
+ * Frustum culls landtable entries before the game's own DrawLandTable
+ * runs. Culled entries have their visibility flag cleared for the
+ * duration of the draw so that the original skips them.
+ */
+namespace landtable_culling
+{
+	struct Stats
+	{
+		size_t frames;
+		size_t visible;
+		size_t culled;
+		size_t last_visible;
+		size_t last_culled;
+	};
+
+	void set_enabled(bool value);
+	bool enabled();
+
+	/// Culls the current landtable against the current view. Must be paired with \c end.
+	void begin();
+	/// Restores the visibility of entries culled by \c begin.
+	void end();
+
+	/// Prints statistics to the debug log and resets them.
+	void report();
+	const Stats& stats();
+}
@@ -0,0 +1,474 @@
+#include "stdafx.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <SADXModLoader.h>
+
+#include "d3d.h"
+#include "landtable_optimizer.h"
+#include "vertex_cache.h"
+
+namespace landtable_optimizer
+{
+	struct Report
+	{
+		size_t meshsets;
+		vertex_cache::Metrics before;
+		vertex_cache::Metrics after;
+	};
+
+	static bool enabled_ = false;
+	// Meshsets left unoptimized because their vertex buffer can't be read back.
+	static size_t skipped_unreadable = 0;
+
+	// Keyed by level and act.
+	static std::map<std::pair<int, int>, Report> reports;
+
+	void set_enabled(bool value)
+	{
+		enabled_ = value;
+	}
+
+	bool enabled()
+	{
+		return enabled_;
+	}
+
+	static void accumulate(vertex_cache::Metrics& dest, const vertex_cache::Metrics& src)
+	{
+		dest.triangles += src.triangles;
+		dest.vertices  += src.vertices;
+		dest.misses    += src.misses;
+	}
+
+	/// Builds an index buffer for the vertices of a draw, merging byte-identical vertices.
+	static std::vector<uint16_t> deduplicate(const BYTE* data, UINT stride, UINT count, std::vector<uint16_t>& unique)
+	{
+		std::unordered_multimap<uint32_t, uint16_t> lookup;
+		std::vector<uint16_t> result(count);
+
+		for (UINT i = 0; i < count; i++)
+		{
+			const BYTE* vertex = data + i * stride;
+
+			uint32_t hash = 2166136261u;
+
+			for (UINT b = 0; b < stride; b++)
+			{
+				hash = (hash ^ vertex[b]) * 16777619u;
+			}
+
+			const auto range = lookup.equal_range(hash);
+			auto it = range.first;
+
+			for (; it != range.second; ++it)
+			{
+				if (!memcmp(data + unique[it->second] * stride, vertex, stride))
+				{
+					break;
+				}
+			}
+
+			if (it != range.second)
+			{
+				result[i] = it->second;
+				continue;
+			}
+
+			if (unique.size() > 0xFFFF)
+			{
+				return {};
+			}
+
+			const auto index = static_cast<uint16_t>(unique.size());
+			unique.push_back(static_cast<uint16_t>(i));
+			lookup.emplace(hash, index);
+			result[i] = index;
+		}
+
+		return result;
+	}
+
+	/// Converts the draw to a triangle list, dropping the degenerate triangles used to stitch strips.
+	static std::vector<uint16_t> to_triangle_list(const std::vector<uint16_t>& vertices, D3DPRIMITIVETYPE type)
+	{
+		std::vector<uint16_t> result;
+
+		if (type == D3DPT_TRIANGLELIST)
+		{
+			result.reserve(vertices.size());
+
+			for (size_t i = 0; i + 2 < vertices.size(); i += 3)
+			{
+				result.insert(result.end(), { vertices[i], vertices[i + 1], vertices[i + 2] });
+			}
+
+			return result;
+		}
+
+		result.reserve((vertices.size() - 2) * 3);
+
+		for (size_t i = 0; i + 2 < vertices.size(); i++)
+		{
+			auto a = vertices[i];
+			auto b = vertices[i + 1];
+			const auto c = vertices[i + 2];
+
+			if (a == b || b == c || a == c)
+			{
+				continue;
+			}
+
+			// Every other triangle in a strip has reversed winding.
+			if (i & 1)
+			{
+				std::swap(a, b);
+			}
+
+			result.insert(result.end(), { a, b, c });
+		}
+
+		return result;
+	}
+
+	struct Job
+	{
+		MeshSetBuffer* buffer;
+		D3DPRIMITIVETYPE type;
+		UINT stride;
+		UINT first;
+		std::pair<int, int> level;
+
+		std::vector<BYTE> source;
+		std::vector<uint16_t> unique;
+		std::vector<uint16_t> list;
+		std::vector<uint16_t> indices;
+		std::vector<uint16_t> order;
+
+		std::atomic<bool> completed { false };
+	};
+
+	static bool deferred = false;
+	static std::deque<std::unique_ptr<Job>> pending;
+
+	/// Reads back the vertices of a meshset buffer. Must be called on the render thread.
+	static std::unique_ptr<Job> prepare(NJS_MESHSET_SADX* meshset)
+	{
+		auto buffer = reinterpret_cast<MeshSetBuffer*>(meshset->buffer);
+
+		if (!buffer || !buffer->FVF || !buffer->VertexBuffer || buffer->IndexBuffer)
+		{
+			return nullptr;
+		}
+
+		// The vertices are read back to optimize them, which only works for some of the
+		// buffers the game creates.
+		if (!d3d::readable(buffer->VertexBuffer))
+		{
+			++skipped_unreadable;
+			return nullptr;
+		}
+
+		UINT count;
+
+		switch (buffer->PrimitiveType)
+		{
+			case D3DPT_TRIANGLELIST:
+				count = buffer->PrimitiveCount * 3;
+				break;
+
+			case D3DPT_TRIANGLESTRIP:
+				count = buffer->PrimitiveCount + 2;
+				break;
+
+			default:
+				return nullptr;
+		}
+
+		std::unique_ptr<Job> job(new Job());
+
+		job->buffer = buffer;
+		job->type   = buffer->PrimitiveType;
+		job->stride = buffer->Size;
+		job->first  = buffer->StartIndex;
+		job->level  = std::make_pair(static_cast<int>(CurrentLevel), static_cast<int>(CurrentAct));
+
+		BYTE* data = nullptr;
+
+		if (FAILED(buffer->VertexBuffer->Lock(job->first * job->stride, count * job->stride, &data, D3DLOCK_READONLY)))
+		{
+			return nullptr;
+		}
+
+		job->source.assign(data, data + count * job->stride);
+		buffer->VertexBuffer->Unlock();
+
+		return job;
+	}
+
+	/// Builds the optimized index and vertex order. Safe to call from any thread.
+	static void compute(Job& job)
+	{
+		const auto count = static_cast<UINT>(job.source.size() / job.stride);
+		const auto vertices = deduplicate(job.source.data(), job.stride, count, job.unique);
+
+		// Indices are relative to the start of the vertex buffer, and
+		// optimize_fetch reserves 0xFFFF, so 65536 unique vertices won't do.
+		if (vertices.empty() || job.unique.size() > 0xFFFF || job.first + job.unique.size() > 0x10000)
+		{
+			return;
+		}
+
+		job.list = to_triangle_list(vertices, job.type);
+
+		if (job.list.empty())
+		{
+			return;
+		}
+
+		job.indices = vertex_cache::optimize(job.list, job.unique.size());
+		job.order   = vertex_cache::optimize_fetch(job.indices, job.unique.size());
+	}
+
+	/*
+	 * Deferred jobs are computed by a fixed number of worker threads,
+	 * started on first use, rather than by a thread per meshset.
+	 */
+
+	static constexpr unsigned MAX_WORKERS = 4;
+
+	struct Workers
+	{
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::condition_variable idle;
+		std::deque<Job*> queue;
+		size_t busy = 0;
+	};
+
+	// Never freed, since the worker threads run until the process exits.
+	static Workers* workers = nullptr;
+
+	static void work()
+	{
+		std::unique_lock<std::mutex> lock(workers->mutex);
+
+		for (;;)
+		{
+			workers->wake.wait(lock, [] { return !workers->queue.empty(); });
+
+			auto job = workers->queue.front();
+			workers->queue.pop_front();
+			++workers->busy;
+
+			lock.unlock();
+			compute(*job);
+			job->completed.store(true, std::memory_order_release);
+			lock.lock();
+
+			if (--workers->busy == 0)
+			{
+				workers->idle.notify_all();
+			}
+		}
+	}
+
+	static void submit(Job* job)
+	{
+		if (workers == nullptr)
+		{
+			workers = new Workers;
+
+			// One core is left to the render thread.
+			const unsigned hardware = std::thread::hardware_concurrency();
+			const unsigned count    = hardware > 2 ? (std::min)(hardware - 1, MAX_WORKERS) : 1;
+
+			for (unsigned i = 0; i < count; i++)
+			{
+				std::thread(work).detach();
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(workers->mutex);
+			workers->queue.push_back(job);
+		}
+
+		workers->wake.notify_one();
+	}
+
+	/// Drops jobs which haven't been started and waits for the rest to complete.
+	static void discard_queued()
+	{
+		if (workers == nullptr)
+		{
+			return;
+		}
+
+		std::unique_lock<std::mutex> lock(workers->mutex);
+		workers->queue.clear();
+		workers->idle.wait(lock, [] { return workers->busy == 0; });
+	}
+
+	/// Writes the optimized vertices and indices to the meshset buffer. Must be called on the render thread.
+	static void apply(Job& job)
+	{
+		auto buffer = job.buffer;
+
+		if (job.indices.empty() || buffer->IndexBuffer || buffer->PrimitiveType != job.type)
+		{
+			return;
+		}
+
+		Direct3DIndexBuffer8* index_buffer = nullptr;
+		BYTE* index_data = nullptr;
+
+		const UINT index_size = static_cast<UINT>(job.indices.size() * sizeof(uint16_t));
+
+		auto result = Direct3D_Device->CreateIndexBuffer(index_size, D3DUSAGE_WRITEONLY, D3DFMT_INDEX16,
+		                                                 D3DPOOL_MANAGED, &index_buffer);
+
+		if (FAILED(result) || FAILED(index_buffer->Lock(0, index_size, &index_data, 0)))
+		{
+			if (index_buffer)
+			{
+				index_buffer->Release();
+			}
+
+			return;
+		}
+
+		auto out = reinterpret_cast<uint16_t*>(index_data);
+
+		for (auto i : job.indices)
+		{
+			*out++ = static_cast<uint16_t>(job.first + i);
+		}
+
+		index_buffer->Unlock();
+
+		const UINT stride = job.stride;
+		BYTE* data = nullptr;
+
+		// The vertex buffer may be shared with other meshsets, so the
+		// optimized vertices are written back over this draw's own range.
+		if (FAILED(buffer->VertexBuffer->Lock(job.first * stride, static_cast<UINT>(job.order.size()) * stride, &data, 0)))
+		{
+			index_buffer->Release();
+			return;
+		}
+
+		for (size_t i = 0; i < job.order.size(); i++)
+		{
+			memcpy(data + i * stride, &job.source[job.unique[job.order[i]] * stride], stride);
+		}
+
+		buffer->VertexBuffer->Unlock();
+
+		auto& report = reports[job.level];
+		++report.meshsets;
+		accumulate(report.before, vertex_cache::measure(job.list, job.unique.size()));
+		accumulate(report.after, vertex_cache::measure(job.indices, job.order.size()));
+
+		buffer->IndexBuffer    = index_buffer;
+		buffer->PrimitiveType  = D3DPT_TRIANGLELIST;
+		buffer->MinIndex       = job.first;
+		buffer->NumVertecies   = static_cast<int>(job.order.size());
+		buffer->StartIndex     = 0;
+		buffer->PrimitiveCount = static_cast<int>(job.indices.size() / 3);
+	}
+
+	void optimize(NJS_MESHSET_SADX* meshset)
+	{
+		if (!enabled_)
+		{
+			return;
+		}
+
+		auto job = prepare(meshset);
+
+		if (!job)
+		{
+			return;
+		}
+
+		if (deferred)
+		{
+			submit(job.get());
+			pending.push_back(std::move(job));
+			return;
+		}
+
+		compute(*job);
+		apply(*job);
+	}
+
+	void set_deferred(bool value)
+	{
+		deferred = value;
+	}
+
+	size_t apply_completed()
+	{
+		size_t result = 0;
+
+		// Applied in order so that the report is deterministic.
+		while (!pending.empty())
+		{
+			auto& front = pending.front();
+
+			if (!front->completed.load(std::memory_order_acquire))
+			{
+				break;
+			}
+
+			apply(*front);
+			pending.pop_front();
+			++result;
+		}
+
+		return result;
+	}
+
+	size_t pending_count()
+	{
+		return pending.size();
+	}
+
+	void cancel()
+	{
+		discard_queued();
+		pending.clear();
+	}
+
+	void report()
+	{
+		for (auto& it : reports)
+		{
+			const auto& r = it.second;
+
+			PrintDebug("[lantern] Landtable %02d-%d: %u meshsets, %u triangles, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n",
+			           it.first.first, it.first.second, r.meshsets, r.after.triangles,
+			           r.before.acmr(), r.after.acmr(), r.before.atvr(), r.after.atvr());
+		}
+
+		if (skipped_unreadable)
+		{
+			PrintDebug("[lantern] Landtable optimizer skipped %u meshsets with unreadable vertex buffers\n", skipped_unreadable);
+			skipped_unreadable = 0;
+		}
+
+		reports.clear();
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <ninja.h>
+
+namespace landtable_optimizer
+{
+	/// Enables or disables optimization of landtable meshset buffers as they're built.
+	void set_enabled(bool value);
+	bool enabled();
+
+	/// <summary>
+	/// Converts a landtable meshset's buffer to a deduplicated, indexed triangle
+	/// list ordered for post-transform vertex cache efficiency.
+	/// Buffers which are already indexed are left untouched.
+	/// </summary>
+	/// <param name="meshset">A meshset whose buffer has already been built.</param>
+	void optimize(NJS_MESHSET_SADX* meshset);
+
+	/// <summary>
+	/// When enabled, <see cref="optimize"/> only reads the meshset back and leaves the
+	/// optimization itself to a worker thread. The results are written to the meshset
+	/// buffer by <see cref="apply_completed"/>.
+	/// </summary>
+	void set_deferred(bool value);
+	/// Applies deferred optimizations which have completed. Returns the number applied.
+	size_t apply_completed();
+	/// Returns the number of deferred optimizations which haven't been applied yet.
+	size_t pending_count();
+	/// Waits for and discards all deferred optimizations. Must be called before meshsets are freed.
+	void cancel();
+
+	/// Prints the vertex cache report for every landtable optimized since the last report.
+	void report();
+}
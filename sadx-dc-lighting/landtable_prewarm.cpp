@@ -0,0 +1,221 @@
+#include "stdafx.h"
+
+#include <chrono>
+#include <deque>
+#include <utility>
+
+#include <SADXModLoader.h>
+
+#include "landtable_optimizer.h"
+#include "landtable_prewarm.h"
+
+namespace landtable_prewarm
+{
+	using clock = std::chrono::high_resolution_clock;
+
+	// Render thread time spent building buffers per frame.
+	static const auto SLICE = std::chrono::microseconds(4000);
+
+	static bool enabled_  = false;
+	static bool requested = false;
+
+	static LandTable* landtable = nullptr;
+	static std::deque<std::pair<NJS_MODEL_SADX*, NJS_MESHSET_SADX*>> queue;
+	static size_t queued    = 0;
+	static size_t prewarmed = 0;
+
+	struct Timings
+	{
+		int level;
+		int act;
+		/// Render thread time spent building buffers, and the number of frames it was spread over.
+		double build_ms;
+		size_t frames;
+		/// Negative until the first landtable draw after the load.
+		double first_draw_ms;
+		/// Meshsets which had been prewarmed by the time of the first draw.
+		size_t prewarmed_before_draw;
+		bool finished;
+	};
+
+	static Timings timings {};
+
+	static bool timing_first_draw = false;
+	static clock::time_point draw_start;
+
+	void set_enabled(bool value)
+	{
+		enabled_ = value;
+	}
+
+	bool enabled()
+	{
+		return enabled_;
+	}
+
+	static void queue_object(NJS_OBJECT* object)
+	{
+		for (; object != nullptr; object = object->sibling)
+		{
+			const auto model = object->basicdxmodel;
+
+			if (model != nullptr && model->meshsets != nullptr)
+			{
+				for (int i = 0; i < model->nbMeshset; i++)
+				{
+					auto meshset = &model->meshsets[i];
+
+					if (!meshset->buffer)
+					{
+						queue.emplace_back(model, meshset);
+					}
+				}
+			}
+
+			queue_object(object->child);
+		}
+	}
+
+	static void queue_landtable()
+	{
+		landtable = CurrentLandTable;
+
+		for (int i = 0; i < landtable->COLCount; i++)
+		{
+			const auto& col = landtable->Col[i];
+
+			if (col.Flags & ColFlags_Visible)
+			{
+				queue_object(col.Model);
+			}
+		}
+
+		queued    = queue.size();
+		prewarmed = 0;
+
+		timings.level    = CurrentLevel;
+		timings.act      = CurrentAct;
+		timings.build_ms = 0.0;
+		timings.frames   = 0;
+		timings.finished = false;
+
+		PrintDebug("[lantern] Prewarming %u landtable meshsets.\n", queued);
+	}
+
+	/// Prints the prewarm and first draw timings once both are known.
+	static void report()
+	{
+		if (!timings.finished || timings.first_draw_ms < 0.0)
+		{
+			return;
+		}
+
+		PrintDebug("[lantern] Landtable %02d-%d: prewarmed %u of %u meshsets in %.3f ms over %u frames; "
+		           "first draw %.3f ms with %u prewarmed\n",
+		           timings.level, timings.act, prewarmed, queued, timings.build_ms, timings.frames,
+		           timings.first_draw_ms, timings.prewarmed_before_draw);
+
+		timings.finished = false;
+	}
+
+	void request()
+	{
+		cancel();
+		prewarmed = 0;
+		timings.first_draw_ms = -1.0;
+		timing_first_draw = true;
+		requested = enabled_;
+	}
+
+	void cancel()
+	{
+		landtable_optimizer::cancel();
+		queue.clear();
+		landtable = nullptr;
+		requested = false;
+	}
+
+	void update()
+	{
+		if (requested && CurrentLandTable != nullptr)
+		{
+			requested = false;
+			queue_landtable();
+		}
+
+		if (landtable == nullptr)
+		{
+			return;
+		}
+
+		// The landtable was swapped out from under us (e.g. an act change).
+		if (landtable != CurrentLandTable)
+		{
+			cancel();
+			return;
+		}
+
+		landtable_optimizer::apply_completed();
+
+		const auto start = clock::now();
+		const bool built = !queue.empty();
+		landtable_optimizer::set_deferred(true);
+
+		while (!queue.empty() && clock::now() - start < SLICE)
+		{
+			const auto entry = queue.front();
+			queue.pop_front();
+
+			// Meshsets which were drawn in the meantime have already been built.
+			if (!entry.second->buffer)
+			{
+				InitLandTableMeshSet(entry.first, entry.second);
+				++prewarmed;
+			}
+		}
+
+		landtable_optimizer::set_deferred(false);
+
+		if (built)
+		{
+			timings.build_ms += std::chrono::duration<double, std::milli>(clock::now() - start).count();
+			++timings.frames;
+		}
+
+		if (queue.empty() && !landtable_optimizer::pending_count())
+		{
+			timings.finished = true;
+			landtable = nullptr;
+			report();
+		}
+	}
+
+	void draw_begin()
+	{
+		if (timing_first_draw)
+		{
+			draw_start = clock::now();
+		}
+	}
+
+	void draw_end()
+	{
+		if (!timing_first_draw)
+		{
+			return;
+		}
+
+		timing_first_draw = false;
+
+		timings.first_draw_ms = std::chrono::duration<double, std::milli>(clock::now() - draw_start).count();
+		timings.prewarmed_before_draw = prewarmed;
+
+		if (!enabled_)
+		{
+			PrintDebug("[lantern] First landtable draw after load: %.3f ms (not prewarmed)\n", timings.first_draw_ms);
+			return;
+		}
+
+		report();
+	}
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+/*
+ * Builds landtable meshset buffers on the render thread ahead of time
+ * after a level loads, a few milliseconds per frame, rather than lazily
+ * when each meshset is first drawn. The game converts and uploads each
+ * buffer in one call through Direct3D, so the conversion can't be moved
+ * to worker threads; only landtable optimization (if enabled) runs there.
+ *
+ * Once a prewarm finishes, the time it spent building buffers is printed
+ * next to the time the first landtable draw took, which is what the first
+ * draw would otherwise have spent on top of its own.
+ */
+namespace landtable_prewarm
+{
+	void set_enabled(bool value);
+	bool enabled();
+
+	/// Requests a prewarm of the landtable being loaded.
+	void request();
+	/// Stops prewarming and discards pending work. Must be called before the landtable is freed.
+	void cancel();
+	/// Advances the prewarm by one time slice. Called once per frame on the render thread.
+	void update();
+
+	/// Called around landtable drawing to time the first draw after a level load.
+	void draw_begin();
+	void draw_end();
+}
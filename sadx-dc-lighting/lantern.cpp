@@ -14,6 +14,12 @@
 #include "globals.h"
 #include "datapointers.h"
 #include "lantern.h"
+#include "software_lighting.h"
+#include "palette_lighting.h"
+#include "palette_atlas.h"
+#include "frame_stats.h"
+#include "timeline.h"
+#include "palette_store.h"
 
 bool SourceLight_t::operator==(const SourceLight_t& rhs) const
 {
@@ -55,48 +61,22 @@ bool StageLights::operator!=(const StageLights& rhs) const
 template <>
 bool ShaderParameter<SourceLight_t>::commit(IDirect3DDevice9* device)
 {
-	if (is_modified())
+	return state.commit([&](const SourceLight_t& value)
 	{
 		float buffer[24] {};
-		memcpy(buffer, &current, sizeof(SourceLight_t));
+		memcpy(buffer, &value, sizeof(SourceLight_t));
 
-		if (type & Type::vertex)
-		{
-			device->SetVertexShaderConstantF(index, buffer, 6);
-		}
-
-		if (type & Type::pixel)
-		{
-			device->SetPixelShaderConstantF(index, buffer, 6);
-		}
-
-		clear();
-		return true;
-	}
-
-	return false;
+		shader_constants::set(device, index, type, buffer, 6);
+	});
 }
 
 template <>
 bool ShaderParameter<StageLights>::commit(IDirect3DDevice9* device)
 {
-	if (is_modified())
+	return state.commit([&](const StageLights& value)
 	{
-		if (type & Type::vertex)
-		{
-			device->SetVertexShaderConstantF(index, reinterpret_cast<float*>(&current), 16);
-		}
-
-		if (type & Type::pixel)
-		{
-			device->SetPixelShaderConstantF(index, reinterpret_cast<float*>(&current), 16);
-		}
-
-		clear();
-		return true;
-	}
-
-	return false;
+		shader_constants::set(device, index, type, reinterpret_cast<const float*>(&value), 16);
+	});
 }
 
 static bool use_time(Uint32 level, Uint32 act)
@@ -338,39 +318,18 @@ std::string LanternInstance::palette_id(Sint32 level, Sint32 act)
 	return result.str();
 }
 
-void LanternInstance::copy(LanternInstance& inst)
-{
-	atlas      = inst.atlas;
-	last_time  = inst.last_time;
-	last_act   = inst.last_act;
-	last_level = inst.last_level;
-	diffuse_   = inst.diffuse_;
-	specular_  = inst.specular_;
-}
-
-LanternInstance::LanternInstance(ShaderParameter<Texture>* atlas)
-	: atlas(atlas)
-{
-}
-
-LanternInstance::LanternInstance(LanternInstance&& inst) noexcept
-{
-	*this = std::move(inst);
-}
-
-LanternInstance& LanternInstance::operator=(LanternInstance&& inst) noexcept
+LanternInstance::LanternInstance()
+	: palette_(palette_store::empty_palette()),
+	  source_(palette_store::empty_source())
 {
-	copy(inst);
-	inst.atlas = nullptr;
-	return *this;
 }
 
 LanternInstance::~LanternInstance()
 {
-	if (atlas != nullptr)
-	{
-		*atlas = nullptr;
-	}
+	// Let the store drop this instance's data if nothing else shares it.
+	palette_ = {};
+	source_  = {};
+	palette_store::prune();
 }
 
 void LanternInstance::set_last_level(Sint32 level, Sint32 act)
@@ -397,13 +356,18 @@ bool LanternInstance::load_source(const std::string& path)
 
 	PrintDebug("[lantern] Loading lantern source: %s\n", path.c_str());
 
-	for (auto& source_light : source_lights)
+	auto loaded = palette_store::sources().acquire(*source_);
+
+	for (auto& source_light : loaded.mutate())
 	{
 		file.read(reinterpret_cast<char*>(&source_light), sizeof(SourceLight));
 	}
 
 	file.close();
 
+	source_ = palette_store::intern(std::move(loaded));
+	const auto& source_lights = *source_;
+
 	NJS_MATRIX m;
 
 	njUnitMatrix(m);
@@ -413,7 +377,6 @@ bool LanternInstance::load_source(const std::string& path)
 	// Default light direction is down, so we want to rotate relative to that.
 	NJS_VECTOR vs = { 0.0f, -1.0f, 0.0f };
 	njCalcVector(m, &vs, &sl_direction);
-	param::LightDirection = -*reinterpret_cast<D3DXVECTOR3*>(&sl_direction);
 
 	PrintDebug("[lantern] Source light rotation (direction): y: %d, z: %d (x: %f, y: %f, z: %f)\n",
 	           source_lights[15].stage.y, source_lights[15].stage.z, sl_direction.x, sl_direction.y, sl_direction.z);
@@ -463,111 +426,19 @@ bool LanternInstance::load_palette(const std::string& path)
 
 	file.close();
 
+	auto loaded = palette_store::palettes().acquire();
+	auto& palette_pairs = loaded.mutate();
+
 	if (color_data.size() > palette_pairs.size())
 	{
 		PrintDebug("[lantern] WARNING: Palette size exceeds standard maximum.\n");
 	}
 
-	palette_pairs = {};
 	memcpy(palette_pairs.data(), color_data.data(), min(sizeof(ColorPair) * color_data.size(), sizeof(ColorPair) * palette_pairs.size()));
-	generate_atlas();
+	palette_ = palette_store::intern(std::move(loaded));
 	return true;
 }
 
-void LanternInstance::generate_atlas()
-{
-	const bool is_32bit = d3d::supports_xrgb();
-	Texture texture = atlas->value();
-
-	if (texture == nullptr)
-	{
-		// Using a floating point texture to support the GeForce 6000 series cards.
-		const auto format = is_32bit ? D3DFMT_X8R8G8B8 : D3DFMT_A32B32G32R32F;
-
-		if (FAILED(d3d::device->CreateTexture(256, 16, 1, 0, format, D3DPOOL_MANAGED, &texture, nullptr)))
-		{
-			throw std::exception("Failed to create palette texture!");
-		}
-
-		*atlas = texture;
-	}
-	else
-	{
-		// Release all of its references in case there are lingering textures.
-		atlas->release();
-		*atlas = texture;
-	}
-
-	D3DLOCKED_RECT rect;
-	if (FAILED(texture->LockRect(0, &rect, nullptr, 0)))
-	{
-		throw std::exception("Failed to lock texture rect!");
-	}
-
-	struct ABGR32F
-	{
-		float r, g, b, a;
-	};
-
-	static_assert(sizeof(ABGR32F) == sizeof(float) * 4, "nope");
-
-	for (size_t i = 0; i < 8; i++)
-	{
-		const auto index = i * 256;
-
-		/*if (index >= palette_pairs.size() || index + 256 >= palette_pairs.size())
-		{
-			break;
-		}*/
-
-		const auto y = 512 * i;
-
-		if (is_32bit)
-		{
-			const auto pixels = static_cast<NJS_COLOR*>(rect.pBits);
-
-			for (size_t x = 0; x < 256; x++)
-			{
-				const auto& color = palette_pairs[index + x];
-
-				auto& diffuse  = pixels[y + x];
-				auto& specular = pixels[256 + y + x];
-
-				diffuse  = color.diffuse;
-				specular = color.specular;
-			}
-		}
-		else
-		{
-			const auto pixels = static_cast<ABGR32F*>(rect.pBits);
-
-			for (size_t x = 0; x < 256; x++)
-			{
-				const auto& color = palette_pairs[index + x];
-
-				auto& diffuse  = pixels[y + x];
-				auto& specular = pixels[256 + y + x];
-
-				const auto& _diffuse = color.diffuse.argb;
-
-				diffuse.r = _diffuse.r / 255.0f;
-				diffuse.g = _diffuse.g / 255.0f;
-				diffuse.b = _diffuse.b / 255.0f;
-				diffuse.a = _diffuse.a / 255.0f;
-
-				const auto& _specular = color.specular.argb;
-
-				specular.r = _specular.r / 255.0f;
-				specular.g = _specular.g / 255.0f;
-				specular.b = _specular.b / 255.0f;
-				specular.a = _specular.a / 255.0f;
-			}
-		}
-	}
-
-	texture->UnlockRect(0);
-}
-
 /// <summary>
 /// Loads palette data for the specified stage and act.
 /// </summary>
@@ -599,9 +470,11 @@ void LanternInstance::specular_blend_factor(float f)
 	specular_blend_factor_ = f;
 }
 
-inline float _index_float(Sint32 i, Sint32 offset)
+// Texture coordinate at the center of a palette's row in a slot of the combined atlas.
+inline float _index_float(Sint32 i, Sint32 offset, size_t slot, size_t rows)
 {
-	return (static_cast<float>(2 * i + offset) + 0.5f) / 16.0f;
+	const auto row = slot * palette_lighting::ROW_COUNT + 2 * i + offset;
+	return (static_cast<float>(row) + 0.5f) / static_cast<float>(rows);
 }
 
 /// <summary>
@@ -754,6 +627,7 @@ bool LanternCollection::load_source(Sint32 level, Sint32 act)
 		}
 	}
 
+	apply_light_direction();
 	return count == instances.size();
 }
 
@@ -769,106 +643,74 @@ bool LanternCollection::load_source(const std::string& path)
 		}
 	}
 
+	apply_light_direction();
 	return count == instances.size();
 }
 
-// TODO: solve duplicate code by having PL and SL classes which inherit a common interface
-bool LanternCollection::run_pl_callbacks(Sint32 level, Sint32 act, Sint8 time)
+template <typename F>
+bool LanternCollection::run_callbacks(LoadCallbacks& callbacks, Sint32 level, Sint32 act, Sint8 time, F load)
 {
-	bool result = false;
+	const std::string* path = callbacks.resolve(level, act, time);
 
-	for (auto& cb : pl_callbacks)
+	if (path == nullptr)
 	{
-		const auto path_ptr = cb(level, act);
-
-		if (path_ptr == nullptr)
-		{
-			continue;
-		}
+		return false;
+	}
 
-		std::string path_str = path_ptr;
+	bool result = false;
 
-		for (auto& instance : instances)
+	for (auto& instance : instances)
+	{
+		if (level == instance.last_level && act == instance.last_act && time == instance.last_time)
 		{
-			if (level == instance.last_level && act == instance.last_act && time == instance.last_time)
-			{
-				result = true;
-				break;
-			}
-
-			if (!instance.load_palette(path_str))
-			{
-				return false;
-			}
-
-			instance.last_time  = time;
-			instance.last_level = level;
-			instance.last_act   = act;
-
 			result = true;
+			break;
 		}
 
-		if (result)
+		if (!load(instance, *path))
 		{
-			break;
+			return false;
 		}
+
+		instance.last_time  = time;
+		instance.last_level = level;
+		instance.last_act   = act;
+
+		result = true;
 	}
 
 	return result;
 }
 
-bool LanternCollection::run_sl_callbacks(Sint32 level, Sint32 act, Sint8 time)
+bool LanternCollection::run_pl_callbacks(Sint32 level, Sint32 act, Sint8 time)
 {
-	bool result = false;
-
-	for (auto& cb : sl_callbacks)
+	return run_callbacks(pl_callbacks, level, act, time, [](LanternInstance& instance, const std::string& path)
 	{
-		const char* path_ptr = cb(level, act);
-
-		if (path_ptr == nullptr)
-		{
-			continue;
-		}
-
-		const std::string path_str = path_ptr;
-
-		for (auto& instance : instances)
-		{
-			if (level == instance.last_level && act == instance.last_act && time == instance.last_time)
-			{
-				result = true;
-				break;
-			}
-
-			if (!instance.load_source(path_str))
-			{
-				return false;
-			}
-
-			instance.last_time  = time;
-			instance.last_level = level;
-			instance.last_act   = act;
-
-			result = true;
-		}
+		return instance.load_palette(path);
+	});
+}
 
-		if (result)
-		{
-			break;
-		}
-	}
+bool LanternCollection::run_sl_callbacks(Sint32 level, Sint32 act, Sint8 time)
+{
+	const bool result = run_callbacks(sl_callbacks, level, act, time, [](LanternInstance& instance, const std::string& path)
+	{
+		return instance.load_source(path);
+	});
 
+	apply_light_direction();
 	return result;
 }
 
 bool LanternCollection::load_files()
 {
+	TIMELINE_SCOPE("load_files");
+
 	const auto time = GetTimeOfDay();
 	size_t count = 0;
 
 	if (instances.empty())
 	{
-		instances.emplace_back(&param::PaletteA);
+		instances.emplace_back();
 	}
 
 	const bool pl_handled = run_pl_callbacks(CurrentLevel, CurrentAct, time);
@@ -920,6 +762,7 @@ bool LanternCollection::load_files()
 				// Source light loading on the other hand is not a
 				// requirement, so failure is fine.
 				instance.load_source(CurrentLevel, i);
+				apply_light_direction();
 			}
 
 			instance.last_time  = time;
@@ -970,9 +813,110 @@ void LanternCollection::light_direction(const NJS_VECTOR& d)
 
 const NJS_VECTOR& LanternCollection::light_direction()
 {
+	if (primary_handle != nullptr && !primary_handle->source().shares(palette_store::empty_source()))
+	{
+		return primary_handle->light_direction();
+	}
+
 	return instances[0].light_direction();
 }
 
+void LanternCollection::apply_light_direction()
+{
+	if (instances.empty())
+	{
+		return;
+	}
+
+	param::LightDirection = -*reinterpret_cast<const D3DXVECTOR3*>(&light_direction());
+}
+
+lantern_palette_handle LanternCollection::create_handle()
+{
+	const auto id = next_handle++;
+	handles.emplace(id, LanternInstance());
+	return id;
+}
+
+LanternInstance* LanternCollection::handle(lantern_palette_handle id)
+{
+	const auto it = handles.find(id);
+	return it != handles.end() ? &it->second : nullptr;
+}
+
+bool LanternCollection::load_handle_source(lantern_palette_handle id, const std::string& path)
+{
+	LanternInstance* instance = handle(id);
+
+	if (instance == nullptr || !instance->load_source(path))
+	{
+		return false;
+	}
+
+	if (instance == primary_handle)
+	{
+		apply_light_direction();
+	}
+
+	return true;
+}
+
+bool LanternCollection::bind_handle(lantern_palette_handle id, LanternBinding binding)
+{
+	LanternInstance* instance = nullptr;
+
+	if (id != 0)
+	{
+		instance = handle(id);
+
+		if (instance == nullptr)
+		{
+			return false;
+		}
+	}
+
+	switch (binding)
+	{
+		case LanternBinding_Primary:
+			primary_handle = instance;
+			apply_light_direction();
+			return true;
+
+		case LanternBinding_Blend:
+			blend_handle = instance;
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+bool LanternCollection::release_handle(lantern_palette_handle id)
+{
+	const auto it = handles.find(id);
+
+	if (it == handles.end())
+	{
+		return false;
+	}
+
+	if (primary_handle == &it->second)
+	{
+		primary_handle = nullptr;
+		apply_light_direction();
+	}
+
+	if (blend_handle == &it->second)
+	{
+		blend_handle = nullptr;
+	}
+
+	handles.erase(it);
+	free_atlas_slots();
+	palette_store::prune();
+	return true;
+}
+
 void LanternCollection::forward_blend_all(bool enable)
 {
 	for (int i = 0; i < 8; i++)
@@ -1022,6 +966,202 @@ int LanternCollection::specular_blend(int index) const
 	return specular_blend_[index];
 }
 
+// Size in bytes of the top level of a palette atlas.
+static size_t atlas_size(IDirect3DTexture9* texture)
+{
+	D3DSURFACE_DESC desc {};
+	texture->GetLevelDesc(0, &desc);
+
+	const size_t texel = desc.Format == D3DFMT_A32B32G32R32F ? sizeof(float) * 4 : sizeof(uint32_t);
+	return desc.Width * desc.Height * texel;
+}
+
+// Calls f with the palette of every instance and handle, which all need a slot in the atlas.
+template <typename F>
+void LanternCollection::for_each_palette(F f) const
+{
+	for (auto& i : instances)
+	{
+		f(i.palette());
+	}
+
+	for (auto& it : handles)
+	{
+		f(it.second.palette());
+	}
+}
+
+// Frees the slots of palettes which no instance or handle uses anymore.
+void LanternCollection::free_atlas_slots()
+{
+	for (auto& slot : atlas_slots)
+	{
+		bool used = false;
+
+		for_each_palette([&](const PalettePool::Ref& palette)
+		{
+			used = used || (slot && slot.shares(palette));
+		});
+
+		if (!used)
+		{
+			slot = {};
+		}
+	}
+}
+
+size_t LanternCollection::atlas_slot(const PalettePool::Ref& palette) const
+{
+	for (size_t i = 0; i < atlas_slots.size(); i++)
+	{
+		if (atlas_slots[i] && atlas_slots[i].shares(palette))
+		{
+			return i;
+		}
+	}
+
+	return atlas_slots.size();
+}
+
+/// <summary>
+/// Gives every instance's and handle's palette a slot in the combined atlas,
+/// writing only the slots whose palette changed. Slots keep their position for
+/// as long as their palette is used, and the atlas only grows.
+/// </summary>
+void LanternCollection::update_atlas()
+{
+	// Software lighting never samples the atlas from the vertex shader.
+	const bool is_32bit = d3d::supports_xrgb() || software_lighting::enabled();
+	// Using a floating point texture to support the GeForce 6000 series cards.
+	const auto format = is_32bit ? D3DFMT_X8R8G8B8 : D3DFMT_A32B32G32R32F;
+
+	bool current = atlas != nullptr && atlas_format == format;
+
+	for_each_palette([&](const PalettePool::Ref& palette)
+	{
+		current = current && atlas_slot(palette) < atlas_slots.size();
+	});
+
+	if (current)
+	{
+		return;
+	}
+
+	TIMELINE_SCOPE("update_atlas");
+
+	free_atlas_slots();
+
+	std::vector<size_t> dirty;
+	size_t palettes = 0;
+
+	for_each_palette([&](const PalettePool::Ref& palette)
+	{
+		++palettes;
+
+		if (atlas_slot(palette) < atlas_slots.size())
+		{
+			return;
+		}
+
+		const auto free_slot = std::find_if(atlas_slots.begin(), atlas_slots.end(), [](const PalettePool::Ref& slot)
+		{
+			return !slot;
+		});
+
+		const auto slot = static_cast<size_t>(free_slot - atlas_slots.begin());
+
+		if (free_slot == atlas_slots.end())
+		{
+			atlas_slots.emplace_back();
+		}
+
+		atlas_slots[slot] = palette;
+		dirty.push_back(slot);
+	});
+
+	size_t capacity = 1;
+
+	while (capacity < atlas_slots.size())
+	{
+		capacity *= 2;
+	}
+
+	D3DSURFACE_DESC desc {};
+
+	if (atlas != nullptr)
+	{
+		atlas->GetLevelDesc(0, &desc);
+	}
+
+	if (atlas == nullptr || atlas_format != format || desc.Height < capacity * palette_lighting::ROW_COUNT)
+	{
+		release_atlas();
+
+		if (FAILED(d3d::device->CreateTexture(256, static_cast<UINT>(capacity * palette_lighting::ROW_COUNT), 1, 0, format,
+		                                      D3DPOOL_MANAGED, &atlas, nullptr)))
+		{
+			throw std::exception("Failed to create palette texture!");
+		}
+
+		memory_accounting::allocate(memory_accounting::Tag::Atlases, atlas_size(atlas));
+		atlas_format = format;
+
+		dirty.clear();
+
+		for (size_t i = 0; i < atlas_slots.size(); i++)
+		{
+			if (atlas_slots[i])
+			{
+				dirty.push_back(i);
+			}
+		}
+	}
+
+	atlas_slots.resize(capacity);
+
+	if (!dirty.empty())
+	{
+		static_assert(sizeof(ColorPair) == sizeof(uint32_t) * 2, "ColorPair size mismatch");
+
+		const bool written = palette_atlas::write_slots<D3DLOCKED_RECT>(atlas.p, is_32bit, dirty, [&](size_t slot)
+		{
+			return reinterpret_cast<const uint32_t*>(atlas_slots[slot]->data());
+		});
+
+		if (!written)
+		{
+			throw std::exception("Failed to lock texture rect!");
+		}
+
+		for (auto slot : dirty)
+		{
+			software_lighting::update_atlas(atlas, slot, atlas_slots[slot]->data());
+		}
+	}
+
+	// Every occupied slot is used by at least one palette, and the rest share one.
+	const auto occupied = static_cast<size_t>(std::count_if(atlas_slots.begin(), atlas_slots.end(), [](const PalettePool::Ref& slot)
+	{
+		return static_cast<bool>(slot);
+	}));
+
+	frame_stats::current.atlas_uploads += static_cast<uint32_t>(dirty.size());
+	palette_store::count_atlas_update(dirty.size(), palettes - occupied);
+
+	param::PaletteA = atlas;
+	param::PaletteB = atlas;
+}
+
+void LanternCollection::release_atlas()
+{
+	if (atlas != nullptr)
+	{
+		memory_accounting::release(memory_accounting::Tag::Atlases, atlas_size(atlas));
+		software_lighting::remove_atlas(atlas);
+		atlas = nullptr;
+	}
+}
+
 void LanternCollection::apply_parameters()
 {
 	if (instances.empty())
@@ -1029,6 +1169,8 @@ void LanternCollection::apply_parameters()
 		return;
 	}
 
+	update_atlas();
+
 	// .xy is diffuse A and B, .zw is specular A and B.
 	D3DXVECTOR4 indices { 0.0f, 0.0f, 0.0f, 0.0f };
 
@@ -1037,15 +1179,23 @@ void LanternCollection::apply_parameters()
 
 	LanternInstance& i = instances[0];
 
+	// Unless a handle is bound in their place, blending goes towards the second instance, or the first if it's alone.
+	const auto& primary = primary_handle != nullptr ? *primary_handle : i;
+	const auto& blend   = blend_handle != nullptr ? *blend_handle : instances[instances.size() > 1 ? 1 : 0];
+
+	const auto rows   = atlas_slots.size() * palette_lighting::ROW_COUNT;
+	const auto slot_a = atlas_slot(primary.palette());
+	const auto slot_b = atlas_slot(blend.palette());
+
 	const int d = i.diffuse_index();
 
 	if (d >= 0)
 	{
-		indices.x = _index_float(d, 0);
+		indices.x = _index_float(d, 0, slot_a, rows);
 
 		if (diffuse_blend_[d] >= 0)
 		{
-			indices.y       = _index_float(diffuse_blend_[d], 0);
+			indices.y       = _index_float(diffuse_blend_[d], 0, slot_b, rows);
 			blend_factors.x = LanternInstance::diffuse_blend_factor_;
 		}
 	}
@@ -1054,11 +1204,11 @@ void LanternCollection::apply_parameters()
 
 	if (s >= 0)
 	{
-		indices.z = _index_float(s, 1);
+		indices.z = _index_float(s, 1, slot_a, rows);
 
 		if (specular_blend_[s] >= 0)
 		{
-			indices.w       = _index_float(specular_blend_[s], 1);
+			indices.w       = _index_float(specular_blend_[s], 1, slot_b, rows);
 			blend_factors.y = LanternInstance::specular_blend_factor_;
 		}
 	}
@@ -1067,22 +1217,6 @@ void LanternCollection::apply_parameters()
 	param::BlendFactor = blend_factors;
 }
 
-void LanternCollection::callback_add(std::deque<lantern_load_cb>& c, lantern_load_cb callback)
-{
-	if (callback == nullptr)
-	{
-		return;
-	}
-
-	callback_del(c, callback);
-	c.push_back(callback);
-}
-
-void LanternCollection::callback_del(std::deque<lantern_load_cb>& c, lantern_load_cb callback)
-{
-	c.erase(std::remove(c.begin(), c.end(), callback), c.end());
-}
-
 size_t LanternCollection::add(LanternInstance& src)
 {
 	instances.emplace_back(std::move(src));
@@ -1092,24 +1226,26 @@ size_t LanternCollection::add(LanternInstance& src)
 void LanternCollection::remove(size_t index)
 {
 	instances.erase(instances.begin() + index);
+	free_atlas_slots();
+	palette_store::prune();
 }
 
-void LanternCollection::add_pl_callback(lantern_load_cb callback)
+void LanternCollection::add_pl_callback(lantern_load_cb callback, bool pure)
 {
-	callback_add(pl_callbacks, callback);
+	pl_callbacks.add(callback, pure);
 }
 
 void LanternCollection::remove_pl_callback(lantern_load_cb callback)
 {
-	callback_del(pl_callbacks, callback);
+	pl_callbacks.remove(callback);
 }
 
-void LanternCollection::add_sl_callback(lantern_load_cb callback)
+void LanternCollection::add_sl_callback(lantern_load_cb callback, bool pure)
 {
-	callback_add(sl_callbacks, callback);
+	sl_callbacks.add(callback, pure);
 }
 
 void LanternCollection::remove_sl_callback(lantern_load_cb callback)
 {
-	callback_del(sl_callbacks, callback);
+	sl_callbacks.remove(callback);
 }
@@ -3,10 +3,15 @@
 #include <ninja.h>
 #include <array>
 #include <deque>
+#include <unordered_map>
+#include <vector>
 #include <SADXStructs.h>
 
 #include "ShaderParameter.h"
 #include "../include/lanternapi.h"
+#include "load_callbacks.h"
+#include "memory_accounting.h"
+#include "shared_pool.h"
 
 #pragma pack(push, 1)
 
@@ -60,6 +65,13 @@ struct ColorPair
 #pragma pack(pop)
 
 static_assert(sizeof(SourceLight) == 0x60, "SourceLight size mismatch");
+
+/// 256 diffuse and specular color pairs for each of the 8 palettes.
+using PalettePairs = std::array<ColorPair, 256 * 8>;
+using SourceLights = std::array<SourceLight, 16>;
+
+using PalettePool = SharedPool<PalettePairs, memory_accounting::Tag::Palettes>;
+using SourcePool  = SharedPool<SourceLights, memory_accounting::Tag::Palettes>;
 template<> bool ShaderParameter<SourceLight_t>::commit(IDirect3DDevice9* device);
 template<> bool ShaderParameter<StageLights>::commit(IDirect3DDevice9* device);
 
@@ -84,20 +96,16 @@ public:
 
 class LanternInstance : ILantern
 {
-	// TODO: handle externally
-	ShaderParameter<Texture>* atlas;
-	std::array<ColorPair, 256 * 8> palette_pairs {};
-	SourceLight source_lights[16] {};
+	/// Shared with every instance which has loaded identical data.
+	PalettePool::Ref palette_;
+	SourcePool::Ref source_;
 	NJS_VECTOR sl_direction {};
 
-	void copy(LanternInstance& inst);
-
 public:
-	explicit LanternInstance(ShaderParameter<Texture>* atlas);
-	LanternInstance(LanternInstance&& inst) noexcept;
-
+	LanternInstance();
+	LanternInstance(LanternInstance&&) noexcept = default;
 	LanternInstance(const LanternInstance&) = default;
-	LanternInstance& operator=(LanternInstance&&) noexcept;
+	LanternInstance& operator=(LanternInstance&&) noexcept = default;
 
 	~LanternInstance();
 
@@ -125,7 +133,6 @@ public:
 
 	bool load_palette(Sint32 level, Sint32 act) override;
 	bool load_palette(const std::string& path) override;
-	void generate_atlas();
 	bool load_source(Sint32 level, Sint32 act) override;
 	bool load_source(const std::string& path) override;
 	void set_last_level(Sint32 level, Sint32 act) override;
@@ -136,20 +143,55 @@ public:
 	Sint32 specular_index() override;
 	void light_direction(const NJS_VECTOR& d) override;
 	const NJS_VECTOR& light_direction() override;
+
+	const PalettePool::Ref& palette() const
+	{
+		return palette_;
+	}
+
+	const SourcePool::Ref& source() const
+	{
+		return source_;
+	}
 };
 
 class LanternCollection : ILantern
 {
 	std::deque<LanternInstance> instances;
-	std::deque<lantern_load_cb> pl_callbacks;
-	std::deque<lantern_load_cb> sl_callbacks;
+	LoadCallbacks pl_callbacks;
+	LoadCallbacks sl_callbacks;
 
-	static void callback_add(std::deque<lantern_load_cb>& c, lantern_load_cb callback);
-	static void callback_del(std::deque<lantern_load_cb>& c, lantern_load_cb callback);
+	template <typename F>
+	bool run_callbacks(LoadCallbacks& callbacks, Sint32 level, Sint32 act, Sint8 time, F load);
 
 	Sint32 diffuse_blend_[8]  = { -1, -1, -1, -1, -1, -1, -1, -1 };
 	Sint32 specular_blend_[8] = { -1, -1, -1, -1, -1, -1, -1, -1 };
 
+	/// <summary>
+	/// Every instance's palette packed into one texture, 16 rows per distinct palette.
+	/// Bound to both palette samplers, so blending between any two instances only
+	/// changes the rows selected by the Indices parameter.
+	/// </summary>
+	Texture atlas;
+	D3DFORMAT atlas_format = D3DFMT_UNKNOWN;
+	/// Palette in each 16 row slot of the atlas. Empty slots are free.
+	std::vector<PalettePool::Ref> atlas_slots;
+
+	/// Palettes loaded ahead of time through the API. They keep their atlas slots until released.
+	std::unordered_map<lantern_palette_handle, LanternInstance> handles;
+	lantern_palette_handle next_handle = 1;
+	/// Handles bound in place of the first instance and the blend target, if any.
+	LanternInstance* primary_handle = nullptr;
+	LanternInstance* blend_handle   = nullptr;
+
+	template <typename F>
+	void for_each_palette(F f) const;
+	size_t atlas_slot(const PalettePool::Ref& palette) const;
+	void free_atlas_slots();
+	void update_atlas();
+	/// Sets the shader light direction from the bound primary handle, or the first instance.
+	void apply_light_direction();
+
 public:
 	size_t add(LanternInstance& src);
 	void remove(size_t index);
@@ -159,15 +201,24 @@ public:
 		return instances.size();
 	}
 
-	void add_pl_callback(lantern_load_cb callback);
+	void add_pl_callback(lantern_load_cb callback, bool pure = false);
 	void remove_pl_callback(lantern_load_cb callback);
-	void add_sl_callback(lantern_load_cb callback);
+	void add_sl_callback(lantern_load_cb callback, bool pure = false);
 	void remove_sl_callback(lantern_load_cb callback);
 	bool run_pl_callbacks(Sint32 level, Sint32 act, Sint8 time);
 	bool run_sl_callbacks(Sint32 level, Sint32 act, Sint8 time);
 	bool load_files();
 
-	// TODO: Expose to API when explicit multi-palette management is implemented.
+	/// Returns a new, empty palette handle.
+	lantern_palette_handle create_handle();
+	/// Returns the instance a handle refers to, or nullptr if it's invalid.
+	LanternInstance* handle(lantern_palette_handle id);
+	/// Loads a handle's source lights. They only change the light direction while it's bound as the primary.
+	bool load_handle_source(lantern_palette_handle id, const std::string& path);
+	/// Binds a handle in place of the first instance or as the blend target. 0 restores the default.
+	bool bind_handle(lantern_palette_handle id, LanternBinding binding);
+	bool release_handle(lantern_palette_handle id);
+
 	/// Blend all indices of diffuse and specular to the same index
 	/// of a secondary palette atlas.
 	void forward_blend_all(bool enable);
@@ -185,6 +236,8 @@ public:
 	int specular_blend(int index) const;
 	/// Apply necessary shader parameters.
 	void apply_parameters();
+	/// Releases the combined atlas. It's recreated the next time parameters are applied.
+	void release_atlas();
 
 	LanternInstance& operator[](size_t i)
 	{
@@ -89,6 +89,9 @@ float  AlphaRef  : register(c33) = 16.0f / 255.0f;
 
 float3 ViewPosition : register(c34);
 
+// Only used by instanced draws, which take their world matrix from the instance stream.
+float4x4 ViewMatrix : register(c35);
+
 // Helpers
 
 // From FixedFuncEMU.fx
@@ -136,6 +139,16 @@ struct VS_IN
 	float3 normal   : NORMAL;
 	float2 tex      : TEXCOORD0;
 	float4 color    : COLOR0;
+#ifdef SOFTWARE_LIGHTING
+	// Palette specular color, lit on the CPU.
+	float4 specular : COLOR1;
+#endif
+#ifdef USE_INSTANCING
+	// Columns of the instance's world matrix.
+	float4 world0   : TEXCOORD5;
+	float4 world1   : TEXCOORD6;
+	float4 world2   : TEXCOORD7;
+#endif
 };
 
 struct PS_IN
@@ -148,29 +161,56 @@ struct PS_IN
 	float3 worldPos : FOG1;
 };
 
+// Transforms a point (w = 1) or direction (w = 0) into world space.
+float3 ToWorld(in VS_IN input, in float4 v)
+{
+#ifdef USE_INSTANCING
+	return float3(dot(v, input.world0), dot(v, input.world1), dot(v, input.world2));
+#else
+	return (float3)mul(v, WorldMatrix);
+#endif
+}
+
 // Vertex shaders
 
 PS_IN vs_main(VS_IN input)
 {
 	PS_IN output;
 
+	output.worldPos = ToWorld(input, float4(input.position, 1));
+
+#ifdef USE_INSTANCING
+	output.position = mul(float4(output.worldPos, 1), ViewMatrix);
+#else
 	output.position = mul(float4(input.position, 1), wvMatrix);
+#endif
+
 	output.fogDist = output.position.z;
 
 	output.position = mul(output.position, ProjectionMatrix);
 
-	output.worldPos = (float3)mul(float4(input.position, 1), WorldMatrix);
-
 #if defined(USE_TEXTURE) && defined(USE_ENVMAP)
+#ifdef USE_INSTANCING
+	// Instanced models are assumed to be scaled uniformly, so the normal
+	// can be rotated into view space without the inverse transpose.
+	output.tex = (float2)mul(normalize(ToWorld(input, float4(input.normal, 0))), (float3x3)ViewMatrix);
+#else
 	output.tex = (float2)mul(float4(input.normal, 1), wvMatrixInvT);
+#endif
 	output.tex = (float2)mul(float4(output.tex, 0, 1), TextureTransform);
 #else
 	output.tex = input.tex;
 #endif
 
-#if defined(USE_LIGHT)
+#if defined(USE_LIGHT) && defined(SOFTWARE_LIGHTING)
+	{
+		// Lit on the CPU with the same math as below; the vertex colors hold the result.
+		output.diffuse = input.color;
+		output.specular = float4(input.specular.rgb, 0.0f);
+	}
+#elif defined(USE_LIGHT)
 	{
-		float3 worldNormal = mul(input.normal * NormalScale, (float3x3)WorldMatrix);
+		float3 worldNormal = ToWorld(input, float4(input.normal * NormalScale, 0));
 		float4 diffuse = GetDiffuse(input.color);
 
 		// This is the "brightness index" calculation. Just a dot product
@@ -8,35 +8,93 @@
 
 #include "../include/lanternapi.h"
 #include "apiconfig.h"
-
-inline void check_blend()
+#include "instancing.h"
+#include "frame_stats.h"
+#include "timeline.h"
+#include "memory_accounting.h"
+#include "palette_store.h"
+#include "api_queue.h"
+
+// Defers a call from another thread with a copy of the array it was given, which the command frees.
+template <typename T, typename F>
+static bool defer_array(T const* const* items, size_t length, F f)
 {
-	if (param::PaletteB.value() == nullptr)
+	if (api_queue::on_render_thread())
 	{
-		param::PaletteB = param::PaletteA;
+		return false;
 	}
+
+	auto copy = new std::vector<T const*>(items, items + length);
+
+	api_queue::push(api_queue::Command([=]
+	{
+		f(copy->data(), copy->size());
+		delete copy;
+	}));
+
+	return true;
 }
 
 void pl_load_register(lantern_load_cb callback)
 {
+	if (api_queue::defer([=] { pl_load_register(callback); }))
+	{
+		return;
+	}
+
 	globals::palettes.add_pl_callback(callback);
 }
 
 void pl_load_unregister(lantern_load_cb callback)
 {
+	if (api_queue::defer([=] { pl_load_unregister(callback); }))
+	{
+		return;
+	}
+
 	globals::palettes.remove_pl_callback(callback);
 }
 
 void sl_load_register(lantern_load_cb callback)
 {
+	if (api_queue::defer([=] { sl_load_register(callback); }))
+	{
+		return;
+	}
+
 	globals::palettes.add_sl_callback(callback);
 }
 
 void sl_load_unregister(lantern_load_cb callback)
 {
+	if (api_queue::defer([=] { sl_load_unregister(callback); }))
+	{
+		return;
+	}
+
 	globals::palettes.remove_sl_callback(callback);
 }
 
+void pl_load_register_pure(lantern_load_cb callback)
+{
+	if (api_queue::defer([=] { pl_load_register_pure(callback); }))
+	{
+		return;
+	}
+
+	globals::palettes.add_pl_callback(callback, true);
+}
+
+void sl_load_register_pure(lantern_load_cb callback)
+{
+	if (api_queue::defer([=] { sl_load_register_pure(callback); }))
+	{
+		return;
+	}
+
+	globals::palettes.add_sl_callback(callback, true);
+}
+
 void material_register(NJS_MATERIAL const* const* materials, size_t length, lantern_material_cb callback)
 {
 	if (!length || materials == nullptr || callback == nullptr)
@@ -44,6 +102,11 @@ void material_register(NJS_MATERIAL const* const* materials, size_t length, lant
 		return;
 	}
 
+	if (defer_array(materials, length, [=](NJS_MATERIAL const* const* m, size_t n) { material_register(m, n, callback); }))
+	{
+		return;
+	}
+
 	for (size_t i = 0; i < length; i++)
 	{
 		auto material = materials[i];
@@ -67,6 +130,11 @@ void material_unregister(NJS_MATERIAL const* const* materials, size_t length, la
 		return;
 	}
 
+	if (defer_array(materials, length, [=](NJS_MATERIAL const* const* m, size_t n) { material_unregister(m, n, callback); }))
+	{
+		return;
+	}
+
 	for (size_t i = 0; i < length; i++)
 	{
 		auto it = apiconfig::material_callbacks.find(materials[i]);
@@ -85,18 +153,75 @@ void material_unregister(NJS_MATERIAL const* const* materials, size_t length, la
 	}
 }
 
+void instancing_register(NJS_MODEL_SADX const* const* models, size_t length)
+{
+	if (!length || models == nullptr)
+	{
+		return;
+	}
+
+	if (defer_array(models, length, [=](NJS_MODEL_SADX const* const* m, size_t n) { instancing_register(m, n); }))
+	{
+		return;
+	}
+
+	for (size_t i = 0; i < length; i++)
+	{
+		if (models[i] != nullptr)
+		{
+			apiconfig::instanced_models.insert(models[i]);
+		}
+	}
+}
+
+void instancing_unregister(NJS_MODEL_SADX const* const* models, size_t length)
+{
+	if (!length || models == nullptr)
+	{
+		return;
+	}
+
+	if (defer_array(models, length, [=](NJS_MODEL_SADX const* const* m, size_t n) { instancing_unregister(m, n); }))
+	{
+		return;
+	}
+
+	// Queued instances may refer to models which are about to be freed.
+	instancing::flush();
+
+	for (size_t i = 0; i < length; i++)
+	{
+		apiconfig::instanced_models.erase(models[i]);
+	}
+}
+
 void set_shader_flags(uint32_t flags, bool add)
 {
+	if (api_queue::defer([=] { set_shader_flags(flags, add); }))
+	{
+		return;
+	}
+
 	d3d::set_flags(flags, add);
 }
 
 void allow_landtable_specular(bool allow)
 {
+	if (api_queue::defer([=] { allow_landtable_specular(allow); }))
+	{
+		return;
+	}
+
 	apiconfig::landtable_specular = allow;
 }
 
 void set_diffuse(int32_t n, bool permanent)
 {
+	if (api_queue::defer([=] { set_diffuse(n, permanent); }))
+	{
+		return;
+	}
+
 	globals::palettes.diffuse_index(n);
 	LanternInstance::diffuse_override = n >= 0;
 	LanternInstance::diffuse_override_is_temp = !permanent;
@@ -104,6 +229,11 @@ void set_diffuse(int32_t n, bool permanent)
 
 void set_specular(int32_t n, bool permanent)
 {
+	if (api_queue::defer([=] { set_specular(n, permanent); }))
+	{
+		return;
+	}
+
 	globals::palettes.specular_index(n);
 	LanternInstance::specular_override = n >= 0;
 	LanternInstance::specular_override_is_temp = !permanent;
@@ -121,39 +251,67 @@ int32_t get_specular()
 
 void set_blend_factor(float factor)
 {
+	if (api_queue::defer([=] { set_blend_factor(factor); }))
+	{
+		return;
+	}
+
 	set_diffuse_blend_factor(factor);
 	set_specular_blend_factor(factor);
 }
 
 void allow_object_vcolor(bool allow)
 {
+	if (api_queue::defer([=] { allow_object_vcolor(allow); }))
+	{
+		return;
+	}
+
 	apiconfig::object_vcolor = allow;
 }
 
 void use_default_diffuse(bool use)
 {
+	if (api_queue::defer([=] { use_default_diffuse(use); }))
+	{
+		return;
+	}
+
 	param::ForceDefaultDiffuse = use;
 }
 
 void diffuse_override(bool enable)
 {
+	if (api_queue::defer([=] { diffuse_override(enable); }))
+	{
+		return;
+	}
+
 	param::DiffuseOverride = enable;
 }
 
 void diffuse_override_rgb(float r, float g, float b)
 {
+	if (api_queue::defer([=] { diffuse_override_rgb(r, g, b); }))
+	{
+		return;
+	}
+
 	const D3DXVECTOR3 color = { r, g, b };
 	param::DiffuseOverrideColor = color;
 }
 
 void set_diffuse_blend(int32_t src, int32_t dest)
 {
-	if (dest < -1 || dest > 7)
+	if (api_queue::defer([=] { set_diffuse_blend(src, dest); }))
 	{
 		return;
 	}
 
-	check_blend();
+	if (dest < -1 || dest > 7)
+	{
+		return;
+	}
 
 	if (src == -1)
 	{
@@ -171,12 +329,15 @@ void set_diffuse_blend(int32_t src, int32_t dest)
 
 void set_specular_blend(int32_t src, int32_t dest)
 {
-	if (dest < -1 || dest > 7)
+	if (api_queue::defer([=] { set_specular_blend(src, dest); }))
 	{
 		return;
 	}
 
-	check_blend();
+	if (dest < -1 || dest > 7)
+	{
+		return;
+	}
 
 	if (src == -1)
 	{
@@ -214,13 +375,21 @@ int32_t get_specular_blend(int32_t src)
 
 void set_diffuse_blend_factor(float factor)
 {
-	check_blend();
+	if (api_queue::defer([=] { set_diffuse_blend_factor(factor); }))
+	{
+		return;
+	}
+
 	LanternInstance::diffuse_blend_factor(factor);
 }
 
 void set_specular_blend_factor(float factor)
 {
-	check_blend();
+	if (api_queue::defer([=] { set_specular_blend_factor(factor); }))
+	{
+		return;
+	}
+
 	LanternInstance::specular_blend_factor(factor);
 }
 
@@ -236,12 +405,22 @@ float get_specular_blend_factor()
 
 void set_blend(int32_t src, int32_t dest)
 {
+	if (api_queue::defer([=] { set_blend(src, dest); }))
+	{
+		return;
+	}
+
 	set_diffuse_blend(src, dest);
 	set_specular_blend(src, dest);
 }
 
 void set_alpha_reject(float threshold, bool permanent)
 {
+	if (api_queue::defer([=] { set_alpha_reject(threshold, permanent); }))
+	{
+		return;
+	}
+
 	if (!permanent)
 	{
 		if (!apiconfig::alpha_ref_is_temp)
@@ -267,7 +446,121 @@ void set_light_direction(const NJS_VECTOR* v)
 {
 	if (v != nullptr)
 	{
+		const NJS_VECTOR dir = *v;
+
+		if (api_queue::defer([=] { set_light_direction(&dir); }))
+		{
+			return;
+		}
+
 		apiconfig::override_light_dir = true;
 		apiconfig::light_dir_override = *v;
 	}
 }
+
+void frame_stats_enable(bool enable)
+{
+	if (api_queue::defer([=] { frame_stats_enable(enable); }))
+	{
+		return;
+	}
+
+	frame_stats::set_enabled(enable);
+}
+
+size_t frame_stats_count()
+{
+	return frame_stats::count();
+}
+
+bool frame_stats_get(size_t frames_ago, LanternFrameStats* stats)
+{
+	if (stats == nullptr)
+	{
+		return false;
+	}
+
+	return frame_stats::get(frames_ago, *stats);
+}
+
+bool frame_stats_dump(const char* path)
+{
+	if (path == nullptr)
+	{
+		return false;
+	}
+
+	return frame_stats::dump(path);
+}
+
+void timeline_enable(bool enable)
+{
+	if (api_queue::defer([=] { timeline_enable(enable); }))
+	{
+		return;
+	}
+
+	timeline::set_enabled(enable);
+}
+
+bool timeline_dump(const char* path)
+{
+	if (path == nullptr)
+	{
+		return false;
+	}
+
+	return timeline::write(path);
+}
+
+bool memory_usage(LanternMemoryTag tag, LanternMemoryUsage* usage)
+{
+	if (usage == nullptr || tag < 0 || tag >= LanternMemory_Count)
+	{
+		return false;
+	}
+
+	const auto& u = memory_accounting::usage(static_cast<memory_accounting::Tag>(tag));
+
+	usage->bytes       = u.bytes;
+	usage->allocations = u.allocations;
+	usage->peak_bytes  = u.peak_bytes;
+	return true;
+}
+
+bool palette_stats(LanternPaletteStats* stats)
+{
+	if (stats == nullptr)
+	{
+		return false;
+	}
+
+	*stats = palette_store::stats();
+	return true;
+}
+
+lantern_palette_handle palette_handle_create()
+{
+	return globals::palettes.create_handle();
+}
+
+bool palette_handle_load(lantern_palette_handle handle, const char* path)
+{
+	LanternInstance* instance = globals::palettes.handle(handle);
+	return instance != nullptr && path != nullptr && instance->load_palette(path);
+}
+
+bool palette_handle_load_source(lantern_palette_handle handle, const char* path)
+{
+	return path != nullptr && globals::palettes.load_handle_source(handle, path);
+}
+
+bool palette_handle_bind(lantern_palette_handle handle, LanternBinding binding)
+{
+	return globals::palettes.bind_handle(handle, binding);
+}
+
+bool palette_handle_release(lantern_palette_handle handle)
+{
+	return globals::palettes.release_handle(handle);
+}
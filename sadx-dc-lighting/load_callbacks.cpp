@@ -0,0 +1,84 @@
+#include "stdafx.h"
+
+#include <algorithm>
+
+#include "load_callbacks.h"
+#include "frame_stats.h"
+
+void LoadCallbacks::add(lantern_load_cb callback, bool pure)
+{
+	if (callback == nullptr)
+	{
+		return;
+	}
+
+	remove(callback);
+	entries.push_back({ callback, pure });
+	++generation;
+}
+
+void LoadCallbacks::remove(lantern_load_cb callback)
+{
+	entries.erase(std::remove_if(entries.begin(), entries.end(), [&](const Entry& e)
+	{
+		return e.callback == callback;
+	}), entries.end());
+
+	++generation;
+}
+
+const std::string* LoadCallbacks::resolve(int32_t level, int32_t act, int8_t time)
+{
+	// Acts never come close to needing more than 24 bits.
+	const auto key = static_cast<uint64_t>(static_cast<uint32_t>(level)) << 32
+	                 | static_cast<uint64_t>(static_cast<uint32_t>(act) & 0xFFFFFF) << 8
+	                 | static_cast<uint8_t>(time);
+	auto& r = resolved[key];
+
+	if (r.generation != generation)
+	{
+		r.generation = generation;
+		r.end        = entries.size();
+		r.found      = false;
+		r.path.clear();
+
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			if (!entries[i].pure)
+			{
+				r.end = i;
+				break;
+			}
+
+			const char* path = entries[i].callback(level, act);
+			++frame_stats::current.callback_invocations;
+
+			if (path != nullptr)
+			{
+				r.end   = i;
+				r.found = true;
+				r.path  = path;
+				break;
+			}
+		}
+	}
+
+	if (r.found)
+	{
+		return &r.path;
+	}
+
+	for (size_t i = r.end; i < entries.size(); i++)
+	{
+		const char* path = entries[i].callback(level, act);
+		++frame_stats::current.callback_invocations;
+
+		if (path != nullptr)
+		{
+			live_path = path;
+			return &live_path;
+		}
+	}
+
+	return nullptr;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+#include "../include/lanternapi.h"
+#include "memory_accounting.h"
+
+/*
+ * PL or SL level-load callbacks, in the order they were registered.
+ * The path used for a level and act is the one returned by the first
+ * callback which returns one.
+ *
+ * Callbacks registered as pure are only called once per level, act and
+ * time of day, since a callback can read the time of day itself:
+ * the result of the leading run of pure callbacks is memoized, and only
+ * callbacks after it are called again. Every register and unregister
+ * bumps a generation which invalidates all memoized results.
+ */
+class LoadCallbacks
+{
+	struct Entry
+	{
+		lantern_load_cb callback;
+		bool pure;
+	};
+
+	struct Resolution
+	{
+		/// 0 until resolved for the first time.
+		uint32_t generation;
+		/// The callback which provided path, or if none did, the first impure callback.
+		size_t end;
+		bool found;
+		std::string path;
+	};
+
+	template <typename T>
+	using Allocator = memory_accounting::Allocator<T, memory_accounting::Tag::Callbacks>;
+
+	std::deque<Entry, Allocator<Entry>> entries;
+	std::unordered_map<uint64_t, Resolution, std::hash<uint64_t>, std::equal_to<uint64_t>,
+	                   Allocator<std::pair<const uint64_t, Resolution>>> resolved;
+	uint32_t generation = 1;
+	/// Holds the path returned by an impure callback.
+	std::string live_path;
+
+public:
+	/// Registers \p callback after every other, moving it there if it was already registered.
+	void add(lantern_load_cb callback, bool pure);
+	void remove(lantern_load_cb callback);
+
+	/// <summary>
+	/// Returns the path provided for the level and act at the time of day \p time by the first
+	/// callback to provide one, or nullptr if none do. The path is valid until the next call.
+	/// </summary>
+	const std::string* resolve(int32_t level, int32_t act, int8_t time);
+};
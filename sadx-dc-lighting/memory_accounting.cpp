@@ -0,0 +1,47 @@
+#include "stdafx.h"
+
+#include "memory_accounting.h"
+
+namespace memory_accounting
+{
+	static Usage usages[static_cast<size_t>(Tag::Count)] {};
+
+	static const char* const NAMES[static_cast<size_t>(Tag::Count)] = {
+		"palettes",
+		"atlases",
+		"shader source",
+		"shader bytecode",
+		"callbacks",
+	};
+
+	void allocate(Tag tag, size_t bytes)
+	{
+		auto& u = usages[static_cast<size_t>(tag)];
+
+		u.bytes += bytes;
+		++u.allocations;
+
+		if (u.bytes > u.peak_bytes)
+		{
+			u.peak_bytes = u.bytes;
+		}
+	}
+
+	void release(Tag tag, size_t bytes)
+	{
+		auto& u = usages[static_cast<size_t>(tag)];
+
+		u.bytes -= bytes;
+		--u.allocations;
+	}
+
+	const Usage& usage(Tag tag)
+	{
+		return usages[static_cast<size_t>(tag)];
+	}
+
+	const char* name(Tag tag)
+	{
+		return NAMES[static_cast<size_t>(tag)];
+	}
+}
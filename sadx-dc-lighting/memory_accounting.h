@@ -0,0 +1,119 @@
+#pragma once
+
+// This header is intentionally free of game and Direct3D
+// dependencies so that it can be used and measured headlessly.
+
+#include <cstddef>
+#include <memory>
+
+/*
+ * Tracks the memory held by each subsystem: live bytes, live
+ * allocations and the peak of live bytes. Containers are tracked by
+ * giving them an Allocator, fixed-size storage inside objects with a
+ * Footprint member, and anything else (e.g. Direct3D resources) with
+ * explicit calls to allocate and release.
+ *
+ * Not thread-safe; every tracked subsystem is used from the game thread.
+ */
+namespace memory_accounting
+{
+	/// Values match LanternMemoryTag in lanternapi.h.
+	enum class Tag : size_t
+	{
+		/// Pooled palette and source light blocks, including free ones.
+		Palettes,
+		/// Palette atlas textures.
+		Atlases,
+		/// The shader source file.
+		ShaderSource,
+		/// Bytecode of created shaders.
+		ShaderBytecode,
+		/// Callback and model tables registered through the API.
+		Callbacks,
+		Count
+	};
+
+	struct Usage
+	{
+		size_t bytes;
+		size_t allocations;
+		size_t peak_bytes;
+	};
+
+	void allocate(Tag tag, size_t bytes);
+	void release(Tag tag, size_t bytes);
+
+	const Usage& usage(Tag tag);
+	const char* name(Tag tag);
+
+	/// Accounts \p SIZE bytes for as long as the object it's a member of exists.
+	template <Tag TAG, size_t SIZE>
+	class Footprint
+	{
+	public:
+		Footprint()
+		{
+			allocate(TAG, SIZE);
+		}
+
+		Footprint(const Footprint&) : Footprint()
+		{
+		}
+
+		Footprint& operator=(const Footprint&)
+		{
+			return *this;
+		}
+
+		~Footprint()
+		{
+			release(TAG, SIZE);
+		}
+	};
+
+	/// A std::allocator which accounts its allocations to a tag.
+	template <typename T, Tag TAG>
+	class Allocator
+	{
+	public:
+		using value_type = T;
+
+		template <typename U>
+		struct rebind
+		{
+			using other = Allocator<U, TAG>;
+		};
+
+		Allocator() noexcept = default;
+
+		template <typename U>
+		Allocator(const Allocator<U, TAG>&) noexcept
+		{
+		}
+
+		T* allocate(size_t n)
+		{
+			T* result = std::allocator<T>().allocate(n);
+			memory_accounting::allocate(TAG, n * sizeof(T));
+			return result;
+		}
+
+		void deallocate(T* p, size_t n) noexcept
+		{
+			memory_accounting::release(TAG, n * sizeof(T));
+			std::allocator<T>().deallocate(p, n);
+		}
+
+		template <typename U>
+		bool operator==(const Allocator<U, TAG>&) const noexcept
+		{
+			return true;
+		}
+
+		template <typename U>
+		bool operator!=(const Allocator<U, TAG>&) const noexcept
+		{
+			return false;
+		}
+	};
+}
@@ -20,8 +20,22 @@
 #include "Obj_Chaos7.h"
 #include "FixChaoGardenMaterials.h"
 #include "FixCharacterMaterials.h"
+#include "MaterialOverrides.h"
 #include "polybuff.h"
+#include "polybuff_cache.h"
+#include "polybuff_indexed.h"
+#include "profiler.h"
+#include "landtable_optimizer.h"
+#include "landtable_prewarm.h"
+#include "landtable_culling.h"
+#include "instancing.h"
+#include "software_lighting.h"
+#include "trace_recorder.h"
+#include "frame_stats.h"
+#include "timeline.h"
+#include "memory_accounting.h"
 #include "apiconfig.h"
+#include "api_queue.h"
 
 static Trampoline* CharSel_LoadA_t                 = nullptr;
 static Trampoline* Direct3D_ParseMaterial_t        = nullptr;
@@ -142,9 +156,13 @@ inline void fix_default_color(Uint32& color)
 
 static void __fastcall Direct3D_ParseMaterial_r(NJS_MATERIAL* material)
 {
+	TIMELINE_SCOPE("Direct3D_ParseMaterial");
+
 	using namespace d3d;
 
 	TARGET_DYNAMIC(Direct3D_ParseMaterial)(material);
+	TRACE_EVENT(parse_material, material);
+	++frame_stats::current.material_parses;
 
 	if (shaders_null())
 	{
@@ -200,6 +218,13 @@ static void __fastcall Direct3D_ParseMaterial_r(NJS_MATERIAL* material)
 		flags = _nj_constant_attr_or_ | (_nj_constant_attr_and_ & flags);
 	}
 
+	const auto override_entry = material_overrides::find(material);
+
+	if (override_entry != nullptr)
+	{
+		flags = material_overrides::apply_flags(override_entry, flags);
+	}
+
 	fix_default_color(EntityVertexColor.color);
 	fix_default_color(LandTableVertexColor.color);
 
@@ -219,6 +244,13 @@ static void __fastcall Direct3D_ParseMaterial_r(NJS_MATERIAL* material)
 
 	do_effect = true;
 
+	// Table overrides are applied first so that material
+	// callbacks registered through the API can still replace them.
+	if (override_entry != nullptr)
+	{
+		material_overrides::apply_indices(override_entry);
+	}
+
 	if (apiconfig::material_callbacks.empty())
 	{
 		return;
@@ -232,6 +264,8 @@ static void __fastcall Direct3D_ParseMaterial_r(NJS_MATERIAL* material)
 
 	for (auto& cb : it->second)
 	{
+		++frame_stats::current.callback_invocations;
+
 		if (cb(material, flags))
 		{
 			break;
@@ -297,6 +331,8 @@ static void __cdecl GoToNextChaoStage_r()
 			return;
 	}
 
+	// Garden landtable materials are only patched once the garden is actually loaded.
+	ApplyChaoGardenMaterials(CurrentLevel);
 	globals::palettes.load_files();
 
 	CurrentLevel = level;
@@ -325,36 +361,67 @@ static void __cdecl SetTimeOfDay_r(Sint8 time)
 	globals::palettes.load_files();
 }
 
+static void report_memory()
+{
+	for (size_t i = 0; i < static_cast<size_t>(memory_accounting::Tag::Count); ++i)
+	{
+		const auto tag = static_cast<memory_accounting::Tag>(i);
+		const auto& u  = memory_accounting::usage(tag);
+
+		PrintDebug("[lantern] Memory (%s): %u bytes in %u allocations, %u bytes peak\n",
+		           memory_accounting::name(tag), u.bytes, u.allocations, u.peak_bytes);
+	}
+}
+
 static void __cdecl LoadLevelFiles_r()
 {
+	landtable_prewarm::cancel();
+	polybuff_cache::clear();
+	polybuff_indexed::clear();
+	landtable_optimizer::report();
+	landtable_culling::report();
+	instancing::report();
+	software_lighting::report();
+	report_memory();
 	TARGET_DYNAMIC(LoadLevelFiles)();
 	globals::palettes.load_files();
+	landtable_prewarm::request();
 }
 
 static void __cdecl DrawLandTable_r()
 {
+	landtable_prewarm::draw_begin();
+	landtable_culling::begin();
+
 	if (apiconfig::landtable_specular)
 	{
 		TARGET_DYNAMIC(DrawLandTable)();
-		return;
 	}
+	else
+	{
+		const auto flag = _nj_control_3d_flag_;
+		const auto or   = _nj_constant_attr_or_;
 
-	const auto flag = _nj_control_3d_flag_;
-	const auto or   = _nj_constant_attr_or_;
+		_nj_control_3d_flag_ |= NJD_CONTROL_3D_CONSTANT_ATTR;
+		_nj_constant_attr_or_ |= NJD_FLAG_IGNORE_SPECULAR;
 
-	_nj_control_3d_flag_ |= NJD_CONTROL_3D_CONSTANT_ATTR;
-	_nj_constant_attr_or_ |= NJD_FLAG_IGNORE_SPECULAR;
+		TARGET_DYNAMIC(DrawLandTable)();
 
-	TARGET_DYNAMIC(DrawLandTable)();
+		_nj_control_3d_flag_ = flag;
+		_nj_constant_attr_or_ = or;
+	}
 
-	_nj_control_3d_flag_ = flag;
-	_nj_constant_attr_or_ = or;
+	landtable_culling::end();
+	landtable_prewarm::draw_end();
 }
 
 static Sint32 __fastcall Direct3D_SetTexList_r(NJS_TEXLIST* texlist)
 {
+	TRACE_EVENT(set_texlist, texlist);
+
 	if (texlist != Direct3D_CurrentTexList)
 	{
+		instancing::flush();
 		param::AllowVertexColor = true;
 
 		if (!globals::light_type)
@@ -422,6 +489,8 @@ static void __cdecl SetCurrentStageLight_EggViper_r(ObjectMaster* a1)
 
 void __cdecl InitLandTableMeshSet_r(NJS_MODEL_SADX* model, NJS_MESHSET_SADX* meshset)
 {
+	TIMELINE_SCOPE("InitLandTableMeshSet");
+
 	if (meshset->buffer)
 	{
 		return;
@@ -462,6 +531,7 @@ void __cdecl InitLandTableMeshSet_r(NJS_MODEL_SADX* model, NJS_MESHSET_SADX* mes
 	if (func)
 	{
 		func(meshset, points, normals);
+		landtable_optimizer::optimize(meshset);
 	}
 }
 
@@ -470,6 +540,8 @@ extern "C"
 	EXPORT ModInfo SADXModInfo = { ModLoaderVer, nullptr, nullptr, 0, nullptr, 0, nullptr, 0, nullptr, 0 };
 	EXPORT void __cdecl Init(const char* path, const HelperFunctions& helperFunctions)
 	{
+		PROFILE_SCOPE("Init");
+
 		auto handle = GetModuleHandle(L"d3d9.dll");
 
 		if (handle == nullptr)
@@ -490,12 +562,17 @@ extern "C"
 			return;
 		}
 
-		MH_Initialize();
+		PROFILE_STAGE("MH_Initialize", MH_Initialize());
+
+		// API calls from any other thread are queued until the end of the frame from here on.
+		api_queue::set_render_thread();
 
 		WriteJump(InitLandTableMeshSet, InitLandTableMeshSet_r);
 
-		LanternInstance base(&param::PaletteA);
-		globals::palettes.add(base);
+		PROFILE_STAGE("LanternInstance", {
+			LanternInstance base;
+			globals::palettes.add(base);
+		});
 
 		globals::helper_functions = helperFunctions;
 
@@ -513,29 +590,65 @@ extern "C"
 			d3d::set_flags(ShaderFlags_RangeFog, true);
 		}
 
-		d3d::init_trampolines();
-
-		CharSel_LoadA_t                 = new Trampoline(0x00512BC0, 0x00512BC6, CharSel_LoadA_r);
-		Direct3D_ParseMaterial_t        = new Trampoline(0x00784850, 0x00784858, Direct3D_ParseMaterial_r);
-		GoToNextLevel_t                 = new Trampoline(0x00414610, 0x00414616, GoToNextLevel_r);
-		IncrementAct_t                  = new Trampoline(0x004146E0, 0x004146E5, IncrementAct_r);
-		LoadLevelFiles_t                = new Trampoline(0x00422AD0, 0x00422AD8, LoadLevelFiles_r);
-		SetLevelAndAct_t                = new Trampoline(0x00414570, 0x00414576, SetLevelAndAct_r);
-		GoToNextChaoStage_t             = new Trampoline(0x00715130, 0x00715135, GoToNextChaoStage_r);
-		SetTimeOfDay_t                  = new Trampoline(0x00412C00, 0x00412C05, SetTimeOfDay_r);
-		DrawLandTable_t                 = new Trampoline(0x0043A6A0, 0x0043A6A8, DrawLandTable_r);
-		Direct3D_SetTexList_t           = new Trampoline(0x0077F3D0, 0x0077F3D8, Direct3D_SetTexList_r);
-		SetCurrentStageLights_t         = new Trampoline(0x0040A950, 0x0040A955, SetCurrentStageLights_r);
-		SetCurrentStageLight_EggViper_t = new Trampoline(0x0057E560, 0x0057E567, SetCurrentStageLight_EggViper_r);
-
-		// Material callback hijack
-		WriteJump(reinterpret_cast<void*>(0x0040A340), CorrectMaterial_r);
-
-		FixCharacterMaterials();
-		FixChaoGardenMaterials();
-		Past_Init();
-		SkyDeck_Init();
-		Chaos7_Init();
+		GetPrivateProfileStringA("Performance", "OptimizeLandTables", "False", str.data(), str.size(), config_path.c_str());
+		landtable_optimizer::set_enabled(!strcmp(str.data(), "True"));
+
+		GetPrivateProfileStringA("Performance", "PrewarmLandTables", "False", str.data(), str.size(), config_path.c_str());
+		landtable_prewarm::set_enabled(!strcmp(str.data(), "True"));
+
+		GetPrivateProfileStringA("Performance", "FrustumCullLandTables", "False", str.data(), str.size(), config_path.c_str());
+		landtable_culling::set_enabled(!strcmp(str.data(), "True"));
+
+		GetPrivateProfileStringA("Performance", "InstanceModels", "True", str.data(), str.size(), config_path.c_str());
+		instancing::set_enabled(!strcmp(str.data(), "True"));
+
+		// Also enabled automatically for devices which can't sample palettes from the vertex shader.
+		GetPrivateProfileStringA("Performance", "SoftwareLighting", "False", str.data(), str.size(), config_path.c_str());
+		software_lighting::set_enabled(!strcmp(str.data(), "True"));
+
+		GetPrivateProfileStringA("Debug", "Timeline", "False", str.data(), str.size(), config_path.c_str());
+		timeline::set_enabled(!strcmp(str.data(), "True"));
+
+		GetPrivateProfileStringA("Debug", "FrameStats", "False", str.data(), str.size(), config_path.c_str());
+
+		if (!strcmp(str.data(), "True"))
+		{
+			frame_stats::set_enabled(true);
+			frame_stats::start_csv(globals::mod_path + "\\frame_stats.csv");
+		}
+
+#ifdef LANTERN_TRACE
+		GetPrivateProfileStringA("Debug", "TraceFrames", "0", str.data(), str.size(), config_path.c_str());
+		trace_recorder::start(globals::mod_path + "\\lantern.trace", static_cast<uint32_t>(strtoul(str.data(), nullptr, 10)));
+#endif
+
+		PROFILE_STAGE("d3d::init_trampolines", d3d::init_trampolines());
+
+		{
+			PROFILE_SCOPE("Trampolines");
+
+			CharSel_LoadA_t                 = new Trampoline(0x00512BC0, 0x00512BC6, CharSel_LoadA_r);
+			Direct3D_ParseMaterial_t        = new Trampoline(0x00784850, 0x00784858, Direct3D_ParseMaterial_r);
+			GoToNextLevel_t                 = new Trampoline(0x00414610, 0x00414616, GoToNextLevel_r);
+			IncrementAct_t                  = new Trampoline(0x004146E0, 0x004146E5, IncrementAct_r);
+			LoadLevelFiles_t                = new Trampoline(0x00422AD0, 0x00422AD8, LoadLevelFiles_r);
+			SetLevelAndAct_t                = new Trampoline(0x00414570, 0x00414576, SetLevelAndAct_r);
+			GoToNextChaoStage_t             = new Trampoline(0x00715130, 0x00715135, GoToNextChaoStage_r);
+			SetTimeOfDay_t                  = new Trampoline(0x00412C00, 0x00412C05, SetTimeOfDay_r);
+			DrawLandTable_t                 = new Trampoline(0x0043A6A0, 0x0043A6A8, DrawLandTable_r);
+			Direct3D_SetTexList_t           = new Trampoline(0x0077F3D0, 0x0077F3D8, Direct3D_SetTexList_r);
+			SetCurrentStageLights_t         = new Trampoline(0x0040A950, 0x0040A955, SetCurrentStageLights_r);
+			SetCurrentStageLight_EggViper_t = new Trampoline(0x0057E560, 0x0057E567, SetCurrentStageLight_EggViper_r);
+
+			// Material callback hijack
+			WriteJump(reinterpret_cast<void*>(0x0040A340), CorrectMaterial_r);
+		}
+
+		PROFILE_STAGE("FixCharacterMaterials", FixCharacterMaterials());
+		PROFILE_STAGE("FixChaoGardenMaterials", FixChaoGardenMaterials());
+		PROFILE_STAGE("Past_Init", Past_Init());
+		PROFILE_STAGE("SkyDeck_Init", SkyDeck_Init());
+		PROFILE_STAGE("Chaos7_Init", Chaos7_Init());
 
 		// Vertex normal correction for certain objects in
 		// Red Mountain and Sky Deck.
@@ -546,12 +659,16 @@ extern "C"
 
 		NormalScaleMultiplier = { 1.0f, 1.0f, 1.0f };
 
-		polybuff_rewrite_init();
+		PROFILE_STAGE("polybuff_rewrite_init", polybuff_rewrite_init());
+		// Deferred until the Init scope finishes, so that Init itself is complete.
+		PROFILE_REPORT(globals::mod_path + "\\startup_profile.csv");
 	}
 
-#ifdef _DEBUG
 	EXPORT void __cdecl OnFrame()
 	{
+		landtable_prewarm::update();
+
+#ifdef _DEBUG
 		auto pad = ControllerPointers[0];
 		if (pad)
 		{
@@ -581,6 +698,6 @@ extern "C"
 		}
 
 		show_light_direction();
-	}
 #endif
+	}
 }
@@ -0,0 +1,60 @@
+#include "stdafx.h"
+
+#include "palette_atlas.h"
+
+namespace palette_atlas
+{
+	struct ABGR32F
+	{
+		float r, g, b, a;
+	};
+
+	static_assert(sizeof(ABGR32F) == sizeof(float) * 4, "nope");
+
+	static ABGR32F to_float(uint32_t color)
+	{
+		return {
+			static_cast<float>((color >> 16) & 0xFF) / 255.0f,
+			static_cast<float>((color >> 8) & 0xFF) / 255.0f,
+			static_cast<float>(color & 0xFF) / 255.0f,
+			static_cast<float>(color >> 24) / 255.0f
+		};
+	}
+
+	size_t slot_size(bool is_32bit)
+	{
+		return palette_lighting::ROW_SIZE * palette_lighting::ROW_COUNT * (is_32bit ? sizeof(uint32_t) : sizeof(ABGR32F));
+	}
+
+	void write_palette(void* bits, bool is_32bit, const uint32_t* pairs)
+	{
+		constexpr auto width = palette_lighting::ROW_SIZE;
+
+		for (size_t i = 0; i < palette_lighting::ROW_COUNT / 2; i++)
+		{
+			const auto index = i * width;
+			const auto y = 2 * width * i;
+
+			if (is_32bit)
+			{
+				const auto pixels = static_cast<uint32_t*>(bits);
+
+				for (size_t x = 0; x < width; x++)
+				{
+					pixels[y + x]         = pairs[(index + x) * 2];
+					pixels[width + y + x] = pairs[(index + x) * 2 + 1];
+				}
+			}
+			else
+			{
+				const auto pixels = static_cast<ABGR32F*>(bits);
+
+				for (size_t x = 0; x < width; x++)
+				{
+					pixels[y + x]         = to_float(pairs[(index + x) * 2]);
+					pixels[width + y + x] = to_float(pairs[(index + x) * 2 + 1]);
+				}
+			}
+		}
+	}
+}
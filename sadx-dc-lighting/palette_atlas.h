@@ -0,0 +1,56 @@
+#pragma once
+
+// This header is intentionally free of game and Direct3D
+// dependencies so that it can be used and measured headlessly.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "palette_lighting.h"
+
+/*
+ * Writes palettes into the atlas LanternCollection binds to both palette
+ * samplers. The atlas is 256 texels wide with palette_lighting::ROW_COUNT
+ * rows per slot: a diffuse row then a specular row for each of a palette's
+ * 8 palettes. Texels are X8R8G8B8, or four floats (RGBA) on devices
+ * without 32-bit vertex textures.
+ */
+namespace palette_atlas
+{
+	/// Size in bytes of one slot.
+	size_t slot_size(bool is_32bit);
+
+	/// <summary>
+	/// Writes a palette's rows to an atlas, starting at \p bits.
+	/// </summary>
+	/// <param name="pairs">ROW_SIZE * 8 pairs of diffuse and specular D3DCOLORs, laid out like PalettePairs.</param>
+	void write_palette(void* bits, bool is_32bit, const uint32_t* pairs);
+
+	/// <summary>
+	/// Locks the top level of \p texture and writes the palette returned by \p palette for each slot in \p slots.
+	/// Texture and LockedRect are IDirect3DTexture9 and D3DLOCKED_RECT in game, and their mock_device
+	/// counterparts in the tools.
+	/// </summary>
+	/// <returns><c>false</c> if the texture couldn't be locked.</returns>
+	template <typename LockedRect, typename Texture, typename F>
+	bool write_slots(Texture* texture, bool is_32bit, const std::vector<size_t>& slots, F palette)
+	{
+		LockedRect rect;
+
+		if (texture->LockRect(0, &rect, nullptr, 0) < 0)
+		{
+			return false;
+		}
+
+		const size_t size = slot_size(is_32bit);
+
+		for (auto slot : slots)
+		{
+			write_palette(static_cast<uint8_t*>(rect.pBits) + slot * size, is_32bit, palette(slot));
+		}
+
+		texture->UnlockRect(0);
+		return true;
+	}
+}
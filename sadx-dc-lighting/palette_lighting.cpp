@@ -0,0 +1,391 @@
+#include "stdafx.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <future>
+#include <thread>
+#include <vector>
+#include <emmintrin.h>
+
+#include "palette_lighting.h"
+
+namespace palette_lighting
+{
+	// Below this, starting threads costs more than lighting the vertices.
+	static constexpr size_t MIN_VERTICES_PER_THREAD = 4096;
+
+	/// Per-draw values shared by every vertex.
+	struct Prepared
+	{
+		/// Normalized light direction.
+		float light[3];
+		const uint32_t* diffuse_a;
+		const uint32_t* specular_a;
+		const uint32_t* diffuse_b;
+		const uint32_t* specular_b;
+		/// BGRA order, matching the byte order of a D3DCOLOR.
+		float material[4];
+	};
+
+	static const uint32_t* row(const uint32_t* atlas, uint32_t rows, uint32_t index)
+	{
+		return atlas + ROW_SIZE * (std::min<uint32_t>)(index, rows - 1);
+	}
+
+	static Prepared prepare(const Parameters& params)
+	{
+		Prepared result {};
+
+		const auto& l = params.light_direction;
+		const float length = std::sqrt(l[0] * l[0] + l[1] * l[1] + l[2] * l[2]);
+		const float scale  = length > 0.0f ? 1.0f / length : 0.0f;
+
+		for (int i = 0; i < 3; i++)
+		{
+			result.light[i] = l[i] * scale;
+		}
+
+		const auto rows = params.atlas_rows ? params.atlas_rows : static_cast<uint32_t>(ROW_COUNT);
+
+		result.diffuse_a  = row(params.atlas_a, rows, params.diffuse_a);
+		result.specular_a = row(params.atlas_a, rows, params.specular_a);
+
+		const auto atlas_b = params.atlas_b != nullptr ? params.atlas_b : params.atlas_a;
+
+		result.diffuse_b  = row(atlas_b, rows, params.diffuse_b);
+		result.specular_b = row(atlas_b, rows, params.specular_b);
+
+		result.material[0] = params.material_diffuse[2];
+		result.material[1] = params.material_diffuse[1];
+		result.material[2] = params.material_diffuse[0];
+		result.material[3] = params.material_diffuse[3];
+
+		return result;
+	}
+
+	static float clamp_index(float t)
+	{
+		// Written out so NaN goes to 0 the same way as _mm_max_ps.
+		if (!(t > 0.0f))
+		{
+			t = 0.0f;
+		}
+
+		return t < 0.99f ? t : 0.99f;
+	}
+
+	static float saturate(float v)
+	{
+		if (!(v > 0.0f))
+		{
+			v = 0.0f;
+		}
+
+		return v < 1.0f ? v : 1.0f;
+	}
+
+	static uint32_t read_color(const Input& input, const uint8_t* vertex)
+	{
+		if (input.color_offset == NO_COLOR)
+		{
+			return 0;
+		}
+
+		uint32_t color;
+		memcpy(&color, vertex + input.color_offset, sizeof(uint32_t));
+		return color;
+	}
+
+	static void write_colors(const Output& output, size_t i, uint32_t diffuse, uint32_t specular)
+	{
+		const auto vertex = output.data + i * output.stride;
+		memcpy(vertex + output.diffuse_offset, &diffuse, sizeof(uint32_t));
+		memcpy(vertex + output.specular_offset, &specular, sizeof(uint32_t));
+	}
+
+	static void unpack(uint32_t color, float* out)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			out[c] = static_cast<float>((color >> (c * 8)) & 0xFF) / 255.0f;
+		}
+	}
+
+	static uint32_t pack(const float* in)
+	{
+		uint32_t result = 0;
+
+		for (int c = 0; c < 4; c++)
+		{
+			const auto value = static_cast<uint32_t>(saturate(in[c]) * 255.0f + 0.5f);
+			result |= value << (c * 8);
+		}
+
+		return result;
+	}
+
+	void light_reference(const Parameters& params, const Input& input, const Output& output, size_t count)
+	{
+		const auto p = prepare(params);
+		const auto& w = params.world;
+
+		for (size_t v = 0; v < count; v++)
+		{
+			const auto vertex = input.data + v * input.stride;
+
+			float normal[3];
+			memcpy(normal, vertex + input.normal_offset, sizeof(normal));
+
+			// GetDiffuse; all colors here are in BGRA order.
+			const auto vcolor = read_color(input, vertex);
+			float diffuse[4];
+
+			if (params.vertex_color_source && vcolor != 0)
+			{
+				unpack(vcolor, diffuse);
+			}
+			else
+			{
+				memcpy(diffuse, p.material, sizeof(diffuse));
+			}
+
+			if (!params.allow_vertex_color || params.force_default_diffuse)
+			{
+				diffuse[0] = diffuse[1] = diffuse[2] = 1.0f;
+			}
+
+			float scaled[3];
+
+			for (int i = 0; i < 3; i++)
+			{
+				scaled[i] = normal[i] * params.normal_scale[i];
+			}
+
+			float world_normal[3];
+
+			for (int j = 0; j < 3; j++)
+			{
+				world_normal[j] = scaled[0] * w[0][j] + scaled[1] * w[1][j] + scaled[2] * w[2][j];
+			}
+
+			const float dot = p.light[0] * world_normal[0] + p.light[1] * world_normal[1] + p.light[2] * world_normal[2];
+			const float t   = clamp_index(1.0f - (dot + 1.0f) * 0.5f);
+
+			// The shader samples texel floor(t * 255) with point filtering.
+			const auto x = static_cast<size_t>(t * 255.0f);
+
+			float pdiffuse[4];
+			float pspecular[4];
+
+			if (params.diffuse_override)
+			{
+				pdiffuse[0] = params.diffuse_override_color[2];
+				pdiffuse[1] = params.diffuse_override_color[1];
+				pdiffuse[2] = params.diffuse_override_color[0];
+				pdiffuse[3] = 1.0f;
+			}
+			else
+			{
+				unpack(p.diffuse_a[x], pdiffuse);
+			}
+
+			unpack(p.specular_a[x], pspecular);
+
+			if (params.blend)
+			{
+				float bdiffuse[4];
+				float bspecular[4];
+
+				unpack(p.diffuse_b[x], bdiffuse);
+				unpack(p.specular_b[x], bspecular);
+
+				for (int c = 0; c < 4; c++)
+				{
+					pdiffuse[c]  = pdiffuse[c] + (bdiffuse[c] - pdiffuse[c]) * params.blend_diffuse;
+					pspecular[c] = pspecular[c] + (bspecular[c] - pspecular[c]) * params.blend_specular;
+				}
+			}
+
+			float out_diffuse[4];
+			float out_specular[4];
+
+			for (int c = 0; c < 3; c++)
+			{
+				out_diffuse[c]  = diffuse[c] * pdiffuse[c];
+				out_specular[c] = pspecular[c];
+			}
+
+			out_diffuse[3]  = diffuse[3];
+			out_specular[3] = 0.0f;
+
+			write_colors(output, v, pack(out_diffuse), pack(out_specular));
+		}
+	}
+
+	static __m128 unpack_ps(uint32_t color)
+	{
+		const __m128i zero  = _mm_setzero_si128();
+		const __m128i bytes = _mm_cvtsi32_si128(static_cast<int>(color));
+		const __m128i words = _mm_unpacklo_epi8(bytes, zero);
+		return _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(words, zero)), _mm_set1_ps(255.0f));
+	}
+
+	static uint32_t pack_ps(__m128 value)
+	{
+		value = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+		value = _mm_add_ps(_mm_mul_ps(value, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f));
+
+		const __m128i dwords = _mm_cvttps_epi32(value);
+		const __m128i words  = _mm_packs_epi32(dwords, dwords);
+		return static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_packus_epi16(words, words)));
+	}
+
+	// Lights a single vertex whose palette texel has already been computed.
+	static void shade(const Parameters& params, const Prepared& p, const Input& input, const Output& output,
+	                  size_t v, size_t x, __m128 override_color, __m128 rgb_mask)
+	{
+		const auto vertex = input.data + v * input.stride;
+		const auto vcolor = read_color(input, vertex);
+
+		__m128 diffuse = params.vertex_color_source && vcolor != 0 ? unpack_ps(vcolor) : _mm_loadu_ps(p.material);
+
+		if (!params.allow_vertex_color || params.force_default_diffuse)
+		{
+			diffuse = _mm_or_ps(_mm_andnot_ps(rgb_mask, diffuse), _mm_and_ps(rgb_mask, _mm_set1_ps(1.0f)));
+		}
+
+		__m128 pdiffuse  = params.diffuse_override ? override_color : unpack_ps(p.diffuse_a[x]);
+		__m128 pspecular = unpack_ps(p.specular_a[x]);
+
+		if (params.blend)
+		{
+			const __m128 bdiffuse  = unpack_ps(p.diffuse_b[x]);
+			const __m128 bspecular = unpack_ps(p.specular_b[x]);
+
+			pdiffuse  = _mm_add_ps(pdiffuse, _mm_mul_ps(_mm_sub_ps(bdiffuse, pdiffuse), _mm_set1_ps(params.blend_diffuse)));
+			pspecular = _mm_add_ps(pspecular, _mm_mul_ps(_mm_sub_ps(bspecular, pspecular), _mm_set1_ps(params.blend_specular)));
+		}
+
+		// Alpha comes from the diffuse color for diffuse, and is 0 for specular.
+		const __m128 out_diffuse  = _mm_or_ps(_mm_and_ps(rgb_mask, _mm_mul_ps(diffuse, pdiffuse)), _mm_andnot_ps(rgb_mask, diffuse));
+		const __m128 out_specular = _mm_and_ps(rgb_mask, pspecular);
+
+		write_colors(output, v, pack_ps(out_diffuse), pack_ps(out_specular));
+	}
+
+	void light(const Parameters& params, const Input& input, const Output& output, size_t count)
+	{
+		const auto p = prepare(params);
+		const auto& w = params.world;
+
+		const __m128 rgb_mask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+		const __m128 override_color = _mm_set_ps(1.0f, params.diffuse_override_color[0],
+		                                         params.diffuse_override_color[1], params.diffuse_override_color[2]);
+
+		const __m128 sx = _mm_set1_ps(params.normal_scale[0]);
+		const __m128 sy = _mm_set1_ps(params.normal_scale[1]);
+		const __m128 sz = _mm_set1_ps(params.normal_scale[2]);
+
+		const __m128 lx = _mm_set1_ps(p.light[0]);
+		const __m128 ly = _mm_set1_ps(p.light[1]);
+		const __m128 lz = _mm_set1_ps(p.light[2]);
+
+		const __m128 one  = _mm_set1_ps(1.0f);
+		const __m128 half = _mm_set1_ps(0.5f);
+		const __m128 ceiling = _mm_set1_ps(0.99f);
+		const __m128 size = _mm_set1_ps(255.0f);
+
+		const size_t blocks = count / 4 * 4;
+
+		for (size_t v = 0; v < blocks; v += 4)
+		{
+			alignas(16) float n[3][4];
+
+			for (size_t i = 0; i < 4; i++)
+			{
+				const auto normal = reinterpret_cast<const float*>(input.data + (v + i) * input.stride + input.normal_offset);
+
+				n[0][i] = normal[0];
+				n[1][i] = normal[1];
+				n[2][i] = normal[2];
+			}
+
+			// Same order of operations as the reference so both pick the same texel.
+			const __m128 nx = _mm_mul_ps(_mm_load_ps(n[0]), sx);
+			const __m128 ny = _mm_mul_ps(_mm_load_ps(n[1]), sy);
+			const __m128 nz = _mm_mul_ps(_mm_load_ps(n[2]), sz);
+
+			__m128 world[3];
+
+			for (int j = 0; j < 3; j++)
+			{
+				world[j] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, _mm_set1_ps(w[0][j])),
+				                                 _mm_mul_ps(ny, _mm_set1_ps(w[1][j]))),
+				                      _mm_mul_ps(nz, _mm_set1_ps(w[2][j])));
+			}
+
+			const __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(lx, world[0]), _mm_mul_ps(ly, world[1])),
+			                              _mm_mul_ps(lz, world[2]));
+
+			__m128 t = _mm_sub_ps(one, _mm_mul_ps(_mm_add_ps(dot, one), half));
+			t = _mm_min_ps(_mm_max_ps(t, _mm_setzero_ps()), ceiling);
+
+			alignas(16) int32_t x[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(x), _mm_cvttps_epi32(_mm_mul_ps(t, size)));
+
+			for (size_t i = 0; i < 4; i++)
+			{
+				shade(params, p, input, output, v + i, static_cast<size_t>(x[i]), override_color, rgb_mask);
+			}
+		}
+
+		if (blocks < count)
+		{
+			const Input tail_input = { input.data + blocks * input.stride, input.stride, input.normal_offset, input.color_offset };
+			const Output tail_output = { output.data + blocks * output.stride, output.stride, output.diffuse_offset, output.specular_offset };
+
+			light_reference(params, tail_input, tail_output, count - blocks);
+		}
+	}
+
+	size_t light_parallel(const Parameters& params, const Input& input, const Output& output, size_t count)
+	{
+		const size_t hardware = (std::max<size_t>)(std::thread::hardware_concurrency(), 1);
+		const size_t threads  = (std::min)(hardware, count / MIN_VERTICES_PER_THREAD);
+
+		if (threads < 2)
+		{
+			light(params, input, output, count);
+			return 1;
+		}
+
+		// Chunks are kept to multiples of 4 so only the last one has a scalar tail.
+		const size_t chunk = (count / threads + 3) / 4 * 4;
+
+		std::vector<std::future<void>> workers;
+		workers.reserve(threads - 1);
+
+		size_t start = 0;
+
+		for (size_t i = 0; i + 1 < threads && start + chunk < count; i++, start += chunk)
+		{
+			const Input chunk_input = { input.data + start * input.stride, input.stride, input.normal_offset, input.color_offset };
+			const Output chunk_output = { output.data + start * output.stride, output.stride, output.diffuse_offset, output.specular_offset };
+
+			workers.push_back(std::async(std::launch::async, light, std::cref(params), chunk_input, chunk_output, chunk));
+		}
+
+		const Input last_input = { input.data + start * input.stride, input.stride, input.normal_offset, input.color_offset };
+		const Output last_output = { output.data + start * output.stride, output.stride, output.diffuse_offset, output.specular_offset };
+
+		light(params, last_input, last_output, count - start);
+
+		for (auto& worker : workers)
+		{
+			worker.get();
+		}
+
+		return workers.size() + 1;
+	}
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+// This header is intentionally free of game and Direct3D
+// dependencies so that it can be used and measured headlessly.
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * CPU evaluation of the palette lighting done by vs_main in lantern.hlsl,
+ * for devices which can't sample textures from the vertex shader.
+ * Colors are packed as D3DCOLOR (0xAARRGGBB).
+ */
+namespace palette_lighting
+{
+	/// Texels per palette row.
+	constexpr size_t ROW_SIZE = 256;
+	/// Rows per palette in an atlas: a diffuse and a specular row for each of its 8 palettes.
+	constexpr size_t ROW_COUNT = 16;
+
+	/// Everything vs_main reads from shader constants to light a vertex.
+	struct Parameters
+	{
+		/// Upper 3x3 of the row-major world matrix.
+		float world[3][3];
+		float normal_scale[3];
+		/// Light direction. Doesn't need to be normalized.
+		float light_direction[3];
+
+		/// Palette atlas (ROW_SIZE * atlas_rows texels) for the primary and secondary palettes.
+		const uint32_t* atlas_a;
+		const uint32_t* atlas_b;
+		/// Rows in each atlas; a multiple of ROW_COUNT. 0 is treated as ROW_COUNT.
+		uint32_t atlas_rows;
+
+		/// Atlas rows, as selected by the Indices parameter.
+		uint32_t diffuse_a, specular_a, diffuse_b, specular_b;
+
+		/// Lerps towards the secondary palette. Ignored when \c blend is false.
+		bool blend;
+		float blend_diffuse;
+		float blend_specular;
+
+		/// Vertex colors are used when non-zero, otherwise \c material_diffuse.
+		bool vertex_color_source;
+		/// RGBA in [0, 1].
+		float material_diffuse[4];
+		bool allow_vertex_color;
+		bool force_default_diffuse;
+
+		/// Replaces the diffuse palette color.
+		bool diffuse_override;
+		float diffuse_override_color[3];
+	};
+
+	/// Strided vertex input. Normals are three floats.
+	struct Input
+	{
+		const uint8_t* data;
+		size_t stride;
+		size_t normal_offset;
+		/// Offset of the vertex color, or \c NO_COLOR if the vertices have none.
+		size_t color_offset;
+	};
+
+	constexpr size_t NO_COLOR = ~static_cast<size_t>(0);
+
+	/// Strided output of lit diffuse and specular colors.
+	struct Output
+	{
+		uint8_t* data;
+		size_t stride;
+		size_t diffuse_offset;
+		size_t specular_offset;
+	};
+
+	/// Scalar port of the shader math, kept as the reference for \c light.
+	void light_reference(const Parameters& params, const Input& input, const Output& output, size_t count);
+
+	/// Same results as \c light_reference, four vertices at a time.
+	void light(const Parameters& params, const Input& input, const Output& output, size_t count);
+
+	/// <summary>
+	/// Splits \c light across worker threads once there are enough vertices to make it worthwhile.
+	/// </summary>
+	/// <returns>The number of threads used.</returns>
+	size_t light_parallel(const Parameters& params, const Input& input, const Output& output, size_t count);
+}
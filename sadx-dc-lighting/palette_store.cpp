@@ -0,0 +1,156 @@
+#include "stdafx.h"
+
+#include <cstring>
+#include <vector>
+
+#include "palette_store.h"
+
+namespace palette_store
+{
+	struct PaletteEntry
+	{
+		uint64_t hash;
+		PalettePool::Ref palette;
+	};
+
+	struct SourceEntry
+	{
+		uint64_t hash;
+		SourcePool::Ref source;
+	};
+
+	// Only a handful of distinct palettes are ever held at once, so these are searched linearly.
+	static std::vector<PaletteEntry> palette_entries;
+	static std::vector<SourceEntry> source_entries;
+	static LanternPaletteStats stats_ {};
+
+	// Intentionally never destroyed: instances in static storage may outlive them otherwise.
+	PalettePool& palettes()
+	{
+		static auto pool = new PalettePool;
+		return *pool;
+	}
+
+	SourcePool& sources()
+	{
+		static auto pool = new SourcePool;
+		return *pool;
+	}
+
+	const PalettePool::Ref& empty_palette()
+	{
+		static const auto empty = palettes().acquire();
+		return empty;
+	}
+
+	const SourcePool::Ref& empty_source()
+	{
+		static const auto empty = sources().acquire();
+		return empty;
+	}
+
+	// 64-bit FNV-1a over 32-bit words.
+	template <typename T>
+	static uint64_t fingerprint(const T& value)
+	{
+		static_assert(sizeof(T) % sizeof(uint32_t) == 0, "fingerprinted data must be a whole number of words");
+
+		const auto words = reinterpret_cast<const uint32_t*>(&value);
+		uint64_t hash = 14695981039346656037ull;
+
+		for (size_t i = 0; i < sizeof(T) / sizeof(uint32_t); ++i)
+		{
+			hash = (hash ^ words[i]) * 1099511628211ull;
+		}
+
+		return hash;
+	}
+
+	template <typename Entry, typename Ref, typename Get>
+	static Ref intern(std::vector<Entry>& entries, Ref ref, uint32_t& dedupes, Get get)
+	{
+		const auto hash = fingerprint(*ref);
+
+		for (auto& entry : entries)
+		{
+			const auto& stored = get(entry);
+
+			if (entry.hash == hash && (stored.shares(ref) || !memcmp(&*stored, &*ref, sizeof(*ref))))
+			{
+				if (!stored.shares(ref))
+				{
+					++dedupes;
+				}
+
+				return stored;
+			}
+		}
+
+		entries.push_back({ hash, ref });
+		return ref;
+	}
+
+	PalettePool::Ref intern(PalettePool::Ref palette)
+	{
+		++stats_.palette_loads;
+		prune();
+
+		return intern(palette_entries, std::move(palette), stats_.palette_dedupes,
+		              [](const PaletteEntry& e) -> const PalettePool::Ref& { return e.palette; });
+	}
+
+	SourcePool::Ref intern(SourcePool::Ref source)
+	{
+		++stats_.source_loads;
+		prune();
+
+		return intern(source_entries, std::move(source), stats_.source_dedupes,
+		              [](const SourceEntry& e) -> const SourcePool::Ref& { return e.source; });
+	}
+
+	void count_atlas_update(size_t written, size_t shared)
+	{
+		stats_.atlases_generated += static_cast<uint32_t>(written);
+		stats_.atlases_shared    += static_cast<uint32_t>(shared);
+	}
+
+	void prune()
+	{
+		for (auto it = palette_entries.begin(); it != palette_entries.end();)
+		{
+			if (it->palette.refs() == 1)
+			{
+				it = palette_entries.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+
+		for (auto it = source_entries.begin(); it != source_entries.end();)
+		{
+			if (it->source.refs() == 1)
+			{
+				it = source_entries.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+
+	void clear()
+	{
+		palette_entries.clear();
+		source_entries.clear();
+	}
+
+	const LanternPaletteStats& stats()
+	{
+		stats_.unique_palettes = static_cast<uint32_t>(palette_entries.size());
+		stats_.unique_sources  = static_cast<uint32_t>(source_entries.size());
+		return stats_;
+	}
+}
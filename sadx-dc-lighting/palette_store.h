@@ -0,0 +1,47 @@
+#pragma once
+
+#include "lantern.h"
+#include "../include/lanternapi.h"
+
+/*
+ * Owns the pools LanternInstance palette and source light data come
+ * from, and deduplicates that data by content: loaded data is hashed,
+ * and if identical data is already held by another instance, the new
+ * block is dropped in favor of the existing one. Since the combined
+ * atlas has a slot per distinct block, instances with identical
+ * palettes also share their rows of the atlas.
+ *
+ * Stored blocks are never written to; loading new data always
+ * acquires a new block and interns it. Entries are dropped by prune
+ * once nothing but the store references them.
+ */
+namespace palette_store
+{
+	PalettePool& palettes();
+	SourcePool& sources();
+
+	/// Shared by every instance which has yet to load a palette.
+	const PalettePool::Ref& empty_palette();
+	/// Shared by every instance which has yet to load a source file.
+	const SourcePool::Ref& empty_source();
+
+	/// <summary>
+	/// Returns the stored block with the same content as <paramref name="palette"/>,
+	/// storing <paramref name="palette"/> if there is none.
+	/// </summary>
+	PalettePool::Ref intern(PalettePool::Ref palette);
+	/// <summary>
+	/// Returns the stored block with the same content as <paramref name="source"/>,
+	/// storing <paramref name="source"/> if there is none.
+	/// </summary>
+	SourcePool::Ref intern(SourcePool::Ref source);
+
+	/// Counts an update of the combined atlas which wrote \p written palettes, with \p shared instances sharing another's slot.
+	void count_atlas_update(size_t written, size_t shared);
+
+	/// Drops palettes and sources which are no longer referenced outside of the store.
+	void prune();
+	void clear();
+
+	const LanternPaletteStats& stats();
+}
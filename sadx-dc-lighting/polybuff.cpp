@@ -2,8 +2,15 @@
 
 #include "polybuff.h"
 #include "d3d.h"
+#include "polybuff_cache.h"
+#include "polybuff_indexed.h"
+#include "polybuff_kernels.h"
+#include "timeline.h"
 
 #include <SADXModLoader.h>
+#include <algorithm>
+#include <cstddef>
+#include <vector>
 
 /*
  * Despite having designated polybuff drawing functions
@@ -17,6 +24,10 @@
  *
  * The code below re-implements the functions to handle the
  * secondary case CORRECTLY and use the mesh-provided vcolors.
+ *
+ * The straightforward re-implementations are kept as a reference
+ * and fallback. The SSE2 versions further below assemble whole
+ * vertices in registers and must produce identical output.
  */
 
 DataPointer(NJS_COLOR, PolyBuffVertexColor, 0x03D0848C);
@@ -42,6 +53,8 @@ enum RenderFlags_
 
 void __cdecl polybuff_vcolor_strip_r(NJS_MESHSET_SADX* meshset, NJS_POINT3* points)
 {
+	TIMELINE_SCOPE("polybuff_vcolor_strip");
+
 	NJS_COLOR v6; // edi
 
 	Sint16* meshes = meshset->meshes;
@@ -146,6 +159,8 @@ void __cdecl polybuff_vcolor_strip_r(NJS_MESHSET_SADX* meshset, NJS_POINT3* poin
 
 void __cdecl polybuff_vcolor_tri_r(NJS_MESHSET_SADX* meshset, NJS_POINT3* points)
 {
+	TIMELINE_SCOPE("polybuff_vcolor_tri");
+
 	NJS_COLOR v5; // edi
 	FVFStruct_F* v9; // edx
 	float v10; // ecx
@@ -200,6 +215,8 @@ void __cdecl polybuff_vcolor_tri_r(NJS_MESHSET_SADX* meshset, NJS_POINT3* points
 
 void __cdecl polybuff_normal_vcolor_strip_r(NJS_MESHSET_SADX* meshset, NJS_POINT3* points, NJS_VECTOR* normals)
 {
+	TIMELINE_SCOPE("polybuff_normal_vcolor_strip");
+
 	NJS_COLOR v6; // edi
 
 	Sint16* meshes = meshset->meshes;
@@ -316,6 +333,8 @@ void __cdecl polybuff_normal_vcolor_strip_r(NJS_MESHSET_SADX* meshset, NJS_POINT
 
 void __cdecl polybuff_normal_vcolor_tri_r(NJS_MESHSET_SADX* meshset, NJS_POINT3* points, NJS_VECTOR* normals)
 {
+	TIMELINE_SCOPE("polybuff_normal_vcolor_tri");
+
 	NJS_COLOR v6; // edi
 
 	Sint16* meshes = meshset->meshes;
@@ -382,6 +401,8 @@ void __cdecl polybuff_normal_vcolor_tri_r(NJS_MESHSET_SADX* meshset, NJS_POINT3*
 
 void __cdecl polybuff_normal_vcolor_uv_strip_r(NJS_MESHSET_SADX* meshset, NJS_POINT3* points, NJS_VECTOR* normals)
 {
+	TIMELINE_SCOPE("polybuff_normal_vcolor_uv_strip");
+
 	NJS_COLOR v3; // ebp
 	NJS_TEX* uv; // esi
 	Sint16* meshes; // edi
@@ -543,6 +564,8 @@ void __cdecl polybuff_normal_vcolor_uv_strip_r(NJS_MESHSET_SADX* meshset, NJS_PO
 
 void __cdecl polybuff_normal_vcolor_uv_tri_r(NJS_MESHSET* a1, NJS_POINT3* points, NJS_VECTOR* normals)
 {
+	TIMELINE_SCOPE("polybuff_normal_vcolor_uv_tri");
+
 	NJS_COLOR v18; // [esp+10h] [ebp-8h]
 
 	int v3 = Direct3D_CurrentCullMode;
@@ -615,8 +638,222 @@ void __cdecl polybuff_normal_vcolor_uv_tri_r(NJS_MESHSET* a1, NJS_POINT3* points
 	PolyBuff_DrawTriangleList(&stru_3D0FF20);
 }
 
+/*
+ * SSE2 vertex assembly. The kernels are in polybuff_kernels.h
+ * so that they can be checked against the scalar reference headlessly.
+ */
+
+using polybuff_kernels::UvScale;
+using polybuff_kernels::VertexSource;
+using polybuff_kernels::VertexF;
+using polybuff_kernels::VertexG;
+using polybuff_kernels::VertexI;
+using polybuff_kernels::assemble_list;
+using polybuff_kernels::assemble_indexed_strips;
+using polybuff_kernels::assemble_strips;
+using polybuff_kernels::fingerprint;
+using polybuff_kernels::strip_vertex_count;
+using polybuff_kernels::write_vertex;
+
+static_assert(sizeof(polybuff_kernels::Vector) == sizeof(NJS_VECTOR) && sizeof(polybuff_kernels::Tex) == sizeof(NJS_TEX),
+              "vector layout mismatch");
+static_assert(sizeof(VertexF) == sizeof(FVFStruct_F) && offsetof(VertexF, diffuse) == offsetof(FVFStruct_F, diffuse),
+              "FVFStruct_F layout mismatch");
+static_assert(sizeof(VertexG) == sizeof(FVFStruct_G) && offsetof(VertexG, diffuse) == offsetof(FVFStruct_G, diffuse),
+              "FVFStruct_G layout mismatch");
+static_assert(sizeof(VertexI) == sizeof(FVFStruct_I) && offsetof(VertexI, u) == offsetof(FVFStruct_I, u),
+              "FVFStruct_I layout mismatch");
+
+static VertexSource make_source(const NJS_POINT3* points, const NJS_VECTOR* normals, const NJS_TEX* uv,
+                                const NJS_COLOR* vertcolor, const NJS_COLOR& global)
+{
+	return polybuff_kernels::make_source(reinterpret_cast<const polybuff_kernels::Vector*>(points),
+	                                     reinterpret_cast<const polybuff_kernels::Vector*>(normals),
+	                                     reinterpret_cast<const polybuff_kernels::Tex*>(uv),
+	                                     reinterpret_cast<const uint32_t*>(vertcolor),
+	                                     global.color);
+}
+
+static polybuff_kernels::VertexDeduplicator deduplicator;
+
+template <UvScale scale, typename T>
+static void draw_strips(PolyBuff& polybuff, const void* key, const Sint16* meshes, int strip_count, const VertexSource& src)
+{
+	const int count = strip_vertex_count(meshes, strip_count);
+
+	if (polybuff.Stride == sizeof(T))
+	{
+		const uint64_t hash = fingerprint(meshes, true, strip_count, count - 2 * strip_count, src, scale);
+
+		if (polybuff_cache::draw(key, hash, polybuff, D3DPT_TRIANGLESTRIP))
+		{
+			return;
+		}
+
+		auto cached = static_cast<T*>(polybuff_cache::begin_insert(key, hash, polybuff, count));
+
+		if (cached)
+		{
+			assemble_strips<scale>(cached, meshes, strip_count, src);
+			polybuff_cache::end_insert(key, polybuff, D3DPT_TRIANGLESTRIP);
+			return;
+		}
+
+		// Streams which aren't cached are drawn indexed to reduce upload size,
+		// as long as the vertices are addressable with 16-bit indices.
+		const int vertex_count = count - 2 * strip_count;
+
+		T* vertices       = nullptr;
+		uint16_t* indices = nullptr;
+
+		if (vertex_count <= 0xFFFF && polybuff_indexed::begin(sizeof(T), vertex_count, count,
+		                                                      reinterpret_cast<void**>(&vertices), &indices))
+		{
+			const auto unique = assemble_indexed_strips<scale>(deduplicator, vertices, indices, meshes, strip_count, vertex_count, src);
+			polybuff_indexed::end(polybuff, unique, count);
+			return;
+		}
+	}
+
+	PolyBuff_SetCurrent(&polybuff);
+	auto buffer = (T*)PolyBuff_LockTriangleStrip(&polybuff, count, Direct3D_CurrentCullMode);
+
+	if (buffer)
+	{
+		assemble_strips<scale>(buffer, meshes, strip_count, src);
+	}
+
+	PolyBuff_Unlock(&polybuff);
+	PolyBuff_DrawTriangleStrip(&polybuff);
+}
+
+template <UvScale scale, typename T>
+static void draw_list(PolyBuff& polybuff, const void* key, const Sint16* meshes, int triangle_count, const VertexSource& src)
+{
+	const unsigned int count = 3 * triangle_count;
+
+	if (polybuff.Stride == sizeof(T))
+	{
+		const uint64_t hash = fingerprint(meshes, false, triangle_count, count, src, scale);
+
+		if (polybuff_cache::draw(key, hash, polybuff, D3DPT_TRIANGLELIST))
+		{
+			return;
+		}
+
+		auto cached = static_cast<T*>(polybuff_cache::begin_insert(key, hash, polybuff, count));
+
+		if (cached)
+		{
+			assemble_list<scale>(cached, meshes, count, src);
+			polybuff_cache::end_insert(key, polybuff, D3DPT_TRIANGLELIST);
+			return;
+		}
+	}
+
+	PolyBuff_SetCurrent(&polybuff);
+	auto buffer = (T*)PolyBuff_LockTriangleList(&polybuff, count, Direct3D_CurrentCullMode);
+
+	if (buffer)
+	{
+		assemble_list<scale>(buffer, meshes, count, src);
+	}
+
+	PolyBuff_Unlock(&polybuff);
+	PolyBuff_DrawTriangleList(&polybuff);
+}
+
+static const NJS_COLOR* select_vertcolor(const NJS_COLOR* vertcolor)
+{
+	return LastRenderFlags & RenderFlags_OffsetMaterial ? nullptr : vertcolor;
+}
+
+void __cdecl polybuff_vcolor_strip_sse2(NJS_MESHSET_SADX* meshset, NJS_POINT3* points)
+{
+	TIMELINE_SCOPE("polybuff_vcolor_strip");
+
+	const NJS_COLOR color = PolyBuffVertexColor;
+	const auto src = make_source(points, nullptr, nullptr, select_vertcolor(meshset->vertcolor), color);
+	draw_strips<UvScale::Multiply, VertexF>(stru_3D0FEB4, meshset, meshset->meshes, meshset->nbMesh, src);
+}
+
+void __cdecl polybuff_vcolor_tri_sse2(NJS_MESHSET_SADX* meshset, NJS_POINT3* points)
+{
+	TIMELINE_SCOPE("polybuff_vcolor_tri");
+
+	const NJS_COLOR color = PolyBuffVertexColor;
+	const auto src = make_source(points, nullptr, nullptr, select_vertcolor(meshset->vertcolor), color);
+	draw_list<UvScale::Multiply, VertexF>(stru_3D0FEB4, meshset, meshset->meshes, meshset->nbMesh, src);
+}
+
+void __cdecl polybuff_normal_vcolor_strip_sse2(NJS_MESHSET_SADX* meshset, NJS_POINT3* points, NJS_VECTOR* normals)
+{
+	TIMELINE_SCOPE("polybuff_normal_vcolor_strip");
+
+	const NJS_COLOR color = PolyBuffVertexColor;
+	const auto src = make_source(points, normals, nullptr, select_vertcolor(meshset->vertcolor), color);
+	draw_strips<UvScale::Multiply, VertexG>(stru_3D0FED8, meshset, meshset->meshes, meshset->nbMesh, src);
+}
+
+void __cdecl polybuff_normal_vcolor_tri_sse2(NJS_MESHSET_SADX* meshset, NJS_POINT3* points, NJS_VECTOR* normals)
+{
+	TIMELINE_SCOPE("polybuff_normal_vcolor_tri");
+
+	const NJS_COLOR color = PolyBuffVertexColor;
+	const auto src = make_source(points, normals, nullptr, select_vertcolor(meshset->vertcolor), color);
+	draw_list<UvScale::Multiply, VertexG>(stru_3D0FED8, meshset, meshset->meshes, meshset->nbMesh, src);
+}
+
+void __cdecl polybuff_normal_vcolor_uv_strip_sse2(NJS_MESHSET_SADX* meshset, NJS_POINT3* points, NJS_VECTOR* normals)
+{
+	TIMELINE_SCOPE("polybuff_normal_vcolor_uv_strip");
+
+	const NJS_COLOR color = PolyBuffVertexColor;
+	const auto vertcolor = select_vertcolor(meshset->vertcolor);
+	const auto src = make_source(points, normals, meshset->vertuv, vertcolor, color);
+
+	// The two paths of the reference implementation scale UVs differently.
+	if (vertcolor == nullptr)
+	{
+		draw_strips<UvScale::Multiply, VertexI>(stru_3D0FF20, meshset, meshset->meshes, meshset->nbMesh, src);
+	}
+	else
+	{
+		draw_strips<UvScale::Divide, VertexI>(stru_3D0FF20, meshset, meshset->meshes, meshset->nbMesh, src);
+	}
+}
+
+void __cdecl polybuff_normal_vcolor_uv_tri_sse2(NJS_MESHSET* meshset, NJS_POINT3* points, NJS_VECTOR* normals)
+{
+	TIMELINE_SCOPE("polybuff_normal_vcolor_uv_tri");
+
+	const NJS_COLOR color = PolyBuffVertexColor;
+
+	// Unlike the other variants, the reference implementation only uses the global
+	// vertex color when the mesh *has* vertex colors. Without them, it would
+	// dereference a null pointer, so the global color is used instead.
+	const bool global = LastRenderFlags & RenderFlags_OffsetMaterial && meshset->vertcolor;
+	const auto src = make_source(points, normals, meshset->vertuv, global ? nullptr : meshset->vertcolor, color);
+	draw_list<UvScale::Multiply, VertexI>(stru_3D0FF20, meshset, meshset->meshes, meshset->nbMesh, src);
+}
+
 void polybuff_rewrite_init()
 {
+	// SSE2 is all but guaranteed, but the reference implementations
+	// are still used if it isn't available for whatever reason.
+	if (IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE))
+	{
+		PrintDebug("[lantern] Using SSE2 polybuff vertex assembly.\n");
+
+		WriteJump(polybuff_vcolor_strip, polybuff_vcolor_strip_sse2);
+		WriteJump(polybuff_vcolor_tri, polybuff_vcolor_tri_sse2);
+		WriteJump(polybuff_normal_vcolor_strip, polybuff_normal_vcolor_strip_sse2);
+		WriteJump(polybuff_normal_vcolor_tri, polybuff_normal_vcolor_tri_sse2);
+		WriteJump(polybuff_normal_vcolor_uv_strip, polybuff_normal_vcolor_uv_strip_sse2);
+		WriteJump(polybuff_normal_vcolor_uv_tri, polybuff_normal_vcolor_uv_tri_sse2);
+		return;
+	}
+
 	WriteJump(polybuff_vcolor_strip, polybuff_vcolor_strip_r);
 	WriteJump(polybuff_vcolor_tri, polybuff_vcolor_tri_r);
 	WriteJump(polybuff_normal_vcolor_strip, polybuff_normal_vcolor_strip_r);
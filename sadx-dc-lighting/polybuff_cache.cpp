@@ -0,0 +1,212 @@
+#include "stdafx.h"
+
+#include <array>
+#include <unordered_map>
+
+#include <SADXModLoader.h>
+
+#include "polybuff_cache.h"
+
+namespace polybuff_cache
+{
+	// 4 MiB in total.
+	static constexpr size_t RING_SIZE   = 4;
+	static constexpr UINT   BUFFER_SIZE = 1 << 20;
+
+	struct Buffer
+	{
+		Direct3DVertexBuffer8* vertex_buffer;
+		UINT used;
+		uint32_t generation;
+	};
+
+	struct Entry
+	{
+		uint64_t fingerprint;
+		bool cached;
+		uint32_t buffer;
+		uint32_t generation;
+		uint32_t start_vertex;
+		uint32_t count;
+		uint32_t stride;
+	};
+
+	static std::array<Buffer, RING_SIZE> ring {};
+	static uint32_t current = 0;
+
+	static std::unordered_map<const void*, Entry> entries;
+	static Buffer* locked = nullptr;
+
+	static Stats stats_ {};
+
+	static bool valid(const Entry& entry)
+	{
+		return entry.cached && ring[entry.buffer].generation == entry.generation;
+	}
+
+	/// Advances the ring, evicting everything stored in the next buffer.
+	static void advance()
+	{
+		current = (current + 1) % RING_SIZE;
+
+		auto& buffer = ring[current];
+		buffer.used = 0;
+		++buffer.generation;
+		++stats_.evictions;
+	}
+
+	static bool allocate(uint32_t stride, uint32_t count, uint32_t& start_vertex)
+	{
+		const UINT size = stride * count;
+
+		if (!size || size > BUFFER_SIZE)
+		{
+			return false;
+		}
+
+		// Streams must start on a multiple of their stride
+		// since they're drawn with a starting vertex.
+		UINT offset = (ring[current].used + stride - 1) / stride * stride;
+
+		if (offset + size > BUFFER_SIZE)
+		{
+			advance();
+			offset = 0;
+		}
+
+		auto& buffer = ring[current];
+
+		if (buffer.vertex_buffer == nullptr)
+		{
+			const auto result = Direct3D_Device->CreateVertexBuffer(BUFFER_SIZE, D3DUSAGE_WRITEONLY, 0,
+			                                                        D3DPOOL_MANAGED, &buffer.vertex_buffer);
+
+			if (FAILED(result))
+			{
+				buffer.vertex_buffer = nullptr;
+				return false;
+			}
+		}
+
+		buffer.used  = offset + size;
+		start_vertex = offset / stride;
+		return true;
+	}
+
+	static void draw_entry(const Entry& entry, PolyBuff& polybuff, D3DPRIMITIVETYPE type)
+	{
+		const UINT primitives = type == D3DPT_TRIANGLESTRIP ? entry.count - 2 : entry.count / 3;
+		const auto vertex_buffer = ring[entry.buffer].vertex_buffer;
+
+		d3d::draw_polybuff(polybuff, type, primitives, [&]
+		{
+			Direct3D_Device->SetVertexShader(polybuff.FVF);
+			Direct3D_Device->SetStreamSource(0, vertex_buffer, entry.stride);
+			Direct3D_Device->DrawPrimitive(type, entry.start_vertex, primitives);
+
+			// Restore the polybuff's own stream in case the game
+			// assumes it's still bound from a previous draw.
+			Direct3D_Device->SetStreamSource(0, polybuff.pStreamData, polybuff.Stride);
+		});
+	}
+
+	bool draw(const void* key, uint64_t fingerprint, PolyBuff& polybuff, D3DPRIMITIVETYPE type)
+	{
+		const auto it = entries.find(key);
+
+		if (it == entries.end() || it->second.fingerprint != fingerprint
+		    || it->second.stride != polybuff.Stride || !valid(it->second))
+		{
+			++stats_.misses;
+			return false;
+		}
+
+		const auto& entry = it->second;
+		draw_entry(entry, polybuff, type);
+
+		++stats_.hits;
+		stats_.bytes_saved += entry.count * entry.stride;
+		return true;
+	}
+
+	void* begin_insert(const void* key, uint64_t fingerprint, const PolyBuff& polybuff, uint32_t count)
+	{
+		auto& entry = entries[key];
+
+		// The first time a fingerprint is seen, it's only recorded.
+		if (entry.fingerprint != fingerprint || !entry.count)
+		{
+			entry = { fingerprint, false, 0, 0, 0, count, polybuff.Stride };
+			return nullptr;
+		}
+
+		if (entry.count != count || !allocate(polybuff.Stride, count, entry.start_vertex))
+		{
+			return nullptr;
+		}
+
+		auto& buffer = ring[current];
+		BYTE* data   = nullptr;
+
+		const UINT offset = entry.start_vertex * polybuff.Stride;
+
+		if (FAILED(buffer.vertex_buffer->Lock(offset, count * polybuff.Stride, &data, 0)))
+		{
+			return nullptr;
+		}
+
+		entry.cached     = true;
+		entry.buffer     = current;
+		entry.generation = buffer.generation;
+		entry.stride     = polybuff.Stride;
+
+		locked = &buffer;
+		++stats_.inserts;
+		return data;
+	}
+
+	void end_insert(const void* key, PolyBuff& polybuff, D3DPRIMITIVETYPE type)
+	{
+		if (locked == nullptr)
+		{
+			return;
+		}
+
+		locked->vertex_buffer->Unlock();
+		locked = nullptr;
+
+		draw_entry(entries[key], polybuff, type);
+	}
+
+	void clear()
+	{
+		if (stats_.hits || stats_.misses)
+		{
+			PrintDebug("[lantern] Polybuff cache: %u hits, %u misses (%.1f%%), %u inserts, %u evictions, %u KB saved\n",
+			           stats_.hits, stats_.misses, hit_rate() * 100.0f, stats_.inserts, stats_.evictions,
+			           stats_.bytes_saved / 1024);
+		}
+
+		entries.clear();
+
+		for (auto& buffer : ring)
+		{
+			buffer.used = 0;
+			++buffer.generation;
+		}
+
+		current = 0;
+		stats_  = {};
+	}
+
+	const Stats& stats()
+	{
+		return stats_;
+	}
+
+	float hit_rate()
+	{
+		const auto total = stats_.hits + stats_.misses;
+		return total ? static_cast<float>(stats_.hits) / static_cast<float>(total) : 0.0f;
+	}
+}
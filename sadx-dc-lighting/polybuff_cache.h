@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include "d3d.h"
+
+/*
+ * Keeps converted polybuff vertex streams in a ring of persistent
+ * vertex buffers so that meshsets which don't change between frames
+ * can skip conversion and upload entirely.
+ *
+ * Streams are keyed by meshset and a fingerprint of their contents.
+ * A stream is only cached once it has been seen unchanged twice so
+ * that meshsets which change every frame don't churn the ring.
+ */
+namespace polybuff_cache
+{
+	struct Stats
+	{
+		size_t hits;
+		size_t misses;
+		size_t inserts;
+		size_t evictions;
+		/// Vertex bytes which didn't have to be converted and uploaded.
+		size_t bytes_saved;
+	};
+
+	/// <summary>
+	/// Draws the cached stream for the specified meshset if one exists with a matching fingerprint.
+	/// </summary>
+	/// <param name="key">The meshset being drawn.</param>
+	/// <param name="fingerprint">Fingerprint of the meshset's vertex data.</param>
+	/// <param name="polybuff">The polybuff the stream would otherwise be written to.</param>
+	/// <param name="type">The primitive type to draw.</param>
+	/// <returns><c>true</c> if the stream was drawn from the cache.</returns>
+	bool draw(const void* key, uint64_t fingerprint, PolyBuff& polybuff, D3DPRIMITIVETYPE type);
+
+	/// <summary>
+	/// Reserves space in the ring for a stream of the specified size.
+	/// If the stream should be cached, the returned pointer must be filled
+	/// with the converted vertices and followed by a call to <see cref="end_insert"/>.
+	/// </summary>
+	/// <returns>Pointer to the reserved space, or <c>nullptr</c> if the stream shouldn't be cached.</returns>
+	void* begin_insert(const void* key, uint64_t fingerprint, const PolyBuff& polybuff, uint32_t count);
+	/// Completes an insertion started with \c begin_insert and draws the new stream.
+	void end_insert(const void* key, PolyBuff& polybuff, D3DPRIMITIVETYPE type);
+
+	/// Invalidates all cached streams and prints statistics to the debug log.
+	void clear();
+
+	const Stats& stats();
+	float hit_rate();
+}
@@ -0,0 +1,170 @@
+#include "stdafx.h"
+
+#include <SADXModLoader.h>
+
+#include "polybuff_indexed.h"
+
+namespace polybuff_indexed
+{
+	static constexpr UINT VERTEX_BUFFER_SIZE = 1 << 20;
+	static constexpr UINT INDEX_BUFFER_SIZE  = 1 << 18;
+
+	static Direct3DVertexBuffer8* vertex_buffer = nullptr;
+	static Direct3DIndexBuffer8* index_buffer   = nullptr;
+
+	static UINT vertex_offset = 0;
+	static UINT index_offset  = 0;
+
+	// Region reserved by the last call to begin.
+	static UINT locked_vertex_offset = 0;
+	static UINT locked_index_offset  = 0;
+	static UINT locked_stride        = 0;
+
+	static Stats stats_ {};
+
+	static bool create()
+	{
+		if (vertex_buffer != nullptr && index_buffer != nullptr)
+		{
+			return true;
+		}
+
+		release();
+
+		auto result = Direct3D_Device->CreateVertexBuffer(VERTEX_BUFFER_SIZE, D3DUSAGE_DYNAMIC | D3DUSAGE_WRITEONLY,
+		                                                  0, D3DPOOL_DEFAULT, &vertex_buffer);
+
+		if (FAILED(result))
+		{
+			vertex_buffer = nullptr;
+			return false;
+		}
+
+		result = Direct3D_Device->CreateIndexBuffer(INDEX_BUFFER_SIZE, D3DUSAGE_DYNAMIC | D3DUSAGE_WRITEONLY,
+		                                            D3DFMT_INDEX16, D3DPOOL_DEFAULT, &index_buffer);
+
+		if (FAILED(result))
+		{
+			index_buffer = nullptr;
+			release();
+			return false;
+		}
+
+		vertex_offset = 0;
+		index_offset  = 0;
+		return true;
+	}
+
+	bool begin(uint32_t stride, uint32_t max_vertices, uint32_t index_count, void** vertices, uint16_t** indices)
+	{
+		const UINT vertex_size = stride * max_vertices;
+		const UINT index_size  = index_count * sizeof(uint16_t);
+
+		if (!vertex_size || vertex_size > VERTEX_BUFFER_SIZE || index_size > INDEX_BUFFER_SIZE || !create())
+		{
+			return false;
+		}
+
+		// Vertices must start on a multiple of their stride since they're drawn with a base vertex.
+		UINT v_offset = (vertex_offset + stride - 1) / stride * stride;
+		DWORD v_flags = D3DLOCK_NOOVERWRITE;
+
+		if (v_offset + vertex_size > VERTEX_BUFFER_SIZE)
+		{
+			v_offset = 0;
+			v_flags  = D3DLOCK_DISCARD;
+		}
+
+		UINT i_offset = index_offset;
+		DWORD i_flags = D3DLOCK_NOOVERWRITE;
+
+		if (i_offset + index_size > INDEX_BUFFER_SIZE)
+		{
+			i_offset = 0;
+			i_flags  = D3DLOCK_DISCARD;
+		}
+
+		BYTE* v_data = nullptr;
+		BYTE* i_data = nullptr;
+
+		if (FAILED(vertex_buffer->Lock(v_offset, vertex_size, &v_data, v_flags)))
+		{
+			return false;
+		}
+
+		if (FAILED(index_buffer->Lock(i_offset, index_size, &i_data, i_flags)))
+		{
+			vertex_buffer->Unlock();
+			return false;
+		}
+
+		locked_vertex_offset = v_offset;
+		locked_index_offset  = i_offset;
+		locked_stride        = stride;
+
+		*vertices = v_data;
+		*indices  = reinterpret_cast<uint16_t*>(i_data);
+		return true;
+	}
+
+	void end(PolyBuff& polybuff, uint32_t vertex_count, uint32_t index_count)
+	{
+		vertex_buffer->Unlock();
+		index_buffer->Unlock();
+
+		vertex_offset = locked_vertex_offset + vertex_count * locked_stride;
+		index_offset  = locked_index_offset + index_count * sizeof(uint16_t);
+
+		d3d::draw_polybuff(polybuff, D3DPT_TRIANGLESTRIP, index_count - 2, [&]
+		{
+			Direct3D_Device->SetVertexShader(polybuff.FVF);
+			Direct3D_Device->SetStreamSource(0, vertex_buffer, locked_stride);
+			Direct3D_Device->SetIndices(index_buffer, locked_vertex_offset / locked_stride);
+			Direct3D_Device->DrawIndexedPrimitive(D3DPT_TRIANGLESTRIP, 0, vertex_count,
+			                                      locked_index_offset / sizeof(uint16_t), index_count - 2);
+
+			// Restore the polybuff's own stream in case the game
+			// assumes it's still bound from a previous draw.
+			Direct3D_Device->SetStreamSource(0, polybuff.pStreamData, polybuff.Stride);
+		});
+
+		++stats_.draws;
+		stats_.vertex_bytes   += vertex_count * locked_stride;
+		stats_.index_bytes    += index_count * sizeof(uint16_t);
+		stats_.expanded_bytes += index_count * locked_stride;
+	}
+
+	void release()
+	{
+		if (vertex_buffer != nullptr)
+		{
+			vertex_buffer->Release();
+			vertex_buffer = nullptr;
+		}
+
+		if (index_buffer != nullptr)
+		{
+			index_buffer->Release();
+			index_buffer = nullptr;
+		}
+	}
+
+	void clear()
+	{
+		if (stats_.draws)
+		{
+			const auto indexed = stats_.vertex_bytes + stats_.index_bytes;
+
+			PrintDebug("[lantern] Indexed polybuff strips: %u draws, %u KB written instead of %u KB (%.1f%%)\n",
+			           stats_.draws, indexed / 1024, stats_.expanded_bytes / 1024,
+			           100.0f * static_cast<float>(indexed) / static_cast<float>(stats_.expanded_bytes));
+		}
+
+		stats_ = {};
+	}
+
+	const Stats& stats()
+	{
+		return stats_;
+	}
+}
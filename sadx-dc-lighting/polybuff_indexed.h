@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include "d3d.h"
+
+/*
+ * Dynamic vertex and index buffers for drawing polybuff strips as
+ * deduplicated vertices with a 16-bit index buffer. Strips are still
+ * stitched with degenerate triangles, but by repeating indices rather
+ * than whole vertices.
+ */
+namespace polybuff_indexed
+{
+	struct Stats
+	{
+		size_t draws;
+		/// Vertex bytes written by the indexed path.
+		size_t vertex_bytes;
+		/// Index bytes written by the indexed path.
+		size_t index_bytes;
+		/// Vertex bytes the expanded strips would have required instead.
+		size_t expanded_bytes;
+	};
+
+	/// <summary>
+	/// Reserves space for a stream in the dynamic buffers.
+	/// On success, the stream must be written and followed by a call to <see cref="end"/>.
+	/// </summary>
+	/// <param name="stride">Vertex stride.</param>
+	/// <param name="max_vertices">Maximum number of vertices that will be written.</param>
+	/// <param name="index_count">Number of indices that will be written.</param>
+	/// <param name="vertices">Receives a pointer to the vertex space.</param>
+	/// <param name="indices">Receives a pointer to the index space.</param>
+	/// <returns><c>true</c> on success.</returns>
+	bool begin(uint32_t stride, uint32_t max_vertices, uint32_t index_count, void** vertices, uint16_t** indices);
+
+	/// <summary>
+	/// Unlocks the dynamic buffers and draws the stream as a triangle strip in place of the polybuff.
+	/// </summary>
+	/// <param name="polybuff">The polybuff the stream would otherwise be written to.</param>
+	/// <param name="vertex_count">Number of vertices actually written.</param>
+	/// <param name="index_count">Number of indices written.</param>
+	void end(PolyBuff& polybuff, uint32_t vertex_count, uint32_t index_count);
+
+	/// Releases the dynamic buffers. They are re-created on demand.
+	void release();
+	/// Prints statistics to the debug log and resets them.
+	void clear();
+	const Stats& stats();
+}
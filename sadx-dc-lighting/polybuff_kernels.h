@@ -0,0 +1,488 @@
+#pragma once
+
+// This header is intentionally free of game and Direct3D
+// dependencies so that it can be used and measured headlessly.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <emmintrin.h>
+#include <vector>
+
+/*
+ * Vertex assembly for the polybuff drawing functions.
+ *
+ * Every variant reduces to the same two shapes: triangle lists,
+ * which are a straight gather of one vertex per index, and strips,
+ * which are the same gather with the first and last vertex of each
+ * strip duplicated to stitch them together with degenerate triangles.
+ *
+ * Colors are read with a stride so that the global vertex color
+ * can be used without branching per vertex.
+ *
+ * The types below mirror the layout of NJS_POINT3, NJS_TEX and
+ * FVFStruct_F/G/I; polybuff.cpp asserts that they match.
+ */
+namespace polybuff_kernels
+{
+	struct Vector
+	{
+		float x, y, z;
+	};
+
+	struct Tex
+	{
+		int16_t u, v;
+	};
+
+	/// Position, diffuse.
+	struct VertexF
+	{
+		Vector position;
+		uint32_t diffuse;
+	};
+
+	/// Position, normal, diffuse.
+	struct VertexG
+	{
+		Vector position;
+		Vector normal;
+		uint32_t diffuse;
+	};
+
+	/// Position, normal, diffuse, texture coordinates.
+	struct VertexI
+	{
+		Vector position;
+		Vector normal;
+		uint32_t diffuse;
+		float u, v;
+	};
+
+	enum class UvScale
+	{
+		// Matches the (float)u * 0.0039215689f of the original code.
+		Multiply,
+		// Matches the u / 255.0f of the mesh-provided vcolor path.
+		Divide,
+	};
+
+	struct VertexSource
+	{
+		const Vector*   points;
+		const Vector*   normals;
+		const Tex*      uv;
+		const uint32_t* colors;
+		size_t          color_stride;
+	};
+
+	/// Reads colors from \p vertcolor, or \p global for every vertex if it's null.
+	inline VertexSource make_source(const Vector* points, const Vector* normals, const Tex* uv,
+	                                const uint32_t* vertcolor, const uint32_t& global)
+	{
+		if (vertcolor == nullptr)
+		{
+			return { points, normals, uv, &global, 0 };
+		}
+
+		return { points, normals, uv, vertcolor, 1 };
+	}
+
+	/// Returns the number of vertices in a stream of \p strip_count strips, including the stitching vertices.
+	inline int strip_vertex_count(const int16_t* meshes, int strip_count)
+	{
+		int result = 0;
+
+		for (int i = 0; i < strip_count; i++)
+		{
+			const int n = *meshes & 0x3FFF;
+			result += n + 2;
+			meshes += n + 1;
+		}
+
+		return result;
+	}
+
+	/*
+	 * Scalar reference, one component at a time like the
+	 * polybuff_*_r functions. The SSE2 versions must match it
+	 * byte for byte.
+	 */
+
+	template <UvScale scale>
+	float scale_uv_reference(int16_t value)
+	{
+		return scale == UvScale::Multiply
+			? static_cast<float>(value) * 0.0039215689f
+			: value / 255.0f;
+	}
+
+	template <UvScale scale>
+	void write_vertex_reference(VertexF* dst, const VertexSource& src, int16_t index, size_t c)
+	{
+		dst->position = src.points[index];
+		dst->diffuse  = src.colors[c * src.color_stride];
+	}
+
+	template <UvScale scale>
+	void write_vertex_reference(VertexG* dst, const VertexSource& src, int16_t index, size_t c)
+	{
+		dst->position = src.points[index];
+		dst->normal   = src.normals[index];
+		dst->diffuse  = src.colors[c * src.color_stride];
+	}
+
+	template <UvScale scale>
+	void write_vertex_reference(VertexI* dst, const VertexSource& src, int16_t index, size_t c)
+	{
+		dst->position = src.points[index];
+		dst->normal   = src.normals[index];
+		dst->diffuse  = src.colors[c * src.color_stride];
+		dst->u        = scale_uv_reference<scale>(src.uv[c].u);
+		dst->v        = scale_uv_reference<scale>(src.uv[c].v);
+	}
+
+	template <UvScale scale, typename T>
+	void assemble_list_reference(T* buffer, const int16_t* meshes, size_t count, const VertexSource& src)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			write_vertex_reference<scale>(buffer++, src, meshes[i], i);
+		}
+	}
+
+	template <UvScale scale, typename T>
+	void assemble_strips_reference(T* buffer, const int16_t* meshes, int strip_count, const VertexSource& src)
+	{
+		size_t c = 0;
+
+		for (int i = 0; i < strip_count; i++)
+		{
+			const int n = *meshes++ & 0x3FFF;
+			auto head = buffer++;
+
+			for (int j = 0; j < n; j++)
+			{
+				write_vertex_reference<scale>(buffer++, src, meshes[j], c++);
+			}
+
+			meshes += n;
+
+			*head = *(head + 1);
+
+			*buffer = *(buffer - 1);
+			++buffer;
+		}
+	}
+
+	/*
+	 * SSE2 versions, which assemble whole vertices in registers.
+	 */
+
+	// Loads { x, y, z, 0 } without reading past the end of the vector.
+	inline __m128 load_vector(const Vector& v)
+	{
+		const __m128 xy = _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(&v.x)));
+		return _mm_movelh_ps(xy, _mm_load_ss(&v.z));
+	}
+
+	template <UvScale scale>
+	__m128 load_uv(const Tex& uv)
+	{
+		// Sign-extend both 16-bit components to 32-bit integers.
+		__m128i i = _mm_cvtsi32_si128(*reinterpret_cast<const int*>(&uv));
+		i = _mm_srai_epi32(_mm_unpacklo_epi16(i, i), 16);
+
+		const __m128 f = _mm_cvtepi32_ps(i);
+
+		return scale == UvScale::Multiply
+			? _mm_mul_ps(f, _mm_set1_ps(0.0039215689f))
+			: _mm_div_ps(f, _mm_set1_ps(255.0f));
+	}
+
+	// Returns { px, py, pz, nx }; the remaining normal components are returned through n.
+	inline __m128 load_position_normal(const VertexSource& src, int16_t index, __m128& n)
+	{
+		const __m128 p = load_vector(src.points[index]);
+		n = load_vector(src.normals[index]);
+
+		const __m128 t = _mm_shuffle_ps(p, n, _MM_SHUFFLE(0, 0, 2, 2));
+		return _mm_shuffle_ps(p, t, _MM_SHUFFLE(2, 0, 1, 0));
+	}
+
+	template <UvScale scale>
+	void write_vertex(VertexF* dst, const VertexSource& src, int16_t index, size_t c)
+	{
+		const __m128i color = _mm_cvtsi32_si128(static_cast<int>(src.colors[c * src.color_stride]));
+		const __m128 v = _mm_or_ps(load_vector(src.points[index]), _mm_castsi128_ps(_mm_slli_si128(color, 12)));
+
+		_mm_storeu_ps(&dst->position.x, v);
+	}
+
+	template <UvScale scale>
+	void write_vertex(VertexG* dst, const VertexSource& src, int16_t index, size_t c)
+	{
+		__m128 n;
+		_mm_storeu_ps(&dst->position.x, load_position_normal(src, index, n));
+		_mm_storel_pi(reinterpret_cast<__m64*>(&dst->normal.y), _mm_shuffle_ps(n, n, _MM_SHUFFLE(3, 3, 2, 1)));
+		dst->diffuse = src.colors[c * src.color_stride];
+	}
+
+	template <UvScale scale>
+	void write_vertex(VertexI* dst, const VertexSource& src, int16_t index, size_t c)
+	{
+		__m128 n;
+		_mm_storeu_ps(&dst->position.x, load_position_normal(src, index, n));
+		_mm_storel_pi(reinterpret_cast<__m64*>(&dst->normal.y), _mm_shuffle_ps(n, n, _MM_SHUFFLE(3, 3, 2, 1)));
+		dst->diffuse = src.colors[c * src.color_stride];
+		_mm_storel_pi(reinterpret_cast<__m64*>(&dst->u), load_uv<scale>(src.uv[c]));
+	}
+
+	template <UvScale scale, typename T>
+	void assemble_list(T* buffer, const int16_t* meshes, size_t count, const VertexSource& src)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			write_vertex<scale>(buffer++, src, meshes[i], i);
+		}
+	}
+
+	template <UvScale scale, typename T>
+	void assemble_strips(T* buffer, const int16_t* meshes, int strip_count, const VertexSource& src)
+	{
+		size_t c = 0;
+
+		for (int i = 0; i < strip_count; i++)
+		{
+			const int n = *meshes++ & 0x3FFF;
+			auto head = buffer++;
+
+			for (int j = 0; j < n; j++)
+			{
+				write_vertex<scale>(buffer++, src, meshes[j], c++);
+			}
+
+			meshes += n;
+
+			*head = *(head + 1);
+
+			*buffer = *(buffer - 1);
+			++buffer;
+		}
+	}
+
+	/*
+	 * Maps source vertices to deduplicated output vertices for the indexed
+	 * strip path. Two corners are only merged if they reference the same
+	 * point and have the same color and UV, so the output is identical.
+	 */
+	class VertexDeduplicator
+	{
+		struct Key
+		{
+			uint32_t index;
+			uint32_t color;
+			uint32_t uv;
+
+			bool operator==(const Key& other) const
+			{
+				return index == other.index && color == other.color && uv == other.uv;
+			}
+		};
+
+		struct Slot
+		{
+			uint32_t stamp;
+			Key key;
+			uint16_t vertex;
+		};
+
+		std::vector<Slot> slots;
+		uint32_t stamp = 0;
+		size_t mask    = 0;
+
+	public:
+		/// Prepares the table for up to \p capacity unique vertices.
+		void reset(size_t capacity)
+		{
+			size_t size = 64;
+
+			while (size < capacity * 2)
+			{
+				size <<= 1;
+			}
+
+			if (slots.size() < size)
+			{
+				slots.assign(size, {});
+				stamp = 0;
+			}
+
+			// Stale slots are identified by their stamp, so the
+			// table only needs to be cleared when it wraps around.
+			if (++stamp == 0)
+			{
+				std::fill(slots.begin(), slots.end(), Slot {});
+				stamp = 1;
+			}
+
+			mask = size - 1;
+		}
+
+		/// Returns the output vertex for the specified source vertex, adding it as \p next if it's new.
+		uint16_t find_or_add(uint32_t index, uint32_t color, uint32_t uv, uint16_t next, bool& added)
+		{
+			const Key key = { index, color, uv };
+			size_t i = ((index * 2654435761u) ^ (color * 2246822519u) ^ (uv * 3266489917u)) & mask;
+
+			while (slots[i].stamp == stamp)
+			{
+				if (slots[i].key == key)
+				{
+					added = false;
+					return slots[i].vertex;
+				}
+
+				i = (i + 1) & mask;
+			}
+
+			slots[i] = { stamp, key, next };
+			added = true;
+			return next;
+		}
+	};
+
+	/// <summary>
+	/// Assembles strips as deduplicated vertices and 16-bit indices. Strips are stitched by
+	/// repeating indices instead of vertices, so they expand to exactly what assemble_strips writes.
+	/// </summary>
+	/// <returns>The number of vertices written.</returns>
+	template <UvScale scale, typename T>
+	uint16_t assemble_indexed_strips(VertexDeduplicator& deduplicator, T* vertices, uint16_t* indices, const int16_t* meshes,
+	                                 int strip_count, size_t vertex_count, const VertexSource& src)
+	{
+		deduplicator.reset(vertex_count);
+
+		size_t c = 0;
+		uint16_t next = 0;
+
+		for (int i = 0; i < strip_count; i++)
+		{
+			const int n = *meshes++ & 0x3FFF;
+			auto head = indices++;
+
+			for (int j = 0; j < n; j++, c++)
+			{
+				const uint32_t color = src.colors[c * src.color_stride];
+				const uint32_t uv    = src.uv ? *reinterpret_cast<const uint32_t*>(&src.uv[c]) : 0;
+
+				bool added;
+				const auto vertex = deduplicator.find_or_add(static_cast<uint16_t>(meshes[j]), color, uv, next, added);
+
+				if (added)
+				{
+					write_vertex<scale>(&vertices[next++], src, meshes[j], c);
+				}
+
+				*indices++ = vertex;
+			}
+
+			meshes += n;
+
+			*head = *(head + 1);
+
+			*indices = *(indices - 1);
+			++indices;
+		}
+
+		return next;
+	}
+
+	/*
+	 * Fingerprint of everything that ends up in the converted vertex
+	 * stream, used to key cached streams. It only reads the source data,
+	 * which is cheaper than converting the stream and locking and
+	 * uploading the polybuff.
+	 *
+	 * The words of each vertex, including its color and UV, are combined
+	 * with independent multiplies, so only one multiply per vertex is on
+	 * the dependency chain. Each
+	 * step is a bijection of the running hash, and a change to any single
+	 * word always changes the combined value, so it always changes the
+	 * fingerprint.
+	 */
+
+	inline uint64_t fingerprint_mix(uint64_t hash, uint64_t value)
+	{
+		return (hash ^ value) * 0x9E3779B97F4A7C15ull;
+	}
+
+	inline uint64_t fingerprint_mix(uint64_t hash, const void* ptr)
+	{
+		return fingerprint_mix(hash, static_cast<uint64_t>(reinterpret_cast<uintptr_t>(ptr)));
+	}
+
+	inline uint64_t fingerprint_combine(const Vector& v, uint64_t kx, uint64_t ky, uint64_t kz)
+	{
+		auto words = reinterpret_cast<const uint32_t*>(&v.x);
+		return words[0] * kx + words[1] * ky + words[2] * kz;
+	}
+
+	inline uint64_t fingerprint_vertex(uint64_t hash, const VertexSource& src, int16_t index, size_t c)
+	{
+		uint64_t value = static_cast<uint16_t>(index) * 0xC2B2AE3D27D4EB4Full
+		                 + src.colors[c * src.color_stride] * 0x94D049BB133111EBull
+		                 + fingerprint_combine(src.points[index], 0x165667B19E3779F9ull, 0x85EBCA77C2B2AE63ull,
+		                                       0x27D4EB2F165667C5ull);
+
+		if (src.normals)
+		{
+			value += fingerprint_combine(src.normals[index], 0xFF51AFD7ED558CCDull, 0xC4CEB9FE1A85EC53ull,
+			                             0xD6E8FEB86659FD93ull);
+		}
+
+		if (src.uv)
+		{
+			value += *reinterpret_cast<const uint32_t*>(&src.uv[c]) * 0xBF58476D1CE4E5B9ull;
+		}
+
+		return fingerprint_mix(hash, value);
+	}
+
+	inline uint64_t fingerprint(const int16_t* meshes, bool strips, int primitive_count, size_t vertex_count,
+	                            const VertexSource& src, UvScale scale)
+	{
+		uint64_t hash = 14695981039346656037ull;
+
+		hash = fingerprint_mix(hash, meshes);
+		hash = fingerprint_mix(hash, src.points);
+		hash = fingerprint_mix(hash, src.normals);
+		hash = fingerprint_mix(hash, src.uv);
+		hash = fingerprint_mix(hash, static_cast<uint64_t>(scale) << 32 | src.color_stride);
+
+		if (!strips)
+		{
+			for (size_t c = 0; c < vertex_count; c++)
+			{
+				hash = fingerprint_vertex(hash, src, meshes[c], c);
+			}
+
+			return hash;
+		}
+
+		size_t c = 0;
+
+		for (int i = 0; i < primitive_count; i++)
+		{
+			const int n = *meshes++ & 0x3FFF;
+			hash = fingerprint_mix(hash, static_cast<uint64_t>(n));
+
+			for (int j = 0; j < n; j++)
+			{
+				hash = fingerprint_vertex(hash, src, *meshes++, c++);
+			}
+		}
+
+		return hash;
+	}
+}
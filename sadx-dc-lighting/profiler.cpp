@@ -0,0 +1,268 @@
+#include "stdafx.h"
+
+#include "profiler.h"
+
+#ifdef LANTERN_PROFILE
+
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <malloc.h>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <SADXModLoader.h>
+
+static std::atomic<size_t> allocations { 0 };
+
+// Counting is done by replacing the global allocation functions, which
+// only affects allocations made from within this module. Every form is
+// replaced, so that no allocation or deallocation falls through to the
+// CRT's own versions and mismatches the heap these allocate from.
+
+static void* allocate(size_t size)
+{
+	++allocations;
+	return malloc(size ? size : 1);
+}
+
+static void* allocate_or_throw(size_t size)
+{
+	void* result = allocate(size);
+
+	if (result == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+
+	return result;
+}
+
+void* operator new(size_t size)
+{
+	return allocate_or_throw(size);
+}
+
+void* operator new[](size_t size)
+{
+	return allocate_or_throw(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return allocate(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+	free(ptr);
+}
+
+#ifdef __cpp_aligned_new
+
+static void* allocate_aligned(size_t size, std::align_val_t alignment)
+{
+	++allocations;
+	return _aligned_malloc(size ? size : 1, static_cast<size_t>(alignment));
+}
+
+static void* allocate_aligned_or_throw(size_t size, std::align_val_t alignment)
+{
+	void* result = allocate_aligned(size, alignment);
+
+	if (result == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+
+	return result;
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	return allocate_aligned_or_throw(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+	return allocate_aligned_or_throw(size, alignment);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return allocate_aligned(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return allocate_aligned(size, alignment);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+	_aligned_free(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept
+{
+	_aligned_free(ptr);
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept
+{
+	_aligned_free(ptr);
+}
+
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept
+{
+	_aligned_free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	_aligned_free(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	_aligned_free(ptr);
+}
+
+#endif
+
+namespace profiler
+{
+	struct Stage
+	{
+		const char* name;
+		size_t depth;
+		bool finished;
+		clock::time_point start;
+		clock::time_point end;
+		size_t start_allocations;
+		size_t end_allocations;
+
+		double milliseconds() const
+		{
+			const auto until = finished ? end : clock::now();
+			return std::chrono::duration<double, std::milli>(until - start).count();
+		}
+
+		size_t allocations() const
+		{
+			return (finished ? end_allocations : allocation_count()) - start_allocations;
+		}
+	};
+
+	static std::vector<Stage> stages;
+	static size_t depth = 0;
+
+	static bool report_pending = false;
+	static std::string report_path;
+
+	static void write_report(const std::string& path);
+
+	ScopedTimer::ScopedTimer(const char* name)
+		: index(stages.size())
+	{
+		stages.push_back({ name, depth++, false });
+
+		// Sampled last so that the bookkeeping above isn't included.
+		auto& stage = stages[index];
+		stage.start_allocations = allocation_count();
+		stage.start = clock::now();
+	}
+
+	ScopedTimer::~ScopedTimer()
+	{
+		const auto end = clock::now();
+		auto& stage = stages[index];
+
+		stage.end             = end;
+		stage.end_allocations = allocation_count();
+		stage.finished        = true;
+
+		if (--depth == 0 && report_pending)
+		{
+			report_pending = false;
+			write_report(report_path);
+		}
+	}
+
+	size_t allocation_count()
+	{
+		return allocations;
+	}
+
+	void report(const std::string& path)
+	{
+		if (depth > 0)
+		{
+			report_pending = true;
+			report_path    = path;
+			return;
+		}
+
+		write_report(path);
+	}
+
+	static void write_report(const std::string& path)
+	{
+		for (auto& stage : stages)
+		{
+			const std::string indent(stage.depth * 2, ' ');
+
+			PrintDebug("[lantern] %s%-*s %9.3f ms %6u allocations\n", indent.c_str(),
+			           static_cast<int>(32 - indent.size()), stage.name, stage.milliseconds(), stage.allocations());
+		}
+
+		std::ofstream file(path);
+
+		if (!file.is_open())
+		{
+			PrintDebug("[lantern] Failed to open profiler output: %s\n", path.c_str());
+			return;
+		}
+
+		file << "stage,depth,milliseconds,allocations,finished\n";
+
+		for (auto& stage : stages)
+		{
+			file << stage.name << ',' << stage.depth << ',' << stage.milliseconds() << ','
+			     << stage.allocations() << ',' << (stage.finished ? 1 : 0) << '\n';
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,64 @@
+#pragma once
+
+// Profiling is always available in debug builds. Define
+// LANTERN_PROFILE to enable it in release builds as well.
+// When disabled, all of the macros below compile to nothing.
+#if defined(_DEBUG) && !defined(LANTERN_PROFILE)
+#define LANTERN_PROFILE
+#endif
+
+#ifdef LANTERN_PROFILE
+
+#include <chrono>
+#include <string>
+
+namespace profiler
+{
+	using clock = std::chrono::high_resolution_clock;
+
+	/// <summary>
+	/// Records the wall time and number of allocations made
+	/// between construction and destruction as a named stage.
+	/// </summary>
+	class ScopedTimer
+	{
+		size_t index;
+
+	public:
+		explicit ScopedTimer(const char* name);
+		~ScopedTimer();
+
+		ScopedTimer(const ScopedTimer&) = delete;
+		ScopedTimer& operator=(const ScopedTimer&) = delete;
+	};
+
+	/// Returns the total number of allocations made by the mod so far.
+	size_t allocation_count();
+
+	/// <summary>
+	/// Prints all recorded stages to the debug log and writes them as CSV to the specified path.
+	/// If a stage is still running, this happens when the outermost one finishes, so that
+	/// every stage is reported with its complete time and allocations.
+	/// </summary>
+	void report(const std::string& path);
+}
+
+#define PROFILER_CONCAT_(a, b) a ## b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_(a, b)
+
+#define PROFILE_SCOPE(NAME) \
+	profiler::ScopedTimer PROFILER_CONCAT(_scoped_timer_, __LINE__)(NAME)
+
+#define PROFILE_STAGE(NAME, ...) \
+	do { PROFILE_SCOPE(NAME); __VA_ARGS__; } while (0)
+
+#define PROFILE_REPORT(PATH) \
+	profiler::report(PATH)
+
+#else
+
+#define PROFILE_SCOPE(NAME) ((void)0)
+#define PROFILE_STAGE(NAME, ...) do { __VA_ARGS__; } while (0)
+#define PROFILE_REPORT(PATH) ((void)0)
+
+#endif
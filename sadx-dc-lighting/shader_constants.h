@@ -0,0 +1,134 @@
+#pragma once
+
+// This header is intentionally free of game and Direct3D
+// dependencies so that it can be used and measured headlessly.
+
+#include <cstdint>
+
+/*
+ * The device-independent half of ShaderParameter: change tracking and
+ * the uploads a commit makes. Uploads are templated on the device, which
+ * is IDirect3DDevice9 in game and mock_device::Device in the tools.
+ */
+namespace shader_constants
+{
+	/// Shader stages a parameter is bound to. Same values as IShaderParameter::Type.
+	enum Stage : uint32_t
+	{
+		vertex = 0b01,
+		pixel  = 0b10,
+		both   = 0b11
+	};
+
+	/// Same value as D3DVERTEXTEXTURESAMPLER0.
+	constexpr uint32_t VERTEX_SAMPLER0 = 257;
+
+	/// Uploads \p count registers to the constants of each stage in \p stages.
+	template <typename Device>
+	void set(Device* device, int index, uint32_t stages, const float* registers, uint32_t count)
+	{
+		if (stages & vertex)
+		{
+			device->SetVertexShaderConstantF(index, registers, count);
+		}
+
+		if (stages & pixel)
+		{
+			device->SetPixelShaderConstantF(index, registers, count);
+		}
+	}
+
+	/// Binds a texture to sampler \p index of each stage in \p stages.
+	template <typename Device, typename Texture>
+	void set_texture(Device* device, int index, uint32_t stages, Texture* texture)
+	{
+		if (stages & vertex)
+		{
+			device->SetTexture(VERTEX_SAMPLER0 + index, texture);
+		}
+
+		if (stages & pixel)
+		{
+			device->SetTexture(index, texture);
+		}
+	}
+
+	/// <summary>
+	/// A parameter's current value and the value last committed to the device.
+	/// Values assigned since the last commit are only uploaded if they differ from it.
+	/// </summary>
+	template <typename T>
+	class Tracked
+	{
+		bool reset = false;
+		bool assigned = false;
+		T last;
+		T current;
+
+	public:
+		explicit Tracked(const T& value)
+			: last(value),
+			  current(value)
+		{
+		}
+
+		bool is_modified() const
+		{
+			return reset || (assigned && last != current);
+		}
+
+		void clear()
+		{
+			reset    = false;
+			assigned = false;
+			last     = current;
+		}
+
+		/// Uploads the value on the next commit even if it hasn't changed.
+		void force()
+		{
+			reset = true;
+		}
+
+		/// Replaces both values without uploading anything.
+		void discard(const T& value)
+		{
+			clear();
+			current = value;
+			last    = value;
+		}
+
+		/// <returns><c>true</c> if this is the first assignment since the last commit.</returns>
+		bool assign(const T& value)
+		{
+			const bool first = !assigned;
+			assigned = true;
+			current  = value;
+			return first;
+		}
+
+		const T& value() const
+		{
+			return current;
+		}
+
+		/// <summary>
+		/// Calls \p upload with the current value if it was modified, then clears it.
+		/// Otherwise only the assignment is forgotten.
+		/// </summary>
+		/// <returns><c>true</c> if the value was uploaded.</returns>
+		template <typename F>
+		bool commit(F upload)
+		{
+			if (!is_modified())
+			{
+				assigned = false;
+				return false;
+			}
+
+			upload(current);
+			clear();
+			return true;
+		}
+	};
+}
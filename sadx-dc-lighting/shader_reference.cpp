@@ -0,0 +1,507 @@
+#include "stdafx.h"
+
+#include <cmath>
+#include <cstring>
+#include <emmintrin.h>
+
+#include "shader_reference.h"
+
+namespace shader_reference
+{
+	static constexpr size_t ATLAS_WIDTH  = 256;
+
+	static constexpr uint32_t FOGMODE_EXP    = 1;
+	static constexpr uint32_t FOGMODE_EXP2   = 2;
+	static constexpr uint32_t FOGMODE_LINEAR = 3;
+	static constexpr uint32_t D3DMCS_COLOR1  = 1;
+
+	static constexpr float E = 2.71828f;
+
+	void Constants::set_defaults()
+	{
+		memset(c, 0, sizeof(c));
+
+		const float texture_transform[4][4] = {
+			{ -0.5f, 0.0f, 0.0f, 0.0f },
+			{ 0.0f, 0.5f, 0.0f, 0.0f },
+			{ 0.0f, 0.0f, 1.0f, 0.0f },
+			{ 0.5f, 0.5f, 0.0f, 1.0f }
+		};
+
+		memcpy(c[Register_TextureTransform], texture_transform, sizeof(texture_transform));
+
+		const auto set = [this](size_t index, float x, float y, float z, float w)
+		{
+			c[index][0] = x;
+			c[index][1] = y;
+			c[index][2] = z;
+			c[index][3] = w;
+		};
+
+		set(Register_NormalScale, 1.0f, 1.0f, 1.0f, 0.0f);
+		set(Register_LightDirection, 0.0f, -1.0f, 0.0f, 0.0f);
+		set(Register_DiffuseSource, 1.0f, 1.0f, 1.0f, 1.0f);
+		set(Register_MaterialDiffuse, 1.0f, 1.0f, 1.0f, 1.0f);
+		set(Register_AllowVertexColor, 1.0f, 1.0f, 1.0f, 1.0f);
+		set(Register_DiffuseOverrideColor, 1.0f, 1.0f, 1.0f, 0.0f);
+		set(Register_AlphaRef, 16.0f / 255.0f, 16.0f / 255.0f, 16.0f / 255.0f, 16.0f / 255.0f);
+	}
+
+	// Shared by both paths: anything not worth vectorizing, and anything whose
+	// result must be bit-identical between them.
+
+	static float clamp(float value, float low, float high)
+	{
+		// Written out so NaN goes to the low end the same way as _mm_max_ps.
+		if (!(value > low))
+		{
+			value = low;
+		}
+
+		return value < high ? value : high;
+	}
+
+	static bool get_bool(const Constants& constants, size_t index)
+	{
+		return constants.c[index][0] != 0.0f;
+	}
+
+	static void sample_atlas(const Atlas& atlas, float u, float v, float* out)
+	{
+		const auto x = static_cast<size_t>(clamp(std::floor(u * ATLAS_WIDTH), 0.0f, ATLAS_WIDTH - 1.0f));
+		const auto height = static_cast<float>(atlas.rows);
+		const auto y = static_cast<size_t>(clamp(std::floor(v * height), 0.0f, height - 1.0f));
+		const auto i = y * ATLAS_WIDTH + x;
+
+		if (atlas.is_float)
+		{
+			memcpy(out, static_cast<const float*>(atlas.data) + i * 4, sizeof(float) * 4);
+			return;
+		}
+
+		const auto texel = static_cast<const uint32_t*>(atlas.data)[i];
+
+		out[0] = static_cast<float>((texel >> 16) & 0xFF) / 255.0f;
+		out[1] = static_cast<float>((texel >> 8) & 0xFF) / 255.0f;
+		out[2] = static_cast<float>(texel & 0xFF) / 255.0f;
+		// X8R8G8B8 has no alpha to sample.
+		out[3] = 1.0f;
+	}
+
+	static void sample_texture(const Texture& texture, const float* tex, float* out)
+	{
+		if (texture.texels == nullptr || !texture.width || !texture.height)
+		{
+			out[0] = out[1] = out[2] = out[3] = 1.0f;
+			return;
+		}
+
+		const float u = tex[0] - std::floor(tex[0]);
+		const float v = tex[1] - std::floor(tex[1]);
+
+		const auto x = static_cast<size_t>(clamp(u * texture.width, 0.0f, texture.width - 1.0f));
+		const auto y = static_cast<size_t>(clamp(v * texture.height, 0.0f, texture.height - 1.0f));
+
+		const auto texel = texture.texels[y * texture.width + x];
+
+		out[0] = static_cast<float>((texel >> 16) & 0xFF) / 255.0f;
+		out[1] = static_cast<float>((texel >> 8) & 0xFF) / 255.0f;
+		out[2] = static_cast<float>(texel & 0xFF) / 255.0f;
+		out[3] = static_cast<float>(texel >> 24) / 255.0f;
+	}
+
+	static float fog_factor(const Constants& constants, float d)
+	{
+		const auto& config = constants.c[Register_FogConfig];
+
+		// fogCoeff is left uninitialized for FOGMODE_NONE, which compiles to 0.
+		float coefficient = 0.0f;
+
+		switch (static_cast<uint32_t>(constants.c[Register_FogMode][0]))
+		{
+			default:
+				break;
+
+			case FOGMODE_EXP:
+				coefficient = 1.0f / std::pow(E, d * config[2]);
+				break;
+
+			case FOGMODE_EXP2:
+				coefficient = 1.0f / std::pow(E, d * d * config[2] * config[2]);
+				break;
+
+			case FOGMODE_LINEAR:
+				coefficient = (config[1] - d) / (config[1] - config[0]);
+				break;
+		}
+
+		return clamp(coefficient, 0.0f, 1.0f);
+	}
+
+	// The brightness index: the palette texture coordinate for a world space normal.
+	static float palette_coordinate(float dot)
+	{
+		return std::floor(clamp(1.0f - (dot + 1.0f) / 2.0f, 0.0f, 0.99f) * 255.0f) / 255.0f;
+	}
+
+	static float inverse_length(const float* v)
+	{
+		return 1.0f / std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+	}
+
+	// Scalar path.
+
+	static void mul(const float* v, const float (*m)[4], float* out)
+	{
+		for (int j = 0; j < 4; j++)
+		{
+			out[j] = v[0] * m[0][j] + v[1] * m[1][j] + v[2] * m[2][j] + v[3] * m[3][j];
+		}
+	}
+
+	static void get_diffuse(const Constants& constants, const float* vcolor, float* out)
+	{
+		const bool any = vcolor[0] != 0.0f || vcolor[1] != 0.0f || vcolor[2] != 0.0f || vcolor[3] != 0.0f;
+		const bool vertex = static_cast<uint32_t>(constants.c[Register_DiffuseSource][0]) == D3DMCS_COLOR1 && any;
+
+		memcpy(out, vertex ? vcolor : constants.c[Register_MaterialDiffuse], sizeof(float) * 4);
+
+		if (!get_bool(constants, Register_AllowVertexColor) || get_bool(constants, Register_ForceDefaultDiffuse))
+		{
+			out[0] = out[1] = out[2] = 1.0f;
+		}
+	}
+
+	void vs_main(const Constants& constants, uint32_t permutation, const Samplers& samplers,
+	             const VertexInput& input, VertexOutput& output)
+	{
+		const auto& c = constants.c;
+
+		const float position[4] = { input.position[0], input.position[1], input.position[2], 1.0f };
+
+		float world[4];
+		mul(position, &c[Register_WorldMatrix], world);
+		memcpy(output.world_position, world, sizeof(output.world_position));
+
+		float view[4];
+		mul(position, &c[Register_wvMatrix], view);
+		output.fog_distance = view[2];
+
+		mul(view, &c[Register_ProjectionMatrix], output.position);
+
+		if ((permutation & Permutation_Texture) && (permutation & Permutation_EnvMap))
+		{
+			const float normal[4] = { input.normal[0], input.normal[1], input.normal[2], 1.0f };
+
+			float tex[4];
+			mul(normal, &c[Register_wvMatrixInvT], tex);
+
+			const float tex2[4] = { tex[0], tex[1], 0.0f, 1.0f };
+			mul(tex2, &c[Register_TextureTransform], tex);
+
+			output.tex[0] = tex[0];
+			output.tex[1] = tex[1];
+		}
+		else
+		{
+			output.tex[0] = input.tex[0];
+			output.tex[1] = input.tex[1];
+		}
+
+		if (!(permutation & Permutation_Light))
+		{
+			get_diffuse(constants, input.color, output.diffuse);
+			memset(output.specular, 0, sizeof(output.specular));
+			return;
+		}
+
+		const float normal[4] = {
+			input.normal[0] * c[Register_NormalScale][0],
+			input.normal[1] * c[Register_NormalScale][1],
+			input.normal[2] * c[Register_NormalScale][2],
+			0.0f
+		};
+
+		float world_normal[4];
+		mul(normal, &c[Register_WorldMatrix], world_normal);
+
+		float diffuse[4];
+		get_diffuse(constants, input.color, diffuse);
+
+		const auto& light = c[Register_LightDirection];
+		const float scale = inverse_length(light);
+		const float dot = light[0] * scale * world_normal[0] + light[1] * scale * world_normal[1] + light[2] * scale * world_normal[2];
+		const float i   = palette_coordinate(dot);
+
+		const auto& indices = c[Register_Indices];
+
+		float pdiffuse[4];
+		float pspecular[4];
+
+		if (get_bool(constants, Register_DiffuseOverride))
+		{
+			memcpy(pdiffuse, c[Register_DiffuseOverrideColor], sizeof(float) * 3);
+			pdiffuse[3] = 1.0f;
+		}
+		else
+		{
+			sample_atlas(samplers.palette_a, i, indices[0], pdiffuse);
+		}
+
+		sample_atlas(samplers.palette_a, i, indices[2], pspecular);
+
+		if (permutation & Permutation_Blend)
+		{
+			float bdiffuse[4];
+			float bspecular[4];
+
+			sample_atlas(samplers.palette_b, i, indices[1], bdiffuse);
+			sample_atlas(samplers.palette_b, i, indices[3], bspecular);
+
+			const auto& factor = c[Register_BlendFactor];
+
+			for (int k = 0; k < 4; k++)
+			{
+				pdiffuse[k]  = pdiffuse[k] + (bdiffuse[k] - pdiffuse[k]) * factor[0];
+				pspecular[k] = pspecular[k] + (bspecular[k] - pspecular[k]) * factor[1];
+			}
+		}
+
+		for (int k = 0; k < 3; k++)
+		{
+			output.diffuse[k]  = diffuse[k] * pdiffuse[k];
+			output.specular[k] = pspecular[k];
+		}
+
+		output.diffuse[3]  = diffuse[3];
+		output.specular[3] = 0.0f;
+	}
+
+	static float fog_distance(const Constants& constants, uint32_t permutation, const VertexOutput& input)
+	{
+		if (!(permutation & Permutation_RangeFog))
+		{
+			return input.fog_distance;
+		}
+
+		const auto& view = constants.c[Register_ViewPosition];
+
+		const float d[3] = {
+			input.world_position[0] - view[0],
+			input.world_position[1] - view[1],
+			input.world_position[2] - view[2]
+		};
+
+		return std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+	}
+
+	bool ps_main(const Constants& constants, uint32_t permutation, const Samplers& samplers,
+	             const VertexOutput& input, float* color)
+	{
+		if (permutation & Permutation_Texture)
+		{
+			float texel[4];
+			sample_texture(samplers.base, input.tex, texel);
+
+			for (int k = 0; k < 4; k++)
+			{
+				color[k] = texel[k] * input.diffuse[k] + input.specular[k];
+			}
+		}
+		else
+		{
+			memcpy(color, input.diffuse, sizeof(float) * 4);
+		}
+
+		if ((permutation & Permutation_Alpha) && color[3] < constants.c[Register_AlphaRef][0])
+		{
+			return false;
+		}
+
+		if (permutation & Permutation_Fog)
+		{
+			const float factor = fog_factor(constants, fog_distance(constants, permutation, input));
+			const auto& fog = constants.c[Register_FogColor];
+
+			for (int k = 0; k < 3; k++)
+			{
+				color[k] = factor * color[k] + (1.0f - factor) * fog[k];
+			}
+		}
+
+		return true;
+	}
+
+	// SIMD path. Every operation is done in the same order as above.
+
+	static __m128 mul_ps(__m128 v, const float (*m)[4])
+	{
+		const __m128 x = _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0));
+		const __m128 y = _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1));
+		const __m128 z = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2));
+		const __m128 w = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
+
+		__m128 result = _mm_mul_ps(x, _mm_loadu_ps(m[0]));
+		result = _mm_add_ps(result, _mm_mul_ps(y, _mm_loadu_ps(m[1])));
+		result = _mm_add_ps(result, _mm_mul_ps(z, _mm_loadu_ps(m[2])));
+		return _mm_add_ps(result, _mm_mul_ps(w, _mm_loadu_ps(m[3])));
+	}
+
+	static __m128 get_diffuse_ps(const Constants& constants, const float* vcolor)
+	{
+		float diffuse[4];
+		get_diffuse(constants, vcolor, diffuse);
+		return _mm_loadu_ps(diffuse);
+	}
+
+	static __m128 sample_atlas_ps(const Atlas& atlas, float u, float v)
+	{
+		float texel[4];
+		sample_atlas(atlas, u, v, texel);
+		return _mm_loadu_ps(texel);
+	}
+
+	void vs_batch(const Constants& constants, uint32_t permutation, const Samplers& samplers,
+	              const VertexInput* input, VertexOutput* output, size_t count)
+	{
+		const auto& c = constants.c;
+
+		const bool envmap = (permutation & Permutation_Texture) && (permutation & Permutation_EnvMap);
+		const bool light  = (permutation & Permutation_Light) != 0;
+		const bool blend  = (permutation & Permutation_Blend) != 0;
+		const bool diffuse_override = get_bool(constants, Register_DiffuseOverride);
+
+		const auto& light_direction = c[Register_LightDirection];
+		const float scale = inverse_length(light_direction);
+
+		// light * scale is evaluated per vertex in the scalar path, but it's the same every time.
+		const __m128 scaled_light = _mm_mul_ps(_mm_setr_ps(light_direction[0], light_direction[1], light_direction[2], 0.0f),
+		                                       _mm_set1_ps(scale));
+
+		const __m128 normal_scale = _mm_setr_ps(c[Register_NormalScale][0], c[Register_NormalScale][1],
+		                                        c[Register_NormalScale][2], 0.0f);
+
+		const __m128 rgb_mask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+		const __m128 one_w    = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+
+		const __m128 override_color = _mm_setr_ps(c[Register_DiffuseOverrideColor][0], c[Register_DiffuseOverrideColor][1],
+		                                          c[Register_DiffuseOverrideColor][2], 1.0f);
+
+		const __m128 blend_diffuse  = _mm_set1_ps(c[Register_BlendFactor][0]);
+		const __m128 blend_specular = _mm_set1_ps(c[Register_BlendFactor][1]);
+
+		const auto& indices = c[Register_Indices];
+
+		for (size_t v = 0; v < count; v++)
+		{
+			const auto& in = input[v];
+			auto& out = output[v];
+
+			const __m128 position = _mm_setr_ps(in.position[0], in.position[1], in.position[2], 1.0f);
+
+			float world[4];
+			_mm_storeu_ps(world, mul_ps(position, &c[Register_WorldMatrix]));
+			memcpy(out.world_position, world, sizeof(out.world_position));
+
+			const __m128 view = mul_ps(position, &c[Register_wvMatrix]);
+			out.fog_distance = _mm_cvtss_f32(_mm_shuffle_ps(view, view, _MM_SHUFFLE(2, 2, 2, 2)));
+
+			_mm_storeu_ps(out.position, mul_ps(view, &c[Register_ProjectionMatrix]));
+
+			if (envmap)
+			{
+				const __m128 normal = _mm_setr_ps(in.normal[0], in.normal[1], in.normal[2], 1.0f);
+
+				__m128 tex = mul_ps(normal, &c[Register_wvMatrixInvT]);
+				tex = _mm_or_ps(_mm_movelh_ps(tex, _mm_setzero_ps()), one_w);
+				tex = mul_ps(tex, &c[Register_TextureTransform]);
+
+				_mm_storel_pi(reinterpret_cast<__m64*>(out.tex), tex);
+			}
+			else
+			{
+				out.tex[0] = in.tex[0];
+				out.tex[1] = in.tex[1];
+			}
+
+			const __m128 diffuse = get_diffuse_ps(constants, in.color);
+
+			if (!light)
+			{
+				_mm_storeu_ps(out.diffuse, diffuse);
+				_mm_storeu_ps(out.specular, _mm_setzero_ps());
+				continue;
+			}
+
+			const __m128 normal = _mm_mul_ps(_mm_setr_ps(in.normal[0], in.normal[1], in.normal[2], 0.0f), normal_scale);
+			const __m128 world_normal = mul_ps(normal, &c[Register_WorldMatrix]);
+
+			alignas(16) float terms[4];
+			_mm_store_ps(terms, _mm_mul_ps(scaled_light, world_normal));
+
+			const float i = palette_coordinate(terms[0] + terms[1] + terms[2]);
+
+			__m128 pdiffuse  = diffuse_override ? override_color : sample_atlas_ps(samplers.palette_a, i, indices[0]);
+			__m128 pspecular = sample_atlas_ps(samplers.palette_a, i, indices[2]);
+
+			if (blend)
+			{
+				const __m128 bdiffuse  = sample_atlas_ps(samplers.palette_b, i, indices[1]);
+				const __m128 bspecular = sample_atlas_ps(samplers.palette_b, i, indices[3]);
+
+				pdiffuse  = _mm_add_ps(pdiffuse, _mm_mul_ps(_mm_sub_ps(bdiffuse, pdiffuse), blend_diffuse));
+				pspecular = _mm_add_ps(pspecular, _mm_mul_ps(_mm_sub_ps(bspecular, pspecular), blend_specular));
+			}
+
+			const __m128 lit = _mm_or_ps(_mm_and_ps(rgb_mask, _mm_mul_ps(diffuse, pdiffuse)), _mm_andnot_ps(rgb_mask, diffuse));
+
+			_mm_storeu_ps(out.diffuse, lit);
+			_mm_storeu_ps(out.specular, _mm_and_ps(rgb_mask, pspecular));
+		}
+	}
+
+	void ps_batch(const Constants& constants, uint32_t permutation, const Samplers& samplers,
+	              const VertexOutput* input, float* colors, bool* visible, size_t count)
+	{
+		const auto& c = constants.c;
+
+		const bool texture = (permutation & Permutation_Texture) != 0;
+		const bool alpha   = (permutation & Permutation_Alpha) != 0;
+		const bool fog     = (permutation & Permutation_Fog) != 0;
+
+		const __m128 rgb_mask  = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+		const __m128 fog_color = _mm_loadu_ps(c[Register_FogColor]);
+		const __m128 one       = _mm_set1_ps(1.0f);
+
+		for (size_t p = 0; p < count; p++)
+		{
+			const auto& in = input[p];
+			__m128 color = _mm_loadu_ps(in.diffuse);
+
+			if (texture)
+			{
+				float texel[4];
+				sample_texture(samplers.base, in.tex, texel);
+				color = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(texel), color), _mm_loadu_ps(in.specular));
+			}
+
+			if (alpha && _mm_cvtss_f32(_mm_shuffle_ps(color, color, _MM_SHUFFLE(3, 3, 3, 3))) < c[Register_AlphaRef][0])
+			{
+				visible[p] = false;
+				_mm_storeu_ps(colors + p * 4, color);
+				continue;
+			}
+
+			if (fog)
+			{
+				const __m128 factor = _mm_set1_ps(fog_factor(constants, fog_distance(constants, permutation, in)));
+				const __m128 fogged = _mm_add_ps(_mm_mul_ps(factor, color), _mm_mul_ps(_mm_sub_ps(one, factor), fog_color));
+
+				color = _mm_or_ps(_mm_and_ps(rgb_mask, fogged), _mm_andnot_ps(rgb_mask, color));
+			}
+
+			visible[p] = true;
+			_mm_storeu_ps(colors + p * 4, color);
+		}
+	}
+}
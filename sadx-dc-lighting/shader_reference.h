@@ -0,0 +1,135 @@
+#pragma once
+
+// This header is intentionally free of game and Direct3D
+// dependencies so that it can be used and measured headlessly.
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * A CPU port of vs_main and ps_main in lantern.hlsl, for checking
+ * lighting output without a GPU. It reads the same constant registers
+ * that the param:: shader parameters are committed to and the same
+ * palette atlas bytes that palette_atlas::write_palette writes.
+ * Instancing and software lighting variants aren't covered.
+ */
+namespace shader_reference
+{
+	/// Constant registers used by lantern.hlsl, c0 through c38.
+	constexpr size_t REGISTER_COUNT = 39;
+
+	/// First register of each shader constant, as declared in lantern.hlsl and param::.
+	/// Matrices take four registers, one per row.
+	enum Register : size_t
+	{
+		Register_WorldMatrix          = 0,
+		Register_wvMatrix             = 4,
+		Register_ProjectionMatrix     = 8,
+		Register_wvMatrixInvT         = 12,
+		Register_TextureTransform     = 16,
+		Register_NormalScale          = 20,
+		Register_LightDirection       = 21,
+		Register_DiffuseSource        = 22,
+		Register_MaterialDiffuse      = 23,
+		Register_Indices              = 24,
+		Register_BlendFactor          = 25,
+		Register_AllowVertexColor     = 26,
+		Register_ForceDefaultDiffuse  = 27,
+		Register_DiffuseOverride      = 28,
+		Register_DiffuseOverrideColor = 29,
+		Register_FogMode              = 30,
+		Register_FogConfig            = 31,
+		Register_FogColor             = 32,
+		Register_AlphaRef             = 33,
+		Register_ViewPosition         = 34,
+		Register_ViewMatrix           = 35,
+	};
+
+	/// Shader permutation. Values match ShaderFlags in lanternapi.h.
+	enum Permutation : uint32_t
+	{
+		Permutation_Texture  = 1 << 0,
+		Permutation_EnvMap   = 1 << 1,
+		Permutation_Alpha    = 1 << 2,
+		Permutation_Light    = 1 << 3,
+		Permutation_Blend    = 1 << 4,
+		Permutation_Fog      = 1 << 5,
+		Permutation_RangeFog = 1 << 6,
+	};
+
+	/// Float constant registers. Vertex and pixel shader constants don't overlap, so they share one file.
+	struct Constants
+	{
+		float c[REGISTER_COUNT][4];
+
+		/// Fills the registers with the defaults from lantern.hlsl.
+		void set_defaults();
+	};
+
+	/// A palette atlas as written by palette_atlas::write_palette: 256 texels wide, 16 rows per palette.
+	struct Atlas
+	{
+		/// X8R8G8B8 texels, or four floats (RGBA) per texel if \c is_float.
+		const void* data;
+		bool is_float;
+		size_t rows = 16;
+	};
+
+	/// A D3DCOLOR (0xAARRGGBB) texture, sampled with point filtering and wrap addressing.
+	struct Texture
+	{
+		const uint32_t* texels;
+		size_t width;
+		size_t height;
+	};
+
+	/// All colors are RGBA in [0, 1].
+	struct VertexInput
+	{
+		float position[3];
+		float normal[3];
+		float tex[2];
+		float color[4];
+	};
+
+	struct VertexOutput
+	{
+		float position[4];
+		float diffuse[4];
+		float specular[4];
+		float tex[2];
+		float fog_distance;
+		float world_position[3];
+	};
+
+	/// Palette atlases and base texture bound for a draw.
+	struct Samplers
+	{
+		Atlas palette_a;
+		Atlas palette_b;
+		Texture base;
+	};
+
+	/// Port of vs_main.
+	void vs_main(const Constants& constants, uint32_t permutation, const Samplers& samplers,
+	             const VertexInput& input, VertexOutput& output);
+
+	/// <summary>
+	/// Port of ps_main.
+	/// </summary>
+	/// <returns><c>false</c> if the pixel was clipped by the alpha test.</returns>
+	bool ps_main(const Constants& constants, uint32_t permutation, const Samplers& samplers,
+	             const VertexOutput& input, float* color);
+
+	/// Same results as \c vs_main for every vertex, with the per-vertex math done in SIMD registers.
+	void vs_batch(const Constants& constants, uint32_t permutation, const Samplers& samplers,
+	              const VertexInput* input, VertexOutput* output, size_t count);
+
+	/// <summary>
+	/// Same results as \c ps_main for every input, with the per-pixel math done in SIMD registers.
+	/// </summary>
+	/// <param name="colors">Receives four floats per input.</param>
+	/// <param name="visible">Receives whether each input passed the alpha test.</param>
+	void ps_batch(const Constants& constants, uint32_t permutation, const Samplers& samplers,
+	              const VertexOutput* input, float* colors, bool* visible, size_t count);
+}
@@ -0,0 +1,155 @@
+#include "stdafx.h"
+
+#include <algorithm>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+
+#include "shader_usage.h"
+
+namespace shader_usage
+{
+	static const char* stage_name(Stage stage)
+	{
+		return stage == Stage::Vertex ? "vs" : "ps";
+	}
+
+	std::vector<uint64_t>& Histogram::counts(Stage stage)
+	{
+		return stage == Stage::Vertex ? vertex : pixel;
+	}
+
+	const std::vector<uint64_t>& Histogram::counts(Stage stage) const
+	{
+		return stage == Stage::Vertex ? vertex : pixel;
+	}
+
+	uint64_t Histogram::count(Stage stage, uint32_t key) const
+	{
+		return key < KEY_COUNT ? counts(stage)[key] : 0;
+	}
+
+	uint64_t Histogram::total(Stage stage) const
+	{
+		const auto& c = counts(stage);
+		return std::accumulate(c.begin(), c.end(), uint64_t(0));
+	}
+
+	std::vector<uint32_t> Histogram::hottest(Stage stage, double coverage) const
+	{
+		const auto& c = counts(stage);
+		std::vector<uint32_t> keys;
+
+		for (uint32_t key = 0; key < KEY_COUNT; ++key)
+		{
+			if (c[key])
+			{
+				keys.push_back(key);
+			}
+		}
+
+		std::stable_sort(keys.begin(), keys.end(), [&](uint32_t a, uint32_t b)
+		{
+			return c[a] > c[b];
+		});
+
+		const auto target = static_cast<double>(total(stage)) * coverage;
+		uint64_t sum = 0;
+		size_t n = 0;
+
+		while (n < keys.size() && static_cast<double>(sum) < target)
+		{
+			sum += c[keys[n++]];
+		}
+
+		keys.resize(n);
+		return keys;
+	}
+
+	std::vector<uint32_t> Histogram::unused(Stage stage, const std::vector<uint32_t>& candidates) const
+	{
+		std::vector<uint32_t> result;
+
+		for (auto key : candidates)
+		{
+			if (!count(stage, key))
+			{
+				result.push_back(key);
+			}
+		}
+
+		return result;
+	}
+
+	bool Histogram::load(const std::string& path)
+	{
+		std::ifstream file(path);
+
+		if (!file.is_open())
+		{
+			return true;
+		}
+
+		Histogram loaded;
+		std::string line;
+
+		while (std::getline(file, line))
+		{
+			if (line.empty() || line[0] == '#')
+			{
+				continue;
+			}
+
+			std::istringstream stream(line);
+			std::string stage;
+			uint32_t key = 0;
+			uint64_t value = 0;
+
+			stream >> stage >> std::hex >> key >> std::dec >> value;
+
+			if (stream.fail() || key >= KEY_COUNT || (stage != "vs" && stage != "ps"))
+			{
+				return false;
+			}
+
+			loaded.counts(stage == "vs" ? Stage::Vertex : Stage::Pixel)[key] += value;
+		}
+
+		for (uint32_t key = 0; key < KEY_COUNT; ++key)
+		{
+			vertex[key] += loaded.vertex[key];
+			pixel[key] += loaded.pixel[key];
+		}
+
+		return true;
+	}
+
+	// One line per permutation which has been drawn with: stage, key in hex, count.
+	// e.g. "vs b 1234"
+	bool Histogram::save(const std::string& path) const
+	{
+		std::ofstream file(path, std::ios::out | std::ios::trunc);
+
+		if (!file.is_open())
+		{
+			return false;
+		}
+
+		file << "# Draws per shader permutation: stage, cache key (hex), draws\n";
+
+		for (auto stage : { Stage::Vertex, Stage::Pixel })
+		{
+			const auto& c = counts(stage);
+
+			for (uint32_t key = 0; key < KEY_COUNT; ++key)
+			{
+				if (c[key])
+				{
+					file << stage_name(stage) << ' ' << std::hex << key << ' ' << std::dec << c[key] << '\n';
+				}
+			}
+		}
+
+		return file.good();
+	}
+}
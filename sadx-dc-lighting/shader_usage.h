@@ -0,0 +1,68 @@
+#pragma once
+
+// This header is intentionally free of game and Direct3D
+// dependencies so that it can be used and measured headlessly.
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * Counts how often each vertex and pixel shader permutation is drawn
+ * with, accumulated across sessions in a small text file.
+ *
+ * Keys are the same values the shader cache is keyed by: sanitized
+ * flags (plus vertex shader variant bits) masked to the flags each
+ * stage compiles with.
+ */
+namespace shader_usage
+{
+	/// Keys must be less than this.
+	constexpr uint32_t KEY_COUNT = 1024;
+
+	enum class Stage
+	{
+		Vertex,
+		Pixel
+	};
+
+	class Histogram
+	{
+		std::vector<uint64_t> vertex = std::vector<uint64_t>(KEY_COUNT);
+		std::vector<uint64_t> pixel  = std::vector<uint64_t>(KEY_COUNT);
+
+		std::vector<uint64_t>& counts(Stage stage);
+		const std::vector<uint64_t>& counts(Stage stage) const;
+
+	public:
+		/// Counts a draw made with the specified permutations. Out of range keys are ignored.
+		void add(uint32_t vs_key, uint32_t ps_key)
+		{
+			if (vs_key < KEY_COUNT && ps_key < KEY_COUNT)
+			{
+				++vertex[vs_key];
+				++pixel[ps_key];
+			}
+		}
+
+		uint64_t count(Stage stage, uint32_t key) const;
+		uint64_t total(Stage stage) const;
+
+		/// <summary>
+		/// Returns the most used keys, most used first, until together
+		/// they account for at least \p coverage (0 to 1) of all draws.
+		/// </summary>
+		std::vector<uint32_t> hottest(Stage stage, double coverage) const;
+
+		/// Returns the keys in \p candidates which have never been drawn with.
+		std::vector<uint32_t> unused(Stage stage, const std::vector<uint32_t>& candidates) const;
+
+		/// <summary>
+		/// Adds the counts stored in a file to this histogram. A missing file is treated as empty.
+		/// </summary>
+		/// <returns><c>false</c> if the file exists but is malformed, in which case nothing is added.</returns>
+		bool load(const std::string& path);
+		bool save(const std::string& path) const;
+	};
+}
@@ -0,0 +1,191 @@
+#pragma once
+
+// This header is intentionally free of game and Direct3D
+// dependencies so that it can be used and measured headlessly.
+
+#include <cstddef>
+#include <deque>
+#include <utility>
+
+#include "memory_accounting.h"
+
+/*
+ * Fixed-size, reference-counted blocks of T. Blocks are never returned
+ * to the heap; released blocks go on a free list and are handed out
+ * again by acquire, so churn costs no allocations once the pool has
+ * grown to the largest number of blocks held at once.
+ *
+ * References are cheap to copy and move. Copies share their block
+ * until one of them is written to through Ref::mutate, which gives
+ * that reference a block of its own (copy on write).
+ *
+ * Not thread-safe; reference counts are plain integers.
+ */
+template <typename T, memory_accounting::Tag TAG>
+class SharedPool
+{
+	struct Block
+	{
+		T value {};
+		size_t refs = 0;
+		Block* next_free = nullptr;
+	};
+
+	std::deque<Block, memory_accounting::Allocator<Block, TAG>> blocks;
+	Block* free_ = nullptr;
+	size_t in_use_ = 0;
+
+	Block* take()
+	{
+		Block* block;
+
+		if (free_ != nullptr)
+		{
+			block = free_;
+			free_ = block->next_free;
+		}
+		else
+		{
+			blocks.emplace_back();
+			block = &blocks.back();
+		}
+
+		block->refs = 1;
+		block->next_free = nullptr;
+		++in_use_;
+		return block;
+	}
+
+	void give(Block* block)
+	{
+		if (--block->refs == 0)
+		{
+			block->next_free = free_;
+			free_ = block;
+			--in_use_;
+		}
+	}
+
+public:
+	class Ref
+	{
+		friend class SharedPool;
+
+		SharedPool* pool  = nullptr;
+		Block*      block = nullptr;
+
+		Ref(SharedPool* pool, Block* block)
+			: pool(pool),
+			  block(block)
+		{
+		}
+
+	public:
+		Ref() = default;
+
+		Ref(const Ref& other)
+			: pool(other.pool),
+			  block(other.block)
+		{
+			if (block != nullptr)
+			{
+				++block->refs;
+			}
+		}
+
+		Ref(Ref&& other) noexcept
+			: pool(other.pool),
+			  block(other.block)
+		{
+			other.pool  = nullptr;
+			other.block = nullptr;
+		}
+
+		Ref& operator=(Ref other) noexcept
+		{
+			std::swap(pool, other.pool);
+			std::swap(block, other.block);
+			return *this;
+		}
+
+		~Ref()
+		{
+			if (block != nullptr)
+			{
+				pool->give(block);
+			}
+		}
+
+		explicit operator bool() const
+		{
+			return block != nullptr;
+		}
+
+		const T& operator*() const
+		{
+			return block->value;
+		}
+
+		const T* operator->() const
+		{
+			return &block->value;
+		}
+
+		/// Number of references sharing this block.
+		size_t refs() const
+		{
+			return block != nullptr ? block->refs : 0;
+		}
+
+		bool shares(const Ref& other) const
+		{
+			return block == other.block;
+		}
+
+		/// Returns the value for writing, first copying it into a block of its own if it's shared.
+		T& mutate()
+		{
+			if (block->refs > 1)
+			{
+				Block* copy = pool->take();
+				copy->value = block->value;
+				pool->give(block);
+				block = copy;
+			}
+
+			return block->value;
+		}
+	};
+
+	SharedPool() = default;
+	SharedPool(const SharedPool&) = delete;
+	SharedPool& operator=(const SharedPool&) = delete;
+
+	/// Returns a reference to an unshared, value-initialized block.
+	Ref acquire()
+	{
+		Ref result(this, take());
+		result.block->value = T {};
+		return result;
+	}
+
+	/// Returns a reference to an unshared block holding a copy of \p value.
+	Ref acquire(const T& value)
+	{
+		Ref result(this, take());
+		result.block->value = value;
+		return result;
+	}
+
+	/// Blocks currently referenced.
+	size_t in_use() const
+	{
+		return in_use_;
+	}
+
+	/// Blocks allocated, whether referenced or free.
+	size_t capacity() const
+	{
+		return blocks.size();
+	}
+};
@@ -0,0 +1,405 @@
+#include "stdafx.h"
+
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include <atlbase.h>
+#include <d3d9.h>
+#include <SADXModLoader.h>
+
+#include "d3d.h"
+#include "lantern.h"
+#include "palette_lighting.h"
+#include "software_lighting.h"
+
+namespace software_lighting
+{
+	static constexpr UINT VERTEX_BUFFER_SIZE = 1 << 21;
+	static constexpr size_t NO_ELEMENT = ~static_cast<size_t>(0);
+
+	/// Vertex layout of the dynamic vertex buffer.
+	struct Vertex
+	{
+		float position[3];
+		float normal[3];
+		uint32_t diffuse;
+		uint32_t specular;
+		float uv[2];
+	};
+
+	static constexpr DWORD VERTEX_FVF = D3DFVF_XYZ | D3DFVF_NORMAL | D3DFVF_DIFFUSE | D3DFVF_SPECULAR | D3DFVF_TEX1;
+	static_assert(sizeof(Vertex) == 40, "vertex size mismatch");
+
+	/// Offsets of the source vertex elements read while lighting.
+	struct Layout
+	{
+		size_t normal;
+		size_t color;
+		size_t uv;
+	};
+
+	static bool enabled_ = false;
+
+	static std::unordered_map<IDirect3DTexture9*, std::vector<uint32_t>> atlases;
+
+	static CComPtr<IDirect3DVertexBuffer9> vertex_buffer;
+	static UINT vertex_offset = 0;
+	static UINT uploaded_vertex = 0;
+
+	static Stats stats_ {};
+
+	void set_enabled(bool value)
+	{
+		enabled_ = value;
+	}
+
+	bool enabled()
+	{
+		return enabled_;
+	}
+
+	void update_atlas(IDirect3DTexture9* texture, size_t slot, const ColorPair* pairs)
+	{
+		if (!enabled_ || texture == nullptr)
+		{
+			return;
+		}
+
+		constexpr size_t SLOT_SIZE = palette_lighting::ROW_SIZE * palette_lighting::ROW_COUNT;
+
+		auto& atlas = atlases[texture];
+
+		if (atlas.size() < (slot + 1) * SLOT_SIZE)
+		{
+			atlas.resize((slot + 1) * SLOT_SIZE);
+		}
+
+		const auto rows = &atlas[slot * SLOT_SIZE];
+
+		// Same layout as palette_atlas::write_palette: a diffuse row then a specular row per palette.
+		for (size_t i = 0; i < palette_lighting::ROW_COUNT / 2; i++)
+		{
+			const auto diffuse  = &rows[(2 * i) * palette_lighting::ROW_SIZE];
+			const auto specular = &rows[(2 * i + 1) * palette_lighting::ROW_SIZE];
+
+			for (size_t x = 0; x < palette_lighting::ROW_SIZE; x++)
+			{
+				const auto& pair = pairs[i * palette_lighting::ROW_SIZE + x];
+
+				diffuse[x]  = pair.diffuse.color;
+				specular[x] = pair.specular.color;
+			}
+		}
+	}
+
+	void remove_atlas(IDirect3DTexture9* texture)
+	{
+		atlases.erase(texture);
+	}
+
+	static const std::vector<uint32_t>* find_atlas(const Texture& texture)
+	{
+		const auto it = atlases.find(texture.p);
+		return it != atlases.end() ? &it->second : nullptr;
+	}
+
+	static bool get_layout(DWORD fvf, Layout& layout)
+	{
+		if ((fvf & D3DFVF_POSITION_MASK) != D3DFVF_XYZ || !(fvf & D3DFVF_NORMAL))
+		{
+			return false;
+		}
+
+		size_t offset = sizeof(float) * 3;
+
+		layout.normal = offset;
+		offset += sizeof(float) * 3;
+
+		if (fvf & D3DFVF_PSIZE)
+		{
+			offset += sizeof(float);
+		}
+
+		layout.color = palette_lighting::NO_COLOR;
+
+		if (fvf & D3DFVF_DIFFUSE)
+		{
+			layout.color = offset;
+			offset += sizeof(uint32_t);
+		}
+
+		if (fvf & D3DFVF_SPECULAR)
+		{
+			offset += sizeof(uint32_t);
+		}
+
+		// Only the first texture coordinate set is used by the shader, and only as two floats.
+		const auto tex_count = (fvf & D3DFVF_TEXCOUNT_MASK) >> D3DFVF_TEXCOUNT_SHIFT;
+		layout.uv = tex_count > 0 && (fvf & D3DFVF_TEXCOORDSIZE1(0)) == D3DFVF_TEXCOORDSIZE2(0) ? offset : NO_ELEMENT;
+
+		return true;
+	}
+
+	static UINT vertex_count(D3DPRIMITIVETYPE type, UINT primitives)
+	{
+		switch (type)
+		{
+			case D3DPT_POINTLIST:
+				return primitives;
+			case D3DPT_LINELIST:
+				return primitives * 2;
+			case D3DPT_LINESTRIP:
+				return primitives + 1;
+			case D3DPT_TRIANGLELIST:
+				return primitives * 3;
+			case D3DPT_TRIANGLESTRIP:
+			case D3DPT_TRIANGLEFAN:
+				return primitives + 2;
+			default:
+				return 0;
+		}
+	}
+
+	static bool create()
+	{
+		if (vertex_buffer != nullptr)
+		{
+			return true;
+		}
+
+		const auto result = d3d::device->CreateVertexBuffer(VERTEX_BUFFER_SIZE, D3DUSAGE_DYNAMIC | D3DUSAGE_WRITEONLY,
+		                                                    VERTEX_FVF, D3DPOOL_DEFAULT, &vertex_buffer, nullptr);
+
+		if (FAILED(result))
+		{
+			vertex_buffer = nullptr;
+			return false;
+		}
+
+		vertex_offset = 0;
+		return true;
+	}
+
+	static palette_lighting::Parameters get_parameters(const std::vector<uint32_t>* atlas_a, const std::vector<uint32_t>* atlas_b)
+	{
+		palette_lighting::Parameters params {};
+
+		const auto& world = param::WorldMatrix.value();
+
+		for (int i = 0; i < 3; i++)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				params.world[i][j] = world.m[i][j];
+			}
+		}
+
+		const auto& normal_scale = param::NormalScale.value();
+		params.normal_scale[0] = normal_scale.x;
+		params.normal_scale[1] = normal_scale.y;
+		params.normal_scale[2] = normal_scale.z;
+
+		const auto& light_direction = param::LightDirection.value();
+		params.light_direction[0] = light_direction.x;
+		params.light_direction[1] = light_direction.y;
+		params.light_direction[2] = light_direction.z;
+
+		params.atlas_a    = atlas_a->data();
+		params.atlas_b    = atlas_b != nullptr ? atlas_b->data() : nullptr;
+		// Both samplers are bound to the same combined atlas.
+		params.atlas_rows = static_cast<uint32_t>(atlas_a->size() / palette_lighting::ROW_SIZE);
+
+		// Indices are texture coordinates at the center of each row.
+		const auto& indices = param::Indices.value();
+		params.diffuse_a  = static_cast<uint32_t>(indices.x * params.atlas_rows);
+		params.diffuse_b  = static_cast<uint32_t>(indices.y * params.atlas_rows);
+		params.specular_a = static_cast<uint32_t>(indices.z * params.atlas_rows);
+		params.specular_b = static_cast<uint32_t>(indices.w * params.atlas_rows);
+
+		params.blend          = atlas_b != nullptr;
+		params.blend_diffuse  = param::BlendFactor.value().x;
+		params.blend_specular = param::BlendFactor.value().y;
+
+		params.vertex_color_source = param::DiffuseSource.value() == D3DMCS_COLOR1;
+
+		const auto& material = param::MaterialDiffuse.value();
+		params.material_diffuse[0] = material.r;
+		params.material_diffuse[1] = material.g;
+		params.material_diffuse[2] = material.b;
+		params.material_diffuse[3] = material.a;
+
+		params.allow_vertex_color    = param::AllowVertexColor.value();
+		params.force_default_diffuse = param::ForceDefaultDiffuse.value();
+		params.diffuse_override      = param::DiffuseOverride.value();
+
+		const auto& override_color = param::DiffuseOverrideColor.value();
+		params.diffuse_override_color[0] = override_color.x;
+		params.diffuse_override_color[1] = override_color.y;
+		params.diffuse_override_color[2] = override_color.z;
+
+		return params;
+	}
+
+	bool upload(MeshSetBuffer* buffer)
+	{
+		const auto flags = d3d::get_flags();
+
+		if (!enabled_ || !d3d::do_effect || !(flags & ShaderFlags_Light) || buffer->VertexBuffer == nullptr)
+		{
+			return false;
+		}
+
+		const auto atlas_a = find_atlas(param::PaletteA.value());
+		const auto atlas_b = flags & ShaderFlags_Blend ? find_atlas(param::PaletteB.value()) : nullptr;
+
+		Layout layout {};
+
+		if (atlas_a == nullptr || !get_layout(buffer->FVF, layout))
+		{
+			++stats_.unlit_draws;
+			return false;
+		}
+
+		if (!d3d::readable(buffer->VertexBuffer))
+		{
+			++stats_.unlit_draws;
+			++stats_.unreadable_draws;
+			return false;
+		}
+
+		const bool indexed = buffer->IndexBuffer != nullptr;
+		const UINT first   = indexed ? buffer->MinIndex : buffer->StartIndex;
+		const UINT count   = indexed ? buffer->NumVertecies : vertex_count(buffer->PrimitiveType, buffer->PrimitiveCount);
+		const UINT stride  = buffer->Size;
+		const UINT size    = count * sizeof(Vertex);
+
+		if (!count || size > VERTEX_BUFFER_SIZE || !create())
+		{
+			++stats_.unlit_draws;
+			return false;
+		}
+
+		BYTE* source = nullptr;
+
+		if (FAILED(buffer->VertexBuffer->Lock(first * stride, count * stride, &source, D3DLOCK_READONLY)))
+		{
+			++stats_.unlit_draws;
+			return false;
+		}
+
+		// Vertices must start on a multiple of their size since they're drawn with a base vertex.
+		UINT offset = (vertex_offset + sizeof(Vertex) - 1) / sizeof(Vertex) * sizeof(Vertex);
+		DWORD lock_flags = D3DLOCK_NOOVERWRITE;
+
+		if (offset + size > VERTEX_BUFFER_SIZE)
+		{
+			offset     = 0;
+			lock_flags = D3DLOCK_DISCARD;
+		}
+
+		void* data = nullptr;
+
+		if (FAILED(vertex_buffer->Lock(offset, size, &data, lock_flags)))
+		{
+			buffer->VertexBuffer->Unlock();
+			++stats_.unlit_draws;
+			return false;
+		}
+
+		auto out = static_cast<Vertex*>(data);
+
+		for (UINT i = 0; i < count; i++)
+		{
+			const auto in = source + i * stride;
+
+			Vertex vertex {};
+			memcpy(vertex.position, in, sizeof(vertex.position));
+			memcpy(vertex.normal, in + layout.normal, sizeof(vertex.normal));
+
+			if (layout.uv != NO_ELEMENT)
+			{
+				memcpy(vertex.uv, in + layout.uv, sizeof(vertex.uv));
+			}
+
+			memcpy(&out[i], &vertex, sizeof(Vertex));
+		}
+
+		const palette_lighting::Input input = { source, stride, layout.normal, layout.color };
+		const palette_lighting::Output output = {
+			static_cast<uint8_t*>(data), sizeof(Vertex), offsetof(Vertex, diffuse), offsetof(Vertex, specular)
+		};
+
+		const auto threads = palette_lighting::light_parallel(get_parameters(atlas_a, atlas_b), input, output, count);
+
+		vertex_buffer->Unlock();
+		buffer->VertexBuffer->Unlock();
+
+		vertex_offset   = offset + size;
+		uploaded_vertex = offset / sizeof(Vertex);
+
+		d3d::device->SetFVF(VERTEX_FVF);
+		d3d::device->SetStreamSource(0, vertex_buffer, 0, sizeof(Vertex));
+
+		++stats_.draws;
+		stats_.vertices += count;
+
+		if (threads > 1)
+		{
+			++stats_.threaded_draws;
+		}
+
+		return true;
+	}
+
+	void draw(MeshSetBuffer* buffer)
+	{
+		d3d::draw_software_lit = true;
+
+		if (buffer->IndexBuffer != nullptr)
+		{
+			Direct3D_Device->SetIndices(buffer->IndexBuffer, 0);
+
+			// Lit vertices start at the uploaded vertex rather than at MinIndex.
+			d3d::device->DrawIndexedPrimitive(buffer->PrimitiveType,
+			                                  static_cast<INT>(uploaded_vertex) - buffer->MinIndex,
+			                                  buffer->MinIndex,
+			                                  buffer->NumVertecies,
+			                                  buffer->StartIndex,
+			                                  buffer->PrimitiveCount);
+		}
+		else
+		{
+			d3d::device->DrawPrimitive(buffer->PrimitiveType, uploaded_vertex, buffer->PrimitiveCount);
+		}
+
+		d3d::draw_software_lit = false;
+
+		// Restore the meshset's own stream in case the game
+		// assumes it's still bound from a previous draw.
+		Direct3D_Device->SetVertexShader(buffer->FVF);
+		Direct3D_Device->SetStreamSource(0, buffer->VertexBuffer, buffer->Size);
+	}
+
+	void release()
+	{
+		vertex_buffer = nullptr;
+		vertex_offset = 0;
+	}
+
+	void report()
+	{
+		if (stats_.draws || stats_.unlit_draws)
+		{
+			PrintDebug("[lantern] Software lighting: %u meshsets (%u threaded), %u vertices, %u drawn unlit (%u unreadable)\n",
+			           stats_.draws, stats_.threaded_draws, stats_.vertices, stats_.unlit_draws, stats_.unreadable_draws);
+		}
+
+		stats_ = {};
+	}
+
+	const Stats& stats()
+	{
+		return stats_;
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+
+#include <d3d9.h>
+
+#include "d3d.h"
+#include "lantern.h"
+
+/*
+ * Palette lighting on the CPU for devices which can't sample textures
+ * from the vertex shader. Lit meshsets are copied to a dynamic vertex
+ * buffer with the lit colors in the diffuse and specular streams, and
+ * drawn with a vertex shader which passes those colors through. Every
+ * other draw falls back to the light-free shader permutations.
+ */
+namespace software_lighting
+{
+	struct Stats
+	{
+		/// Meshsets lit on the CPU.
+		size_t draws;
+		/// Vertices lit on the CPU.
+		size_t vertices;
+		/// Meshsets which were split across more than one thread.
+		size_t threaded_draws;
+		/// Lit meshsets which had to be drawn without lighting.
+		size_t unlit_draws;
+		/// Of those, meshsets whose vertex buffer can't be locked for reading.
+		size_t unreadable_draws;
+	};
+
+	void set_enabled(bool value);
+	bool enabled();
+
+	/// <summary>
+	/// Keeps a CPU copy of a palette atlas so that it can be used while lighting.
+	/// Does nothing unless software lighting is enabled.
+	/// </summary>
+	/// <param name="texture">The atlas texture the palettes were written to.</param>
+	/// <param name="slot">Which group of 16 rows in the atlas the palettes were written to.</param>
+	/// <param name="pairs">256 diffuse and specular color pairs for each of the 8 palettes.</param>
+	void update_atlas(IDirect3DTexture9* texture, size_t slot, const ColorPair* pairs);
+	/// Drops the CPU copy of an atlas which is being released.
+	void remove_atlas(IDirect3DTexture9* texture);
+
+	/// <summary>
+	/// Lights a meshset buffer into the dynamic vertex buffer and binds it for drawing.
+	/// On success, must be followed by a call to <see cref="draw"/>.
+	/// </summary>
+	/// <returns><c>true</c> if the meshset was lit.</returns>
+	bool upload(MeshSetBuffer* buffer);
+	/// Draws the meshset buffer lit by \c upload and restores its own stream.
+	void draw(MeshSetBuffer* buffer);
+
+	/// Releases the dynamic vertex buffer. It is re-created on demand.
+	void release();
+
+	/// Prints statistics to the debug log and resets them.
+	void report();
+	const Stats& stats();
+}
@@ -63,6 +63,7 @@
 #include "ShaderParameter.h"
 #include "FixChaoGardenMaterials.h"
 #include "FixCharacterMaterials.h"
+#include "MaterialOverrides.h"
 #include "globals.h"
 #include "lantern.h"
 #include "Obj_Past.h"
@@ -71,6 +72,29 @@
 #include "Trampoline.h"
 #include "FileSystem.h"
 #include "polybuff.h"
+#include "polybuff_cache.h"
+#include "polybuff_indexed.h"
+#include "polybuff_kernels.h"
+#include "profiler.h"
+#include "vertex_cache.h"
+#include "landtable_optimizer.h"
+#include "landtable_prewarm.h"
+#include "frustum.h"
+#include "landtable_culling.h"
+#include "instancing.h"
+#include "palette_lighting.h"
+#include "software_lighting.h"
+#include "shader_reference.h"
+#include "trace.h"
+#include "trace_recorder.h"
+#include "frame_stats.h"
+#include "timeline.h"
+#include "shader_usage.h"
+#include "memory_accounting.h"
+#include "shared_pool.h"
+#include "palette_store.h"
+#include "load_callbacks.h"
+#include "api_queue.h"
 
 // Materials
 #include "ssgarden.h"
@@ -0,0 +1,167 @@
+#include "stdafx.h"
+
+#include <Windows.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "timeline.h"
+
+namespace timeline
+{
+	std::atomic<bool> enabled_(false);
+
+	struct Event
+	{
+		const char* name;
+		int64_t start;
+		int64_t end;
+	};
+
+	struct Ring
+	{
+		uint32_t thread;
+		/// Number of events ever recorded. Only written by the owning thread.
+		std::atomic<uint64_t> head;
+		Event events[RING_SIZE];
+	};
+
+	using clock = std::chrono::steady_clock;
+
+	static const clock::time_point epoch = clock::now();
+
+	static std::mutex rings_mutex;
+	static std::vector<std::unique_ptr<Ring>> rings;
+
+	// Each thread's ring. Explicit TLS rather than thread_local, which
+	// doesn't work in a DLL loaded with LoadLibrary on Windows XP.
+	// Allocated while the DLL loads and never freed, like the rings.
+	static const DWORD ring_slot = TlsAlloc();
+
+	void set_enabled(bool value)
+	{
+		enabled_.store(value, std::memory_order_relaxed);
+	}
+
+	int64_t now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - epoch).count();
+	}
+
+	// Rings outlive their threads so that their events can still be written.
+	static Ring* register_thread()
+	{
+		auto ring = std::make_unique<Ring>();
+		ring->head = 0;
+
+		std::lock_guard<std::mutex> lock(rings_mutex);
+		ring->thread = static_cast<uint32_t>(rings.size() + 1);
+		rings.push_back(std::move(ring));
+		return rings.back().get();
+	}
+
+	void record(const char* name, int64_t start, int64_t end)
+	{
+		if (ring_slot == TLS_OUT_OF_INDEXES)
+		{
+			return;
+		}
+
+		auto ring = static_cast<Ring*>(TlsGetValue(ring_slot));
+
+		if (ring == nullptr)
+		{
+			ring = register_thread();
+			TlsSetValue(ring_slot, ring);
+		}
+
+		const auto head = ring->head.load(std::memory_order_relaxed);
+		ring->events[head % RING_SIZE] = { name, start, end };
+		ring->head.store(head + 1, std::memory_order_release);
+	}
+
+	// Copies the events of a ring which may still be recording. Events are
+	// copied without synchronization, so the head is checked again afterwards
+	// and any event the owning thread may have overwritten is dropped.
+	static void snapshot(const Ring& ring, std::vector<Event>& events)
+	{
+		const auto head  = ring.head.load(std::memory_order_acquire);
+		const auto count = (std::min<uint64_t>)(head, RING_SIZE);
+
+		events.clear();
+
+		for (auto i = head - count; i < head; ++i)
+		{
+			events.push_back(ring.events[i % RING_SIZE]);
+		}
+
+		const auto after = ring.head.load(std::memory_order_acquire);
+
+		if (after + 1 > RING_SIZE)
+		{
+			const auto first_valid = after + 1 - RING_SIZE;
+			const auto first       = head - count;
+
+			if (first_valid > first)
+			{
+				const auto dropped = (std::min<uint64_t>)(first_valid - first, events.size());
+				events.erase(events.begin(), events.begin() + static_cast<ptrdiff_t>(dropped));
+			}
+		}
+	}
+
+	bool write(const std::string& path)
+	{
+		std::vector<Ring*> snapshot_rings;
+
+		{
+			std::lock_guard<std::mutex> lock(rings_mutex);
+
+			for (auto& ring : rings)
+			{
+				snapshot_rings.push_back(ring.get());
+			}
+		}
+
+		std::ofstream file(path, std::ios::out | std::ios::trunc);
+
+		if (!file.is_open())
+		{
+			return false;
+		}
+
+		file.setf(std::ios::fixed);
+		file.precision(3);
+
+		file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+		bool first = true;
+		std::vector<Event> events;
+
+		for (auto ring : snapshot_rings)
+		{
+			file << (first ? "\n" : ",\n")
+			     << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << ring->thread
+			     << ",\"args\":{\"name\":\"Thread " << ring->thread << "\"}}";
+
+			first = false;
+
+			snapshot(*ring, events);
+
+			for (auto& event : events)
+			{
+				file << ",\n{\"name\":\"" << event.name
+				     << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << ring->thread
+				     << ",\"ts\":" << static_cast<double>(event.start) / 1000.0
+				     << ",\"dur\":" << static_cast<double>(event.end - event.start) / 1000.0 << '}';
+			}
+		}
+
+		file << "\n]}\n";
+		return file.good();
+	}
+}
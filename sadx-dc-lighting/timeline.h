@@ -0,0 +1,75 @@
+#pragma once
+
+// This header is intentionally free of game and Direct3D
+// dependencies so that it can be used and measured headlessly.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+ * Scoped timeline markers which can be written out as Chrome trace
+ * event JSON (chrome://tracing, or ui.perfetto.dev).
+ *
+ * Each thread records into its own ring buffer, which only that thread
+ * writes to, so recording takes no locks. Once a ring is full, the
+ * oldest events are overwritten. While disabled, a marker costs a
+ * single relaxed load and branch.
+ *
+ * Marker names must be string literals or otherwise outlive the timeline.
+ */
+namespace timeline
+{
+	/// Events kept per thread.
+	constexpr size_t RING_SIZE = 1 << 16;
+
+	extern std::atomic<bool> enabled_;
+
+	void set_enabled(bool value);
+
+	inline bool enabled()
+	{
+		return enabled_.load(std::memory_order_relaxed);
+	}
+
+	/// Nanoseconds since the timeline was initialized.
+	int64_t now();
+
+	/// Records a complete event on the calling thread's ring.
+	void record(const char* name, int64_t start, int64_t end);
+
+	/// Writes the events in every thread's ring as Chrome trace event JSON.
+	/// Threads may keep recording while this runs.
+	bool write(const std::string& path);
+
+	class Scope
+	{
+		const char* name;
+		int64_t start;
+
+	public:
+		explicit Scope(const char* name)
+			: name(name),
+			  start(enabled() ? now() : -1)
+		{
+		}
+
+		~Scope()
+		{
+			if (start >= 0)
+			{
+				record(name, start, now());
+			}
+		}
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+	};
+}
+
+#define TIMELINE_CONCAT_(a, b) a ## b
+#define TIMELINE_CONCAT(a, b) TIMELINE_CONCAT_(a, b)
+
+#define TIMELINE_SCOPE(NAME) \
+	timeline::Scope TIMELINE_CONCAT(_timeline_scope_, __LINE__)(NAME)
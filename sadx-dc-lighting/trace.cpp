@@ -0,0 +1,204 @@
+#include "stdafx.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "trace.h"
+
+namespace trace
+{
+	bool Writer::open(const std::string& path)
+	{
+		close();
+
+		file.open(path, std::ios::binary | std::ios::out | std::ios::trunc);
+
+		if (!file.is_open())
+		{
+			return false;
+		}
+
+		const FileHeader header = { MAGIC, VERSION, 0 };
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		return true;
+	}
+
+	void Writer::close()
+	{
+		if (file.is_open())
+		{
+			file.close();
+		}
+	}
+
+	bool Writer::is_open() const
+	{
+		return file.is_open();
+	}
+
+	void Writer::write(Event type, const void* data, uint16_t size)
+	{
+		if (!file.is_open())
+		{
+			return;
+		}
+
+		const EventHeader header = { type, size };
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(static_cast<const char*>(data), size);
+	}
+
+	// Copies the payload so that handlers get an aligned struct. Payloads from
+	// newer versions may be larger than the struct; the extra bytes are ignored.
+	template <typename T>
+	static bool dispatch(const uint8_t* payload, uint16_t size, Handler& handler, void (Handler::*method)(const T&))
+	{
+		if (size < sizeof(T))
+		{
+			return false;
+		}
+
+		T event;
+		memcpy(&event, payload, sizeof(T));
+		(handler.*method)(event);
+		return true;
+	}
+
+	bool replay(const uint8_t* data, size_t size, Handler& handler)
+	{
+		FileHeader file_header;
+
+		if (size < sizeof(file_header))
+		{
+			return false;
+		}
+
+		memcpy(&file_header, data, sizeof(file_header));
+
+		if (file_header.magic != MAGIC || file_header.version > VERSION)
+		{
+			return false;
+		}
+
+		size_t offset = sizeof(file_header);
+
+		while (offset < size)
+		{
+			EventHeader header;
+
+			if (size - offset < sizeof(header))
+			{
+				return false;
+			}
+
+			memcpy(&header, data + offset, sizeof(header));
+			offset += sizeof(header);
+
+			if (size - offset < header.size)
+			{
+				return false;
+			}
+
+			const auto payload = data + offset;
+			offset += header.size;
+
+			bool valid = true;
+
+			switch (header.type)
+			{
+				case Event::Frame:
+					valid = dispatch(payload, header.size, handler, &Handler::on_frame);
+					break;
+				case Event::ParseMaterial:
+					valid = dispatch(payload, header.size, handler, &Handler::on_parse_material);
+					break;
+				case Event::SetTexList:
+					valid = dispatch(payload, header.size, handler, &Handler::on_set_texlist);
+					break;
+				case Event::PerformLighting:
+					valid = dispatch(payload, header.size, handler, &Handler::on_perform_lighting);
+					break;
+				case Event::WorldTransform:
+					valid = dispatch(payload, header.size, handler, &Handler::on_world_transform);
+					break;
+				case Event::ProjectionMatrix:
+					valid = dispatch(payload, header.size, handler, &Handler::on_projection_matrix);
+					break;
+				case Event::FogEnable:
+					valid = dispatch(payload, header.size, handler, &Handler::on_fog_enable);
+					break;
+				case Event::FogColor:
+					valid = dispatch(payload, header.size, handler, &Handler::on_fog_color);
+					break;
+				case Event::FogTable:
+					valid = dispatch(payload, header.size, handler, &Handler::on_fog_table);
+					break;
+				case Event::Draw:
+					valid = dispatch(payload, header.size, handler, &Handler::on_draw);
+					break;
+				default:
+					break;
+			}
+
+			if (!valid)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	bool replay_file(const std::string& path, Handler& handler)
+	{
+		std::ifstream file(path, std::ios::binary);
+
+		if (!file.is_open())
+		{
+			return false;
+		}
+
+		const std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		return replay(data.data(), data.size(), handler);
+	}
+
+	void StatsHandler::on_frame(const Frame&)
+	{
+		frames.push_back(current);
+		current = {};
+	}
+
+	void StatsHandler::on_parse_material(const ParseMaterial&)
+	{
+		++current.materials;
+	}
+
+	void StatsHandler::on_set_texlist(const SetTexList& event)
+	{
+		if (event.texlist != last_texlist)
+		{
+			++current.texlist_changes;
+			last_texlist = event.texlist;
+		}
+	}
+
+	void StatsHandler::on_draw(const Draw& event)
+	{
+		++current.draws;
+		current.primitives += event.primitive_count;
+
+		if (!event.shader_flags)
+		{
+			return;
+		}
+
+		++current.shader_draws;
+
+		if (event.shader_flags != last_flags)
+		{
+			++current.shader_changes;
+			last_flags = event.shader_flags;
+		}
+	}
+}
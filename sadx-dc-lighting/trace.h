@@ -0,0 +1,224 @@
+#pragma once
+
+// This header is intentionally free of game and Direct3D
+// dependencies so that it can be used and measured headlessly.
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/*
+ * A compact binary trace of the hook events that drive the lantern
+ * state machine, recorded in game by trace_recorder and replayed
+ * offline through a Handler, as tools/trace_replay does.
+ *
+ * A trace is a FileHeader followed by events. Each event is an
+ * EventHeader followed by its payload. Payloads are packed structs
+ * written in the recording machine's byte order. Pointers from the
+ * game are stored as 32-bit values which only serve as identities.
+ */
+namespace trace
+{
+	constexpr uint32_t MAGIC   = 0x4352544C; // "LTRC"
+	constexpr uint16_t VERSION = 1;
+
+	enum class Event : uint8_t
+	{
+		Frame = 1,
+		ParseMaterial,
+		SetTexList,
+		PerformLighting,
+		WorldTransform,
+		ProjectionMatrix,
+		FogEnable,
+		FogColor,
+		FogTable,
+		Draw,
+		Count
+	};
+
+	enum class DrawKind : uint8_t
+	{
+		Primitive,
+		IndexedPrimitive,
+		PrimitiveUP,
+		IndexedPrimitiveUP
+	};
+
+#pragma pack(push, 1)
+	struct FileHeader
+	{
+		uint32_t magic;
+		uint16_t version;
+		uint16_t reserved;
+	};
+
+	struct EventHeader
+	{
+		Event type;
+		uint16_t size;
+	};
+
+	/// End of a frame.
+	struct Frame
+	{
+		static constexpr Event type = Event::Frame;
+		uint32_t index;
+	};
+
+	/// A material parsed by the game, and the globals which decide its flags.
+	struct ParseMaterial
+	{
+		static constexpr Event type = Event::ParseMaterial;
+		uint32_t material;
+		uint32_t attrflags;
+		uint32_t diffuse;
+		uint32_t specular;
+		uint32_t attr_texId;
+		uint32_t control_3d;
+		uint32_t constant_attr_and;
+		uint32_t constant_attr_or;
+		int32_t light_type;
+	};
+
+	struct SetTexList
+	{
+		static constexpr Event type = Event::SetTexList;
+		uint32_t texlist;
+		uint32_t count;
+	};
+
+	struct PerformLighting
+	{
+		static constexpr Event type = Event::PerformLighting;
+		int32_t light_type;
+	};
+
+	/// Row-major world and view matrices after the game's transform update.
+	struct WorldTransform
+	{
+		static constexpr Event type = Event::WorldTransform;
+		float world[16];
+		float view[16];
+	};
+
+	struct ProjectionMatrix
+	{
+		static constexpr Event type = Event::ProjectionMatrix;
+		float hfov;
+		float near_plane;
+		float far_plane;
+		/// The projection matrix given to the shaders.
+		float projection[16];
+	};
+
+	struct FogEnable
+	{
+		static constexpr Event type = Event::FogEnable;
+		uint8_t enabled;
+	};
+
+	struct FogColor
+	{
+		static constexpr Event type = Event::FogColor;
+		uint32_t color;
+	};
+
+	struct FogTable
+	{
+		static constexpr Event type = Event::FogTable;
+		uint32_t mode;
+		float start;
+		float end;
+		float density;
+	};
+
+	/// A draw call, and the shader permutation it was drawn with.
+	struct Draw
+	{
+		static constexpr Event type = Event::Draw;
+		DrawKind kind;
+		uint8_t primitive_type;
+		uint32_t primitive_count;
+		uint32_t vertex_count;
+		/// Shader flags (including vertex shader variants), or 0 if drawn without the shaders.
+		uint32_t shader_flags;
+	};
+#pragma pack(pop)
+
+	class Writer
+	{
+		std::ofstream file;
+
+		void write(Event type, const void* data, uint16_t size);
+
+	public:
+		/// Creates the file and writes the file header.
+		bool open(const std::string& path);
+		void close();
+		bool is_open() const;
+
+		template <typename T>
+		void write(const T& event)
+		{
+			write(T::type, &event, static_cast<uint16_t>(sizeof(T)));
+		}
+	};
+
+	/// Receives replayed events. Every method does nothing by default.
+	class Handler
+	{
+	public:
+		virtual ~Handler() = default;
+
+		virtual void on_frame(const Frame&) {}
+		virtual void on_parse_material(const ParseMaterial&) {}
+		virtual void on_set_texlist(const SetTexList&) {}
+		virtual void on_perform_lighting(const PerformLighting&) {}
+		virtual void on_world_transform(const WorldTransform&) {}
+		virtual void on_projection_matrix(const ProjectionMatrix&) {}
+		virtual void on_fog_enable(const FogEnable&) {}
+		virtual void on_fog_color(const FogColor&) {}
+		virtual void on_fog_table(const FogTable&) {}
+		virtual void on_draw(const Draw&) {}
+	};
+
+	/// <summary>
+	/// Replays every event in a trace in order.
+	/// Events of unknown types are skipped, so newer traces can still be read.
+	/// </summary>
+	/// <returns><c>false</c> if the trace is malformed. Events before the error have been replayed.</returns>
+	bool replay(const uint8_t* data, size_t size, Handler& handler);
+	bool replay_file(const std::string& path, Handler& handler);
+
+	/// Per-frame counters gathered by \c StatsHandler.
+	struct FrameStats
+	{
+		size_t materials;
+		size_t texlist_changes;
+		size_t draws;
+		/// Draws made with the shaders.
+		size_t shader_draws;
+		/// Changes of shader permutation between shader draws.
+		size_t shader_changes;
+		size_t primitives;
+	};
+
+	/// Collects per-frame statistics from a replayed trace.
+	class StatsHandler : public Handler
+	{
+		FrameStats current {};
+		uint32_t last_flags = 0;
+		uint32_t last_texlist = 0;
+
+	public:
+		std::vector<FrameStats> frames;
+
+		void on_frame(const Frame&) override;
+		void on_parse_material(const ParseMaterial&) override;
+		void on_set_texlist(const SetTexList&) override;
+		void on_draw(const Draw&) override;
+	};
+}
@@ -0,0 +1,150 @@
+#include "stdafx.h"
+
+#include "trace_recorder.h"
+
+#ifdef LANTERN_TRACE
+
+#include <cstring>
+
+#include <SADXModLoader.h>
+
+#include "globals.h"
+
+namespace trace_recorder
+{
+	static trace::Writer writer;
+	static uint32_t frame_index = 0;
+	static uint32_t frame_limit = 0;
+
+	static uint32_t id(const void* pointer)
+	{
+		return static_cast<uint32_t>(reinterpret_cast<uintptr_t>(pointer));
+	}
+
+	// Non-indexed draws don't specify a vertex count, so it's derived from the primitive count.
+	static UINT primitive_vertices(D3DPRIMITIVETYPE type, UINT primitive_count)
+	{
+		switch (type)
+		{
+			case D3DPT_LINELIST:
+				return primitive_count * 2;
+			case D3DPT_LINESTRIP:
+				return primitive_count + 1;
+			case D3DPT_TRIANGLELIST:
+				return primitive_count * 3;
+			case D3DPT_TRIANGLESTRIP:
+			case D3DPT_TRIANGLEFAN:
+				return primitive_count + 2;
+			default:
+				return primitive_count;
+		}
+	}
+
+	void start(const std::string& path, uint32_t frames)
+	{
+		if (!frames || !writer.open(path))
+		{
+			return;
+		}
+
+		frame_index = 0;
+		frame_limit = frames;
+
+		PrintDebug("[lantern] Recording %u frames to %s\n", frames, path.c_str());
+	}
+
+	bool recording()
+	{
+		return writer.is_open();
+	}
+
+	void frame()
+	{
+		writer.write(trace::Frame { frame_index });
+
+		if (++frame_index >= frame_limit)
+		{
+			writer.close();
+			PrintDebug("[lantern] Trace recording finished.\n");
+		}
+	}
+
+	void parse_material(const NJS_MATERIAL* material)
+	{
+		trace::ParseMaterial event;
+
+		event.material          = id(material);
+		event.attrflags         = material->attrflags;
+		event.diffuse           = material->diffuse.color;
+		event.specular          = material->specular.color;
+		event.attr_texId        = material->attr_texId;
+		event.control_3d        = _nj_control_3d_flag_;
+		event.constant_attr_and = _nj_constant_attr_and_;
+		event.constant_attr_or  = _nj_constant_attr_or_;
+		event.light_type        = globals::light_type;
+
+		writer.write(event);
+	}
+
+	void set_texlist(const NJS_TEXLIST* texlist)
+	{
+		writer.write(trace::SetTexList { id(texlist), texlist != nullptr ? texlist->nbTexture : 0 });
+	}
+
+	void perform_lighting(int type)
+	{
+		writer.write(trace::PerformLighting { type });
+	}
+
+	void world_transform()
+	{
+		trace::WorldTransform event;
+
+		memcpy(event.world, &WorldMatrix, sizeof(event.world));
+		memcpy(event.view, &ViewMatrix, sizeof(event.view));
+
+		writer.write(event);
+	}
+
+	void projection_matrix(float hfov, float near_plane, float far_plane, const D3DXMATRIX& projection)
+	{
+		trace::ProjectionMatrix event;
+
+		event.hfov       = hfov;
+		event.near_plane = near_plane;
+		event.far_plane  = far_plane;
+		memcpy(event.projection, &projection, sizeof(event.projection));
+
+		writer.write(event);
+	}
+
+	void fog_enable(bool enabled)
+	{
+		writer.write(trace::FogEnable { static_cast<uint8_t>(enabled) });
+	}
+
+	void fog_color(Uint32 color)
+	{
+		writer.write(trace::FogColor { color });
+	}
+
+	void fog_table(D3DFOGMODE mode, float start, float end, float density)
+	{
+		writer.write(trace::FogTable { static_cast<uint32_t>(mode), start, end, density });
+	}
+
+	void draw(trace::DrawKind kind, D3DPRIMITIVETYPE type, UINT primitive_count, UINT vertex_count, Uint32 shader_flags)
+	{
+		trace::Draw event;
+
+		event.kind            = kind;
+		event.primitive_type  = static_cast<uint8_t>(type);
+		event.primitive_count = primitive_count;
+		event.vertex_count    = vertex_count ? vertex_count : primitive_vertices(type, primitive_count);
+		event.shader_flags    = shader_flags;
+
+		writer.write(event);
+	}
+}
+
+#endif
@@ -0,0 +1,51 @@
+#pragma once
+
+// Trace recording is always available in debug builds. Define
+// LANTERN_TRACE to enable it in release builds as well.
+// When disabled, TRACE_EVENT compiles to nothing.
+#if defined(_DEBUG) && !defined(LANTERN_TRACE)
+#define LANTERN_TRACE
+#endif
+
+#ifdef LANTERN_TRACE
+
+#include <cstdint>
+#include <string>
+
+#include <d3dx9.h>
+#include <ninja.h>
+
+#include "trace.h"
+
+/*
+ * Records hook events to a trace file (see trace.h) for a number of
+ * frames, set by TraceFrames in the Debug section of config.ini.
+ */
+namespace trace_recorder
+{
+	/// Starts recording to the specified path for the specified number of frames.
+	void start(const std::string& path, uint32_t frames);
+	bool recording();
+
+	/// Ends the current frame, and stops recording once enough frames have been recorded.
+	void frame();
+	void parse_material(const NJS_MATERIAL* material);
+	void set_texlist(const NJS_TEXLIST* texlist);
+	void perform_lighting(int type);
+	void world_transform();
+	void projection_matrix(float hfov, float near_plane, float far_plane, const D3DXMATRIX& projection);
+	void fog_enable(bool enabled);
+	void fog_color(Uint32 color);
+	void fog_table(D3DFOGMODE mode, float start, float end, float density);
+	/// Records a draw. A vertex count of 0 is derived from the primitive type and count.
+	void draw(trace::DrawKind kind, D3DPRIMITIVETYPE type, UINT primitive_count, UINT vertex_count, Uint32 shader_flags);
+}
+
+#define TRACE_EVENT(NAME, ...) \
+	do { if (trace_recorder::recording()) { trace_recorder::NAME(__VA_ARGS__); } } while (0)
+
+#else
+
+#define TRACE_EVENT(NAME, ...) ((void)0)
+
+#endif
@@ -0,0 +1,262 @@
+#include "stdafx.h"
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+
+#include "vertex_cache.h"
+
+namespace vertex_cache
+{
+	float Metrics::acmr() const
+	{
+		return triangles ? static_cast<float>(misses) / static_cast<float>(triangles) : 0.0f;
+	}
+
+	float Metrics::atvr() const
+	{
+		return vertices ? static_cast<float>(misses) / static_cast<float>(vertices) : 0.0f;
+	}
+
+	Metrics measure(const std::vector<uint16_t>& indices, size_t vertex_count, size_t cache_size)
+	{
+		Metrics result = { indices.size() / 3, 0, 0 };
+
+		std::vector<bool> referenced(vertex_count);
+		std::deque<uint16_t> fifo;
+
+		for (auto i : indices)
+		{
+			if (!referenced[i])
+			{
+				referenced[i] = true;
+				++result.vertices;
+			}
+
+			if (std::find(fifo.begin(), fifo.end(), i) != fifo.end())
+			{
+				continue;
+			}
+
+			++result.misses;
+			fifo.push_back(i);
+
+			if (fifo.size() > cache_size)
+			{
+				fifo.pop_front();
+			}
+		}
+
+		return result;
+	}
+
+#pragma region Forsyth
+
+	// Tuning values from Forsyth's original description of the algorithm.
+	static constexpr float CACHE_DECAY_POWER   = 1.5f;
+	static constexpr float LAST_TRI_SCORE      = 0.75f;
+	static constexpr float VALENCE_BOOST_SCALE = 2.0f;
+	static constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+	static float vertex_score(int cache_position, uint32_t remaining)
+	{
+		if (!remaining)
+		{
+			// No triangles left to use this vertex.
+			return -1.0f;
+		}
+
+		float score = 0.0f;
+
+		if (cache_position >= 0)
+		{
+			if (cache_position < 3)
+			{
+				// Vertices used by the last triangle get a fixed score regardless of
+				// their position so that the algorithm doesn't prefer one of its edges.
+				score = LAST_TRI_SCORE;
+			}
+			else
+			{
+				const float scale = 1.0f / static_cast<float>(CACHE_SIZE - 3);
+				score = std::pow(1.0f - static_cast<float>(cache_position - 3) * scale, CACHE_DECAY_POWER);
+			}
+		}
+
+		// Boost vertices with few remaining triangles so that lone triangles get cleared out.
+		score += VALENCE_BOOST_SCALE * std::pow(static_cast<float>(remaining), -VALENCE_BOOST_POWER);
+		return score;
+	}
+
+	std::vector<uint16_t> optimize(const std::vector<uint16_t>& indices, size_t vertex_count)
+	{
+		const size_t triangle_count = indices.size() / 3;
+
+		// Per-vertex lists of triangles which haven't been added yet.
+		std::vector<uint32_t> offsets(vertex_count + 1);
+		std::vector<uint32_t> remaining(vertex_count);
+
+		for (auto i : indices)
+		{
+			++remaining[i];
+		}
+
+		for (size_t v = 0; v < vertex_count; v++)
+		{
+			offsets[v + 1] = offsets[v] + remaining[v];
+		}
+
+		std::vector<uint32_t> adjacency(indices.size());
+		std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+
+		for (size_t t = 0; t < triangle_count; t++)
+		{
+			for (size_t k = 0; k < 3; k++)
+			{
+				adjacency[fill[indices[t * 3 + k]]++] = static_cast<uint32_t>(t);
+			}
+		}
+
+		std::vector<int> cache_position(vertex_count, -1);
+		std::vector<float> v_score(vertex_count);
+
+		for (size_t v = 0; v < vertex_count; v++)
+		{
+			v_score[v] = vertex_score(-1, remaining[v]);
+		}
+
+		std::vector<float> t_score(triangle_count);
+		std::vector<bool> added(triangle_count);
+
+		for (size_t t = 0; t < triangle_count; t++)
+		{
+			t_score[t] = v_score[indices[t * 3]] + v_score[indices[t * 3 + 1]] + v_score[indices[t * 3 + 2]];
+		}
+
+		std::vector<uint16_t> result;
+		result.reserve(indices.size());
+
+		// The cache briefly holds up to three extra entries while triangles are added.
+		uint16_t cache[CACHE_SIZE + 3];
+		size_t cache_count = 0;
+
+		size_t cursor = 0;
+		int best = -1;
+
+		for (size_t emitted = 0; emitted < triangle_count; emitted++)
+		{
+			if (best < 0)
+			{
+				// Nothing useful is left in the cache, so take the next triangle that hasn't been added.
+				while (added[cursor])
+				{
+					++cursor;
+				}
+
+				best = static_cast<int>(cursor);
+			}
+
+			const uint16_t* tri = &indices[best * 3];
+			added[best] = true;
+
+			for (size_t k = 0; k < 3; k++)
+			{
+				const auto v = tri[k];
+				result.push_back(v);
+
+				// Remove the triangle from the vertex's list of remaining triangles.
+				const auto begin = adjacency.begin() + offsets[v];
+				const auto end   = begin + remaining[v];
+				const auto it    = std::find(begin, end, static_cast<uint32_t>(best));
+
+				std::iter_swap(it, end - 1);
+				--remaining[v];
+			}
+
+			// Push the triangle's vertices to the front of the cache.
+			uint16_t next[CACHE_SIZE + 3];
+			size_t next_count = 0;
+
+			for (size_t k = 0; k < 3; k++)
+			{
+				next[next_count++] = tri[k];
+			}
+
+			for (size_t i = 0; i < cache_count; i++)
+			{
+				const auto v = cache[i];
+
+				if (v != tri[0] && v != tri[1] && v != tri[2])
+				{
+					next[next_count++] = v;
+				}
+			}
+
+			// Update the scores of everything that was in the cache, including
+			// vertices which have just been pushed out of it.
+			for (size_t i = 0; i < next_count; i++)
+			{
+				const auto v = next[i];
+				cache_position[v] = i < CACHE_SIZE ? static_cast<int>(i) : -1;
+				v_score[v] = vertex_score(cache_position[v], remaining[v]);
+			}
+
+			best = -1;
+			float best_score = -1.0f;
+
+			for (size_t i = 0; i < next_count; i++)
+			{
+				const auto v = next[i];
+
+				for (uint32_t j = 0; j < remaining[v]; j++)
+				{
+					const auto t = adjacency[offsets[v] + j];
+					const uint16_t* other = &indices[t * 3];
+
+					t_score[t] = v_score[other[0]] + v_score[other[1]] + v_score[other[2]];
+
+					if (t_score[t] > best_score)
+					{
+						best_score = t_score[t];
+						best = static_cast<int>(t);
+					}
+				}
+			}
+
+			cache_count = (std::min)(next_count, CACHE_SIZE);
+			std::copy(next, next + cache_count, cache);
+		}
+
+		return result;
+	}
+
+#pragma endregion
+
+	std::vector<uint16_t> optimize_fetch(std::vector<uint16_t>& indices, size_t vertex_count)
+	{
+		static constexpr uint16_t unassigned = 0xFFFF;
+
+		// The sentinel can't also be a vertex index.
+		if (vertex_count > unassigned)
+		{
+			return {};
+		}
+
+		std::vector<uint16_t> remap(vertex_count, unassigned);
+		std::vector<uint16_t> order;
+		order.reserve(vertex_count);
+
+		for (auto& i : indices)
+		{
+			if (remap[i] == unassigned)
+			{
+				remap[i] = static_cast<uint16_t>(order.size());
+				order.push_back(i);
+			}
+
+			i = remap[i];
+		}
+
+		return order;
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+// This header is intentionally free of game and Direct3D
+// dependencies so that it can be used and measured headlessly.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vertex_cache
+{
+	/// Size of the simulated post-transform vertex cache.
+	constexpr size_t CACHE_SIZE = 32;
+
+	struct Metrics
+	{
+		size_t triangles;
+		size_t vertices;
+		size_t misses;
+
+		/// Average cache miss ratio: transformed vertices per triangle.
+		float acmr() const;
+		/// Average transform to vertex ratio: transformed vertices per unique vertex.
+		float atvr() const;
+	};
+
+	/// <summary>
+	/// Simulates a FIFO post-transform vertex cache over an indexed triangle list.
+	/// </summary>
+	/// <param name="indices">Triangle list indices.</param>
+	/// <param name="vertex_count">Number of vertices referenced by <paramref name="indices"/>.</param>
+	/// <param name="cache_size">Number of entries in the simulated cache.</param>
+	Metrics measure(const std::vector<uint16_t>& indices, size_t vertex_count, size_t cache_size = CACHE_SIZE);
+
+	/// <summary>
+	/// Reorders triangles for post-transform vertex cache efficiency using
+	/// Tom Forsyth's linear-speed vertex cache optimization algorithm.
+	/// </summary>
+	/// <param name="indices">Triangle list indices.</param>
+	/// <param name="vertex_count">Number of vertices referenced by <paramref name="indices"/>.</param>
+	/// <returns>The reordered triangle list.</returns>
+	std::vector<uint16_t> optimize(const std::vector<uint16_t>& indices, size_t vertex_count);
+
+	/// <summary>
+	/// Renumbers vertices in the order they're first referenced so that
+	/// vertex fetches are as linear as possible.
+	/// </summary>
+	/// <param name="indices">Triangle list indices. These are renumbered in place.</param>
+	/// <param name="vertex_count">
+	/// Number of vertices referenced by <paramref name="indices"/>. Must be at most 0xFFFF;
+	/// larger meshes are left untouched and an empty order is returned.
+	/// </param>
+	/// <returns>For each new vertex, the index of the original vertex it was taken from.</returns>
+	std::vector<uint16_t> optimize_fetch(std::vector<uint16_t>& indices, size_t vertex_count);
+}
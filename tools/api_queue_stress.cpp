@@ -0,0 +1,145 @@
+// API queue stress test.
+//
+// Sixteen producer threads defer commands onto the API queue as fast as they
+// can while the render thread drains it, so the queue is full most of the
+// time and producers keep racing for the same cells. Checks that every
+// command runs exactly once, on the render thread, and that each producer's
+// commands run in the order they were deferred. Build and run with:
+//
+//     g++ -std=c++14 -O2 -pthread -o api_queue_stress tools/api_queue_stress.cpp sadx-dc-lighting/api_queue.cpp
+//     ./api_queue_stress
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "../sadx-dc-lighting/api_queue.h"
+
+static constexpr uint32_t PRODUCERS = 16;
+static constexpr uint32_t COMMANDS  = 100000;
+
+// Only touched by commands, which must all run on the render thread.
+static uint32_t last[PRODUCERS];
+static uint64_t sums[PRODUCERS];
+static size_t out_of_order = 0;
+static size_t off_thread   = 0;
+static size_t ran          = 0;
+
+static std::thread::id render_thread;
+
+int main()
+{
+	// With no render thread set, every call runs directly.
+	if (api_queue::defer([] {}))
+	{
+		printf("FAIL a command was deferred before the render thread was set\n");
+		return 1;
+	}
+
+	api_queue::set_render_thread();
+	render_thread = std::this_thread::get_id();
+
+	if (api_queue::defer([] {}))
+	{
+		printf("FAIL a command was deferred on the render thread\n");
+		return 1;
+	}
+
+	std::atomic<uint32_t> finished { 0 };
+	std::atomic<size_t> not_deferred { 0 };
+	std::vector<std::thread> producers;
+
+	const auto start = std::chrono::steady_clock::now();
+
+	for (uint32_t p = 0; p < PRODUCERS; p++)
+	{
+		producers.emplace_back([&, p]
+		{
+			for (uint32_t i = 1; i <= COMMANDS; i++)
+			{
+				const bool deferred = api_queue::defer([p, i]
+				{
+					if (std::this_thread::get_id() != render_thread)
+					{
+						++off_thread;
+					}
+
+					if (i != last[p] + 1)
+					{
+						++out_of_order;
+					}
+
+					last[p] = i;
+					sums[p] += i;
+					++ran;
+				});
+
+				if (!deferred)
+				{
+					++not_deferred;
+				}
+			}
+
+			++finished;
+		});
+	}
+
+	while (finished < PRODUCERS)
+	{
+		api_queue::drain();
+	}
+
+	while (api_queue::drain())
+	{
+	}
+
+	for (auto& t : producers)
+	{
+		t.join();
+	}
+
+	const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	bool result = true;
+
+	if (not_deferred)
+	{
+		printf("FAIL %zu commands from producer threads ran directly\n", not_deferred.load());
+		result = false;
+	}
+
+	if (off_thread)
+	{
+		printf("FAIL %zu commands ran off the render thread\n", off_thread);
+		result = false;
+	}
+
+	if (out_of_order)
+	{
+		printf("FAIL %zu commands ran out of order\n", out_of_order);
+		result = false;
+	}
+
+	const uint64_t expected = static_cast<uint64_t>(COMMANDS) * (COMMANDS + 1) / 2;
+
+	for (uint32_t p = 0; p < PRODUCERS; p++)
+	{
+		if (last[p] != COMMANDS || sums[p] != expected)
+		{
+			printf("FAIL producer %u: last command %u, sum %llu, expected %u and %llu\n", p, last[p],
+			       static_cast<unsigned long long>(sums[p]), COMMANDS, static_cast<unsigned long long>(expected));
+			result = false;
+		}
+	}
+
+	if (!result)
+	{
+		return 1;
+	}
+
+	printf("ok   %zu commands from %u producers in %.1f ms (%.0f ns/command)\n", ran, PRODUCERS, ms, ms * 1e6 / ran);
+	return 0;
+}
@@ -0,0 +1,311 @@
+// Landtable frustum culling test and benchmark.
+//
+// Culls a landtable-sized set of bounding spheres for every frame of a camera
+// path with frustum::SphereSet, checks that the visible lists match a scalar
+// sphere-by-sphere reference, and reports the visible and culled counts and the
+// time per frame of both. The camera path is read from a trace recorded in game
+// (see TraceFrames in config.ini), using the last view and projection matrices
+// of each frame, or is a fly-through around the spheres if no trace is given.
+// Build and run with:
+//
+//     g++ -std=c++14 -O2 -o frustum_bench tools/frustum_bench.cpp sadx-dc-lighting/frustum.cpp sadx-dc-lighting/trace.cpp
+//     ./frustum_bench [--bench] [lantern.trace]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../sadx-dc-lighting/frustum.h"
+#include "../sadx-dc-lighting/trace.h"
+
+struct Matrix
+{
+	float m[16];
+};
+
+struct Sphere
+{
+	float x, y, z, r;
+};
+
+// Row-major, row vectors: the product transforms by a, then by b.
+static Matrix multiply(const Matrix& a, const Matrix& b)
+{
+	Matrix result {};
+
+	for (int row = 0; row < 4; row++)
+	{
+		for (int column = 0; column < 4; column++)
+		{
+			for (int k = 0; k < 4; k++)
+			{
+				result.m[row * 4 + column] += a.m[row * 4 + k] * b.m[k * 4 + column];
+			}
+		}
+	}
+
+	return result;
+}
+
+/// Collects the view-projection matrix in effect at the end of each frame.
+class CameraPath : public trace::Handler
+{
+	Matrix view {};
+	Matrix projection {};
+	bool has_view = false;
+	bool has_projection = false;
+
+public:
+	std::vector<Matrix> frames;
+
+	void on_world_transform(const trace::WorldTransform& e) override
+	{
+		std::copy(e.view, e.view + 16, view.m);
+		has_view = true;
+	}
+
+	void on_projection_matrix(const trace::ProjectionMatrix& e) override
+	{
+		std::copy(e.projection, e.projection + 16, projection.m);
+		has_projection = true;
+	}
+
+	void on_frame(const trace::Frame&) override
+	{
+		if (has_view && has_projection)
+		{
+			frames.push_back(multiply(view, projection));
+		}
+	}
+};
+
+// Left-handed, like D3DXMatrixLookAtLH and D3DXMatrixPerspectiveFovLH.
+static Matrix look_at(const float eye[3], const float at[3])
+{
+	float z[3] = { at[0] - eye[0], at[1] - eye[1], at[2] - eye[2] };
+	const float zl = std::sqrt(z[0] * z[0] + z[1] * z[1] + z[2] * z[2]);
+
+	for (auto& c : z)
+	{
+		c /= zl;
+	}
+
+	// x = normalize(cross(up, z)) with up = (0, 1, 0).
+	float x[3] = { z[2], 0.0f, -z[0] };
+	const float xl = std::sqrt(x[0] * x[0] + x[2] * x[2]);
+	x[0] /= xl;
+	x[2] /= xl;
+
+	const float y[3] = { z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0] };
+
+	const auto dot = [&](const float* v) { return v[0] * eye[0] + v[1] * eye[1] + v[2] * eye[2]; };
+
+	return { {
+		x[0], y[0], z[0], 0.0f,
+		x[1], y[1], z[1], 0.0f,
+		x[2], y[2], z[2], 0.0f,
+		-dot(x), -dot(y), -dot(z), 1.0f,
+	} };
+}
+
+static Matrix perspective(float fov_y, float aspect, float zn, float zf)
+{
+	const float ys = 1.0f / std::tan(fov_y / 2.0f);
+	const float xs = ys / aspect;
+
+	return { {
+		xs, 0.0f, 0.0f, 0.0f,
+		0.0f, ys, 0.0f, 0.0f,
+		0.0f, 0.0f, zf / (zf - zn), 1.0f,
+		0.0f, 0.0f, -zn * zf / (zf - zn), 0.0f,
+	} };
+}
+
+// Level-sized extents, in game units.
+static const float EXTENT = 8000.0f;
+
+/// Twenty seconds at 60 frames per second, weaving through the level while turning.
+static std::vector<Matrix> fly_through()
+{
+	const Matrix projection = perspective(1.2f, 4.0f / 3.0f, 1.0f, 10000.0f);
+	std::vector<Matrix> result;
+
+	for (int i = 0; i < 1200; i++)
+	{
+		const float t = static_cast<float>(i) / 1200.0f * 6.2831853f;
+
+		const float eye[3] = { std::sin(t) * EXTENT * 0.6f, 200.0f + std::sin(t * 3.0f) * 150.0f, std::cos(t * 2.0f) * EXTENT * 0.6f };
+		const float at[3]  = { eye[0] + std::cos(t * 5.0f) * 100.0f, eye[1] - 10.0f, eye[2] + std::sin(t * 5.0f) * 100.0f };
+
+		result.push_back(multiply(look_at(eye, at), projection));
+	}
+
+	return result;
+}
+
+/// Landtable entries: mostly small props, some large terrain pieces.
+static std::vector<Sphere> make_landtable(size_t count)
+{
+	std::mt19937 rng(0x1A47E54);
+	std::uniform_real_distribution<float> position(-EXTENT, EXTENT);
+	std::uniform_real_distribution<float> height(-500.0f, 1500.0f);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	std::vector<Sphere> result;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const float r = unit(rng) < 0.1f ? 200.0f + unit(rng) * 1000.0f : 10.0f + unit(rng) * 150.0f;
+		result.push_back({ position(rng), height(rng), position(rng), r });
+	}
+
+	return result;
+}
+
+/// Tests one sphere at a time, in the same order of operations as the SIMD version.
+static void cull_reference(const frustum::Planes& planes, const std::vector<Sphere>& spheres, std::vector<uint32_t>& visible)
+{
+	visible.clear();
+
+	for (size_t i = 0; i < spheres.size(); i++)
+	{
+		const auto& s = spheres[i];
+		bool outside = false;
+
+		for (int p = 0; p < 6; p++)
+		{
+			float distance = planes.a[p] * s.x + planes.d[p];
+			distance = distance + planes.b[p] * s.y;
+			distance = distance + planes.c[p] * s.z;
+
+			outside |= distance < -s.r;
+		}
+
+		if (!outside)
+		{
+			visible.push_back(static_cast<uint32_t>(i));
+		}
+	}
+}
+
+template <typename F>
+static double seconds(F f)
+{
+	const auto start = std::chrono::steady_clock::now();
+	f();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+	bool bench = false;
+	std::string trace_path;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::string(argv[i]) == "--bench")
+		{
+			bench = true;
+		}
+		else
+		{
+			trace_path = argv[i];
+		}
+	}
+
+	std::vector<Matrix> path;
+
+	if (!trace_path.empty())
+	{
+		CameraPath handler;
+
+		if (!trace::replay_file(trace_path, handler) || handler.frames.empty())
+		{
+			printf("FAIL couldn't read a camera path from %s\n", trace_path.c_str());
+			return 1;
+		}
+
+		path = std::move(handler.frames);
+	}
+	else
+	{
+		path = fly_through();
+	}
+
+	const auto spheres = make_landtable(2000);
+
+	frustum::SphereSet set;
+
+	for (const auto& s : spheres)
+	{
+		set.add(s.x, s.y, s.z, s.r);
+	}
+
+	std::vector<frustum::Planes> planes;
+
+	for (const auto& m : path)
+	{
+		planes.push_back(frustum::extract(m.m));
+	}
+
+	std::vector<uint32_t> expected;
+	std::vector<uint32_t> actual;
+	size_t visible = 0;
+
+	for (size_t f = 0; f < planes.size(); f++)
+	{
+		cull_reference(planes[f], spheres, expected);
+		set.cull(planes[f], actual);
+
+		if (actual != expected)
+		{
+			printf("FAIL frame %zu: %zu visible, expected %zu\n", f, actual.size(), expected.size());
+			return 1;
+		}
+
+		visible += actual.size();
+	}
+
+	const double frames = static_cast<double>(planes.size());
+
+	printf("ok   %zu frames, %zu spheres, %.1f visible and %.1f culled per frame\n", planes.size(), spheres.size(),
+	       visible / frames, spheres.size() - visible / frames);
+
+	if (!bench)
+	{
+		return 0;
+	}
+
+	const int repeat = 50;
+
+	const double reference = seconds([&]
+	{
+		for (int i = 0; i < repeat; i++)
+		{
+			for (const auto& p : planes)
+			{
+				cull_reference(p, spheres, expected);
+			}
+		}
+	});
+
+	const double simd = seconds([&]
+	{
+		for (int i = 0; i < repeat; i++)
+		{
+			for (const auto& p : planes)
+			{
+				set.cull(p, actual);
+			}
+		}
+	});
+
+	const double per_frame = 1e6 / (frames * repeat);
+
+	printf("reference %.2f us/frame   sse %.2f us/frame   %.2fx\n", reference * per_frame, simd * per_frame, reference / simd);
+	return 0;
+}
@@ -0,0 +1,413 @@
+// Instancing stress scene benchmark.
+//
+// Submits a ring-heavy scene, like a busy stretch of Speed Highway, to the mock
+// device once per frame in both of the ways the mod can draw it. Per-instance
+// submission makes one draw per meshset per instance, with the world transform
+// constants the world transform hook commits. Instanced submission packs the
+// instances with instancing::pack and draws each meshset once per batch, with
+// the stream setup instancing::draw makes. Checks that the packed instance data
+// transforms vertices the same as the world matrix and that both ways draw the
+// same primitives. With --bench, also reports the device calls and CPU time per
+// frame of each. Build and run with:
+//
+//     g++ -std=c++14 -O2 -o instancing_bench tools/instancing_bench.cpp tools/mock_device.cpp sadx-dc-lighting/shader_reference.cpp
+//     ./instancing_bench [--bench]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../sadx-dc-lighting/instance_data.h"
+#include "mock_device.h"
+
+using mock_device::Device;
+using mock_device::Counters;
+
+struct Matrix
+{
+	float m[4][4];
+};
+
+/// A registered model: each meshset is one indexed draw.
+struct Model
+{
+	const char* name;
+	std::vector<uint32_t> meshset_primitives;
+	size_t instances;
+};
+
+// Same as instancing.cpp.
+static constexpr size_t MAX_INSTANCES = 1024;
+
+// Register layout of the world transform constants, as in lantern.hlsl.
+static constexpr uint32_t REGISTER_WORLD      = 0;
+static constexpr uint32_t REGISTER_WV         = 4;
+static constexpr uint32_t REGISTER_WV_INV_T   = 8;
+static constexpr uint32_t REGISTER_VIEW       = 12;
+static constexpr uint32_t REGISTER_MATERIAL   = 16;
+
+static const Model scene[] = {
+	{ "ring",     { 40 },         1500 },
+	{ "spring",   { 60, 24, 12 }, 120 },
+	{ "item box", { 12, 48 },     80 },
+};
+
+// Row-major, row vectors: the product transforms by a, then by b.
+static Matrix multiply(const Matrix& a, const Matrix& b)
+{
+	Matrix result {};
+
+	for (int row = 0; row < 4; row++)
+	{
+		for (int column = 0; column < 4; column++)
+		{
+			for (int k = 0; k < 4; k++)
+			{
+				result.m[row][column] += a.m[row][k] * b.m[k][column];
+			}
+		}
+	}
+
+	return result;
+}
+
+/// Gauss-Jordan inverse with partial pivoting, like D3DXMatrixInverse would be asked for.
+static Matrix inverse(const Matrix& source)
+{
+	float a[4][8];
+
+	for (int r = 0; r < 4; r++)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			a[r][c]     = source.m[r][c];
+			a[r][c + 4] = r == c ? 1.0f : 0.0f;
+		}
+	}
+
+	for (int c = 0; c < 4; c++)
+	{
+		int pivot = c;
+
+		for (int r = c + 1; r < 4; r++)
+		{
+			if (std::fabs(a[r][c]) > std::fabs(a[pivot][c]))
+			{
+				pivot = r;
+			}
+		}
+
+		for (int k = 0; k < 8; k++)
+		{
+			std::swap(a[c][k], a[pivot][k]);
+		}
+
+		const float scale = 1.0f / a[c][c];
+
+		for (int k = 0; k < 8; k++)
+		{
+			a[c][k] *= scale;
+		}
+
+		for (int r = 0; r < 4; r++)
+		{
+			if (r == c)
+			{
+				continue;
+			}
+
+			const float factor = a[r][c];
+
+			for (int k = 0; k < 8; k++)
+			{
+				a[r][k] -= factor * a[c][k];
+			}
+		}
+	}
+
+	Matrix result;
+
+	for (int r = 0; r < 4; r++)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			result.m[r][c] = a[r][c + 4];
+		}
+	}
+
+	return result;
+}
+
+static Matrix transpose(const Matrix& source)
+{
+	Matrix result;
+
+	for (int r = 0; r < 4; r++)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			result.m[r][c] = source.m[c][r];
+		}
+	}
+
+	return result;
+}
+
+/// Rotation about Y followed by a translation, the way the game spins rings in place.
+static Matrix world_matrix(float angle, const float position[3])
+{
+	const float s = std::sin(angle);
+	const float c = std::cos(angle);
+
+	return { {
+		{ c,           0.0f,        -s,          0.0f },
+		{ 0.0f,        1.0f,        0.0f,        0.0f },
+		{ s,           0.0f,        c,           0.0f },
+		{ position[0], position[1], position[2], 1.0f },
+	} };
+}
+
+struct Scene
+{
+	Matrix view;
+	std::vector<std::vector<float>> positions;
+
+	explicit Scene(uint32_t seed)
+		: view { { { 1.0f, 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f, 0.0f }, { 10.0f, -50.0f, 300.0f, 1.0f } } }
+	{
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<float> coordinate(-2000.0f, 2000.0f);
+
+		for (const auto& model : scene)
+		{
+			std::vector<float> p(model.instances * 3);
+
+			for (auto& v : p)
+			{
+				v = coordinate(rng);
+			}
+
+			positions.push_back(std::move(p));
+		}
+	}
+
+	Matrix world(size_t model, size_t instance, size_t frame) const
+	{
+		const float angle = static_cast<float>(frame) * 0.05f + static_cast<float>(instance) * 0.3f;
+		return world_matrix(angle, &positions[model][instance * 3]);
+	}
+};
+
+// Stand-ins for Direct3D objects, which the mock device never dereferences.
+static int meshset_buffer = 0;
+static int instance_buffer = 0;
+
+static const float material[4] = { 0.7f, 0.7f, 0.7f, 1.0f };
+
+/// Commits the world transform constants the way Direct3D_SetWorldTransform_r does.
+static void set_world_transform(Device& device, const Matrix& world, const Matrix& view)
+{
+	const Matrix wv = multiply(world, view);
+	const Matrix wv_inverse_transpose = transpose(inverse(wv));
+
+	device.SetVertexShaderConstantF(REGISTER_WORLD, world.m[0], 4);
+	device.SetVertexShaderConstantF(REGISTER_WV, wv.m[0], 4);
+	device.SetVertexShaderConstantF(REGISTER_WV_INV_T, wv_inverse_transpose.m[0], 4);
+}
+
+/// Every instance drawn on its own, as with instancing disabled.
+static void draw_per_instance(Device& device, const Scene& s, size_t frame)
+{
+	for (size_t m = 0; m < sizeof(scene) / sizeof(scene[0]); m++)
+	{
+		const auto& model = scene[m];
+
+		for (size_t i = 0; i < model.instances; i++)
+		{
+			set_world_transform(device, s.world(m, i, frame), s.view);
+
+			for (auto primitives : model.meshset_primitives)
+			{
+				device.SetVertexShaderConstantF(REGISTER_MATERIAL, material, 1);
+				device.SetStreamSource(0, &meshset_buffer, 0, 32);
+				device.DrawIndexedPrimitive(4, 0, 0, primitives * 3, 0, primitives);
+			}
+		}
+	}
+}
+
+/// Queued instances drawn in batches of up to MAX_INSTANCES, as instancing::flush and draw do.
+static void draw_instanced(Device& device, const Scene& s, size_t frame, std::vector<instancing::InstanceData>& stream)
+{
+	for (size_t m = 0; m < sizeof(scene) / sizeof(scene[0]); m++)
+	{
+		const auto& model = scene[m];
+
+		for (size_t first = 0; first < model.instances; first += MAX_INSTANCES)
+		{
+			const size_t count = (std::min)(model.instances - first, MAX_INSTANCES);
+
+			stream.resize(count);
+
+			for (size_t i = 0; i < count; i++)
+			{
+				instancing::pack(s.world(m, first + i, frame).m, stream[i]);
+			}
+
+			device.SetVertexShaderConstantF(REGISTER_VIEW, s.view.m[0], 4);
+
+			// The model itself is drawn at the first instance's matrix.
+			set_world_transform(device, s.world(m, first, frame), s.view);
+
+			for (auto primitives : model.meshset_primitives)
+			{
+				device.SetVertexShaderConstantF(REGISTER_MATERIAL, material, 1);
+				device.SetStreamSource(0, &meshset_buffer, 0, 32);
+				device.SetStreamSource(1, &instance_buffer, 0, sizeof(instancing::InstanceData));
+				device.SetStreamSourceFreq(0, mock_device::INDEXED_DATA | static_cast<uint32_t>(count));
+				device.SetStreamSourceFreq(1, mock_device::INSTANCE_DATA | 1u);
+				device.DrawIndexedPrimitive(4, 0, 0, primitives * 3, 0, primitives);
+				device.SetStreamSourceFreq(0, 1);
+				device.SetStreamSourceFreq(1, 1);
+				device.SetStreamSource(1, nullptr, 0, 0);
+			}
+		}
+	}
+}
+
+/// The instanced vertex shader's world transform: a dot product with each packed column.
+static void transform_instanced(const instancing::InstanceData& data, const float p[3], float out[3])
+{
+	for (int c = 0; c < 3; c++)
+	{
+		const float* column = data.columns[c];
+		out[c] = p[0] * column[0] + p[1] * column[1] + p[2] * column[2] + column[3];
+	}
+}
+
+static bool check_pack()
+{
+	std::mt19937 rng(0x1257A7C);
+	std::uniform_real_distribution<float> value(-100.0f, 100.0f);
+
+	for (int n = 0; n < 1000; n++)
+	{
+		const float position[3] = { value(rng), value(rng), value(rng) };
+		const Matrix world = world_matrix(value(rng), position);
+
+		instancing::InstanceData data;
+		instancing::pack(world.m, data);
+
+		const float p[3] = { value(rng), value(rng), value(rng) };
+		float expected[3];
+		float actual[3];
+
+		for (int c = 0; c < 3; c++)
+		{
+			expected[c] = p[0] * world.m[0][c] + p[1] * world.m[1][c] + p[2] * world.m[2][c] + world.m[3][c];
+		}
+
+		transform_instanced(data, p, actual);
+
+		for (int c = 0; c < 3; c++)
+		{
+			if (std::fabs(expected[c] - actual[c]) > 1e-3f)
+			{
+				printf("FAIL pack: component %d is %f, expected %f\n", c, actual[c], expected[c]);
+				return false;
+			}
+		}
+	}
+
+	printf("ok   instance data transforms like the world matrix\n");
+	return true;
+}
+
+template <typename F>
+static double seconds(F f)
+{
+	const auto start = std::chrono::steady_clock::now();
+	f();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void print(const char* name, const Counters& c, size_t frames, double time)
+{
+	const double f = static_cast<double>(frames);
+
+	printf("%-13s %8.0f %10.0f %10.0f %12.0f %10.1f\n", name, c.draws / f, c.constant_registers / f,
+	       c.stream_changes / f, c.primitives / f, time * 1e6 / f);
+}
+
+int main(int argc, char** argv)
+{
+	if (!check_pack())
+	{
+		return 1;
+	}
+
+	const Scene s(0x5EED);
+	std::vector<instancing::InstanceData> stream;
+
+	Device per_instance;
+	Device instanced;
+
+	draw_per_instance(per_instance, s, 0);
+	draw_instanced(instanced, s, 0, stream);
+
+	const auto& a = per_instance.counters();
+	const auto& b = instanced.counters();
+
+	if (a.primitives != b.primitives || b.draws >= a.draws)
+	{
+		printf("FAIL per-instance: %zu draws of %zu primitives; instanced: %zu draws of %zu primitives\n",
+		       a.draws, a.primitives, b.draws, b.primitives);
+		return 1;
+	}
+
+	size_t instances = 0;
+
+	for (const auto& model : scene)
+	{
+		instances += model.instances;
+	}
+
+	printf("ok   %zu instances of %zu models: %zu draws per-instance, %zu instanced\n", instances,
+	       sizeof(scene) / sizeof(scene[0]), a.draws, b.draws);
+
+	if (argc < 2 || std::string(argv[1]) != "--bench")
+	{
+		return 0;
+	}
+
+	const size_t frames = 600;
+
+	per_instance.reset_counters();
+	instanced.reset_counters();
+
+	const double per_instance_time = seconds([&]
+	{
+		for (size_t f = 0; f < frames; f++)
+		{
+			draw_per_instance(per_instance, s, f);
+		}
+	});
+
+	const double instanced_time = seconds([&]
+	{
+		for (size_t f = 0; f < frames; f++)
+		{
+			draw_instanced(instanced, s, f, stream);
+		}
+	});
+
+	printf("\n%-13s %8s %10s %10s %12s %10s\n", "per frame", "draws", "registers", "streams", "primitives", "cpu us");
+	print("per-instance", per_instance.counters(), frames, per_instance_time);
+	print("instanced", instanced.counters(), frames, instanced_time);
+	return 0;
+}
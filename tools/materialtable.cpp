@@ -0,0 +1,301 @@
+// Material override table converter.
+//
+// Generates the material override table loaded by the mod (SYSTEM\materials.bin)
+// from the material arrays and material_register calls in FixCharacterMaterials.cpp.
+// The mod's post-build step runs it (see materialtable.vcxproj), so the shipped table
+// always matches the arrays. It only depends on the standard library, so it can also
+// be built and run anywhere:
+//
+//     g++ -std=c++14 -O2 -o materialtable tools/materialtable.cpp
+//     ./materialtable sadx-dc-lighting/FixCharacterMaterials.cpp materials.bin
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../sadx-dc-lighting/MaterialOverrideFormat.h"
+
+using namespace material_overrides;
+
+struct Behavior
+{
+	int8_t diffuse      = -1;
+	int8_t specular     = -1;
+	int8_t alt_diffuse  = -1;
+	int8_t alt_specular = -1;
+	Predicate predicate = Predicate_Always;
+	Options options     = Options_None;
+};
+
+struct Address
+{
+	uint8_t module;
+	uint32_t address;
+
+	bool operator<(const Address& rhs) const
+	{
+		return module != rhs.module ? module < rhs.module : address < rhs.address;
+	}
+};
+
+static std::string strip_comments(const std::string& source)
+{
+	std::string result;
+	result.reserve(source.size());
+
+	for (size_t i = 0; i < source.size(); i++)
+	{
+		if (source.compare(i, 2, "//") == 0)
+		{
+			i = source.find('\n', i);
+
+			if (i == std::string::npos)
+			{
+				break;
+			}
+		}
+		else if (source.compare(i, 2, "/*") == 0)
+		{
+			i = source.find("*/", i);
+
+			if (i == std::string::npos)
+			{
+				break;
+			}
+
+			++i;
+			continue;
+		}
+
+		result.push_back(source[i]);
+	}
+
+	return result;
+}
+
+/// Maps the callbacks in FixCharacterMaterials.cpp to their table equivalents.
+static bool get_behavior(const std::string& callback, Behavior& result)
+{
+	static const std::regex force(R"(ForceDiffuse(\d)Specular(\d))");
+	std::smatch match;
+
+	if (std::regex_match(callback, match, force))
+	{
+		result.diffuse  = static_cast<int8_t>(std::stoi(match[1]));
+		result.specular = static_cast<int8_t>(std::stoi(match[2]));
+		return true;
+	}
+
+	if (callback == "ChaosPuddleFunc")
+	{
+		result.predicate    = Predicate_ChaosBoss;
+		result.diffuse      = 4;
+		result.specular     = 5;
+		result.alt_diffuse  = 0;
+		result.alt_specular = 1;
+		return true;
+	}
+
+	if (callback == "Chaos2Function")
+	{
+		result.predicate    = Predicate_Chaos2;
+		result.diffuse      = 4;
+		result.specular     = 5;
+		result.alt_diffuse  = 2;
+		result.alt_specular = 3;
+		return true;
+	}
+
+	if (callback == "NPCModelsFunction")
+	{
+		result.diffuse = 2;
+		result.options = Options_PromoteSpecular;
+		return true;
+	}
+
+	return false;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		fprintf(stderr, "usage: %s <FixCharacterMaterials.cpp> <output>\n", argv[0]);
+		return 1;
+	}
+
+	std::ifstream input(argv[1]);
+
+	if (!input.is_open())
+	{
+		fprintf(stderr, "Unable to open input file: %s\n", argv[1]);
+		return 1;
+	}
+
+	std::stringstream buffer;
+	buffer << input.rdbuf();
+	const std::string source = strip_comments(buffer.str());
+
+	// static HMODULE NAME = GetModuleHandle(L"MODULE");
+	static const std::regex module_regex(R"(HMODULE\s+(\w+)\s*=\s*GetModuleHandle\w*\(\s*L?\"([^\"]+)\"\s*\))");
+	// static const NJS_MATERIAL* NAME[] = {
+	static const std::regex array_regex(R"(NJS_MATERIAL\s*\*\s*(\w+)\s*\[\s*\]\s*=\s*\{)");
+	// (NJS_MATERIAL*)0x01234567 or (NJS_MATERIAL*)((size_t)MODULE + 0x01234567)
+	static const std::regex entry_regex(R"(\(\s*NJS_MATERIAL\s*\*\s*\)\s*(?:(0x[0-9A-Fa-f]+)|\(\s*\(\s*size_t\s*\)\s*(\w+)\s*\+\s*(0x[0-9A-Fa-f]+)\s*\)))");
+	// material_register(NAME, LengthOfArray(NAME), &CALLBACK);
+	static const std::regex register_regex(R"(material_register\(\s*(\w+)\s*,[^,]+,\s*&?\s*(\w+)\s*\))");
+
+	std::vector<std::string> module_names;
+	std::map<std::string, uint8_t> module_indices;
+
+	for (auto it = std::sregex_iterator(source.begin(), source.end(), module_regex); it != std::sregex_iterator(); ++it)
+	{
+		const std::string name = (*it)[2];
+
+		if (name.size() >= MODULE_NAME_LENGTH)
+		{
+			fprintf(stderr, "Module name too long: %s\n", name.c_str());
+			return 1;
+		}
+
+		module_names.push_back(name);
+		module_indices[(*it)[1]] = static_cast<uint8_t>(module_names.size());
+	}
+
+	std::map<std::string, std::vector<Address>> arrays;
+
+	for (auto it = std::sregex_iterator(source.begin(), source.end(), array_regex); it != std::sregex_iterator(); ++it)
+	{
+		auto& addresses = arrays[(*it)[1]];
+
+		const size_t start = it->position() + it->length();
+		const size_t end   = source.find('}', start);
+
+		// Array bodies are matched one line at a time to keep the regex engine's stack usage bounded.
+		std::istringstream body(source.substr(start, end - start));
+		std::string line;
+
+		while (std::getline(body, line))
+		{
+			std::smatch e;
+
+			if (!std::regex_search(line, e, entry_regex))
+			{
+				continue;
+			}
+
+			Address address {};
+
+			if (e[1].matched)
+			{
+				address.module  = MODULE_ABSOLUTE;
+				address.address = static_cast<uint32_t>(std::stoul(e[1], nullptr, 16));
+			}
+			else
+			{
+				const auto m = module_indices.find(e[2]);
+
+				if (m == module_indices.end())
+				{
+					fprintf(stderr, "Unknown module handle: %s\n", e[2].str().c_str());
+					return 1;
+				}
+
+				address.module  = m->second;
+				address.address = static_cast<uint32_t>(std::stoul(e[3], nullptr, 16));
+			}
+
+			addresses.push_back(address);
+		}
+	}
+
+	// Callbacks registered later take priority, so later registrations overwrite earlier ones.
+	std::map<Address, Behavior> table;
+	size_t registrations = 0;
+
+	for (auto it = std::sregex_iterator(source.begin(), source.end(), register_regex); it != std::sregex_iterator(); ++it)
+	{
+		const std::string array_name = (*it)[1];
+		const std::string callback   = (*it)[2];
+
+		const auto a = arrays.find(array_name);
+
+		if (a == arrays.end())
+		{
+			fprintf(stderr, "Unknown material array: %s\n", array_name.c_str());
+			return 1;
+		}
+
+		Behavior behavior;
+
+		if (!get_behavior(callback, behavior))
+		{
+			fprintf(stderr, "Unsupported material callback: %s\n", callback.c_str());
+			return 1;
+		}
+
+		for (auto& address : a->second)
+		{
+			table[address] = behavior;
+		}
+
+		printf("%-20s -> %-24s %zu materials\n", array_name.c_str(), callback.c_str(), a->second.size());
+		++registrations;
+	}
+
+	if (!registrations)
+	{
+		fprintf(stderr, "No material registrations found.\n");
+		return 1;
+	}
+
+	std::ofstream output(argv[2], std::ios::binary);
+
+	if (!output.is_open())
+	{
+		fprintf(stderr, "Unable to open output file: %s\n", argv[2]);
+		return 1;
+	}
+
+	Header header {};
+	header.magic        = MAGIC;
+	header.version      = VERSION;
+	header.module_count = static_cast<uint16_t>(module_names.size());
+	header.entry_count  = static_cast<uint32_t>(table.size());
+
+	output.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+
+	for (auto& name : module_names)
+	{
+		char padded[MODULE_NAME_LENGTH] {};
+		strncpy(padded, name.c_str(), MODULE_NAME_LENGTH - 1);
+		output.write(padded, MODULE_NAME_LENGTH);
+	}
+
+	for (auto& pair : table)
+	{
+		Entry entry {};
+
+		entry.address      = pair.first.address;
+		entry.module       = pair.first.module;
+		entry.diffuse      = pair.second.diffuse;
+		entry.specular     = pair.second.specular;
+		entry.alt_diffuse  = pair.second.alt_diffuse;
+		entry.alt_specular = pair.second.alt_specular;
+		entry.predicate    = pair.second.predicate;
+		entry.options      = pair.second.options;
+		entry.flags_or     = 0;
+		entry.flags_and    = 0xFFFFFFFF;
+
+		output.write(reinterpret_cast<const char*>(&entry), sizeof(Entry));
+	}
+
+	printf("Wrote %zu entries (%zu modules) to %s\n", table.size(), module_names.size(), argv[2]);
+	return 0;
+}
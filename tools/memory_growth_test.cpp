@@ -0,0 +1,165 @@
+// Memory accounting no-growth test.
+//
+// Repeats the allocation pattern of a level load and unload many times:
+// palette sets acquired from a SharedPool, shared between levels and written
+// to through copy on write, API callback tables built with an accounting
+// Allocator, and objects holding a Footprint. After the first cycle has grown
+// the pools to their working size, every later cycle must end with exactly the
+// same accounted bytes and allocations, the same pool capacity and the same
+// peak. Build and run with:
+//
+//     g++ -std=c++14 -O2 -o memory_growth_test tools/memory_growth_test.cpp sadx-dc-lighting/memory_accounting.cpp
+//     ./memory_growth_test
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "../sadx-dc-lighting/memory_accounting.h"
+#include "../sadx-dc-lighting/shared_pool.h"
+
+using memory_accounting::Allocator;
+using memory_accounting::Footprint;
+using memory_accounting::Tag;
+using memory_accounting::Usage;
+
+// The size of one palette set: a diffuse and a specular row per palette.
+using Palettes = std::array<uint32_t, 256 * 16>;
+using Pool     = SharedPool<Palettes, Tag::Palettes>;
+
+// A loaded palette file with a fixed-size side table of its own.
+struct LoadedPalette
+{
+	Pool::Ref palettes;
+	Footprint<Tag::Palettes, 512> light_table;
+};
+
+using CallbackList  = std::deque<uint32_t, Allocator<uint32_t, Tag::Callbacks>>;
+using CallbackTable = std::unordered_map<uint32_t, CallbackList, std::hash<uint32_t>, std::equal_to<uint32_t>,
+                                         Allocator<std::pair<const uint32_t, CallbackList>, Tag::Callbacks>>;
+
+static constexpr size_t CYCLES   = 500;
+static constexpr size_t PALETTES = 24;
+static constexpr size_t MODELS   = 64;
+
+struct Snapshot
+{
+	Usage palettes;
+	Usage callbacks;
+	size_t capacity;
+};
+
+static Snapshot snapshot(const Pool& pool)
+{
+	return { memory_accounting::usage(Tag::Palettes), memory_accounting::usage(Tag::Callbacks), pool.capacity() };
+}
+
+static bool same(const Usage& a, const Usage& b)
+{
+	return a.bytes == b.bytes && a.allocations == b.allocations && a.peak_bytes == b.peak_bytes;
+}
+
+static void load_and_unload(Pool& pool, const std::vector<Pool::Ref>& shared, CallbackTable& callbacks, std::mt19937& rng)
+{
+	std::deque<LoadedPalette> level;
+
+	for (size_t i = 0; i < PALETTES; i++)
+	{
+		LoadedPalette loaded;
+
+		// Some levels reuse another level's palettes, and some of those get edited.
+		if (i % 3 == 0)
+		{
+			loaded.palettes = shared[i % shared.size()];
+
+			if (i % 2 == 0)
+			{
+				loaded.palettes.mutate()[i] = static_cast<uint32_t>(rng());
+			}
+		}
+		else
+		{
+			loaded.palettes = pool.acquire();
+			loaded.palettes.mutate()[0] = static_cast<uint32_t>(i);
+		}
+
+		level.push_back(std::move(loaded));
+	}
+
+	// Callbacks registered by mods for the level's models.
+	for (uint32_t model = 0; model < MODELS; model++)
+	{
+		auto& list = callbacks[model * 2654435761u];
+
+		for (uint32_t c = 0; c <= model % 4; c++)
+		{
+			list.push_back(c);
+		}
+	}
+
+	// Unload in an arbitrary order.
+	std::shuffle(level.begin(), level.end(), rng);
+
+	while (!level.empty())
+	{
+		level.pop_back();
+	}
+
+	callbacks.clear();
+}
+
+int main()
+{
+	std::mt19937 rng(0x4E3017);
+
+	Pool pool;
+	std::vector<Pool::Ref> shared;
+
+	// Palettes which outlive every level, like the defaults loaded at startup.
+	for (size_t i = 0; i < 4; i++)
+	{
+		shared.push_back(pool.acquire());
+	}
+
+	CallbackTable callbacks;
+
+	load_and_unload(pool, shared, callbacks, rng);
+	const Snapshot baseline = snapshot(pool);
+
+	for (size_t cycle = 1; cycle < CYCLES; cycle++)
+	{
+		load_and_unload(pool, shared, callbacks, rng);
+		const Snapshot current = snapshot(pool);
+
+		if (!same(current.palettes, baseline.palettes) || !same(current.callbacks, baseline.callbacks)
+		    || current.capacity != baseline.capacity)
+		{
+			printf("FAIL cycle %zu: palettes %zu bytes in %zu allocations (peak %zu), callbacks %zu bytes in %zu allocations (peak %zu), "
+			       "%zu pool blocks; after the first cycle: %zu, %zu (%zu), %zu, %zu (%zu), %zu\n",
+			       cycle,
+			       current.palettes.bytes, current.palettes.allocations, current.palettes.peak_bytes,
+			       current.callbacks.bytes, current.callbacks.allocations, current.callbacks.peak_bytes,
+			       current.capacity,
+			       baseline.palettes.bytes, baseline.palettes.allocations, baseline.palettes.peak_bytes,
+			       baseline.callbacks.bytes, baseline.callbacks.allocations, baseline.callbacks.peak_bytes,
+			       baseline.capacity);
+			return 1;
+		}
+	}
+
+	if (pool.in_use() != shared.size())
+	{
+		printf("FAIL %zu pool blocks still referenced, expected %zu\n", pool.in_use(), shared.size());
+		return 1;
+	}
+
+	printf("ok   %zu load/unload cycles: palettes hold %zu bytes in %zu pool blocks (peak %zu), callbacks %zu bytes (peak %zu)\n",
+	       CYCLES, baseline.palettes.bytes, baseline.capacity, baseline.palettes.peak_bytes,
+	       baseline.callbacks.bytes, baseline.callbacks.peak_bytes);
+	return 0;
+}
@@ -0,0 +1,333 @@
+#include <cstring>
+
+#include "mock_device.h"
+
+namespace mock_device
+{
+	static constexpr uint32_t PIXEL_SAMPLERS = 16;
+
+	// Maps a sampler to a slot in the texture array, or returns SAMPLER_COUNT if it's out of range.
+	static uint32_t sampler_slot(uint32_t sampler)
+	{
+		if (sampler < PIXEL_SAMPLERS)
+		{
+			return sampler;
+		}
+
+		if (sampler >= VERTEX_SAMPLER0 && sampler < VERTEX_SAMPLER0 + (SAMPLER_COUNT - PIXEL_SAMPLERS))
+		{
+			return PIXEL_SAMPLERS + (sampler - VERTEX_SAMPLER0);
+		}
+
+		return SAMPLER_COUNT;
+	}
+
+	Texture::Texture(Device* device, uint32_t width, uint32_t height)
+		: device(device),
+		  width(width),
+		  height(height),
+		  texels(static_cast<size_t>(width) * height)
+	{
+	}
+
+	Result Texture::LockRect(uint32_t level, LockedRect* locked_rect, const void* rect, uint32_t flags)
+	{
+		(void)flags;
+
+		if (level != 0 || rect != nullptr || locked_rect == nullptr || locked)
+		{
+			return INVALIDCALL;
+		}
+
+		locked = true;
+		locked_rect->Pitch = static_cast<int32_t>(width * sizeof(uint32_t));
+		locked_rect->pBits = texels.data();
+
+		++device->counts.texture_locks;
+		device->log(Call::LockRect, level, 1);
+		return OK;
+	}
+
+	Result Texture::UnlockRect(uint32_t level)
+	{
+		if (level != 0 || !locked)
+		{
+			return INVALIDCALL;
+		}
+
+		locked = false;
+		device->log(Call::UnlockRect, level, 1);
+		return OK;
+	}
+
+	uint32_t Texture::get_width() const
+	{
+		return width;
+	}
+
+	uint32_t Texture::get_height() const
+	{
+		return height;
+	}
+
+	const uint32_t* Texture::data() const
+	{
+		return texels.data();
+	}
+
+	void Device::log(Call call, uint32_t index, uint32_t count)
+	{
+		if (recording)
+		{
+			calls.push_back({ call, index, count });
+		}
+	}
+
+	Result Device::set_constants(float (*registers)[4], std::vector<bool>& written, uint32_t limit,
+	                             Call call, uint32_t start, const float* data, uint32_t count)
+	{
+		if (data == nullptr || start >= limit || count > limit - start)
+		{
+			return INVALIDCALL;
+		}
+
+		++counts.constant_uploads;
+		counts.constant_registers += count;
+
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			auto& reg = registers[start + i];
+			const auto src = data + i * 4;
+
+			if (written[start + i] && !memcmp(reg, src, sizeof(reg)))
+			{
+				++counts.redundant_registers;
+			}
+
+			memcpy(reg, src, sizeof(reg));
+			written[start + i] = true;
+		}
+
+		log(call, start, count);
+		return OK;
+	}
+
+	Result Device::SetVertexShaderConstantF(uint32_t start_register, const float* data, uint32_t vector4f_count)
+	{
+		return set_constants(vertex_constants, vertex_written, VERTEX_REGISTERS,
+		                     Call::VertexShaderConstantF, start_register, data, vector4f_count);
+	}
+
+	Result Device::SetPixelShaderConstantF(uint32_t start_register, const float* data, uint32_t vector4f_count)
+	{
+		return set_constants(pixel_constants, pixel_written, PIXEL_REGISTERS,
+		                     Call::PixelShaderConstantF, start_register, data, vector4f_count);
+	}
+
+	Result Device::GetVertexShaderConstantF(uint32_t start_register, float* data, uint32_t vector4f_count) const
+	{
+		if (data == nullptr || start_register >= VERTEX_REGISTERS || vector4f_count > VERTEX_REGISTERS - start_register)
+		{
+			return INVALIDCALL;
+		}
+
+		memcpy(data, vertex_constants[start_register], vector4f_count * sizeof(vertex_constants[0]));
+		return OK;
+	}
+
+	Result Device::GetPixelShaderConstantF(uint32_t start_register, float* data, uint32_t vector4f_count) const
+	{
+		if (data == nullptr || start_register >= PIXEL_REGISTERS || vector4f_count > PIXEL_REGISTERS - start_register)
+		{
+			return INVALIDCALL;
+		}
+
+		memcpy(data, pixel_constants[start_register], vector4f_count * sizeof(pixel_constants[0]));
+		return OK;
+	}
+
+	Result Device::SetVertexShader(const void* shader)
+	{
+		++counts.shader_binds;
+
+		if (shader == vertex_shader)
+		{
+			++counts.redundant_shader_binds;
+		}
+
+		vertex_shader = shader;
+		log(Call::VertexShader, 0, 1);
+		return OK;
+	}
+
+	Result Device::SetPixelShader(const void* shader)
+	{
+		++counts.shader_binds;
+
+		if (shader == pixel_shader)
+		{
+			++counts.redundant_shader_binds;
+		}
+
+		pixel_shader = shader;
+		log(Call::PixelShader, 0, 1);
+		return OK;
+	}
+
+	Result Device::SetTexture(uint32_t sampler, const void* texture)
+	{
+		const auto slot = sampler_slot(sampler);
+
+		if (slot == SAMPLER_COUNT)
+		{
+			return INVALIDCALL;
+		}
+
+		++counts.texture_binds;
+		textures[slot] = texture;
+		log(Call::Texture, sampler, 1);
+		return OK;
+	}
+
+	Result Device::SetRenderState(uint32_t state, uint32_t value)
+	{
+		++counts.state_changes;
+		render_states[state] = value;
+		log(Call::SetRenderState, state, 1);
+		return OK;
+	}
+
+	Result Device::GetRenderState(uint32_t state, uint32_t* value)
+	{
+		if (value == nullptr)
+		{
+			return INVALIDCALL;
+		}
+
+		++counts.state_queries;
+
+		const auto it = render_states.find(state);
+		*value = it != render_states.end() ? it->second : 0;
+
+		log(Call::GetRenderState, state, 1);
+		return OK;
+	}
+
+	std::unique_ptr<Texture> Device::CreateTexture(uint32_t width, uint32_t height)
+	{
+		return std::make_unique<Texture>(this, width, height);
+	}
+
+	Result Device::SetStreamSource(uint32_t stream, const void* buffer, uint32_t offset, uint32_t stride)
+	{
+		(void)offset;
+		(void)stride;
+
+		if (stream >= STREAM_COUNT)
+		{
+			return INVALIDCALL;
+		}
+
+		++counts.stream_changes;
+		streams[stream] = buffer;
+		log(Call::StreamSource, stream, 1);
+		return OK;
+	}
+
+	Result Device::SetStreamSourceFreq(uint32_t stream, uint32_t setting)
+	{
+		if (stream >= STREAM_COUNT || (setting & INDEXED_DATA && setting & INSTANCE_DATA))
+		{
+			return INVALIDCALL;
+		}
+
+		++counts.stream_changes;
+		frequencies[stream] = setting;
+		log(Call::StreamSourceFreq, stream, 1);
+		return OK;
+	}
+
+	Result Device::draw(Call call, uint32_t primitive_count)
+	{
+		if (streams[0] == nullptr)
+		{
+			return INVALIDCALL;
+		}
+
+		const uint32_t frequency = frequencies[0];
+		const uint32_t instances = frequency & INDEXED_DATA ? frequency & ~INDEXED_DATA : 1;
+
+		++counts.draws;
+		counts.primitives += static_cast<size_t>(primitive_count) * instances;
+		log(call, primitive_count, instances);
+		return OK;
+	}
+
+	Result Device::DrawPrimitive(uint32_t type, uint32_t start_vertex, uint32_t primitive_count)
+	{
+		(void)type;
+		(void)start_vertex;
+
+		// Instancing only applies to indexed draws.
+		if (frequencies[0] & INDEXED_DATA)
+		{
+			return INVALIDCALL;
+		}
+
+		return draw(Call::DrawPrimitive, primitive_count);
+	}
+
+	Result Device::DrawIndexedPrimitive(uint32_t type, int32_t base_vertex, uint32_t min_index, uint32_t num_vertices,
+	                                    uint32_t start_index, uint32_t primitive_count)
+	{
+		(void)type;
+		(void)base_vertex;
+		(void)min_index;
+		(void)num_vertices;
+		(void)start_index;
+
+		return draw(Call::DrawIndexedPrimitive, primitive_count);
+	}
+
+	const void* Device::get_vertex_shader() const
+	{
+		return vertex_shader;
+	}
+
+	const void* Device::get_pixel_shader() const
+	{
+		return pixel_shader;
+	}
+
+	const void* Device::get_texture(uint32_t sampler) const
+	{
+		const auto slot = sampler_slot(sampler);
+		return slot != SAMPLER_COUNT ? textures[slot] : nullptr;
+	}
+
+	void Device::copy_constants(shader_reference::Constants& constants) const
+	{
+		for (size_t i = 0; i < shader_reference::REGISTER_COUNT; ++i)
+		{
+			if (pixel_written[i])
+			{
+				memcpy(constants.c[i], pixel_constants[i], sizeof(constants.c[i]));
+			}
+			else if (vertex_written[i])
+			{
+				memcpy(constants.c[i], vertex_constants[i], sizeof(constants.c[i]));
+			}
+		}
+	}
+
+	const Counters& Device::counters() const
+	{
+		return counts;
+	}
+
+	void Device::reset_counters()
+	{
+		counts = {};
+		calls.clear();
+	}
+}
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "../sadx-dc-lighting/shader_reference.h"
+
+/*
+ * A headless stand-in for the subset of IDirect3DDevice9 used by the mod:
+ * shader constants, shader and texture binds, render state queries,
+ * texture locks, vertex streams and draws, for the tools' tests. It doesn't implement the interface;
+ * methods mirror the names and argument order of their IDirect3DDevice9
+ * counterparts instead. Every call is counted, and calls can also be
+ * logged in order.
+ *
+ * Shaders, textures and buffers are opaque pointers; the device never dereferences them.
+ */
+namespace mock_device
+{
+	/// 32 bits like HRESULT, so failures are negative.
+	using Result = int32_t;
+
+	constexpr Result OK          = 0;
+	/// Same value as D3DERR_INVALIDCALL.
+	constexpr Result INVALIDCALL = static_cast<Result>(0x8876086Cu);
+
+	/// Float constant registers available to vs_3_0 and ps_3_0.
+	constexpr uint32_t VERTEX_REGISTERS = 256;
+	constexpr uint32_t PIXEL_REGISTERS  = 224;
+
+	/// Samplers 0-15 are pixel samplers; vertex samplers start at D3DVERTEXTEXTURESAMPLER0.
+	constexpr uint32_t VERTEX_SAMPLER0 = 257;
+	constexpr uint32_t SAMPLER_COUNT   = 16 + 4;
+
+	constexpr uint32_t STREAM_COUNT = 16;
+
+	/// Same values as D3DSTREAMSOURCE_INDEXEDDATA and D3DSTREAMSOURCE_INSTANCEDATA.
+	constexpr uint32_t INDEXED_DATA  = 1u << 30;
+	constexpr uint32_t INSTANCE_DATA = 2u << 30;
+
+	enum class Call : uint8_t
+	{
+		VertexShaderConstantF,
+		PixelShaderConstantF,
+		VertexShader,
+		PixelShader,
+		Texture,
+		SetRenderState,
+		GetRenderState,
+		LockRect,
+		UnlockRect,
+		StreamSource,
+		StreamSourceFreq,
+		DrawPrimitive,
+		DrawIndexedPrimitive,
+	};
+
+	/// A logged call. \c index and \c count are the register range, sampler,
+	/// render state, mip level, stream or primitive count, depending on the call.
+	struct CallRecord
+	{
+		Call call;
+		uint32_t index;
+		uint32_t count;
+	};
+
+	struct Counters
+	{
+		/// SetVertexShaderConstantF and SetPixelShaderConstantF calls.
+		size_t constant_uploads;
+		/// Registers written by those calls.
+		size_t constant_registers;
+		/// Registers written with the value they already held.
+		size_t redundant_registers;
+		size_t shader_binds;
+		/// Binds of the shader that was already bound.
+		size_t redundant_shader_binds;
+		size_t texture_binds;
+		size_t state_changes;
+		size_t state_queries;
+		size_t texture_locks;
+		/// SetStreamSource and SetStreamSourceFreq calls.
+		size_t stream_changes;
+		size_t draws;
+		/// Primitives drawn, counting every instance of an instanced draw.
+		size_t primitives;
+	};
+
+	/// Mirrors D3DLOCKED_RECT.
+	struct LockedRect
+	{
+		int32_t Pitch;
+		void* pBits;
+	};
+
+	class Device;
+
+	/// A single-level 32-bit texture whose texels live in system memory.
+	class Texture
+	{
+		Device* device;
+		uint32_t width;
+		uint32_t height;
+		std::vector<uint32_t> texels;
+		bool locked = false;
+
+	public:
+		Texture(Device* device, uint32_t width, uint32_t height);
+
+		Result LockRect(uint32_t level, LockedRect* locked_rect, const void* rect, uint32_t flags);
+		Result UnlockRect(uint32_t level);
+
+		uint32_t get_width() const;
+		uint32_t get_height() const;
+		const uint32_t* data() const;
+	};
+
+	class Device
+	{
+		friend class Texture;
+
+		float vertex_constants[VERTEX_REGISTERS][4] {};
+		float pixel_constants[PIXEL_REGISTERS][4] {};
+		std::vector<bool> vertex_written = std::vector<bool>(VERTEX_REGISTERS);
+		std::vector<bool> pixel_written  = std::vector<bool>(PIXEL_REGISTERS);
+
+		const void* vertex_shader = nullptr;
+		const void* pixel_shader  = nullptr;
+		const void* textures[SAMPLER_COUNT] {};
+		std::unordered_map<uint32_t, uint32_t> render_states;
+
+		const void* streams[STREAM_COUNT] {};
+		uint32_t frequencies[STREAM_COUNT] {};
+
+		Counters counts {};
+
+		void log(Call call, uint32_t index, uint32_t count);
+		Result set_constants(float (*registers)[4], std::vector<bool>& written, uint32_t limit,
+		                     Call call, uint32_t start, const float* data, uint32_t count);
+		Result draw(Call call, uint32_t primitive_count);
+
+	public:
+		/// Appends every call to \c calls when enabled.
+		bool recording = false;
+		std::vector<CallRecord> calls;
+
+		Result SetVertexShaderConstantF(uint32_t start_register, const float* data, uint32_t vector4f_count);
+		Result SetPixelShaderConstantF(uint32_t start_register, const float* data, uint32_t vector4f_count);
+		Result GetVertexShaderConstantF(uint32_t start_register, float* data, uint32_t vector4f_count) const;
+		Result GetPixelShaderConstantF(uint32_t start_register, float* data, uint32_t vector4f_count) const;
+
+		Result SetVertexShader(const void* shader);
+		Result SetPixelShader(const void* shader);
+		Result SetTexture(uint32_t sampler, const void* texture);
+
+		Result SetRenderState(uint32_t state, uint32_t value);
+		/// Render states which were never set read as 0.
+		Result GetRenderState(uint32_t state, uint32_t* value);
+
+		std::unique_ptr<Texture> CreateTexture(uint32_t width, uint32_t height);
+
+		Result SetStreamSource(uint32_t stream, const void* buffer, uint32_t offset, uint32_t stride);
+		Result SetStreamSourceFreq(uint32_t stream, uint32_t setting);
+		/// Draws fail unless stream 0 has a buffer. Primitive types aren't checked.
+		Result DrawPrimitive(uint32_t type, uint32_t start_vertex, uint32_t primitive_count);
+		/// When stream 0's frequency is INDEXED_DATA | n, the draw counts n instances.
+		Result DrawIndexedPrimitive(uint32_t type, int32_t base_vertex, uint32_t min_index, uint32_t num_vertices,
+		                            uint32_t start_index, uint32_t primitive_count);
+
+		const void* get_vertex_shader() const;
+		const void* get_pixel_shader() const;
+		/// Returns the texture bound to a sampler, or nullptr if the sampler is out of range.
+		const void* get_texture(uint32_t sampler) const;
+
+		/// Copies the constant registers into a register file for shader_reference.
+		/// Registers never written by the device are left untouched, and pixel
+		/// shader constants take precedence over vertex shader constants.
+		void copy_constants(shader_reference::Constants& constants) const;
+
+		const Counters& counters() const;
+		/// Clears the counters and the call log, but keeps the device state.
+		void reset_counters();
+	};
+}
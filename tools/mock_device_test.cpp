@@ -0,0 +1,501 @@
+// Mock device test.
+//
+// Checks the headless device mock the other tools can drive in place of
+// Direct3D: constant uploads and their counters, invalid calls, sampler
+// ranges, render states, texture locks, streams and draws, and the call log.
+// Runs the commits ShaderParameter makes through shader_constants and the
+// atlas writes LanternCollection makes through palette_atlas against it.
+// It also uploads a frame's shader constants through the mock, copies them
+// into a shader_reference register file and checks that the shaders light a
+// vertex the same as with the register file filled in directly. Build and run with:
+//
+//     g++ -std=c++14 -O2 -o mock_device_test tools/mock_device_test.cpp tools/mock_device.cpp sadx-dc-lighting/shader_reference.cpp sadx-dc-lighting/palette_atlas.cpp
+//     ./mock_device_test
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "../sadx-dc-lighting/palette_atlas.h"
+#include "../sadx-dc-lighting/shader_constants.h"
+#include "mock_device.h"
+
+using namespace mock_device;
+using namespace shader_reference;
+
+static int failures = 0;
+
+#define CHECK(condition) check(condition, #condition, __LINE__)
+
+static void check(bool condition, const char* text, int line)
+{
+	if (!condition)
+	{
+		printf("FAIL line %d: %s\n", line, text);
+		++failures;
+	}
+}
+
+static void report(const char* name, int before)
+{
+	if (failures == before)
+	{
+		printf("ok   %s\n", name);
+	}
+}
+
+static void check_constants()
+{
+	const int before = failures;
+
+	Device device;
+
+	const float a[2][4] = { { 1.0f, 2.0f, 3.0f, 4.0f }, { 5.0f, 6.0f, 7.0f, 8.0f } };
+	const float b[4]    = { 9.0f, 9.0f, 9.0f, 9.0f };
+
+	CHECK(device.SetVertexShaderConstantF(10, a[0], 2) == OK);
+	// Register 10 is unchanged, register 11 isn't.
+	CHECK(device.SetVertexShaderConstantF(10, a[0], 1) == OK);
+	CHECK(device.SetVertexShaderConstantF(11, b, 1) == OK);
+
+	float read[2][4];
+	CHECK(device.GetVertexShaderConstantF(10, read[0], 2) == OK);
+	CHECK(!memcmp(read[0], a[0], sizeof(a[0])));
+	CHECK(!memcmp(read[1], b, sizeof(b)));
+
+	const auto& counters = device.counters();
+	CHECK(counters.constant_uploads == 3);
+	CHECK(counters.constant_registers == 4);
+	CHECK(counters.redundant_registers == 1);
+
+	// Ranges past the end of the register file are rejected without being counted.
+	CHECK(device.SetVertexShaderConstantF(VERTEX_REGISTERS - 1, a[0], 2) == INVALIDCALL);
+	CHECK(device.SetPixelShaderConstantF(PIXEL_REGISTERS, a[0], 1) == INVALIDCALL);
+	CHECK(device.SetPixelShaderConstantF(0, nullptr, 1) == INVALIDCALL);
+	CHECK(device.GetPixelShaderConstantF(PIXEL_REGISTERS - 1, read[0], 2) == INVALIDCALL);
+	CHECK(counters.constant_uploads == 3);
+
+	// The first write to a register is never redundant, even if it writes zeros.
+	const float zero[4] = {};
+	CHECK(device.SetPixelShaderConstantF(0, zero, 1) == OK);
+	CHECK(counters.redundant_registers == 1);
+
+	device.reset_counters();
+	CHECK(counters.constant_uploads == 0);
+	CHECK(device.GetVertexShaderConstantF(10, read[0], 1) == OK && read[0][0] == 1.0f);
+
+	report("constants", before);
+}
+
+static void check_binds()
+{
+	const int before = failures;
+
+	Device device;
+	int shader_a = 0;
+	int shader_b = 0;
+	int texture  = 0;
+
+	device.SetVertexShader(&shader_a);
+	device.SetVertexShader(&shader_a);
+	device.SetPixelShader(&shader_b);
+
+	CHECK(device.get_vertex_shader() == &shader_a);
+	CHECK(device.get_pixel_shader() == &shader_b);
+	CHECK(device.counters().shader_binds == 3);
+	CHECK(device.counters().redundant_shader_binds == 1);
+
+	// Pixel samplers are 0-15, vertex samplers start at D3DVERTEXTEXTURESAMPLER0.
+	CHECK(device.SetTexture(0, &texture) == OK);
+	CHECK(device.SetTexture(VERTEX_SAMPLER0 + 1, &texture) == OK);
+	CHECK(device.SetTexture(16, &texture) == INVALIDCALL);
+	CHECK(device.SetTexture(VERTEX_SAMPLER0 + 4, &texture) == INVALIDCALL);
+	CHECK(device.get_texture(0) == &texture);
+	CHECK(device.get_texture(VERTEX_SAMPLER0 + 1) == &texture);
+	CHECK(device.get_texture(1) == nullptr);
+	CHECK(device.get_texture(16) == nullptr);
+	CHECK(device.counters().texture_binds == 2);
+
+	uint32_t value = 1;
+	CHECK(device.GetRenderState(7, &value) == OK && value == 0);
+	device.SetRenderState(7, 3);
+	CHECK(device.GetRenderState(7, &value) == OK && value == 3);
+	CHECK(device.GetRenderState(7, nullptr) == INVALIDCALL);
+	CHECK(device.counters().state_changes == 1);
+	CHECK(device.counters().state_queries == 2);
+
+	report("binds and render states", before);
+}
+
+static void check_textures()
+{
+	const int before = failures;
+
+	Device device;
+	const auto texture = device.CreateTexture(4, 2);
+
+	LockedRect rect {};
+	CHECK(texture->LockRect(0, &rect, nullptr, 0) == OK);
+	CHECK(rect.Pitch == 16);
+
+	// A texture can't be locked twice, and only level 0 exists.
+	LockedRect again {};
+	CHECK(texture->LockRect(0, &again, nullptr, 0) == INVALIDCALL);
+
+	static_cast<uint32_t*>(rect.pBits)[5] = 0xFF123456;
+
+	CHECK(texture->UnlockRect(1) == INVALIDCALL);
+	CHECK(texture->UnlockRect(0) == OK);
+	CHECK(texture->UnlockRect(0) == INVALIDCALL);
+	CHECK(texture->LockRect(1, &rect, nullptr, 0) == INVALIDCALL);
+
+	CHECK(texture->get_width() == 4 && texture->get_height() == 2);
+	CHECK(texture->data()[5] == 0xFF123456);
+	CHECK(device.counters().texture_locks == 1);
+
+	report("textures", before);
+}
+
+static void check_draws()
+{
+	const int before = failures;
+
+	Device device;
+	int vertices  = 0;
+	int instances = 0;
+
+	// Nothing to draw from yet.
+	CHECK(device.DrawPrimitive(4, 0, 10) == INVALIDCALL);
+	CHECK(device.SetStreamSource(STREAM_COUNT, &vertices, 0, 32) == INVALIDCALL);
+
+	CHECK(device.SetStreamSource(0, &vertices, 0, 32) == OK);
+	CHECK(device.DrawPrimitive(4, 0, 10) == OK);
+	CHECK(device.DrawIndexedPrimitive(4, 0, 0, 30, 0, 20) == OK);
+	CHECK(device.counters().draws == 2);
+	CHECK(device.counters().primitives == 30);
+
+	// An instanced draw counts every instance's primitives.
+	CHECK(device.SetStreamSource(1, &instances, 0, 48) == OK);
+	CHECK(device.SetStreamSourceFreq(0, INDEXED_DATA | 5) == OK);
+	CHECK(device.SetStreamSourceFreq(1, INSTANCE_DATA | 1) == OK);
+	CHECK(device.SetStreamSourceFreq(1, INDEXED_DATA | INSTANCE_DATA) == INVALIDCALL);
+	CHECK(device.DrawPrimitive(4, 0, 10) == INVALIDCALL);
+	CHECK(device.DrawIndexedPrimitive(4, 0, 0, 30, 0, 20) == OK);
+	CHECK(device.counters().draws == 3);
+	CHECK(device.counters().primitives == 130);
+
+	CHECK(device.SetStreamSourceFreq(0, 1) == OK);
+	CHECK(device.DrawIndexedPrimitive(4, 0, 0, 30, 0, 20) == OK);
+	CHECK(device.counters().primitives == 150);
+	CHECK(device.counters().stream_changes == 5);
+
+	report("streams and draws", before);
+}
+
+struct Vector4
+{
+	float v[4];
+
+	bool operator!=(const Vector4& other) const
+	{
+		return memcmp(v, other.v, sizeof(v)) != 0;
+	}
+};
+
+static void check_parameters()
+{
+	const int before = failures;
+
+	using shader_constants::Tracked;
+
+	Device device;
+
+	// Committed like ShaderParameter<D3DXVECTOR4>: one register.
+	Tracked<Vector4> light(Vector4 { { 0.0f, -1.0f, 0.0f, 0.0f } });
+
+	const auto commit = [&](Tracked<Vector4>& parameter, uint32_t stages)
+	{
+		return parameter.commit([&](const Vector4& value)
+		{
+			shader_constants::set(&device, Register_LightDirection, stages, value.v, 1);
+		});
+	};
+
+	// Nothing assigned, and assigning the committed value, upload nothing.
+	CHECK(!commit(light, shader_constants::vertex));
+	CHECK(light.assign({ { 0.0f, -1.0f, 0.0f, 0.0f } }));
+	CHECK(!commit(light, shader_constants::vertex));
+	CHECK(device.counters().constant_uploads == 0);
+
+	// Only the first assignment since a commit is reported, which is when ShaderParameter queues itself.
+	const Vector4 a = { { 0.3f, -0.8f, 0.2f, 0.0f } };
+	CHECK(light.assign({ { 1.0f, 0.0f, 0.0f, 0.0f } }));
+	CHECK(!light.assign(a));
+	CHECK(light.is_modified());
+	CHECK(commit(light, shader_constants::vertex));
+	CHECK(!light.is_modified());
+
+	float read[4];
+	CHECK(device.GetVertexShaderConstantF(Register_LightDirection, read, 1) == OK);
+	CHECK(!memcmp(read, a.v, sizeof(read)));
+	CHECK(device.counters().constant_uploads == 1);
+
+	// Changing a value and changing it back before the commit uploads nothing.
+	light.assign({ { 0.0f, 0.0f, 1.0f, 0.0f } });
+	light.assign(a);
+	CHECK(!commit(light, shader_constants::vertex));
+	CHECK(device.counters().constant_uploads == 1);
+
+	// commit_now after a device reset uploads the unchanged value to both stages.
+	light.force();
+	CHECK(commit(light, shader_constants::both));
+	CHECK(device.counters().constant_uploads == 3);
+	CHECK(device.GetPixelShaderConstantF(Register_LightDirection, read, 1) == OK);
+	CHECK(!memcmp(read, a.v, sizeof(read)));
+
+	// Committed like ShaderParameter<Texture> with both stages: vertex sampler first.
+	int palette = 0;
+	Tracked<const int*> texture(nullptr);
+
+	device.recording = true;
+	texture.assign(&palette);
+
+	CHECK(texture.commit([&](const int* value)
+	{
+		shader_constants::set_texture(&device, 1, shader_constants::both, value);
+	}));
+
+	device.recording = false;
+
+	CHECK(device.get_texture(VERTEX_SAMPLER0 + 1) == &palette);
+	CHECK(device.get_texture(1) == &palette);
+	CHECK(device.calls.size() == 2 && device.calls[0].index == VERTEX_SAMPLER0 + 1 && device.calls[1].index == 1);
+
+	// Releasing forgets the texture without unbinding it.
+	texture.discard(nullptr);
+	CHECK(texture.value() == nullptr && !texture.is_modified());
+	CHECK(device.counters().texture_binds == 2);
+
+	report("shader parameter commits", before);
+}
+
+static void check_atlas()
+{
+	const int before = failures;
+
+	std::vector<uint32_t> palettes[2];
+
+	for (size_t p = 0; p < 2; p++)
+	{
+		palettes[p].resize(palette_lighting::ROW_SIZE * 8 * 2);
+
+		for (size_t i = 0; i < palettes[p].size(); i++)
+		{
+			palettes[p][i] = static_cast<uint32_t>((i + p * 7919) * 2654435761u);
+		}
+	}
+
+	// Three slots, of which the first stays empty.
+	Device device;
+	const auto texture = device.CreateTexture(palette_lighting::ROW_SIZE, palette_lighting::ROW_COUNT * 3);
+
+	const std::vector<size_t> dirty = { 1, 2 };
+
+	CHECK(palette_atlas::write_slots<LockedRect>(texture.get(), true, dirty, [&](size_t slot)
+	{
+		return palettes[slot - 1].data();
+	}));
+
+	CHECK(device.counters().texture_locks == 1);
+
+	const auto texels = texture->data();
+
+	// Row 2 * n is palette n's diffuse colors, row 2 * n + 1 its specular colors.
+	for (size_t p = 0; p < 2; p++)
+	{
+		const auto slot = texels + (p + 1) * palette_lighting::ROW_SIZE * palette_lighting::ROW_COUNT;
+
+		for (size_t n = 0; n < 8; n++)
+		{
+			for (size_t x = 0; x < palette_lighting::ROW_SIZE; x++)
+			{
+				const auto pair = &palettes[p][(n * palette_lighting::ROW_SIZE + x) * 2];
+
+				if (slot[2 * n * palette_lighting::ROW_SIZE + x] != pair[0]
+				    || slot[(2 * n + 1) * palette_lighting::ROW_SIZE + x] != pair[1])
+				{
+					CHECK(!"atlas texel matches its palette");
+					n = 8;
+					break;
+				}
+			}
+		}
+	}
+
+	CHECK(texels[0] == 0 && texels[palette_lighting::ROW_SIZE * palette_lighting::ROW_COUNT - 1] == 0);
+
+	// A texture that can't be locked is reported, and nothing is written.
+	LockedRect held {};
+	CHECK(texture->LockRect(0, &held, nullptr, 0) == OK);
+	CHECK(!palette_atlas::write_slots<LockedRect>(texture.get(), true, dirty, [&](size_t)
+	{
+		return palettes[0].data();
+	}));
+	texture->UnlockRect(0);
+
+	// The float atlas holds the same colors, sampled the same by the shader reference.
+	std::vector<float> floats(palette_atlas::slot_size(false) / sizeof(float));
+	palette_atlas::write_palette(floats.data(), false, palettes[0].data());
+
+	Samplers samplers {};
+	samplers.palette_a = { texels + palette_lighting::ROW_SIZE * palette_lighting::ROW_COUNT, false, 16 };
+	samplers.palette_b = { floats.data(), true, 16 };
+
+	Constants constants {};
+	constants.set_defaults();
+
+	const float indices[4] = { 5.5f / 16.0f, 5.5f / 16.0f, 2.5f / 16.0f, 2.5f / 16.0f };
+	const float blend[4]   = { 1.0f, 1.0f, 0.0f, 1.0f };
+	memcpy(constants.c[Register_Indices], indices, sizeof(indices));
+	memcpy(constants.c[Register_BlendFactor], blend, sizeof(blend));
+
+	VertexInput input {};
+	input.normal[1] = 1.0f;
+
+	VertexOutput from_32bit {};
+	VertexOutput from_float {};
+
+	vs_main(constants, Permutation_Light, samplers, input, from_32bit);
+	vs_main(constants, Permutation_Light | Permutation_Blend, samplers, input, from_float);
+
+	for (int i = 0; i < 4; i++)
+	{
+		CHECK(std::fabs(from_32bit.diffuse[i] - from_float.diffuse[i]) < 1e-5f);
+		CHECK(std::fabs(from_32bit.specular[i] - from_float.specular[i]) < 1e-5f);
+	}
+
+	report("palette atlas writes", before);
+}
+
+static void check_log()
+{
+	const int before = failures;
+
+	Device device;
+	const float value[4] = {};
+
+	device.SetVertexShaderConstantF(0, value, 1);
+	device.recording = true;
+	device.SetPixelShaderConstantF(4, value, 1);
+	device.SetRenderState(9, 1);
+	device.SetTexture(2, nullptr);
+	device.recording = false;
+	device.SetTexture(3, nullptr);
+
+	const std::vector<CallRecord>& calls = device.calls;
+
+	CHECK(calls.size() == 3);
+
+	if (calls.size() == 3)
+	{
+		CHECK(calls[0].call == Call::PixelShaderConstantF && calls[0].index == 4 && calls[0].count == 1);
+		CHECK(calls[1].call == Call::SetRenderState && calls[1].index == 9);
+		CHECK(calls[2].call == Call::Texture && calls[2].index == 2);
+	}
+
+	report("call log", before);
+}
+
+static void check_reference()
+{
+	const int before = failures;
+
+	std::vector<uint32_t> atlas(256 * 16);
+
+	for (size_t i = 0; i < atlas.size(); i++)
+	{
+		atlas[i] = static_cast<uint32_t>(i * 2654435761u);
+	}
+
+	Samplers samplers {};
+	samplers.palette_a = { atlas.data(), false, 16 };
+	samplers.palette_b = samplers.palette_a;
+
+	// What the shaders would see if the parameters were committed as the mod does.
+	Constants direct {};
+	direct.set_defaults();
+
+	const float world[4][4] = {
+		{ 0.0f, 1.0f, 0.0f, 0.0f },
+		{ -1.0f, 0.0f, 0.0f, 0.0f },
+		{ 0.0f, 0.0f, 1.0f, 0.0f },
+		{ 5.0f, 6.0f, 7.0f, 1.0f },
+	};
+
+	const float light[4]   = { 0.3f, -0.8f, 0.2f, 0.0f };
+	const float indices[4] = { 1.5f / 16.0f, 0.0f, 3.5f / 16.0f, 0.0f };
+
+	memcpy(direct.c[Register_WorldMatrix], world, sizeof(world));
+	memcpy(direct.c[Register_wvMatrix], world, sizeof(world));
+	memcpy(direct.c[Register_LightDirection], light, sizeof(light));
+	memcpy(direct.c[Register_Indices], indices, sizeof(indices));
+
+	// The same parameters uploaded through the device: vertex-only matrices,
+	// and parameters used by both shaders uploaded to both.
+	Device device;
+	device.SetVertexShaderConstantF(Register_WorldMatrix, world[0], 4);
+	device.SetVertexShaderConstantF(Register_wvMatrix, world[0], 4);
+	device.SetVertexShaderConstantF(Register_LightDirection, light, 1);
+	device.SetVertexShaderConstantF(Register_Indices, indices, 1);
+	device.SetPixelShaderConstantF(Register_Indices, indices, 1);
+
+	Constants copied {};
+	copied.set_defaults();
+	device.copy_constants(copied);
+
+	CHECK(!memcmp(&copied, &direct, sizeof(Constants)));
+
+	VertexInput input {};
+	input.position[0] = 1.0f;
+	input.normal[0] = 0.6f;
+	input.normal[1] = 0.8f;
+
+	VertexOutput expected {};
+	VertexOutput actual {};
+
+	const uint32_t permutation = Permutation_Light | Permutation_Texture;
+	vs_main(direct, permutation, samplers, input, expected);
+	vs_main(copied, permutation, samplers, input, actual);
+
+	CHECK(!memcmp(&expected, &actual, sizeof(VertexOutput)));
+
+	// Pixel constants take precedence where both were written.
+	const float pixel[4] = { 0.5f, 0.5f, 0.5f, 0.5f };
+	device.SetPixelShaderConstantF(Register_LightDirection, pixel, 1);
+	device.copy_constants(copied);
+
+	CHECK(!memcmp(copied.c[Register_LightDirection], pixel, sizeof(pixel)));
+
+	report("constants feed shader_reference", before);
+}
+
+int main()
+{
+	check_constants();
+	check_binds();
+	check_textures();
+	check_draws();
+	check_parameters();
+	check_atlas();
+	check_log();
+	check_reference();
+
+	if (failures)
+	{
+		printf("%d failed\n", failures);
+		return 1;
+	}
+
+	return 0;
+}
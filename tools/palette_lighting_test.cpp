@@ -0,0 +1,288 @@
+// Palette lighting conformance test and benchmark.
+//
+// Lights randomized meshsets with palette_lighting::light and light_parallel
+// and checks that every lit color matches light_reference exactly, across the
+// parameter combinations vs_main supports and vertex counts which exercise the
+// scalar tail and the thread split. With --bench, also reports the vertices per
+// second of each. Build and run with:
+//
+//     g++ -std=c++14 -O2 -pthread -o palette_lighting_test tools/palette_lighting_test.cpp sadx-dc-lighting/palette_lighting.cpp
+//     ./palette_lighting_test [--bench]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../sadx-dc-lighting/palette_lighting.h"
+
+using namespace palette_lighting;
+
+// XYZ | NORMAL | DIFFUSE, as in a lit meshset buffer.
+struct SourceVertex
+{
+	float position[3];
+	float normal[3];
+	uint32_t color;
+};
+
+// Same layout as software_lighting's dynamic vertex buffer.
+struct LitVertex
+{
+	float position[3];
+	float normal[3];
+	uint32_t diffuse;
+	uint32_t specular;
+	float uv[2];
+};
+
+static std::mt19937 rng(0x9A1E77E);
+
+static float random_float(float min, float max)
+{
+	return std::uniform_real_distribution<float>(min, max)(rng);
+}
+
+static std::vector<uint32_t> make_atlas(uint32_t rows)
+{
+	std::vector<uint32_t> result(ROW_SIZE * rows);
+
+	for (auto& texel : result)
+	{
+		texel = static_cast<uint32_t>(rng());
+	}
+
+	return result;
+}
+
+static std::vector<SourceVertex> make_vertices(size_t count)
+{
+	std::vector<SourceVertex> result(count);
+
+	for (auto& v : result)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			v.position[i] = random_float(-100.0f, 100.0f);
+			v.normal[i]   = random_float(-1.0f, 1.0f);
+		}
+
+		// Some vertices have no color so the material diffuse is used instead.
+		v.color = rng() % 4 ? static_cast<uint32_t>(rng()) : 0;
+	}
+
+	// Degenerate normals: zero, and NaN which must pick texel 0 in both.
+	if (count > 2)
+	{
+		memset(result[1].normal, 0, sizeof(result[1].normal));
+		result[2].normal[0] = std::numeric_limits<float>::quiet_NaN();
+	}
+
+	return result;
+}
+
+struct Case
+{
+	const char* name;
+	bool blend;
+	bool vertex_color_source;
+	bool allow_vertex_color;
+	bool force_default_diffuse;
+	bool diffuse_override;
+	bool color;
+};
+
+static const Case cases[] = {
+	{ "basic",            false, true,  true,  false, false, true  },
+	{ "blend",            true,  true,  true,  false, false, true  },
+	{ "material diffuse", false, false, true,  false, false, true  },
+	{ "no vertex color",  false, true,  false, false, false, true  },
+	{ "default diffuse",  true,  true,  true,  true,  false, true  },
+	{ "diffuse override", true,  true,  true,  false, true,  true  },
+	{ "colorless",        false, true,  true,  false, false, false },
+};
+
+static Parameters make_parameters(const Case& c, const std::vector<uint32_t>& atlas_a, const std::vector<uint32_t>& atlas_b,
+                                  uint32_t rows)
+{
+	Parameters params {};
+
+	for (int r = 0; r < 3; r++)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			params.world[r][i] = random_float(-2.0f, 2.0f);
+		}
+
+		params.normal_scale[r]    = random_float(0.5f, 2.0f);
+		params.light_direction[r] = random_float(-1.0f, 1.0f);
+	}
+
+	params.atlas_a    = atlas_a.data();
+	params.atlas_b    = atlas_b.data();
+	params.atlas_rows = rows;
+
+	params.diffuse_a  = rng() % rows;
+	params.specular_a = rng() % rows;
+	params.diffuse_b  = rng() % rows;
+	// Out of range rows are clamped to the last one.
+	params.specular_b = rows + 3;
+
+	params.blend          = c.blend;
+	params.blend_diffuse  = random_float(0.0f, 1.0f);
+	params.blend_specular = random_float(0.0f, 1.0f);
+
+	params.vertex_color_source = c.vertex_color_source;
+
+	for (auto& m : params.material_diffuse)
+	{
+		m = random_float(0.0f, 1.0f);
+	}
+
+	params.allow_vertex_color    = c.allow_vertex_color;
+	params.force_default_diffuse = c.force_default_diffuse;
+	params.diffuse_override      = c.diffuse_override;
+
+	for (auto& o : params.diffuse_override_color)
+	{
+		o = random_float(0.0f, 1.0f);
+	}
+
+	return params;
+}
+
+static Input make_input(const std::vector<SourceVertex>& vertices, bool color)
+{
+	return {
+		reinterpret_cast<const uint8_t*>(vertices.data()), sizeof(SourceVertex), offsetof(SourceVertex, normal),
+		color ? offsetof(SourceVertex, color) : NO_COLOR
+	};
+}
+
+static Output make_output(std::vector<LitVertex>& vertices)
+{
+	return { reinterpret_cast<uint8_t*>(vertices.data()), sizeof(LitVertex), offsetof(LitVertex, diffuse), offsetof(LitVertex, specular) };
+}
+
+static bool compare(const char* name, const char* variant, size_t count, const std::vector<LitVertex>& expected,
+                    const std::vector<LitVertex>& actual)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		if (expected[i].diffuse != actual[i].diffuse || expected[i].specular != actual[i].specular)
+		{
+			printf("FAIL %s (%s, %zu vertices): vertex %zu is %08X %08X, expected %08X %08X\n", name, variant, count, i,
+			       actual[i].diffuse, actual[i].specular, expected[i].diffuse, expected[i].specular);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool check()
+{
+	static const size_t counts[] = { 0, 1, 3, 4, 5, 7, 64, 1001, 65539 };
+
+	const uint32_t rows = static_cast<uint32_t>(ROW_COUNT * 2);
+
+	const auto atlas_a = make_atlas(rows);
+	const auto atlas_b = make_atlas(rows);
+
+	bool result = true;
+
+	for (const auto& c : cases)
+	{
+		const auto params = make_parameters(c, atlas_a, atlas_b, rows);
+
+		for (auto count : counts)
+		{
+			const auto vertices = make_vertices(count);
+			const auto input = make_input(vertices, c.color);
+
+			std::vector<LitVertex> expected(count);
+			std::vector<LitVertex> simd(count);
+			std::vector<LitVertex> parallel(count);
+
+			light_reference(params, input, make_output(expected), count);
+			light(params, input, make_output(simd), count);
+			light_parallel(params, input, make_output(parallel), count);
+
+			result &= compare(c.name, "sse", count, expected, simd);
+			result &= compare(c.name, "threaded", count, expected, parallel);
+		}
+
+		if (result)
+		{
+			printf("ok   %s\n", c.name);
+		}
+	}
+
+	return result;
+}
+
+template <typename F>
+static double seconds(F f)
+{
+	const auto start = std::chrono::steady_clock::now();
+	f();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void bench()
+{
+	const uint32_t rows = static_cast<uint32_t>(ROW_COUNT);
+
+	const auto atlas_a = make_atlas(rows);
+	const auto atlas_b = make_atlas(rows);
+	const auto params = make_parameters(cases[1], atlas_a, atlas_b, rows);
+
+	printf("\n%8s %12s %12s %12s %8s\n", "vertices", "reference", "sse", "threaded", "threads");
+
+	for (size_t count : { 256, 4096, 65536, 262144 })
+	{
+		const auto vertices = make_vertices(count);
+		const auto input = make_input(vertices, true);
+
+		std::vector<LitVertex> lit(count);
+		const auto output = make_output(lit);
+
+		const size_t repeat = (std::max<size_t>)(1, (1 << 24) / count);
+		size_t threads = 0;
+
+		const double reference = seconds([&] { for (size_t i = 0; i < repeat; i++) light_reference(params, input, output, count); });
+		const double simd      = seconds([&] { for (size_t i = 0; i < repeat; i++) light(params, input, output, count); });
+		const double parallel  = seconds([&] { for (size_t i = 0; i < repeat; i++) threads = light_parallel(params, input, output, count); });
+
+		const double total = static_cast<double>(count * repeat) / 1e6;
+
+		printf("%8zu %9.1f M/s %9.1f M/s %9.1f M/s %8zu\n", count, total / reference, total / simd, total / parallel, threads);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (!check())
+	{
+		return 1;
+	}
+
+	if (std::thread::hardware_concurrency() < 2)
+	{
+		printf("note: only one hardware thread, so light_parallel didn't split any work\n");
+	}
+
+	if (argc > 1 && std::string(argv[1]) == "--bench")
+	{
+		bench();
+	}
+
+	return 0;
+}
@@ -0,0 +1,426 @@
+// Polybuff vertex assembly conformance test and benchmark.
+//
+// Assembles randomized meshsets with both the scalar reference and the SSE2
+// kernels from polybuff_kernels.h, for every vertex format, UV scale and color
+// source, and checks that the output is identical byte for byte. It also checks
+// that indexed strips expand to the same vertices as plain strips, and that the
+// fingerprint used to key cached streams changes with the data. With --bench, it
+// instead measures the throughput of each, and the vertex bytes indexed strips
+// save. Build and run with:
+//
+//     g++ -std=c++14 -O2 -o polybuff_conformance tools/polybuff_conformance.cpp
+//     ./polybuff_conformance [--bench]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../sadx-dc-lighting/polybuff_kernels.h"
+
+using namespace polybuff_kernels;
+
+struct Meshset
+{
+	std::vector<Vector>   points;
+	std::vector<Vector>   normals;
+	std::vector<int16_t>  meshes;
+	std::vector<Tex>      uv;
+	std::vector<uint32_t> colors;
+
+	int primitive_count = 0;
+	// Output vertices, including the stitching vertices of strips.
+	size_t output_count = 0;
+};
+
+static std::mt19937 rng(0x1A47E54);
+
+static float random_float()
+{
+	return std::uniform_real_distribution<float>(-1000.0f, 1000.0f)(rng);
+}
+
+// With shared attributes, every corner referencing a point has the same color and UV,
+// like most models. Otherwise they're random for every corner.
+static Meshset make_meshset(bool strips, int primitive_count, int max_strip_length, size_t point_count,
+                            bool shared_attributes = false)
+{
+	Meshset result;
+	result.primitive_count = primitive_count;
+
+	for (size_t i = 0; i < point_count; i++)
+	{
+		result.points.push_back({ random_float(), random_float(), random_float() });
+		result.normals.push_back({ random_float(), random_float(), random_float() });
+	}
+
+	std::uniform_int_distribution<int> index(0, static_cast<int>(point_count) - 1);
+	std::uniform_int_distribution<int> coordinate(-32768, 32767);
+
+	const auto add_corner = [&]
+	{
+		const int i = index(rng);
+		result.meshes.push_back(static_cast<int16_t>(i));
+
+		if (shared_attributes)
+		{
+			result.uv.push_back({ static_cast<int16_t>(i * 7), static_cast<int16_t>(-i * 13) });
+			result.colors.push_back(0xFF000000u | static_cast<uint32_t>(i) * 2654435761u >> 8);
+		}
+		else
+		{
+			result.uv.push_back({ static_cast<int16_t>(coordinate(rng)), static_cast<int16_t>(coordinate(rng)) });
+			result.colors.push_back(static_cast<uint32_t>(rng()));
+		}
+	};
+
+	if (strips)
+	{
+		std::uniform_int_distribution<int> length(3, max_strip_length);
+
+		for (int i = 0; i < primitive_count; i++)
+		{
+			const int n = length(rng);
+
+			// The upper bits flag the winding of the strip and are masked off.
+			result.meshes.push_back(static_cast<int16_t>(n | (rng() & 0x8000)));
+
+			for (int j = 0; j < n; j++)
+			{
+				add_corner();
+			}
+		}
+
+		result.output_count = result.colors.size() + 2 * primitive_count;
+	}
+	else
+	{
+		for (int i = 0; i < 3 * primitive_count; i++)
+		{
+			add_corner();
+		}
+
+		result.output_count = result.colors.size();
+	}
+
+	return result;
+}
+
+template <UvScale scale, typename T>
+static void assemble_reference(T* buffer, const Meshset& m, bool strips, const VertexSource& src)
+{
+	if (strips)
+	{
+		assemble_strips_reference<scale>(buffer, m.meshes.data(), m.primitive_count, src);
+	}
+	else
+	{
+		assemble_list_reference<scale>(buffer, m.meshes.data(), m.output_count, src);
+	}
+}
+
+template <UvScale scale, typename T>
+static void assemble_sse2(T* buffer, const Meshset& m, bool strips, const VertexSource& src)
+{
+	if (strips)
+	{
+		assemble_strips<scale>(buffer, m.meshes.data(), m.primitive_count, src);
+	}
+	else
+	{
+		assemble_list<scale>(buffer, m.meshes.data(), m.output_count, src);
+	}
+}
+
+static const uint32_t global_color = 0xFF7F3F1F;
+
+template <typename T>
+static VertexSource source_for(const Meshset& m, bool vertex_colors)
+{
+	const bool normals = sizeof(T) >= sizeof(VertexG);
+	const bool uv      = sizeof(T) == sizeof(VertexI);
+
+	return make_source(m.points.data(), normals ? m.normals.data() : nullptr, uv ? m.uv.data() : nullptr,
+	                   vertex_colors ? m.colors.data() : nullptr, global_color);
+}
+
+template <UvScale scale, typename T>
+static bool check(const char* name, int iterations)
+{
+	for (int i = 0; i < iterations; i++)
+	{
+		const bool strips        = (i & 1) != 0;
+		const bool vertex_colors = (i & 2) != 0;
+
+		const auto m   = make_meshset(strips, 1 + static_cast<int>(rng() % 64), 48, 1 + rng() % 512);
+		const auto src = source_for<T>(m, vertex_colors);
+
+		// Filled with different garbage so that unwritten bytes don't compare equal.
+		std::vector<T> expected(m.output_count);
+		std::vector<T> actual(m.output_count);
+		memset(expected.data(), 0xAA, expected.size() * sizeof(T));
+		memset(actual.data(), 0x55, actual.size() * sizeof(T));
+
+		assemble_reference<scale>(expected.data(), m, strips, src);
+		assemble_sse2<scale>(actual.data(), m, strips, src);
+
+		if (memcmp(expected.data(), actual.data(), expected.size() * sizeof(T)) != 0)
+		{
+			for (size_t v = 0; v < expected.size(); v++)
+			{
+				if (memcmp(&expected[v], &actual[v], sizeof(T)) != 0)
+				{
+					printf("FAIL %s: iteration %d (%s, %s colors), vertex %zu of %zu differs\n", name, i,
+					       strips ? "strips" : "list", vertex_colors ? "vertex" : "global", v, expected.size());
+					break;
+				}
+			}
+
+			return false;
+		}
+	}
+
+	printf("ok   %s\n", name);
+	return true;
+}
+
+// The indexed strips have to expand to exactly the vertices of the plain strips.
+template <UvScale scale, typename T>
+static bool check_indexed(const char* name, int iterations)
+{
+	VertexDeduplicator deduplicator;
+
+	for (int i = 0; i < iterations; i++)
+	{
+		const bool vertex_colors = (i & 1) != 0;
+		const bool shared        = (i & 2) != 0;
+
+		const auto m   = make_meshset(true, 1 + static_cast<int>(rng() % 64), 48, 1 + rng() % 512, shared);
+		const auto src = source_for<T>(m, vertex_colors);
+
+		std::vector<T> expected(m.output_count);
+		memset(expected.data(), 0xAA, expected.size() * sizeof(T));
+		assemble_strips_reference<scale>(expected.data(), m.meshes.data(), m.primitive_count, src);
+
+		std::vector<T> vertices(m.colors.size());
+		std::vector<uint16_t> indices(m.output_count);
+
+		const auto unique = assemble_indexed_strips<scale>(deduplicator, vertices.data(), indices.data(), m.meshes.data(),
+		                                                   m.primitive_count, m.colors.size(), src);
+
+		for (size_t v = 0; v < indices.size(); v++)
+		{
+			if (indices[v] >= unique || memcmp(&expected[v], &vertices[indices[v]], sizeof(T)) != 0)
+			{
+				printf("FAIL %s indexed: iteration %d (%s colors), index %zu of %zu differs\n", name, i,
+				       vertex_colors ? "vertex" : "global", v, indices.size());
+				return false;
+			}
+		}
+	}
+
+	printf("ok   %s indexed\n", name);
+	return true;
+}
+
+static bool references(const Meshset& m, bool strips, size_t point)
+{
+	const int16_t* meshes = m.meshes.data();
+
+	for (int i = 0; i < (strips ? m.primitive_count : 1); i++)
+	{
+		const size_t n = strips ? *meshes++ & 0x3FFF : m.meshes.size();
+
+		if (std::find(meshes, meshes + n, static_cast<int16_t>(point)) != meshes + n)
+		{
+			return true;
+		}
+
+		meshes += n;
+	}
+
+	return false;
+}
+
+// Every input which ends up in the stream has to change the fingerprint.
+static bool check_fingerprint(int iterations)
+{
+	for (int i = 0; i < iterations; i++)
+	{
+		const bool strips = (i & 1) != 0;
+
+		auto m = make_meshset(strips, 1 + static_cast<int>(rng() % 64), 48, 1 + rng() % 512);
+
+		const auto hash = [&]
+		{
+			const auto src = source_for<VertexI>(m, true);
+			return fingerprint(m.meshes.data(), strips, m.primitive_count, m.colors.size(), src, UvScale::Multiply);
+		};
+
+		const uint64_t original = hash();
+
+		const size_t corner = rng() % m.colors.size();
+		const size_t point  = rng() % m.points.size();
+
+		const std::pair<const char*, void*> fields[] =
+		{
+			{ "color",  &m.colors[corner] },
+			{ "uv",     &m.uv[corner] },
+			{ "point",  &m.points[point].y },
+			{ "normal", &m.normals[point].z },
+		};
+
+		for (const auto& field : fields)
+		{
+			auto& word = *static_cast<uint32_t*>(field.second);
+			const uint32_t bit = 1u << (rng() % 32);
+
+			// Points which aren't referenced don't end up in the stream.
+			const bool per_point  = field.second == &m.points[point].y || field.second == &m.normals[point].z;
+			const bool referenced = !per_point || references(m, strips, point);
+
+			word ^= bit;
+			const bool changed = hash() != original;
+			word ^= bit;
+
+			if (referenced && !changed)
+			{
+				printf("FAIL fingerprint: iteration %d, changing a %s didn't change it\n", i, field.first);
+				return false;
+			}
+		}
+	}
+
+	printf("ok   fingerprint\n");
+	return true;
+}
+
+template <typename F>
+static double seconds(F f)
+{
+	const auto start = std::chrono::steady_clock::now();
+	f();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template <UvScale scale, typename T>
+static void bench(const char* name, bool strips)
+{
+	// Roughly the size of a large level chunk.
+	const auto m   = make_meshset(strips, strips ? 4096 : 16384, 24, 8192);
+	const auto src = source_for<T>(m, true);
+
+	std::vector<T> buffer(m.output_count);
+	const int repeat = 200;
+
+	const double reference = seconds([&]
+	{
+		for (int i = 0; i < repeat; i++)
+		{
+			assemble_reference<scale>(buffer.data(), m, strips, src);
+		}
+	});
+
+	const double sse2 = seconds([&]
+	{
+		for (int i = 0; i < repeat; i++)
+		{
+			assemble_sse2<scale>(buffer.data(), m, strips, src);
+		}
+	});
+
+	volatile uint64_t sink = 0;
+
+	const double hashing = seconds([&]
+	{
+		for (int i = 0; i < repeat; i++)
+		{
+			sink = sink ^ fingerprint(m.meshes.data(), strips, m.primitive_count, m.colors.size(), src, scale);
+		}
+	});
+
+	const double vertices = static_cast<double>(m.output_count) * repeat;
+
+	printf("%-13s %-6s reference %7.1f Mvert/s   sse2 %7.1f Mvert/s (%.2fx)   fingerprint %7.1f Mvert/s\n", name,
+	       strips ? "strips" : "list", vertices / reference / 1e6, vertices / sse2 / 1e6, reference / sse2,
+	       vertices / hashing / 1e6);
+}
+
+template <UvScale scale, typename T>
+static void bench_indexed(const char* name)
+{
+	// Models share most points between strips, with the same color and UV.
+	const auto m   = make_meshset(true, 2048, 24, 4096, true);
+	const auto src = source_for<T>(m, true);
+
+	VertexDeduplicator deduplicator;
+	std::vector<T> expanded(m.output_count);
+	std::vector<T> vertices(m.colors.size());
+	std::vector<uint16_t> indices(m.output_count);
+
+	const int repeat = 200;
+	uint16_t unique = 0;
+
+	const double plain = seconds([&]
+	{
+		for (int i = 0; i < repeat; i++)
+		{
+			assemble_strips<scale>(expanded.data(), m.meshes.data(), m.primitive_count, src);
+		}
+	});
+
+	const double indexed = seconds([&]
+	{
+		for (int i = 0; i < repeat; i++)
+		{
+			unique = assemble_indexed_strips<scale>(deduplicator, vertices.data(), indices.data(), m.meshes.data(),
+			                                        m.primitive_count, m.colors.size(), src);
+		}
+	});
+
+	const size_t plain_bytes   = m.output_count * sizeof(T);
+	const size_t indexed_bytes = unique * sizeof(T) + m.output_count * sizeof(uint16_t);
+	const double vertices_out  = static_cast<double>(m.output_count) * repeat;
+
+	printf("%-13s indexed: %6zu KB instead of %6zu KB (%5.1f%%)   plain %7.1f Mvert/s   indexed %7.1f Mvert/s\n", name,
+	       indexed_bytes / 1024, plain_bytes / 1024, 100.0 * indexed_bytes / plain_bytes, vertices_out / plain / 1e6,
+	       vertices_out / indexed / 1e6);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 1 && std::string(argv[1]) == "--bench")
+	{
+		for (bool strips : { false, true })
+		{
+			bench<UvScale::Multiply, VertexF>("F", strips);
+			bench<UvScale::Multiply, VertexG>("G", strips);
+			bench<UvScale::Multiply, VertexI>("I (multiply)", strips);
+			bench<UvScale::Divide, VertexI>("I (divide)", strips);
+		}
+
+		bench_indexed<UvScale::Multiply, VertexF>("F");
+		bench_indexed<UvScale::Multiply, VertexG>("G");
+		bench_indexed<UvScale::Divide, VertexI>("I");
+
+		return 0;
+	}
+
+	const int iterations = 400;
+	bool ok = true;
+
+	ok &= check<UvScale::Multiply, VertexF>("F", iterations);
+	ok &= check<UvScale::Multiply, VertexG>("G", iterations);
+	ok &= check<UvScale::Multiply, VertexI>("I (multiply)", iterations);
+	ok &= check<UvScale::Divide, VertexI>("I (divide)", iterations);
+	ok &= check_indexed<UvScale::Multiply, VertexF>("F", iterations);
+	ok &= check_indexed<UvScale::Multiply, VertexG>("G", iterations);
+	ok &= check_indexed<UvScale::Divide, VertexI>("I", iterations);
+	ok &= check_fingerprint(iterations);
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,644 @@
+// Shader reference golden vector test and benchmark.
+//
+// Runs hand-derived golden vectors through shader_reference::vs_main and ps_main:
+// palette texel selection, blending, transforms, environment mapping, texturing,
+// the alpha test and each fog mode, with the expected values worked out from
+// lantern.hlsl rather than from the port. It then checks that vs_batch and
+// ps_batch match the scalar port bit for bit on randomized inputs for every
+// permutation. With --bench, also reports vertices and pixels per second.
+// Build and run with:
+//
+//     g++ -std=c++14 -O2 -o shader_reference_test tools/shader_reference_test.cpp sadx-dc-lighting/shader_reference.cpp
+//     ./shader_reference_test [--bench]
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../sadx-dc-lighting/shader_reference.h"
+
+using namespace shader_reference;
+
+static constexpr size_t ATLAS_WIDTH = 256;
+static constexpr size_t ATLAS_ROWS  = 16;
+
+// Each texel encodes where it is: x in red, the row in green, and the atlas in blue.
+static std::vector<uint32_t> make_atlas(uint32_t id)
+{
+	std::vector<uint32_t> result(ATLAS_WIDTH * ATLAS_ROWS);
+
+	for (uint32_t y = 0; y < ATLAS_ROWS; y++)
+	{
+		for (uint32_t x = 0; x < ATLAS_WIDTH; x++)
+		{
+			result[y * ATLAS_WIDTH + x] = x << 16 | y << 8 | id;
+		}
+	}
+
+	return result;
+}
+
+// The V coordinate of the middle of an atlas row, as set in the Indices parameter.
+static float row(size_t y)
+{
+	return (static_cast<float>(y) + 0.5f) / static_cast<float>(ATLAS_ROWS);
+}
+
+static void set(Constants& constants, size_t index, float x, float y, float z, float w)
+{
+	constants.c[index][0] = x;
+	constants.c[index][1] = y;
+	constants.c[index][2] = z;
+	constants.c[index][3] = w;
+}
+
+static void set_identity(Constants& constants, size_t index)
+{
+	for (size_t r = 0; r < 4; r++)
+	{
+		for (size_t c = 0; c < 4; c++)
+		{
+			constants.c[index + r][c] = r == c ? 1.0f : 0.0f;
+		}
+	}
+}
+
+static int failures = 0;
+
+static void expect(const char* name, const float* actual, const double* expected, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		if (std::fabs(actual[i] - expected[i]) > 1e-5)
+		{
+			printf("FAIL %s: component %zu is %.7f, expected %.7f\n", name, i, actual[i], expected[i]);
+			++failures;
+			return;
+		}
+	}
+
+	printf("ok   %s\n", name);
+}
+
+static void expect(const char* name, bool actual, bool expected)
+{
+	if (actual != expected)
+	{
+		printf("FAIL %s: %s, expected %s\n", name, actual ? "true" : "false", expected ? "true" : "false");
+		++failures;
+		return;
+	}
+
+	printf("ok   %s\n", name);
+}
+
+struct Fixture
+{
+	std::vector<uint32_t> atlas_a = make_atlas(0x40);
+	std::vector<uint32_t> atlas_b = make_atlas(0x80);
+	// 2x2, ARGB: red, green / blue, half-transparent white.
+	uint32_t texels[4] = { 0xFFFF0000, 0xFF00FF00, 0xFF0000FF, 0x80FFFFFF };
+
+	Constants constants {};
+	Samplers samplers {};
+
+	Fixture()
+	{
+		constants.set_defaults();
+
+		set_identity(constants, Register_WorldMatrix);
+		set_identity(constants, Register_wvMatrix);
+		set_identity(constants, Register_ProjectionMatrix);
+		set_identity(constants, Register_wvMatrixInvT);
+
+		// Diffuse from palette A row 1, specular from row 3; B uses rows 5 and 7.
+		set(constants, Register_Indices, row(1), row(5), row(3), row(7));
+
+		samplers.palette_a = { atlas_a.data(), false, ATLAS_ROWS };
+		samplers.palette_b = { atlas_b.data(), false, ATLAS_ROWS };
+		samplers.base      = { texels, 2, 2 };
+	}
+
+	VertexOutput vs(uint32_t permutation, const VertexInput& input) const
+	{
+		VertexOutput output {};
+		vs_main(constants, permutation, samplers, input, output);
+		return output;
+	}
+};
+
+static VertexInput vertex(float nx, float ny, float nz)
+{
+	VertexInput input {};
+	input.normal[0] = nx;
+	input.normal[1] = ny;
+	input.normal[2] = nz;
+	return input;
+}
+
+// A palette texel as sampled: red is the column, green the row, blue the atlas id.
+static void texel(size_t x, size_t y, uint32_t id, double* out)
+{
+	out[0] = x / 255.0;
+	out[1] = y / 255.0;
+	out[2] = id / 255.0;
+}
+
+static void check_palette()
+{
+	Fixture f;
+
+	// The default light points down (0, -1, 0). The palette column is
+	// floor(clamp(1 - (dot + 1) / 2, 0, 0.99) * 255), sampled at that
+	// column over 255 across a 256 texel row.
+	struct Case
+	{
+		const char* name;
+		float normal[3];
+		size_t column;
+	};
+
+	const Case cases[] = {
+		// dot = -1: 1 - 0 = 1, clamped to 0.99; floor(252.45) = 252, and 252 / 255 * 256 = 252.99.
+		{ "palette: facing away from the light", { 0.0f, 1.0f, 0.0f }, 252 },
+		// dot = 1: 0.
+		{ "palette: facing the light", { 0.0f, -1.0f, 0.0f }, 0 },
+		// dot = 0: 0.5; floor(127.5) = 127, and 127 / 255 * 256 = 127.5.
+		{ "palette: perpendicular", { 1.0f, 0.0f, 0.0f }, 127 },
+	};
+
+	for (const auto& c : cases)
+	{
+		const auto output = f.vs(Permutation_Light, vertex(c.normal[0], c.normal[1], c.normal[2]));
+
+		double expected[8];
+		texel(c.column, 1, 0x40, expected);
+		expected[3] = 1.0;
+		texel(c.column, 3, 0x40, expected + 4);
+		expected[7] = 0.0;
+
+		float actual[8];
+		memcpy(actual, output.diffuse, sizeof(output.diffuse));
+		memcpy(actual + 4, output.specular, sizeof(output.specular));
+
+		expect(c.name, actual, expected, 8);
+	}
+
+	// The light direction is normalized, and the normal is scaled and then transformed by the world matrix.
+	set(f.constants, Register_LightDirection, 0.0f, -4.0f, 0.0f, 0.0f);
+	set(f.constants, Register_NormalScale, 1.0f, 0.0f, 1.0f, 0.0f);
+	// World rotates +X onto +Y, so normal (1, 1, 0) scaled to (1, 0, 0) ends up facing away from the light.
+	set(f.constants, Register_WorldMatrix + 0, 0.0f, 1.0f, 0.0f, 0.0f);
+	set(f.constants, Register_WorldMatrix + 1, -1.0f, 0.0f, 0.0f, 0.0f);
+
+	{
+		const auto output = f.vs(Permutation_Light, vertex(1.0f, 1.0f, 0.0f));
+
+		double expected[4];
+		texel(252, 1, 0x40, expected);
+		expected[3] = 1.0;
+
+		expect("palette: normal scale and world rotation", output.diffuse, expected, 4);
+	}
+}
+
+static void check_lighting()
+{
+	Fixture f;
+
+	// Blend 25% of the way to palette B for diffuse and 50% for specular, facing the light (column 0).
+	set(f.constants, Register_BlendFactor, 0.25f, 0.5f, 0.0f, 0.0f);
+
+	{
+		const auto output = f.vs(Permutation_Light | Permutation_Blend, vertex(0.0f, -1.0f, 0.0f));
+
+		const double expected[8] = {
+			0.0, (1.0 + (5.0 - 1.0) * 0.25) / 255.0, (0x40 + (0x80 - 0x40) * 0.25) / 255.0, 1.0,
+			0.0, (3.0 + (7.0 - 3.0) * 0.5) / 255.0, (0x40 + (0x80 - 0x40) * 0.5) / 255.0, 0.0,
+		};
+
+		float actual[8];
+		memcpy(actual, output.diffuse, sizeof(output.diffuse));
+		memcpy(actual + 4, output.specular, sizeof(output.specular));
+
+		expect("lighting: palette blend", actual, expected, 8);
+	}
+
+	set(f.constants, Register_BlendFactor, 0.0f, 0.0f, 0.0f, 0.0f);
+
+	// Vertex colors are used when the diffuse source is COLOR1 and the color isn't all zero.
+	VertexInput input = vertex(0.0f, -1.0f, 0.0f);
+	input.color[0] = 0.5f;
+	input.color[1] = 0.25f;
+	input.color[2] = 1.0f;
+	input.color[3] = 0.75f;
+
+	{
+		const auto output = f.vs(Permutation_Light, input);
+		// Column 0 has no red, so only green and blue show the vertex color.
+		const double expected[4] = { 0.0, 0.25 * 1.0 / 255.0, 1.0 * 0x40 / 255.0, 0.75 };
+		expect("lighting: vertex color", output.diffuse, expected, 4);
+	}
+
+	// With vertex colors disallowed, RGB is forced to white but alpha still comes from the vertex.
+	set(f.constants, Register_AllowVertexColor, 0.0f, 0.0f, 0.0f, 0.0f);
+
+	{
+		const auto output = f.vs(Permutation_Light, input);
+		const double expected[4] = { 0.0, 1.0 / 255.0, 0x40 / 255.0, 0.75 };
+		expect("lighting: vertex color disallowed", output.diffuse, expected, 4);
+	}
+
+	set(f.constants, Register_AllowVertexColor, 1.0f, 1.0f, 1.0f, 1.0f);
+
+	// Material diffuse is used when the source isn't COLOR1 (D3DMCS_MATERIAL is 0).
+	set(f.constants, Register_DiffuseSource, 0.0f, 0.0f, 0.0f, 0.0f);
+	set(f.constants, Register_MaterialDiffuse, 0.5f, 0.5f, 0.5f, 0.5f);
+
+	{
+		const auto output = f.vs(Permutation_Light, input);
+		const double expected[4] = { 0.0, 0.5 / 255.0, 0.5 * 0x40 / 255.0, 0.5 };
+		expect("lighting: material diffuse", output.diffuse, expected, 4);
+	}
+
+	// The diffuse override replaces the palette color, but not the specular.
+	set(f.constants, Register_DiffuseOverride, 1.0f, 1.0f, 1.0f, 1.0f);
+	set(f.constants, Register_DiffuseOverrideColor, 0.2f, 0.4f, 0.6f, 0.0f);
+
+	{
+		const auto output = f.vs(Permutation_Light, input);
+
+		const double expected[8] = {
+			0.5 * 0.2, 0.5 * 0.4, 0.5 * 0.6, 0.5,
+			0.0, 3.0 / 255.0, 0x40 / 255.0, 0.0,
+		};
+
+		float actual[8];
+		memcpy(actual, output.diffuse, sizeof(output.diffuse));
+		memcpy(actual + 4, output.specular, sizeof(output.specular));
+
+		expect("lighting: diffuse override", actual, expected, 8);
+	}
+
+	// Without the light permutation there's no palette and no specular.
+	{
+		const auto output = f.vs(0, input);
+		const double expected[8] = { 0.5, 0.5, 0.5, 0.5, 0.0, 0.0, 0.0, 0.0 };
+
+		float actual[8];
+		memcpy(actual, output.diffuse, sizeof(output.diffuse));
+		memcpy(actual + 4, output.specular, sizeof(output.specular));
+
+		expect("lighting: unlit", actual, expected, 8);
+	}
+}
+
+static void check_transform()
+{
+	Fixture f;
+
+	// World moves +10 in X. World-view moves +10 in Z. The projection scales X by 2 and Y by 3,
+	// and puts view Z in W with Z - 1 in Z.
+	set(f.constants, Register_WorldMatrix + 3, 10.0f, 0.0f, 0.0f, 1.0f);
+	set(f.constants, Register_wvMatrix + 3, 0.0f, 0.0f, 10.0f, 1.0f);
+	set(f.constants, Register_ProjectionMatrix + 0, 2.0f, 0.0f, 0.0f, 0.0f);
+	set(f.constants, Register_ProjectionMatrix + 1, 0.0f, 3.0f, 0.0f, 0.0f);
+	set(f.constants, Register_ProjectionMatrix + 2, 0.0f, 0.0f, 1.0f, 1.0f);
+	set(f.constants, Register_ProjectionMatrix + 3, 0.0f, 0.0f, -1.0f, 0.0f);
+
+	VertexInput input = vertex(0.0f, 1.0f, 0.0f);
+	input.position[0] = 1.0f;
+	input.position[1] = 2.0f;
+	input.position[2] = 3.0f;
+	input.tex[0] = 0.125f;
+	input.tex[1] = 0.375f;
+
+	const auto output = f.vs(Permutation_Texture, input);
+
+	const double position[4] = { 2.0, 6.0, 12.0, 13.0 };
+	const double world[3]    = { 11.0, 2.0, 3.0 };
+	const double distance[1] = { 13.0 };
+	const double tex[2]      = { 0.125, 0.375 };
+
+	expect("transform: clip position", output.position, position, 4);
+	expect("transform: world position", output.world_position, world, 3);
+	expect("transform: fog distance is view Z", &output.fog_distance, distance, 1);
+	expect("transform: texture coordinates pass through", output.tex, tex, 2);
+
+	// Environment mapping transforms the normal by wvMatrixInvT, then by the texture
+	// transform: u = -0.5 * x + 0.5 and v = 0.5 * y + 0.5.
+	input.normal[0] = 0.5f;
+	input.normal[1] = -0.5f;
+
+	const auto env = f.vs(Permutation_Texture | Permutation_EnvMap, input);
+	const double env_tex[2] = { 0.25, 0.25 };
+
+	expect("transform: environment map", env.tex, env_tex, 2);
+}
+
+static void check_pixel()
+{
+	Fixture f;
+
+	VertexOutput input {};
+	input.diffuse[0] = 0.5f;
+	input.diffuse[1] = 0.5f;
+	input.diffuse[2] = 0.5f;
+	input.diffuse[3] = 1.0f;
+	input.specular[0] = 0.25f;
+	input.specular[1] = 0.0f;
+	input.specular[2] = 0.0f;
+	input.specular[3] = 0.0f;
+	input.fog_distance = 13.0f;
+
+	float color[4];
+
+	// Untextured draws are just the diffuse color.
+	ps_main(f.constants, 0, f.samplers, input, color);
+
+	{
+		const double expected[4] = { 0.5, 0.5, 0.5, 1.0 };
+		expect("pixel: untextured", color, expected, 4);
+	}
+
+	// (0.75, 1.25) wraps to (0.75, 0.25): texel (1, 0), which is green.
+	input.tex[0] = 0.75f;
+	input.tex[1] = 1.25f;
+
+	ps_main(f.constants, Permutation_Texture, f.samplers, input, color);
+
+	{
+		const double expected[4] = { 0.25, 0.5, 0.0, 1.0 };
+		expect("pixel: texture times diffuse plus specular", color, expected, 4);
+	}
+
+	// (0.25, 0.75) is texel (0, 1), blue. Negative coordinates wrap too.
+	input.tex[0] = -0.75f;
+	input.tex[1] = 0.75f;
+
+	ps_main(f.constants, Permutation_Texture, f.samplers, input, color);
+
+	{
+		const double expected[4] = { 0.25, 0.0, 0.5, 1.0 };
+		expect("pixel: wrapped negative coordinates", color, expected, 4);
+	}
+
+	// Texel (1, 1) has alpha 0x80; with diffuse alpha 0.1 that's below the 16 / 255 alpha reference.
+	input.tex[0] = 0.75f;
+	input.tex[1] = 0.75f;
+	input.diffuse[3] = 0.1f;
+
+	expect("pixel: alpha test clips", ps_main(f.constants, Permutation_Texture | Permutation_Alpha, f.samplers, input, color), false);
+	expect("pixel: no alpha test without the permutation", ps_main(f.constants, Permutation_Texture, f.samplers, input, color), true);
+
+	input.diffuse[3] = 1.0f;
+
+	// Linear fog from 10 to 20 at distance 13 keeps 70% of the color.
+	set(f.constants, Register_FogMode, 3.0f, 0.0f, 0.0f, 0.0f);
+	set(f.constants, Register_FogConfig, 10.0f, 20.0f, 0.0f, 0.0f);
+	set(f.constants, Register_FogColor, 1.0f, 0.0f, 1.0f, 1.0f);
+
+	ps_main(f.constants, Permutation_Fog, f.samplers, input, color);
+
+	{
+		const double expected[4] = { 0.7 * 0.5 + 0.3, 0.7 * 0.5, 0.7 * 0.5 + 0.3, 1.0 };
+		expect("pixel: linear fog", color, expected, 4);
+	}
+
+	// Range fog measures from the view position to the world position instead: 3-4-5.
+	input.world_position[0] = 3.0f;
+	input.world_position[1] = 4.0f;
+	set(f.constants, Register_FogConfig, 0.0f, 10.0f, 0.0f, 0.0f);
+
+	ps_main(f.constants, Permutation_Fog | Permutation_RangeFog, f.samplers, input, color);
+
+	{
+		const double expected[4] = { 0.5 * 0.5 + 0.5, 0.5 * 0.5, 0.5 * 0.5 + 0.5, 1.0 };
+		expect("pixel: range fog", color, expected, 4);
+	}
+
+	// Exponential fog with density 0.1 at distance 13. lantern.hlsl uses E = 2.71828.
+	set(f.constants, Register_FogMode, 1.0f, 0.0f, 0.0f, 0.0f);
+	set(f.constants, Register_FogConfig, 0.0f, 0.0f, 0.1f, 0.0f);
+
+	ps_main(f.constants, Permutation_Fog, f.samplers, input, color);
+
+	{
+		const double factor = 1.0 / std::pow(2.71828, 1.3);
+		const double expected[4] = { factor * 0.5 + (1.0 - factor), factor * 0.5, factor * 0.5 + (1.0 - factor), 1.0 };
+		expect("pixel: exponential fog", color, expected, 4);
+	}
+
+	set(f.constants, Register_FogMode, 2.0f, 0.0f, 0.0f, 0.0f);
+
+	ps_main(f.constants, Permutation_Fog, f.samplers, input, color);
+
+	{
+		const double factor = 1.0 / std::pow(2.71828, 13.0 * 13.0 * 0.1 * 0.1);
+		const double expected[4] = { factor * 0.5 + (1.0 - factor), factor * 0.5, factor * 0.5 + (1.0 - factor), 1.0 };
+		expect("pixel: squared exponential fog", color, expected, 4);
+	}
+}
+
+static std::mt19937 rng(0x5EADE5);
+
+static float random_float(float min, float max)
+{
+	return std::uniform_real_distribution<float>(min, max)(rng);
+}
+
+static std::vector<VertexInput> make_vertices(size_t count)
+{
+	std::vector<VertexInput> result(count);
+
+	for (auto& v : result)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			v.position[i] = random_float(-100.0f, 100.0f);
+			v.normal[i]   = random_float(-1.0f, 1.0f);
+		}
+
+		v.tex[0] = random_float(-2.0f, 2.0f);
+		v.tex[1] = random_float(-2.0f, 2.0f);
+
+		for (auto& c : v.color)
+		{
+			c = rng() % 4 ? random_float(0.0f, 1.0f) : 0.0f;
+		}
+	}
+
+	return result;
+}
+
+static void randomize(Fixture& f)
+{
+	for (size_t r = 0; r < 16; r++)
+	{
+		for (size_t c = 0; c < 4; c++)
+		{
+			f.constants.c[r][c] = random_float(-2.0f, 2.0f);
+		}
+	}
+
+	set(f.constants, Register_LightDirection, random_float(-1.0f, 1.0f), random_float(-1.0f, 1.0f), random_float(-1.0f, 1.0f), 0.0f);
+	set(f.constants, Register_BlendFactor, random_float(0.0f, 1.0f), random_float(0.0f, 1.0f), 0.0f, 0.0f);
+	set(f.constants, Register_FogConfig, 50.0f, 150.0f, 0.01f, 0.0f);
+	set(f.constants, Register_FogColor, random_float(0.0f, 1.0f), random_float(0.0f, 1.0f), random_float(0.0f, 1.0f), 1.0f);
+	set(f.constants, Register_ViewPosition, random_float(-10.0f, 10.0f), random_float(-10.0f, 10.0f), random_float(-10.0f, 10.0f), 0.0f);
+}
+
+static void check_batches()
+{
+	Fixture f;
+	randomize(f);
+
+	const auto vertices = make_vertices(257);
+
+	std::vector<VertexOutput> expected(vertices.size());
+	std::vector<VertexOutput> actual(vertices.size());
+	std::vector<float> expected_colors(vertices.size() * 4);
+	std::vector<float> actual_colors(vertices.size() * 4);
+	std::unique_ptr<bool[]> expected_visible(new bool[vertices.size()]);
+	std::unique_ptr<bool[]> actual_visible(new bool[vertices.size()]);
+
+	for (uint32_t permutation = 0; permutation < 128; permutation++)
+	{
+		for (uint32_t mode = 0; mode < 4; mode++)
+		{
+			set(f.constants, Register_FogMode, static_cast<float>(mode), 0.0f, 0.0f, 0.0f);
+			set(f.constants, Register_DiffuseOverride, permutation & 1 ? 1.0f : 0.0f, 0.0f, 0.0f, 0.0f);
+
+			for (size_t i = 0; i < vertices.size(); i++)
+			{
+				vs_main(f.constants, permutation, f.samplers, vertices[i], expected[i]);
+				expected_visible[i] = ps_main(f.constants, permutation, f.samplers, expected[i], &expected_colors[i * 4]);
+			}
+
+			vs_batch(f.constants, permutation, f.samplers, vertices.data(), actual.data(), vertices.size());
+			ps_batch(f.constants, permutation, f.samplers, expected.data(), actual_colors.data(), actual_visible.get(), vertices.size());
+
+			for (size_t i = 0; i < vertices.size(); i++)
+			{
+				const bool vs_match = !memcmp(&expected[i], &actual[i], sizeof(VertexOutput));
+				const bool ps_match = expected_visible[i] == actual_visible[i]
+				                      && !memcmp(&expected_colors[i * 4], &actual_colors[i * 4], sizeof(float) * 4);
+
+				if (!vs_match || !ps_match)
+				{
+					printf("FAIL batch: permutation %u, fog mode %u, vertex %zu differs from the scalar port in the %s shader\n",
+					       permutation, mode, i, vs_match ? "pixel" : "vertex");
+					++failures;
+					return;
+				}
+			}
+		}
+	}
+
+	printf("ok   batch: vs_batch and ps_batch match the scalar port for all 128 permutations\n");
+}
+
+template <typename F>
+static double seconds(F f)
+{
+	const auto start = std::chrono::steady_clock::now();
+	f();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void bench()
+{
+	Fixture f;
+	randomize(f);
+	set(f.constants, Register_FogMode, 3.0f, 0.0f, 0.0f, 0.0f);
+
+	const size_t count  = 4096;
+	const size_t repeat = 1000;
+
+	const auto vertices = make_vertices(count);
+
+	std::vector<VertexOutput> outputs(count);
+	std::vector<float> colors(count * 4);
+	std::unique_ptr<bool[]> visible(new bool[count]);
+
+	const uint32_t permutations[] = {
+		Permutation_Texture | Permutation_Light | Permutation_Fog,
+		Permutation_Texture | Permutation_Light | Permutation_Blend | Permutation_Fog | Permutation_Alpha,
+		Permutation_Texture | Permutation_EnvMap | Permutation_Light | Permutation_Fog | Permutation_RangeFog,
+	};
+
+	printf("\n%-12s %14s %14s %14s %14s\n", "permutation", "vs_main", "vs_batch", "ps_main", "ps_batch");
+
+	for (auto permutation : permutations)
+	{
+		const double vs_scalar = seconds([&]
+		{
+			for (size_t r = 0; r < repeat; r++)
+			{
+				for (size_t i = 0; i < count; i++)
+				{
+					vs_main(f.constants, permutation, f.samplers, vertices[i], outputs[i]);
+				}
+			}
+		});
+
+		const double vs_simd = seconds([&]
+		{
+			for (size_t r = 0; r < repeat; r++)
+			{
+				vs_batch(f.constants, permutation, f.samplers, vertices.data(), outputs.data(), count);
+			}
+		});
+
+		const double ps_scalar = seconds([&]
+		{
+			for (size_t r = 0; r < repeat; r++)
+			{
+				for (size_t i = 0; i < count; i++)
+				{
+					visible[i] = ps_main(f.constants, permutation, f.samplers, outputs[i], &colors[i * 4]);
+				}
+			}
+		});
+
+		const double ps_simd = seconds([&]
+		{
+			for (size_t r = 0; r < repeat; r++)
+			{
+				ps_batch(f.constants, permutation, f.samplers, outputs.data(), colors.data(), visible.get(), count);
+			}
+		});
+
+		const double total = static_cast<double>(count * repeat) / 1e6;
+
+		printf("0x%02X %18.1f M/s %10.1f M/s %10.1f M/s %10.1f M/s\n", permutation,
+		       total / vs_scalar, total / vs_simd, total / ps_scalar, total / ps_simd);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	check_palette();
+	check_lighting();
+	check_transform();
+	check_pixel();
+	check_batches();
+
+	if (failures)
+	{
+		printf("%d failed\n", failures);
+		return 1;
+	}
+
+	if (argc > 1 && std::string(argv[1]) == "--bench")
+	{
+		bench();
+	}
+
+	return 0;
+}
@@ -0,0 +1,226 @@
+// Palette instance churn benchmark.
+//
+// Repeats what Sky Deck does each time its palette object spawns and is
+// deleted: the collection's first instance reloads its palette and source
+// lights, a second instance is created, loads the other act's palette, is
+// added to the collection and is removed again. Runs the cycle with palette
+// data embedded in every instance, as LanternInstance used to hold it, and
+// with the data in SharedPool blocks, as it does now. Palette files are read
+// from memory so that only the instances' own cost is measured. Checks that
+// both leave the same palettes in the collection and that the pools and their
+// accounted memory stop growing after the first two cycles. With --bench, also
+// reports the time per cycle of both. Build and run with:
+//
+//     g++ -std=c++14 -O2 -o shared_pool_bench tools/shared_pool_bench.cpp sadx-dc-lighting/memory_accounting.cpp
+//     ./shared_pool_bench [--bench]
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../sadx-dc-lighting/memory_accounting.h"
+#include "../sadx-dc-lighting/shared_pool.h"
+
+using memory_accounting::Tag;
+
+// Same sizes as PalettePairs and SourceLights in lantern.h.
+using PalettePairs = std::array<std::array<uint32_t, 2>, 256 * 8>;
+using SourceLights = std::array<std::array<uint8_t, 0x60>, 16>;
+
+static_assert(sizeof(PalettePairs) == 16384, "PalettePairs size mismatch");
+static_assert(sizeof(SourceLights) == 1536, "SourceLights size mismatch");
+
+using PalettePool = SharedPool<PalettePairs, Tag::Palettes>;
+using SourcePool  = SharedPool<SourceLights, Tag::Palettes>;
+
+/// Contents of the PL and SL files for Sky Deck's two acts.
+struct Files
+{
+	std::vector<uint8_t> palettes[2];
+	std::vector<uint8_t> sources[2];
+
+	Files()
+	{
+		for (size_t act = 0; act < 2; act++)
+		{
+			palettes[act].resize(sizeof(PalettePairs));
+			sources[act].resize(sizeof(SourceLights));
+
+			for (size_t i = 0; i < palettes[act].size(); i++)
+			{
+				palettes[act][i] = static_cast<uint8_t>((i + act * 131) * 2654435761u >> 24);
+			}
+
+			for (size_t i = 0; i < sources[act].size(); i++)
+			{
+				sources[act][i] = static_cast<uint8_t>(i + act);
+			}
+		}
+	}
+};
+
+/// An instance holding its palette data, as LanternInstance did before the pool.
+struct EmbeddedInstance
+{
+	PalettePairs palette {};
+	SourceLights source {};
+
+	void load_palette(const Files& files, size_t act)
+	{
+		memcpy(&palette, files.palettes[act].data(), sizeof(palette));
+	}
+
+	void load_source(const Files& files, size_t act)
+	{
+		memcpy(&source, files.sources[act].data(), sizeof(source));
+	}
+
+	const PalettePairs& palette_data() const
+	{
+		return palette;
+	}
+};
+
+/// An instance referring to pooled blocks, as LanternInstance does now.
+/// New instances share a single empty block until they load anything.
+struct PooledInstance
+{
+	static PalettePool palettes;
+	static SourcePool sources;
+	static const PalettePool::Ref empty_palette;
+	static const SourcePool::Ref empty_source;
+
+	PalettePool::Ref palette = empty_palette;
+	SourcePool::Ref source = empty_source;
+
+	void load_palette(const Files& files, size_t act)
+	{
+		auto loaded = palettes.acquire();
+		memcpy(&loaded.mutate(), files.palettes[act].data(), sizeof(PalettePairs));
+		palette = std::move(loaded);
+	}
+
+	void load_source(const Files& files, size_t act)
+	{
+		auto loaded = sources.acquire();
+		memcpy(&loaded.mutate(), files.sources[act].data(), sizeof(SourceLights));
+		source = std::move(loaded);
+	}
+
+	const PalettePairs& palette_data() const
+	{
+		return *palette;
+	}
+};
+
+PalettePool PooledInstance::palettes;
+SourcePool PooledInstance::sources;
+const PalettePool::Ref PooledInstance::empty_palette = PooledInstance::palettes.acquire();
+const SourcePool::Ref PooledInstance::empty_source = PooledInstance::sources.acquire();
+
+/// One spawn and deletion of Sky Deck's palette object, as in Obj_SkyDeck.cpp.
+template <typename Instance>
+static void cycle(std::vector<Instance>& collection, const Files& files)
+{
+	collection[0].load_palette(files, 0);
+	collection[0].load_source(files, 0);
+
+	Instance lantern;
+	lantern.load_palette(files, 1);
+	collection.emplace_back(std::move(lantern));
+
+	collection.erase(collection.begin() + 1);
+}
+
+template <typename F>
+static double seconds(F f)
+{
+	const auto start = std::chrono::steady_clock::now();
+	f();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+	const Files files;
+
+	std::vector<EmbeddedInstance> embedded(1);
+	std::vector<PooledInstance> pooled(1);
+
+	// Reserved up front, as the collection's vector has grown to two instances
+	// long before the object's first deletion.
+	embedded.reserve(2);
+	pooled.reserve(2);
+
+	// The first cycle replaces the empty blocks the first instance started with, and the
+	// second is the first to load over blocks of its own, which takes one more block.
+	for (int i = 0; i < 2; i++)
+	{
+		cycle(embedded, files);
+		cycle(pooled, files);
+	}
+
+	const size_t palette_blocks = PooledInstance::palettes.capacity();
+	const size_t source_blocks  = PooledInstance::sources.capacity();
+	const auto usage = memory_accounting::usage(Tag::Palettes);
+
+	const size_t cycles = 10000;
+
+	for (size_t i = 0; i < cycles; i++)
+	{
+		cycle(pooled, files);
+	}
+
+	const auto after = memory_accounting::usage(Tag::Palettes);
+
+	if (PooledInstance::palettes.capacity() != palette_blocks || PooledInstance::sources.capacity() != source_blocks
+	    || after.bytes != usage.bytes || after.allocations != usage.allocations || after.peak_bytes != usage.peak_bytes)
+	{
+		printf("FAIL the pools grew from %zu and %zu blocks (%zu bytes) to %zu and %zu (%zu bytes)\n", palette_blocks,
+		       source_blocks, usage.bytes, PooledInstance::palettes.capacity(), PooledInstance::sources.capacity(),
+		       after.bytes);
+		return 1;
+	}
+
+	if (pooled.size() != 1 || embedded.size() != 1 || pooled[0].palette_data() != embedded[0].palette_data()
+	    || memcmp(&pooled[0].palette_data(), files.palettes[0].data(), sizeof(PalettePairs)))
+	{
+		printf("FAIL the collections don't hold the first act's palette after churn\n");
+		return 1;
+	}
+
+	printf("ok   %zu churn cycles: pools hold %zu palette and %zu source blocks (%zu bytes) throughout\n", cycles + 2,
+	       palette_blocks, source_blocks, usage.bytes);
+
+	if (argc < 2 || std::string(argv[1]) != "--bench")
+	{
+		return 0;
+	}
+
+	const size_t bench_cycles = 200000;
+
+	const double embedded_time = seconds([&]
+	{
+		for (size_t i = 0; i < bench_cycles; i++)
+		{
+			cycle(embedded, files);
+		}
+	});
+
+	const double pooled_time = seconds([&]
+	{
+		for (size_t i = 0; i < bench_cycles; i++)
+		{
+			cycle(pooled, files);
+		}
+	});
+
+	printf("\n%-10s %12s\n", "per cycle", "ns");
+	printf("%-10s %12.1f\n", "embedded", embedded_time * 1e9 / bench_cycles);
+	printf("%-10s %12.1f\n", "pooled", pooled_time * 1e9 / bench_cycles);
+	return 0;
+}
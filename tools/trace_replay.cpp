@@ -0,0 +1,544 @@
+// Hook event trace replayer.
+//
+// Replays a trace recorded in game (see TraceFrames in config.ini) through
+// trace::StatsHandler, mirrors the shader constants and shader binds the hooks
+// make onto the mock device, and reports what each frame did and how long it
+// took to replay. Without a trace, writes a synthetic one with trace::Writer
+// and checks that replaying it gives back every event unchanged, that the
+// per-frame statistics match what was written, and that truncated and
+// corrupt traces are rejected. With --bench, the synthetic trace is also
+// replayed for timing. Build and run with:
+//
+//     g++ -std=c++14 -O2 -o trace_replay tools/trace_replay.cpp tools/mock_device.cpp sadx-dc-lighting/trace.cpp sadx-dc-lighting/shader_reference.cpp
+//     ./trace_replay [--bench] [lantern.trace]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "../sadx-dc-lighting/trace.h"
+#include "mock_device.h"
+
+using Clock = std::chrono::steady_clock;
+
+// Register layout of the shader parameters, as in d3d.cpp.
+static constexpr uint32_t REGISTER_WORLD           = 0;
+static constexpr uint32_t REGISTER_WV              = 4;
+static constexpr uint32_t REGISTER_PROJECTION      = 8;
+static constexpr uint32_t REGISTER_MATERIAL        = 23;
+static constexpr uint32_t REGISTER_FOG_MODE        = 30;
+static constexpr uint32_t REGISTER_FOG_CONFIG      = 31;
+static constexpr uint32_t REGISTER_FOG_COLOR       = 32;
+
+/// An event as it appears in the trace, for comparing what was written with what was replayed.
+struct Recorded
+{
+	trace::Event type;
+	std::vector<uint8_t> payload;
+
+	bool operator==(const Recorded& other) const
+	{
+		return type == other.type && payload == other.payload;
+	}
+};
+
+template <typename T>
+static Recorded record(const T& event)
+{
+	const auto bytes = reinterpret_cast<const uint8_t*>(&event);
+	return { T::type, std::vector<uint8_t>(bytes, bytes + sizeof(T)) };
+}
+
+/// Keeps every replayed event.
+class Recorder : public trace::Handler
+{
+public:
+	std::vector<Recorded> events;
+
+	void on_frame(const trace::Frame& e) override { events.push_back(record(e)); }
+	void on_parse_material(const trace::ParseMaterial& e) override { events.push_back(record(e)); }
+	void on_set_texlist(const trace::SetTexList& e) override { events.push_back(record(e)); }
+	void on_perform_lighting(const trace::PerformLighting& e) override { events.push_back(record(e)); }
+	void on_world_transform(const trace::WorldTransform& e) override { events.push_back(record(e)); }
+	void on_projection_matrix(const trace::ProjectionMatrix& e) override { events.push_back(record(e)); }
+	void on_fog_enable(const trace::FogEnable& e) override { events.push_back(record(e)); }
+	void on_fog_color(const trace::FogColor& e) override { events.push_back(record(e)); }
+	void on_fog_table(const trace::FogTable& e) override { events.push_back(record(e)); }
+	void on_draw(const trace::Draw& e) override { events.push_back(record(e)); }
+};
+
+/// Per-frame device work and replay time, alongside the StatsHandler counters.
+struct FrameCost
+{
+	size_t constant_registers;
+	size_t redundant_registers;
+	size_t shader_binds;
+	double microseconds;
+};
+
+/// <summary>
+/// Gathers StatsHandler's statistics while making the device calls the hooks
+/// make for each event: the world and world-view matrices on each transform
+/// update, the projection, the material diffuse, the fog parameters, and a
+/// shader bind whenever a draw's permutation changes.
+/// </summary>
+class Replayer : public trace::StatsHandler
+{
+	mock_device::Device& device;
+	Clock::time_point frame_start = Clock::now();
+	uint32_t bound_flags = 0;
+	mock_device::Counters last {};
+
+	// Stand-ins for the compiled shaders, one per permutation seen.
+	std::vector<uint32_t> permutations;
+
+	const void* shader(uint32_t flags)
+	{
+		auto it = std::find(permutations.begin(), permutations.end(), flags);
+
+		if (it == permutations.end())
+		{
+			permutations.push_back(flags);
+			it = permutations.end() - 1;
+		}
+
+		// Never dereferenced by the device.
+		return reinterpret_cast<const void*>(static_cast<uintptr_t>(it - permutations.begin() + 1) * 16);
+	}
+
+public:
+	std::vector<FrameCost> costs;
+
+	explicit Replayer(mock_device::Device& device)
+		: device(device)
+	{
+	}
+
+	void on_frame(const trace::Frame& e) override
+	{
+		StatsHandler::on_frame(e);
+
+		const auto& c = device.counters();
+		const auto now = Clock::now();
+
+		costs.push_back({
+			c.constant_registers - last.constant_registers,
+			c.redundant_registers - last.redundant_registers,
+			c.shader_binds - last.shader_binds,
+			std::chrono::duration<double, std::micro>(now - frame_start).count()
+		});
+
+		last = c;
+		frame_start = now;
+	}
+
+	void on_parse_material(const trace::ParseMaterial& e) override
+	{
+		StatsHandler::on_parse_material(e);
+
+		const float diffuse[4] = {
+			static_cast<float>((e.diffuse >> 16) & 0xFF) / 255.0f,
+			static_cast<float>((e.diffuse >> 8) & 0xFF) / 255.0f,
+			static_cast<float>(e.diffuse & 0xFF) / 255.0f,
+			static_cast<float>(e.diffuse >> 24) / 255.0f,
+		};
+
+		device.SetVertexShaderConstantF(REGISTER_MATERIAL, diffuse, 1);
+	}
+
+	void on_world_transform(const trace::WorldTransform& e) override
+	{
+		float wv[16] {};
+
+		for (int row = 0; row < 4; row++)
+		{
+			for (int column = 0; column < 4; column++)
+			{
+				for (int k = 0; k < 4; k++)
+				{
+					wv[row * 4 + column] += e.world[row * 4 + k] * e.view[k * 4 + column];
+				}
+			}
+		}
+
+		device.SetVertexShaderConstantF(REGISTER_WORLD, e.world, 4);
+		device.SetVertexShaderConstantF(REGISTER_WV, wv, 4);
+	}
+
+	void on_projection_matrix(const trace::ProjectionMatrix& e) override
+	{
+		device.SetVertexShaderConstantF(REGISTER_PROJECTION, e.projection, 4);
+	}
+
+	void on_fog_enable(const trace::FogEnable& e) override
+	{
+		const float mode[4] = { e.enabled ? 1.0f : 0.0f, 0.0f, 0.0f, 0.0f };
+		device.SetPixelShaderConstantF(REGISTER_FOG_MODE, mode, 1);
+	}
+
+	void on_fog_color(const trace::FogColor& e) override
+	{
+		const float color[4] = {
+			static_cast<float>((e.color >> 16) & 0xFF) / 255.0f,
+			static_cast<float>((e.color >> 8) & 0xFF) / 255.0f,
+			static_cast<float>(e.color & 0xFF) / 255.0f,
+			static_cast<float>(e.color >> 24) / 255.0f,
+		};
+
+		device.SetPixelShaderConstantF(REGISTER_FOG_COLOR, color, 1);
+	}
+
+	void on_fog_table(const trace::FogTable& e) override
+	{
+		const float config[4] = { e.start, e.end, e.density, 0.0f };
+		device.SetPixelShaderConstantF(REGISTER_FOG_CONFIG, config, 1);
+	}
+
+	void on_draw(const trace::Draw& e) override
+	{
+		StatsHandler::on_draw(e);
+
+		if (e.shader_flags && e.shader_flags != bound_flags)
+		{
+			device.SetVertexShader(shader(e.shader_flags));
+			device.SetPixelShader(shader(e.shader_flags));
+			bound_flags = e.shader_flags;
+		}
+	}
+};
+
+static std::vector<uint8_t> read_file(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	return std::vector<uint8_t>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+/// Writes a synthetic trace of the given number of frames, returning the
+/// events written and the statistics StatsHandler should gather from them.
+static bool write_synthetic(const std::string& path, size_t frame_count, std::vector<Recorded>& written,
+                            std::vector<trace::FrameStats>& expected)
+{
+	trace::Writer writer;
+
+	if (!writer.open(path))
+	{
+		return false;
+	}
+
+	const auto emit = [&](const auto& event)
+	{
+		writer.write(event);
+		written.push_back(record(event));
+	};
+
+	uint32_t last_texlist = 0;
+	uint32_t last_flags = 0;
+
+	for (uint32_t f = 0; f < frame_count; f++)
+	{
+		trace::FrameStats stats {};
+
+		trace::ProjectionMatrix projection { 0.96f, -1.0f, -10000.0f, {} };
+
+		for (int i = 0; i < 16; i++)
+		{
+			projection.projection[i] = i % 5 == 0 ? 1.0f : 0.0f;
+		}
+
+		emit(projection);
+		emit(trace::FogEnable { static_cast<uint8_t>(f % 2) });
+		emit(trace::FogColor { 0xFF000000u | f });
+		emit(trace::FogTable { 3, 100.0f, 2000.0f + f, 0.0f });
+
+		for (uint32_t object = 0; object < 40; object++)
+		{
+			trace::WorldTransform transform {};
+
+			for (int i = 0; i < 16; i++)
+			{
+				transform.world[i] = i % 5 == 0 ? 1.0f : 0.0f;
+				transform.view[i]  = transform.world[i];
+			}
+
+			transform.world[12] = static_cast<float>(object);
+			transform.world[14] = static_cast<float>(f);
+			emit(transform);
+
+			// A few texlists shared by runs of objects, like a level's object list.
+			const uint32_t texlist = 0x03B00000u + (object / 8) * 0x40;
+			emit(trace::SetTexList { texlist, 8 + object / 8 });
+
+			if (texlist != last_texlist)
+			{
+				++stats.texlist_changes;
+				last_texlist = texlist;
+			}
+
+			emit(trace::PerformLighting { static_cast<int32_t>(object % 4) });
+
+			for (uint32_t meshset = 0; meshset < 1 + object % 3; meshset++)
+			{
+				emit(trace::ParseMaterial { 0x03C00000u + object * 0x100 + meshset * 0x14, 0x94002400u,
+				                            0xFFB2B2B2u, 0xFFFFFFFFu, meshset, 0, 0xFFFFFFFFu, 0, 0 });
+				++stats.materials;
+
+				const bool shaded = object % 10 != 9;
+				const uint32_t flags = shaded ? 0x11u | ((object % 5) << 8) : 0;
+				const uint32_t primitives = 12 + object + meshset;
+
+				emit(trace::Draw { trace::DrawKind::IndexedPrimitive, 4, primitives, primitives * 2, flags });
+
+				++stats.draws;
+				stats.primitives += primitives;
+
+				if (shaded)
+				{
+					++stats.shader_draws;
+
+					if (flags != last_flags)
+					{
+						++stats.shader_changes;
+						last_flags = flags;
+					}
+				}
+			}
+		}
+
+		emit(trace::Frame { f });
+		expected.push_back(stats);
+	}
+
+	writer.close();
+	return true;
+}
+
+static bool equal(const trace::FrameStats& a, const trace::FrameStats& b)
+{
+	return a.materials == b.materials && a.texlist_changes == b.texlist_changes && a.draws == b.draws
+	       && a.shader_draws == b.shader_draws && a.shader_changes == b.shader_changes && a.primitives == b.primitives;
+}
+
+static bool self_test(const std::string& path)
+{
+	std::vector<Recorded> written;
+	std::vector<trace::FrameStats> expected;
+
+	if (!write_synthetic(path, 30, written, expected))
+	{
+		printf("FAIL couldn't write %s\n", path.c_str());
+		return false;
+	}
+
+	bool result = true;
+
+	Recorder recorder;
+
+	if (!trace::replay_file(path, recorder) || recorder.events != written)
+	{
+		printf("FAIL round trip: wrote %zu events, replayed %zu differently\n", written.size(), recorder.events.size());
+		result = false;
+	}
+	else
+	{
+		printf("ok   round trip: %zu events\n", written.size());
+	}
+
+	mock_device::Device device;
+	Replayer replayer(device);
+
+	if (!trace::replay_file(path, replayer) || replayer.frames.size() != expected.size()
+	    || !std::equal(expected.begin(), expected.end(), replayer.frames.begin(), equal))
+	{
+		printf("FAIL stats: replayed %zu frames which don't match the %zu written\n", replayer.frames.size(),
+		       expected.size());
+		result = false;
+	}
+	else
+	{
+		printf("ok   stats of %zu frames match\n", expected.size());
+	}
+
+	const auto data = read_file(path);
+
+	// Cut in the middle of the last event: everything before it is replayed, then the error is reported.
+	Recorder truncated;
+
+	if (trace::replay(data.data(), data.size() - 3, truncated) || truncated.events.size() != written.size() - 1
+	    || !std::equal(truncated.events.begin(), truncated.events.end(), written.begin()))
+	{
+		printf("FAIL truncated trace: %zu events replayed\n", truncated.events.size());
+		result = false;
+	}
+
+	// Events of unknown types are skipped.
+	auto extended = data;
+	const trace::EventHeader unknown { trace::Event::Count, 5 };
+	const auto header = reinterpret_cast<const uint8_t*>(&unknown);
+
+	extended.insert(extended.begin() + sizeof(trace::FileHeader), 5, 0xCD);
+	extended.insert(extended.begin() + sizeof(trace::FileHeader), header, header + sizeof(unknown));
+
+	Recorder skipped;
+
+	if (!trace::replay(extended.data(), extended.size(), skipped) || skipped.events != written)
+	{
+		printf("FAIL unknown events weren't skipped\n");
+		result = false;
+	}
+
+	// A payload smaller than its event is malformed.
+	auto short_payload = data;
+	trace::EventHeader first;
+	memcpy(&first, &short_payload[sizeof(trace::FileHeader)], sizeof(first));
+	first.size = 1;
+	memcpy(&short_payload[sizeof(trace::FileHeader)], &first, sizeof(first));
+
+	Recorder rejected;
+
+	if (trace::replay(short_payload.data(), short_payload.size(), rejected) || !rejected.events.empty())
+	{
+		printf("FAIL a short payload was accepted\n");
+		result = false;
+	}
+
+	auto bad_magic = data;
+	bad_magic[0] ^= 0xFF;
+
+	if (trace::replay(bad_magic.data(), bad_magic.size(), rejected))
+	{
+		printf("FAIL a trace with the wrong magic was accepted\n");
+		result = false;
+	}
+
+	if (result)
+	{
+		printf("ok   truncated, corrupt and unknown events\n");
+	}
+
+	return result;
+}
+
+static double percentile(std::vector<double> values, double p)
+{
+	std::sort(values.begin(), values.end());
+	return values[std::min(values.size() - 1, static_cast<size_t>(p * static_cast<double>(values.size())))];
+}
+
+static bool report(const std::string& path, int repeat)
+{
+	const auto data = read_file(path);
+
+	std::vector<trace::FrameStats> frames;
+	std::vector<FrameCost> costs;
+
+	for (int r = 0; r < repeat; r++)
+	{
+		mock_device::Device device;
+		Replayer replayer(device);
+
+		if (!trace::replay(data.data(), data.size(), replayer) || replayer.frames.empty())
+		{
+			printf("FAIL couldn't replay any frames from %s\n", path.c_str());
+			return false;
+		}
+
+		if (costs.empty())
+		{
+			frames = replayer.frames;
+			costs  = replayer.costs;
+			continue;
+		}
+
+		// Keep the fastest replay of each frame.
+		for (size_t f = 0; f < costs.size(); f++)
+		{
+			costs[f].microseconds = std::min(costs[f].microseconds, replayer.costs[f].microseconds);
+		}
+	}
+
+	trace::FrameStats total {};
+	FrameCost total_cost {};
+	std::vector<double> times;
+
+	for (size_t f = 0; f < frames.size(); f++)
+	{
+		total.materials       += frames[f].materials;
+		total.texlist_changes += frames[f].texlist_changes;
+		total.draws           += frames[f].draws;
+		total.shader_draws    += frames[f].shader_draws;
+		total.shader_changes  += frames[f].shader_changes;
+		total.primitives      += frames[f].primitives;
+
+		total_cost.constant_registers  += costs[f].constant_registers;
+		total_cost.redundant_registers += costs[f].redundant_registers;
+		total_cost.shader_binds        += costs[f].shader_binds;
+
+		times.push_back(costs[f].microseconds);
+	}
+
+	const double n = static_cast<double>(frames.size());
+
+	printf("%zu frames, per frame:\n", frames.size());
+	printf("  %10.1f materials\n", total.materials / n);
+	printf("  %10.1f texlist changes\n", total.texlist_changes / n);
+	printf("  %10.1f draws (%.1f with the shaders)\n", total.draws / n, total.shader_draws / n);
+	printf("  %10.1f shader changes\n", total.shader_changes / n);
+	printf("  %10.1f primitives\n", total.primitives / n);
+	printf("  %10.1f constant registers (%.1f redundant)\n", total_cost.constant_registers / n,
+	       total_cost.redundant_registers / n);
+	printf("  %10.1f shader binds\n", total_cost.shader_binds / n);
+
+	double sum = 0.0;
+
+	for (auto t : times)
+	{
+		sum += t;
+	}
+
+	printf("replay cpu us per frame: mean %.2f, median %.2f, p99 %.2f, max %.2f\n", sum / n, percentile(times, 0.5),
+	       percentile(times, 0.99), percentile(times, 1.0));
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	bool bench = false;
+	std::string trace_path;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::string(argv[i]) == "--bench")
+		{
+			bench = true;
+		}
+		else
+		{
+			trace_path = argv[i];
+		}
+	}
+
+	if (!trace_path.empty())
+	{
+		return report(trace_path, bench ? 10 : 1) ? 0 : 1;
+	}
+
+	const std::string path = "trace_replay.trace";
+	bool result = self_test(path);
+
+	if (result && bench)
+	{
+		std::vector<Recorded> written;
+		std::vector<trace::FrameStats> expected;
+
+		result = write_synthetic(path, 600, written, expected) && report(path, 10);
+	}
+
+	std::remove(path.c_str());
+	return result ? 0 : 1;
+}
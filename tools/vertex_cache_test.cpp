@@ -0,0 +1,241 @@
+// Vertex cache optimizer test.
+//
+// Runs vertex_cache::optimize and optimize_fetch over fixture meshes the way
+// the landtable optimizer does, and checks that every triangle survives with
+// its winding, that the renumbered vertices fetch the same triangles, and
+// that the simulated ACMR never gets worse. Prints the ACMR and ATVR of each
+// fixture before and after. Build and run with:
+//
+//     g++ -std=c++14 -O2 -o vertex_cache_test tools/vertex_cache_test.cpp sadx-dc-lighting/vertex_cache.cpp
+//     ./vertex_cache_test
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "../sadx-dc-lighting/vertex_cache.h"
+
+using Triangle = std::array<uint16_t, 3>;
+
+struct Mesh
+{
+	const char* name;
+	std::vector<uint16_t> indices;
+	size_t vertex_count;
+};
+
+static std::mt19937 rng(0x7E27C4C);
+
+/// A grid of quads in row-major order, like most landtable floors.
+static Mesh grid(const char* name, uint16_t columns, uint16_t rows)
+{
+	Mesh mesh { name, {}, static_cast<size_t>((columns + 1) * (rows + 1)) };
+
+	for (uint16_t y = 0; y < rows; y++)
+	{
+		for (uint16_t x = 0; x < columns; x++)
+		{
+			const auto a = static_cast<uint16_t>(y * (columns + 1) + x);
+			const auto b = static_cast<uint16_t>(a + 1);
+			const auto c = static_cast<uint16_t>(a + columns + 1);
+			const auto d = static_cast<uint16_t>(c + 1);
+
+			mesh.indices.insert(mesh.indices.end(), { a, c, b, b, c, d });
+		}
+	}
+
+	return mesh;
+}
+
+/// The same triangles in a random order, as left by exporters which don't care.
+static Mesh shuffled(const char* name, Mesh mesh)
+{
+	std::vector<Triangle> triangles(mesh.indices.size() / 3);
+
+	for (size_t t = 0; t < triangles.size(); t++)
+	{
+		std::copy_n(&mesh.indices[t * 3], 3, triangles[t].begin());
+	}
+
+	std::shuffle(triangles.begin(), triangles.end(), rng);
+
+	mesh.name = name;
+	mesh.indices.clear();
+
+	for (const auto& t : triangles)
+	{
+		mesh.indices.insert(mesh.indices.end(), t.begin(), t.end());
+	}
+
+	return mesh;
+}
+
+static Mesh fan(const char* name, uint16_t triangles)
+{
+	Mesh mesh { name, {}, static_cast<size_t>(triangles + 2) };
+
+	for (uint16_t i = 1; i <= triangles; i++)
+	{
+		mesh.indices.insert(mesh.indices.end(), { 0, i, static_cast<uint16_t>(i + 1) });
+	}
+
+	return mesh;
+}
+
+static Mesh soup(const char* name, uint16_t vertices, size_t triangles)
+{
+	Mesh mesh { name, {}, vertices };
+
+	for (size_t t = 0; t < triangles; t++)
+	{
+		const auto a = static_cast<uint16_t>(rng() % vertices);
+		auto b = static_cast<uint16_t>(rng() % vertices);
+		auto c = static_cast<uint16_t>(rng() % vertices);
+
+		while (b == a)
+		{
+			b = static_cast<uint16_t>(rng() % vertices);
+		}
+
+		while (c == a || c == b)
+		{
+			c = static_cast<uint16_t>(rng() % vertices);
+		}
+
+		mesh.indices.insert(mesh.indices.end(), { a, b, c });
+	}
+
+	return mesh;
+}
+
+/// Rotates a triangle so its smallest index comes first, which keeps its winding.
+static Triangle canonical(const uint16_t* t)
+{
+	const size_t first = std::min_element(t, t + 3) - t;
+	return { t[first], t[(first + 1) % 3], t[(first + 2) % 3] };
+}
+
+static std::vector<Triangle> triangles(const std::vector<uint16_t>& indices)
+{
+	std::vector<Triangle> result;
+
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		result.push_back(canonical(&indices[i]));
+	}
+
+	std::sort(result.begin(), result.end());
+	return result;
+}
+
+static bool check(const Mesh& mesh)
+{
+	const auto optimized = vertex_cache::optimize(mesh.indices, mesh.vertex_count);
+
+	if (triangles(optimized) != triangles(mesh.indices))
+	{
+		printf("FAIL %s: optimize changed the triangles or their winding\n", mesh.name);
+		return false;
+	}
+
+	auto renumbered = optimized;
+	const auto order = vertex_cache::optimize_fetch(renumbered, mesh.vertex_count);
+
+	std::vector<uint16_t> fetched;
+
+	for (auto i : renumbered)
+	{
+		if (i >= order.size())
+		{
+			printf("FAIL %s: vertex %u is past the %zu vertices in the fetch order\n", mesh.name, i, order.size());
+			return false;
+		}
+
+		fetched.push_back(order[i]);
+	}
+
+	if (fetched != optimized)
+	{
+		printf("FAIL %s: the renumbered vertices don't fetch the optimized triangles\n", mesh.name);
+		return false;
+	}
+
+	// Vertices must be numbered in the order they're first used.
+	uint16_t next = 0;
+
+	for (auto i : renumbered)
+	{
+		if (i > next)
+		{
+			printf("FAIL %s: vertex %u is used before vertex %u\n", mesh.name, i, next);
+			return false;
+		}
+
+		if (i == next)
+		{
+			++next;
+		}
+	}
+
+	const auto before = vertex_cache::measure(mesh.indices, mesh.vertex_count);
+	const auto after  = vertex_cache::measure(renumbered, order.size());
+
+	if (after.misses > before.misses || after.triangles != before.triangles || after.vertices != before.vertices)
+	{
+		printf("FAIL %s: ACMR %.3f -> %.3f, %zu -> %zu vertices\n", mesh.name, before.acmr(), after.acmr(),
+		       before.vertices, after.vertices);
+		return false;
+	}
+
+	printf("ok   %-14s %6zu triangles, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", mesh.name, before.triangles,
+	       before.acmr(), after.acmr(), before.atvr(), after.atvr());
+	return true;
+}
+
+int main()
+{
+	const auto floor = grid("grid", 64, 64);
+
+	const Mesh meshes[] = {
+		{ "empty", {}, 0 },
+		{ "one triangle", { 0, 1, 2 }, 3 },
+		floor,
+		shuffled("shuffled grid", floor),
+		grid("long strip", 1000, 1),
+		fan("fan", 300),
+		soup("soup", 500, 3000),
+	};
+
+	bool result = true;
+
+	for (const auto& mesh : meshes)
+	{
+		result &= check(mesh);
+	}
+
+	// A shuffled grid is the case the optimizer exists for, so it must actually help.
+	const auto scrambled = shuffled("shuffled grid", floor);
+	const auto before = vertex_cache::measure(scrambled.indices, scrambled.vertex_count);
+	const auto after  = vertex_cache::measure(vertex_cache::optimize(scrambled.indices, scrambled.vertex_count), scrambled.vertex_count);
+
+	if (after.acmr() > before.acmr() * 0.5f)
+	{
+		printf("FAIL shuffled grid: ACMR only went from %.3f to %.3f\n", before.acmr(), after.acmr());
+		result = false;
+	}
+
+	// optimize_fetch reserves 0xFFFF, so it refuses meshes with more vertices than that.
+	std::vector<uint16_t> indices = { 0, 1, 0xFFFF };
+	const auto unchanged = indices;
+
+	if (!vertex_cache::optimize_fetch(indices, 0x10000).empty() || indices != unchanged)
+	{
+		printf("FAIL optimize_fetch renumbered a mesh with 65536 vertices\n");
+		result = false;
+	}
+
+	return result ? 0 : 1;
+}